@@ -0,0 +1,1152 @@
+#include "x86.h"
+#include <cstring>
+
+namespace {
+
+const char* const INT_REGISTERS[] = {"%edi", "%esi", "%edx", "%ecx", "%r8d", "%r9d"};
+const int INT_REGISTER_COUNT = 6;
+const int SSE_REGISTER_COUNT = 8;
+
+bool isFloating(Type type) {
+    return type == Type::FLOAT || type == Type::DOUBLE;
+}
+
+// The scalars this backend keeps in %eax or %xmm0.
+bool isScalar(Type type) {
+    return type == Type::INT || type == Type::BOOL || isFloating(type);
+}
+
+// C's usual arithmetic conversions over the scalars: bool promotes to int.
+Type arithmeticType(Type left, Type right) {
+    if (left == Type::DOUBLE || right == Type::DOUBLE) return Type::DOUBLE;
+    if (left == Type::FLOAT || right == Type::FLOAT) return Type::FLOAT;
+    return Type::INT;
+}
+
+bool isComparison(BinaryOp op) {
+    return op == BinaryOp::EQ || op == BinaryOp::NE || op == BinaryOp::LT || op == BinaryOp::GT ||
+           op == BinaryOp::LE || op == BinaryOp::GE;
+}
+
+// What a type the backend leaves out is called in its error.
+std::string describe(Type type) {
+    switch (type) {
+        case Type::STRING: return "strings";
+        case Type::CLASS: return "classes and structs";
+        case Type::ARRAY: case Type::SLICE: return "arrays";
+        case Type::MAP: return "maps";
+        case Type::VEC4F: case Type::VEC8F: case Type::VEC4D: case Type::VEC8I: return "vector types";
+        default: return "sized integers";
+    }
+}
+
+std::string memory(int offset, const std::string& base) {
+    return (offset ? std::to_string(offset) : "") + "(" + base + ")";
+}
+
+std::string immediate(long value) {
+    return "$" + std::to_string(value);
+}
+
+const char* suffix(Type type) {
+    return type == Type::FLOAT ? "ss" : "sd";
+}
+
+// Output without libc: bytes collect in a buffer that sl_flush writes to
+// fd 1, as the C runtime does. Only caller-saved registers are touched.
+const char* OUTPUT_RUNTIME = R"ASM(
+	.text
+sl_write_uint:
+	movq %rdi, %rax
+	xorl %r9d, %r9d
+	jmp .Lsl_digits
+sl_write_int:
+	movq %rdi, %rax
+	xorl %r9d, %r9d
+	testq %rax, %rax
+	jns .Lsl_digits
+	negq %rax
+	movl $1, %r9d
+.Lsl_digits:
+	leaq sl_scratch+24(%rip), %rsi
+	movq %rsi, %r8
+	movl $10, %ecx
+1:	xorl %edx, %edx
+	divq %rcx
+	addb $48, %dl
+	decq %rsi
+	movb %dl, (%rsi)
+	testq %rax, %rax
+	jnz 1b
+	testl %r9d, %r9d
+	jz 2f
+	decq %rsi
+	movb $45, (%rsi)
+2:	movq %r8, %rdx
+	subq %rsi, %rdx
+	jmp sl_out_write
+sl_write_bool:
+	leaq .Lsl_true(%rip), %rsi
+	movl $4, %edx
+	testl %edi, %edi
+	jnz sl_out_write
+	leaq .Lsl_false(%rip), %rsi
+	movl $5, %edx
+	jmp sl_out_write
+sl_write_newline:
+	leaq .Lsl_newline(%rip), %rsi
+	movl $1, %edx
+sl_out_write:
+	movq sl_out_len(%rip), %rax
+	leaq (%rax,%rdx), %rcx
+	cmpq $65536, %rcx
+	jbe 1f
+	pushq %rsi
+	pushq %rdx
+	call sl_flush
+	popq %rdx
+	popq %rsi
+	xorl %eax, %eax
+1:	leaq sl_out_buffer(%rip), %rdi
+	addq %rax, %rdi
+	addq %rdx, %rax
+	movq %rax, sl_out_len(%rip)
+	movq %rdx, %rcx
+	rep movsb
+	ret
+sl_flush:
+	leaq sl_out_buffer(%rip), %rsi
+	movq sl_out_len(%rip), %rdx
+1:	testq %rdx, %rdx
+	jz 2f
+	movl $1, %edi
+	movl $1, %eax
+	syscall
+	cmpq $-4, %rax
+	je 1b
+	testq %rax, %rax
+	jle 2f
+	addq %rax, %rsi
+	subq %rax, %rdx
+	jmp 1b
+2:	movq $0, sl_out_len(%rip)
+	ret
+
+	.section .rodata
+.Lsl_true:
+	.ascii "true"
+.Lsl_false:
+	.ascii "false"
+.Lsl_newline:
+	.ascii "\n"
+
+	.bss
+	.p2align 4
+sl_out_buffer:
+	.zero 65536
+sl_out_len:
+	.zero 8
+sl_scratch:
+	.zero 24
+)ASM";
+
+} // namespace
+
+X86Generator::X86Generator()
+    : labels(0), usesOutput(false), returnType(Type::VOID), slots(0), maxSlots(0), depth(0), line(0),
+      lastLine(0), fileScope(false), resultType(Type::INT) {}
+
+bool X86Generator::generate(ProgramNode* root) {
+    root->accept(this);
+    return errors.empty();
+}
+
+void X86Generator::unsupported(const std::string& what, int line) {
+    std::stringstream ss;
+    ss << "Line " << line << ": " << what << " are not supported by --asm";
+    errors.push_back(ss.str());
+}
+
+bool X86Generator::supported(Type type, const std::string& className, int line) {
+    if (isScalar(type)) return true;
+    unsupported(describe(type), line);
+    return false;
+}
+
+void X86Generator::emit(const std::string& instruction) {
+    body << "\t" << instruction << "\n";
+}
+
+std::string X86Generator::newLabel() {
+    return ".L" + std::to_string(++labels);
+}
+
+void X86Generator::placeLabel(const std::string& label) {
+    body << label << ":\n";
+}
+
+void X86Generator::enterScope() {
+    scopes.emplace_back();
+    scopeSlots.push_back(slots);
+}
+
+void X86Generator::exitScope() {
+    slots = scopeSlots.back();
+    scopeSlots.pop_back();
+    scopes.pop_back();
+}
+
+X86Generator::Variable* X86Generator::lookup(const std::string& name) {
+    for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+        auto it = scope->find(name);
+        if (it != scope->end()) return &it->second;
+    }
+    return nullptr;
+}
+
+// A global symbol at file scope, otherwise the next stack slot. The caller
+// enters it into the scope once its initializer has been generated.
+X86Generator::Variable X86Generator::newVariable(Type type, const std::string& name) {
+    Variable var;
+    var.type = type;
+    if (fileScope) {
+        var.symbol = name;
+        globals.push_back(name);
+    } else {
+        var.offset = -8 * ++slots;
+        if (slots > maxSlots) maxSlots = slots;
+    }
+    return var;
+}
+
+std::string X86Generator::location(const Variable& var) {
+    return var.symbol.empty() ? memory(var.offset, "%rbp") : var.symbol + "(%rip)";
+}
+
+void X86Generator::load(Type type, const std::string& from) {
+    if (isFloating(type)) {
+        emit(std::string("mov") + suffix(type) + " " + from + ", %xmm0");
+    } else {
+        emit("movl " + from + ", %eax");
+    }
+}
+
+void X86Generator::store(Type type, const std::string& to) {
+    if (isFloating(type)) {
+        emit(std::string("mov") + suffix(type) + " %xmm0, " + to);
+    } else {
+        emit("movl %eax, " + to);
+    }
+}
+
+void X86Generator::push(Type type) {
+    if (isFloating(type)) {
+        emit("subq $8, %rsp");
+        emit("movsd %xmm0, (%rsp)");
+    } else {
+        emit("pushq %rax");
+    }
+    ++depth;
+}
+
+void X86Generator::pop(Type type) {
+    if (isFloating(type)) {
+        emit("movsd (%rsp), %xmm0");
+        emit("addq $8, %rsp");
+    } else {
+        emit("popq %rax");
+    }
+    --depth;
+}
+
+Type X86Generator::expression(ExpressionNode* expr) {
+    expr->accept(this);
+    return resultType;
+}
+
+void X86Generator::expressionAs(ExpressionNode* expr, Type to) {
+    convert(expression(expr), to);
+    resultType = to;
+}
+
+// Converts the value in %eax or %xmm0 as a C cast would.
+void X86Generator::convert(Type from, Type to) {
+    if (from == to || !isScalar(from) || !isScalar(to)) return;
+    if (to == Type::BOOL) {
+        if (isFloating(from)) {
+            emit(std::string("xorp") + (from == Type::FLOAT ? "s" : "d") + " %xmm1, %xmm1");
+            emit(std::string("ucomi") + suffix(from) + " %xmm1, %xmm0");
+            emit("setne %al");
+            emit("setp %cl");
+            emit("orb %cl, %al");
+        } else {
+            emit("testl %eax, %eax");
+            emit("setne %al");
+        }
+        emit("movzbl %al, %eax");
+    } else if (to == Type::INT) {
+        if (isFloating(from)) {
+            emit(std::string("cvtt") + suffix(from) + "2si %xmm0, %eax");
+        }
+    } else if (!isFloating(from)) {
+        emit(std::string("cvtsi2") + suffix(to) + "l %eax, %xmm0");
+    } else {
+        emit(to == Type::DOUBLE ? "cvtss2sd %xmm0, %xmm0" : "cvtsd2ss %xmm0, %xmm0");
+    }
+}
+
+// Brings left, already in %eax or %xmm0, and right to their common type,
+// with right in %ecx or %xmm1. Returns that type.
+Type X86Generator::operands(Type leftType, ExpressionNode* right) {
+    Type common;
+    if (!secondOperand(leftType, right, common)) {
+        push(leftType);
+        Type rightType = expression(right);
+        common = arithmeticType(leftType, rightType);
+        convert(rightType, common);
+        emit(isFloating(common) ? "movapd %xmm0, %xmm1" : "movl %eax, %ecx");
+        pop(leftType);
+    }
+    convert(leftType, common);
+    return common;
+}
+
+// Sets the flags for a comparison of the operands. ucomis sets CF for
+// "below" and for NaN, so floating-point < and <= compare the other way
+// round and test "above".
+void X86Generator::compare(BinaryOp op, Type common) {
+    if (!isFloating(common)) {
+        emit("cmpl %ecx, %eax");
+    } else if (op == BinaryOp::LT || op == BinaryOp::LE) {
+        emit(std::string("ucomi") + suffix(common) + " %xmm0, %xmm1");
+    } else {
+        emit(std::string("ucomi") + suffix(common) + " %xmm1, %xmm0");
+    }
+}
+
+// left op right with left already in %eax or %xmm0. Returns the type of
+// the result.
+Type X86Generator::binary(BinaryOp op, Type leftType, ExpressionNode* right) {
+    // Division by a power of two shifts, rounding toward zero as idiv does;
+    // gcc does the same even at -O0.
+    auto* divisor = dynamic_cast<LiteralNode*>(right);
+    bool divides = op == BinaryOp::DIV || op == BinaryOp::SLASH_ASSIGN || op == BinaryOp::MOD;
+    if (divides && divisor && divisor->literalType == Type::INT && !isFloating(leftType) && isScalar(leftType) &&
+        divisor->intValue > 1 && (divisor->intValue & (divisor->intValue - 1)) == 0) {
+        int shift = __builtin_ctz((unsigned)divisor->intValue);
+        emit("movl %eax, %edx");
+        emit("sarl $31, %edx");
+        emit("shrl " + immediate(32 - shift) + ", %edx");
+        emit("addl %edx, %eax");
+        if (op == BinaryOp::MOD) {
+            emit("andl " + immediate(divisor->intValue - 1) + ", %eax");
+            emit("subl %edx, %eax");
+        } else {
+            emit("sarl " + immediate(shift) + ", %eax");
+        }
+        return Type::INT;
+    }
+
+    Type common = operands(leftType, right);
+
+    if (isComparison(op)) {
+        compare(op, common);
+        if (isFloating(common)) {
+            switch (op) {
+                case BinaryOp::EQ: emit("sete %al"); emit("setnp %cl"); emit("andb %cl, %al"); break;
+                case BinaryOp::NE: emit("setne %al"); emit("setp %cl"); emit("orb %cl, %al"); break;
+                case BinaryOp::LT: case BinaryOp::GT: emit("seta %al"); break;
+                default: emit("setae %al"); break;
+            }
+        } else {
+            switch (op) {
+                case BinaryOp::EQ: emit("sete %al"); break;
+                case BinaryOp::NE: emit("setne %al"); break;
+                case BinaryOp::LT: emit("setl %al"); break;
+                case BinaryOp::GT: emit("setg %al"); break;
+                case BinaryOp::LE: emit("setle %al"); break;
+                default: emit("setge %al"); break;
+            }
+        }
+        emit("movzbl %al, %eax");
+        return Type::BOOL;
+    }
+
+    if (isFloating(common)) {
+        std::string sse;
+        switch (op) {
+            case BinaryOp::ADD: case BinaryOp::PLUS_ASSIGN: sse = "add"; break;
+            case BinaryOp::SUB: case BinaryOp::MINUS_ASSIGN: sse = "sub"; break;
+            case BinaryOp::MUL: case BinaryOp::STAR_ASSIGN: sse = "mul"; break;
+            case BinaryOp::DIV: case BinaryOp::SLASH_ASSIGN: sse = "div"; break;
+            default: unsupported("floating-point remainders", line); return common;
+        }
+        emit(sse + suffix(common) + " %xmm1, %xmm0");
+        return common;
+    }
+    switch (op) {
+        case BinaryOp::ADD: case BinaryOp::PLUS_ASSIGN: emit("addl %ecx, %eax"); break;
+        case BinaryOp::SUB: case BinaryOp::MINUS_ASSIGN: emit("subl %ecx, %eax"); break;
+        case BinaryOp::MUL: case BinaryOp::STAR_ASSIGN: emit("imull %ecx, %eax"); break;
+        case BinaryOp::DIV: case BinaryOp::SLASH_ASSIGN: emit("cltd"); emit("idivl %ecx"); break;
+        default: emit("cltd"); emit("idivl %ecx"); emit("movl %edx, %eax"); break;
+    }
+    return Type::INT;
+}
+
+// A literal or variable on the right goes straight into %ecx or %xmm1,
+// converted on the way, without saving the left operand on the stack.
+bool X86Generator::secondOperand(Type leftType, ExpressionNode* right, Type& common) {
+    auto* literal = dynamic_cast<LiteralNode*>(right);
+    auto* var = dynamic_cast<VarNode*>(right);
+    Variable* variable = var && !var->isField ? lookup(var->name) : nullptr;
+    Type rightType = literal ? literal->literalType : variable ? variable->type : Type::VOID;
+    if (!isScalar(leftType) || !isScalar(rightType)) return false;
+    common = arithmeticType(leftType, rightType);
+
+    if (literal) {
+        if (!isFloating(common)) {
+            emit("movl " + immediate(literal->literalType == Type::BOOL ? literal->boolValue : literal->intValue) +
+                 ", %ecx");
+        } else if (common == Type::FLOAT) {
+            float value = literal->literalType == Type::FLOAT ? literal->floatValue
+                          : literal->literalType == Type::BOOL ? (float)literal->boolValue
+                                                               : (float)literal->intValue;
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            emit("movl " + immediate(bits) + ", %edx");
+            emit("movd %edx, %xmm1");
+        } else {
+            double value = literal->literalType == Type::DOUBLE  ? literal->doubleValue
+                           : literal->literalType == Type::FLOAT ? (double)literal->floatValue
+                           : literal->literalType == Type::BOOL  ? (double)literal->boolValue
+                                                                 : (double)literal->intValue;
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            emit("movabsq " + immediate((long)bits) + ", %rdx");
+            emit("movq %rdx, %xmm1");
+        }
+        return true;
+    }
+
+    std::string from = location(*variable);
+    if (!isFloating(common)) {
+        emit("movl " + from + ", %ecx");
+    } else if (!isFloating(rightType)) {
+        emit(std::string("cvtsi2") + suffix(common) + "l " + from + ", %xmm1");
+    } else if (rightType != common) {
+        emit("cvtss2sd " + from + ", %xmm1");
+    } else {
+        emit(std::string("mov") + suffix(common) + " " + from + ", %xmm1");
+    }
+    return true;
+}
+
+// Jumps to falseLabel unless expr holds; && and || only evaluate what they
+// need.
+void X86Generator::condition(ExpressionNode* expr, const std::string& falseLabel) {
+    auto* bin = dynamic_cast<BinaryExprNode*>(expr);
+    if (bin && bin->op == BinaryOp::AND) {
+        condition(bin->left.get(), falseLabel);
+        condition(bin->right.get(), falseLabel);
+        return;
+    }
+    if (bin && bin->op == BinaryOp::OR) {
+        std::string rightLabel = newLabel();
+        std::string trueLabel = newLabel();
+        condition(bin->left.get(), rightLabel);
+        emit("jmp " + trueLabel);
+        placeLabel(rightLabel);
+        condition(bin->right.get(), falseLabel);
+        placeLabel(trueLabel);
+        return;
+    }
+    if (bin && isComparison(bin->op)) {
+        Type left = expression(bin->left.get());
+        if (isScalar(left)) {
+            Type common = operands(left, bin->right.get());
+            compare(bin->op, common);
+            if (isFloating(common)) {
+                // Unordered operands compare false, except for !=.
+                switch (bin->op) {
+                    case BinaryOp::EQ: emit("jne " + falseLabel); emit("jp " + falseLabel); break;
+                    case BinaryOp::NE: {
+                        std::string holds = newLabel();
+                        emit("jp " + holds);
+                        emit("je " + falseLabel);
+                        placeLabel(holds);
+                        break;
+                    }
+                    case BinaryOp::LT: case BinaryOp::GT: emit("jbe " + falseLabel); break;
+                    default: emit("jb " + falseLabel); break;
+                }
+            } else {
+                switch (bin->op) {
+                    case BinaryOp::EQ: emit("jne " + falseLabel); break;
+                    case BinaryOp::NE: emit("je " + falseLabel); break;
+                    case BinaryOp::LT: emit("jge " + falseLabel); break;
+                    case BinaryOp::GT: emit("jle " + falseLabel); break;
+                    case BinaryOp::LE: emit("jg " + falseLabel); break;
+                    default: emit("jl " + falseLabel); break;
+                }
+            }
+            return;
+        }
+    }
+    expressionAs(expr, Type::BOOL);
+    emit("testl %eax, %eax");
+    emit("jz " + falseLabel);
+}
+
+// ++ and -- leave the old value in %eax or %xmm0 when postfix and the new
+// one when prefix.
+void X86Generator::increment(const Variable& var, bool up, bool prefix) {
+    std::string where = location(var);
+    if (!isFloating(var.type)) {
+        emit("movl " + where + ", %eax");
+        emit(std::string(up ? "leal 1(%rax)" : "leal -1(%rax)") + ", %ecx");
+        if (var.type == Type::BOOL) {
+            emit("testl %ecx, %ecx");
+            emit("setne %cl");
+            emit("movzbl %cl, %ecx");
+        }
+        emit("movl %ecx, " + where);
+        if (prefix) emit("movl %ecx, %eax");
+        return;
+    }
+    std::string sse = suffix(var.type);
+    if (var.type == Type::FLOAT) {
+        emit("movl $0x3f800000, %eax");
+        emit("movd %eax, %xmm1");
+    } else {
+        emit("movabsq $0x3ff0000000000000, %rax");
+        emit("movq %rax, %xmm1");
+    }
+    emit("mov" + sse + " " + where + ", %xmm0");
+    emit("movapd %xmm0, %xmm2");
+    emit((up ? "add" : "sub") + sse + " %xmm1, %xmm2");
+    emit("mov" + sse + " %xmm2, " + where);
+    if (prefix) emit("movapd %xmm2, %xmm0");
+}
+
+// System V call: the first six integer and eight floating-point arguments
+// go in registers, the rest on the stack in order, and %rsp is 16-byte
+// aligned at the call. Every argument is evaluated into a slot reserved
+// below the temporaries first, so nested calls cannot disturb the ones
+// already computed.
+void X86Generator::call(const std::string& symbol, const std::vector<ExpressionNode*>& arguments,
+                        const std::vector<Type>& parameters) {
+    std::vector<std::string> registers(arguments.size());
+    int ints = 0;
+    int sses = 0;
+    int inRegisters = 0;
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        if (isFloating(parameters[i]) && sses < SSE_REGISTER_COUNT) {
+            registers[i] = "%xmm" + std::to_string(sses++);
+        } else if (!isFloating(parameters[i]) && ints < INT_REGISTER_COUNT) {
+            registers[i] = INT_REGISTERS[ints++];
+        }
+        if (!registers[i].empty()) ++inRegisters;
+    }
+    int onStack = (int)arguments.size() - inRegisters;
+    int padding = (depth + onStack) % 2;
+    int reserved = inRegisters + onStack + padding;
+    if (reserved > 0) {
+        emit("subq " + immediate(8 * reserved) + ", %rsp");
+        depth += reserved;
+    }
+
+    // Register arguments take the lowest slots so they can be dropped
+    // before the call, leaving the stack arguments on top.
+    std::vector<int> slot(arguments.size());
+    int nextRegister = 0;
+    int nextStack = inRegisters;
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        slot[i] = registers[i].empty() ? nextStack++ : nextRegister++;
+        expressionAs(arguments[i], parameters[i]);
+        store(parameters[i], memory(8 * slot[i], "%rsp"));
+    }
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        if (registers[i].empty()) continue;
+        std::string from = memory(8 * slot[i], "%rsp");
+        if (isFloating(parameters[i])) {
+            emit(std::string("mov") + suffix(parameters[i]) + " " + from + ", " + registers[i]);
+        } else {
+            emit("movl " + from + ", " + registers[i]);
+        }
+    }
+    if (inRegisters > 0) {
+        emit("addq " + immediate(8 * inRegisters) + ", %rsp");
+    }
+    emit("call " + symbol);
+    if (onStack + padding > 0) {
+        emit("addq " + immediate(8 * (onStack + padding)) + ", %rsp");
+    }
+    depth -= reserved;
+}
+
+// The output built-ins, in the runtime that emitRuntime appends. Returns
+// false for the built-ins this backend leaves out.
+bool X86Generator::builtin(CallExprNode* node) {
+    const std::string& name = node->functionName;
+    if (name == "write_newline" || name == "flush") {
+        emit(name == "flush" ? "call sl_flush" : "call sl_write_newline");
+    } else if (name == "write_int" || name == "write_uint" || name == "write_bool") {
+        Type type = expression(node->arguments[0].get());
+        if (name == "write_bool") {
+            convert(type, Type::BOOL);
+            emit("movl %eax, %edi");
+        } else if (isFloating(type)) {
+            if (name == "write_uint") {
+                unsupported("conversions of floating-point values to u64", node->line);
+            }
+            emit(std::string("cvtt") + suffix(type) + "2siq %xmm0, %rdi");
+        } else if (type == Type::BOOL) {
+            emit("movl %eax, %edi");
+        } else {
+            emit("movslq %eax, %rdi");
+        }
+        emit("call sl_" + name);
+    } else {
+        return false;
+    }
+    usesOutput = true;
+    resultType = Type::VOID;
+    return true;
+}
+
+void X86Generator::statement(StatementNode* stmt) {
+    if (stmt->line) {
+        line = stmt->line;
+    }
+    if (line != lastLine && !sourceFile.empty()) {
+        emit(".loc 1 " + std::to_string(line));
+        lastLine = line;
+    }
+    stmt->accept(this);
+}
+
+void X86Generator::generateFunction(FunctionNode* node) {
+    returnType = node->returnType;
+    returnLabel = newLabel();
+    slots = maxSlots = depth = 0;
+    lastLine = 0;
+    line = node->line;
+    if (node->returnType != Type::VOID) {
+        supported(node->returnType, node->returnClass, node->line);
+    }
+
+    // Register parameters are stored to slots; stack ones stay where the
+    // caller put them, above the return address.
+    enterScope();
+    int ints = 0;
+    int sses = 0;
+    int stackOffset = 16;
+    for (size_t i = 0; i < node->parameters.size(); ++i) {
+        const auto& param = node->parameters[i];
+        std::string className = i < node->parameterClasses.size() ? node->parameterClasses[i] : "";
+        if (!supported(param.second, className, node->line)) continue;
+        Variable var;
+        var.type = param.second;
+        bool floating = isFloating(param.second);
+        if (floating ? sses < SSE_REGISTER_COUNT : ints < INT_REGISTER_COUNT) {
+            var = newVariable(param.second, param.first);
+            std::string reg = floating ? "%xmm" + std::to_string(sses++) : INT_REGISTERS[ints++];
+            emit((floating ? std::string("mov") + suffix(param.second) : std::string("movl")) + " " + reg + ", " +
+                 location(var));
+        } else {
+            var.offset = stackOffset;
+            stackOffset += 8;
+        }
+        scopes.back()[param.first] = var;
+    }
+    if (node->body) {
+        node->body->accept(this);
+    }
+    exitScope();
+    finishFunction(node->name, node->name == "main");
+}
+
+// Wraps the body in the frame now that its size is known. Falling off the
+// end returns 0, which is what main needs.
+void X86Generator::finishFunction(const std::string& symbol, bool exported) {
+    int frame = (8 * maxSlots + 15) / 16 * 16;
+    output << "\n\t.text\n";
+    if (exported) {
+        output << "\t.globl " << symbol << "\n";
+    }
+    output << "\t.type " << symbol << ", @function\n";
+    output << symbol << ":\n";
+    output << "\tpushq %rbp\n";
+    output << "\tmovq %rsp, %rbp\n";
+    if (frame > 0) {
+        output << "\tsubq $" << frame << ", %rsp\n";
+    }
+    output << body.str();
+    output << "\txorl %eax, %eax\n";
+    output << returnLabel << ":\n";
+    output << "\tleave\n";
+    output << "\tret\n";
+    output << "\t.size " << symbol << ", .-" << symbol << "\n";
+    body.str("");
+}
+
+// _start runs the global initializers and main, flushes the output and
+// exits with what main returned.
+void X86Generator::emitRuntime(bool hasInit, Type mainType) {
+    output << "\n\t.text\n";
+    output << "\t.globl _start\n";
+    output << "_start:\n";
+    output << "\txorl %ebp, %ebp\n";
+    if (hasInit) {
+        output << "\tcall sl_init\n";
+    }
+    output << "\tcall main\n";
+    if (mainType == Type::VOID) {
+        output << "\txorl %eax, %eax\n";
+    }
+    output << "\tmovl %eax, %ebx\n";
+    if (usesOutput) {
+        output << "\tcall sl_flush\n";
+    }
+    output << "\tmovl %ebx, %edi\n";
+    output << "\tmovl $231, %eax\n"; // exit_group
+    output << "\tsyscall\n";
+    if (usesOutput) {
+        output << OUTPUT_RUNTIME;
+    }
+    if (!globals.empty()) {
+        output << "\n\t.bss\n";
+        output << "\t.p2align 3\n";
+        for (const auto& global : globals) {
+            output << global << ":\n";
+            output << "\t.zero 8\n";
+        }
+    }
+    output << "\n\t.section .note.GNU-stack,\"\",@progbits\n";
+}
+
+void X86Generator::visit(ProgramNode* node) {
+    if (!node->classes.empty()) {
+        unsupported("classes and structs", node->classes.front()->line);
+        return;
+    }
+    std::vector<FunctionNode*> bodies;
+    for (auto& func : node->functions) {
+        bodies.push_back(func.get());
+    }
+    for (auto& templ : node->templates) {
+        for (auto& instance : templ->instances) {
+            bodies.push_back(instance.get());
+        }
+    }
+    for (FunctionNode* func : bodies) {
+        functions[func->name] = func;
+    }
+    auto main = functions.find("main");
+    if (main == functions.end()) {
+        errors.push_back("Line 1: --asm needs a main function");
+        return;
+    }
+
+    if (!sourceFile.empty()) {
+        output << "\t.file 1 \"" << sourceFile << "\"\n";
+    }
+
+    // sl_init assigns the globals, which start out zero.
+    scopes.emplace_back();
+    fileScope = true;
+    bool hasInit = false;
+    for (auto& global : node->globals) {
+        statement(global.get());
+        hasInit = hasInit || global->initializer;
+    }
+    fileScope = false;
+    returnLabel = newLabel();
+    if (hasInit) {
+        finishFunction("sl_init", false);
+    }
+    body.str("");
+
+    for (FunctionNode* func : bodies) {
+        generateFunction(func);
+    }
+    emitRuntime(hasInit, main->second->returnType);
+}
+
+void X86Generator::visit(DirectiveNode* node) {
+}
+
+void X86Generator::visit(FunctionNode* node) {
+}
+
+void X86Generator::visit(TemplateNode* node) {
+}
+
+void X86Generator::visit(ClassNode* node) {
+    unsupported("classes and structs", node->line);
+}
+
+void X86Generator::visit(MethodNode* node) {
+    unsupported("classes and structs", node->line);
+}
+
+void X86Generator::visit(ConstructorNode* node) {
+    unsupported("classes and structs", node->line);
+}
+
+void X86Generator::visit(BlockNode* node) {
+    enterScope();
+    for (auto& stmt : node->statements) {
+        statement(stmt.get());
+    }
+    exitScope();
+}
+
+// Locals without an initializer start at zero, like globals.
+void X86Generator::visit(VarDeclNode* node) {
+    if (node->isArray) {
+        unsupported("arrays", node->line);
+        return;
+    }
+    if (!supported(node->type, node->className, node->line)) return;
+    Variable var = newVariable(node->type, node->name);
+    if (node->initializer) {
+        expressionAs(node->initializer.get(), node->type);
+        store(node->type, location(var));
+    } else if (!fileScope) {
+        emit("movq $0, " + location(var));
+    }
+    scopes.back()[node->name] = var;
+}
+
+void X86Generator::visit(VarAssignNode* node) {
+    if (!node->field.empty() || node->isField) {
+        unsupported("classes and structs", node->line);
+        return;
+    }
+    if (node->index) {
+        unsupported(node->arrayKind == ArrayKind::MAP ? "maps" : "arrays", node->line);
+        return;
+    }
+    Variable* var = lookup(node->name);
+    if (!var) return;
+    if (node->assignOp != BinaryOp::ADD) { // plain = is parsed as ADD
+        load(var->type, location(*var));
+        convert(binary(node->assignOp, var->type, node->value.get()), var->type);
+    } else {
+        expressionAs(node->value.get(), var->type);
+    }
+    store(var->type, location(*var));
+}
+
+void X86Generator::visit(ReturnNode* node) {
+    if (node->value && returnType != Type::VOID) {
+        expressionAs(node->value.get(), returnType);
+    }
+    emit("jmp " + returnLabel);
+}
+
+void X86Generator::visit(IfNode* node) {
+    std::string elseLabel = newLabel();
+    condition(node->condition.get(), elseLabel);
+    if (node->thenBlock) {
+        node->thenBlock->accept(this);
+    }
+    if (node->elseIf || node->elseBlock) {
+        std::string endLabel = newLabel();
+        emit("jmp " + endLabel);
+        placeLabel(elseLabel);
+        if (node->elseIf) {
+            statement(node->elseIf.get());
+        } else {
+            node->elseBlock->accept(this);
+        }
+        placeLabel(endLabel);
+    } else {
+        placeLabel(elseLabel);
+    }
+}
+
+void X86Generator::visit(WhileNode* node) {
+    std::string top = newLabel();
+    std::string end = newLabel();
+    placeLabel(top);
+    condition(node->condition.get(), end);
+    jumpTargets.push_back({true, end, top});
+    if (node->body) {
+        node->body->accept(this);
+    }
+    jumpTargets.pop_back();
+    emit("jmp " + top);
+    placeLabel(end);
+}
+
+// parallel for runs its iterations in order, which gives the result its
+// reductions compute.
+void X86Generator::visit(ForNode* node) {
+    enterScope();
+    if (node->init) {
+        statement(node->init.get());
+    }
+    std::string top = newLabel();
+    std::string step = newLabel();
+    std::string end = newLabel();
+    placeLabel(top);
+    if (node->condition) {
+        condition(node->condition.get(), end);
+    }
+    jumpTargets.push_back({true, end, step});
+    if (node->body) {
+        node->body->accept(this);
+    }
+    jumpTargets.pop_back();
+    placeLabel(step);
+    if (node->increment) {
+        expression(node->increment.get());
+    }
+    emit("jmp " + top);
+    placeLabel(end);
+    exitScope();
+}
+
+void X86Generator::visit(DoWhileNode* node) {
+    std::string top = newLabel();
+    std::string test = newLabel();
+    std::string end = newLabel();
+    placeLabel(top);
+    jumpTargets.push_back({true, end, test});
+    if (node->body) {
+        node->body->accept(this);
+    }
+    jumpTargets.pop_back();
+    placeLabel(test);
+    condition(node->condition.get(), end);
+    emit("jmp " + top);
+    placeLabel(end);
+}
+
+void X86Generator::visit(BinaryExprNode* node) {
+    if (node->op == BinaryOp::AND || node->op == BinaryOp::OR) {
+        std::string falseLabel = newLabel();
+        std::string endLabel = newLabel();
+        condition(node, falseLabel);
+        emit("movl $1, %eax");
+        emit("jmp " + endLabel);
+        placeLabel(falseLabel);
+        emit("xorl %eax, %eax");
+        placeLabel(endLabel);
+        resultType = Type::BOOL;
+        return;
+    }
+    Type left = expression(node->left.get());
+    if (!isScalar(left)) return;
+    resultType = binary(node->op, left, node->right.get());
+}
+
+void X86Generator::visit(UnaryExprNode* node) {
+    Type type = expression(node->operand.get());
+    if (node->op == UnaryOp::NOT) {
+        convert(type, Type::BOOL);
+        emit("xorl $1, %eax");
+        resultType = Type::BOOL;
+    } else if (type == Type::DOUBLE) {
+        emit("movq %xmm0, %rax");
+        emit("btcq $63, %rax");
+        emit("movq %rax, %xmm0");
+    } else if (type == Type::FLOAT) {
+        emit("movd %xmm0, %eax");
+        emit("xorl $0x80000000, %eax");
+        emit("movd %eax, %xmm0");
+    } else {
+        emit("negl %eax");
+        resultType = Type::INT;
+    }
+}
+
+void X86Generator::visit(CallExprNode* node) {
+    auto callee = functions.find(node->functionName);
+    if (callee == functions.end()) {
+        if (!builtin(node)) {
+            unsupported("calls to '" + node->functionName + "'", node->line);
+            resultType = node->type;
+        }
+        return;
+    }
+    FunctionNode* func = callee->second;
+    std::vector<ExpressionNode*> arguments;
+    std::vector<Type> parameters;
+    for (size_t i = 0; i < node->arguments.size(); ++i) {
+        arguments.push_back(node->arguments[i].get());
+        parameters.push_back(func->parameters[i].second);
+    }
+    call(func->name, arguments, parameters);
+    resultType = func->returnType;
+}
+
+void X86Generator::visit(LiteralNode* node) {
+    resultType = node->literalType;
+    switch (node->literalType) {
+        case Type::INT:
+            emit("movl " + immediate(node->intValue) + ", %eax");
+            break;
+        case Type::BOOL:
+            emit(node->boolValue ? "movl $1, %eax" : "xorl %eax, %eax");
+            break;
+        case Type::DOUBLE: {
+            uint64_t bits;
+            std::memcpy(&bits, &node->doubleValue, sizeof(bits));
+            emit("movabsq " + immediate((long)bits) + ", %rax");
+            emit("movq %rax, %xmm0");
+            break;
+        }
+        case Type::FLOAT: {
+            uint32_t bits;
+            std::memcpy(&bits, &node->floatValue, sizeof(bits));
+            emit("movl " + immediate(bits) + ", %eax");
+            emit("movd %eax, %xmm0");
+            break;
+        }
+        default:
+            unsupported(describe(node->literalType), node->line);
+    }
+}
+
+void X86Generator::visit(VarNode* node) {
+    Variable* var = node->isField ? nullptr : lookup(node->name);
+    if (!var) {
+        unsupported("classes and structs", node->line);
+        resultType = Type::INT;
+        return;
+    }
+    load(var->type, location(*var));
+    resultType = var->type;
+}
+
+void X86Generator::visit(ArrayAccessNode* node) {
+    unsupported(node->arrayKind == ArrayKind::MAP ? "maps" : "arrays", node->line);
+    resultType = node->type;
+}
+
+void X86Generator::visit(IncDecNode* node) {
+    Variable* var = node->isField ? nullptr : lookup(node->name);
+    if (!var) {
+        unsupported("classes and structs", node->line);
+        return;
+    }
+    increment(*var, node->isIncrement, true);
+}
+
+void X86Generator::visit(IncDecExprNode* node) {
+    Variable* var = node->isField ? nullptr : lookup(node->name);
+    if (!var) {
+        unsupported("classes and structs", node->line);
+        resultType = Type::INT;
+        return;
+    }
+    increment(*var, node->isIncrement, node->isPrefix);
+    resultType = var->type;
+}
+
+void X86Generator::visit(BreakNode* node) {
+    emit("jmp " + jumpTargets.back().breakLabel);
+}
+
+void X86Generator::visit(ContinueNode* node) {
+    for (auto target = jumpTargets.rbegin(); target != jumpTargets.rend(); ++target) {
+        if (target->isLoop) {
+            emit("jmp " + target->continueLabel);
+            return;
+        }
+    }
+}
+
+// A chain of compares in front of the case bodies, which follow each other
+// so that they fall through.
+void X86Generator::visit(SwitchNode* node) {
+    Type type = expression(node->expression.get());
+    if (!isScalar(type) || isFloating(type)) return;
+    std::vector<std::string> starts;
+    for (auto& caseNode : node->cases) {
+        starts.push_back(newLabel());
+        emit("cmpl " + immediate(caseNode->intValue) + ", %eax");
+        emit("je " + starts.back());
+    }
+    std::string defaultLabel = newLabel();
+    std::string end = newLabel();
+    emit("jmp " + defaultLabel);
+    jumpTargets.push_back({false, end, ""});
+    for (size_t i = 0; i < node->cases.size(); ++i) {
+        placeLabel(starts[i]);
+        node->cases[i]->accept(this);
+    }
+    placeLabel(defaultLabel);
+    if (node->defaultCase) {
+        node->defaultCase->accept(this);
+    }
+    jumpTargets.pop_back();
+    placeLabel(end);
+}
+
+void X86Generator::visit(CaseNode* node) {
+    if (node->block) {
+        node->block->accept(this);
+    }
+}
+
+void X86Generator::visit(TernaryExprNode* node) {
+    Type type = node->trueExpr->type;
+    if (isScalar(type) && isScalar(node->falseExpr->type) && type != node->falseExpr->type) {
+        type = arithmeticType(type, node->falseExpr->type);
+    }
+    std::string elseLabel = newLabel();
+    std::string endLabel = newLabel();
+    condition(node->condition.get(), elseLabel);
+    expressionAs(node->trueExpr.get(), type);
+    emit("jmp " + endLabel);
+    placeLabel(elseLabel);
+    expressionAs(node->falseExpr.get(), type);
+    placeLabel(endLabel);
+    resultType = type;
+}
+
+// The task runs right away on this thread; sync has nothing to wait for.
+void X86Generator::visit(SpawnNode* node) {
+    if (node->target.empty()) {
+        expression(node->call.get());
+        return;
+    }
+    Variable var;
+    if (node->declaresTarget) {
+        if (!supported(node->targetType, node->targetClass, node->line)) return;
+        var = newVariable(node->targetType, node->target);
+    } else {
+        Variable* existing = lookup(node->target);
+        if (!existing) return;
+        var = *existing;
+    }
+    expressionAs(node->call.get(), var.type);
+    store(var.type, location(var));
+    if (node->declaresTarget) {
+        scopes.back()[node->target] = var;
+    }
+}
+
+void X86Generator::visit(SyncNode* node) {
+}
+
+void X86Generator::visit(ExpressionStmtNode* node) {
+    if (node->expression) {
+        expression(node->expression.get());
+    }
+}
+
+void X86Generator::visit(FieldAccessNode* node) {
+    unsupported("classes and structs", node->line);
+    resultType = node->type;
+}
+
+void X86Generator::visit(SliceExprNode* node) {
+    unsupported(node->type == Type::STRING ? "strings" : "arrays", node->line);
+    resultType = node->type;
+}
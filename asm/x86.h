@@ -0,0 +1,138 @@
+#ifndef ASM_X86_H
+#define ASM_X86_H
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../ast/ast.h"
+
+// Writes x86-64 assembly (System V ABI, GNU as syntax) for `slc --asm`,
+// which is assembled with as and linked with ld: no C and no gcc, for quick
+// debug builds. The code is what gcc -O0 gives: every variable lives in its
+// stack slot, expressions are evaluated in %eax or %xmm0 and temporaries go
+// on the stack. Covers int, bool, float and double functions and globals,
+// all control flow and the integer and bool output built-ins; spawn and
+// parallel for run in order, as under --run. Programs using anything else
+// are reported and compiled through C instead.
+class X86Generator : public ASTVisitor {
+private:
+    struct Variable {
+        Type type = Type::INT;
+        int offset = 0;     // from %rbp, for locals and parameters
+        std::string symbol; // for globals
+    };
+
+    // Innermost loop or switch.
+    struct JumpTarget {
+        bool isLoop;
+        std::string breakLabel;
+        std::string continueLabel;
+    };
+
+    std::vector<std::string> errors;
+    std::string sourceFile;
+    std::stringstream output; // finished functions
+    std::stringstream body;   // the function being generated
+    std::map<std::string, FunctionNode*> functions;
+    std::vector<std::map<std::string, Variable>> scopes; // globals first
+    std::vector<int> scopeSlots;
+    std::vector<JumpTarget> jumpTargets;
+    std::vector<std::string> globals;
+    int labels;
+    bool usesOutput;
+
+    // State of the function being generated.
+    Type returnType;
+    std::string returnLabel;
+    int slots;    // 8-byte stack slots in use
+    int maxSlots;
+    int depth;    // 8-byte temporaries pushed below the slots
+    int line;
+    int lastLine; // last line given to .loc
+    bool fileScope;
+
+    Type resultType; // type of the value in %eax or %xmm0
+
+    void unsupported(const std::string& what, int line);
+    bool supported(Type type, const std::string& className, int line);
+
+    void emit(const std::string& instruction);
+    std::string newLabel();
+    void placeLabel(const std::string& label);
+
+    void enterScope();
+    void exitScope();
+    Variable* lookup(const std::string& name);
+    Variable newVariable(Type type, const std::string& name);
+    static std::string location(const Variable& var);
+    void load(Type type, const std::string& from);
+    void store(Type type, const std::string& to);
+    void push(Type type);
+    void pop(Type type);
+
+    Type expression(ExpressionNode* expr);
+    void expressionAs(ExpressionNode* expr, Type to);
+    void convert(Type from, Type to);
+    Type operands(Type leftType, ExpressionNode* right);
+    bool secondOperand(Type leftType, ExpressionNode* right, Type& common);
+    void compare(BinaryOp op, Type common);
+    Type binary(BinaryOp op, Type leftType, ExpressionNode* right);
+    void condition(ExpressionNode* expr, const std::string& falseLabel);
+    void increment(const Variable& var, bool up, bool prefix);
+    void call(const std::string& symbol, const std::vector<ExpressionNode*>& arguments,
+              const std::vector<Type>& parameters);
+    bool builtin(CallExprNode* node);
+    void statement(StatementNode* stmt);
+    void generateFunction(FunctionNode* node);
+    void finishFunction(const std::string& symbol, bool exported);
+    void emitRuntime(bool hasInit, Type mainType);
+
+public:
+    X86Generator();
+
+    // The .sl file, named in the line table for debuggers.
+    void setSourceFile(const std::string& path) { sourceFile = path; }
+
+    // Returns false and fills getErrors() when the program uses something
+    // this backend does not cover.
+    bool generate(ProgramNode* root);
+    std::string getAssembly() const { return output.str(); }
+    const std::vector<std::string>& getErrors() const { return errors; }
+
+    void visit(ProgramNode* node) override;
+    void visit(DirectiveNode* node) override;
+    void visit(FunctionNode* node) override;
+    void visit(TemplateNode* node) override;
+    void visit(ClassNode* node) override;
+    void visit(MethodNode* node) override;
+    void visit(ConstructorNode* node) override;
+    void visit(BlockNode* node) override;
+    void visit(VarDeclNode* node) override;
+    void visit(VarAssignNode* node) override;
+    void visit(ReturnNode* node) override;
+    void visit(IfNode* node) override;
+    void visit(WhileNode* node) override;
+    void visit(ForNode* node) override;
+    void visit(BinaryExprNode* node) override;
+    void visit(UnaryExprNode* node) override;
+    void visit(CallExprNode* node) override;
+    void visit(LiteralNode* node) override;
+    void visit(VarNode* node) override;
+    void visit(ArrayAccessNode* node) override;
+    void visit(IncDecNode* node) override;
+    void visit(IncDecExprNode* node) override;
+    void visit(DoWhileNode* node) override;
+    void visit(BreakNode* node) override;
+    void visit(ContinueNode* node) override;
+    void visit(SwitchNode* node) override;
+    void visit(CaseNode* node) override;
+    void visit(TernaryExprNode* node) override;
+    void visit(SpawnNode* node) override;
+    void visit(SyncNode* node) override;
+    void visit(ExpressionStmtNode* node) override;
+    void visit(FieldAccessNode* node) override;
+    void visit(SliceExprNode* node) override;
+};
+
+#endif // ASM_X86_H
@@ -118,6 +118,27 @@ void IncDecExprNode::accept(ASTVisitor* visitor) {
 void TernaryExprNode::accept(ASTVisitor* visitor) {
     visitor->visit(this);
 }
+
+void SpawnNode::accept(ASTVisitor* visitor) {
+    visitor->visit(this);
+}
+
+void SyncNode::accept(ASTVisitor* visitor) {
+    visitor->visit(this);
+}
+
+void ExpressionStmtNode::accept(ASTVisitor* visitor) {
+    visitor->visit(this);
+}
+
+void FieldAccessNode::accept(ASTVisitor* visitor) {
+    visitor->visit(this);
+}
+
+void SliceExprNode::accept(ASTVisitor* visitor) {
+    visitor->visit(this);
+}
+
 Type stringToType(const std::string& typeStr) {
     if (typeStr == "int") return Type::INT;
     if (typeStr == "double") return Type::DOUBLE;
@@ -125,6 +146,18 @@ Type stringToType(const std::string& typeStr) {
     if (typeStr == "string") return Type::STRING;
     if (typeStr == "bool") return Type::BOOL;
     if (typeStr == "void") return Type::VOID;
+    if (typeStr == "i8") return Type::I8;
+    if (typeStr == "i16") return Type::I16;
+    if (typeStr == "i32") return Type::I32;
+    if (typeStr == "i64") return Type::I64;
+    if (typeStr == "u8") return Type::U8;
+    if (typeStr == "u16") return Type::U16;
+    if (typeStr == "u32") return Type::U32;
+    if (typeStr == "u64") return Type::U64;
+    if (typeStr == "vec4f") return Type::VEC4F;
+    if (typeStr == "vec8f") return Type::VEC8F;
+    if (typeStr == "vec4d") return Type::VEC4D;
+    if (typeStr == "vec8i") return Type::VEC8I;
     return Type::VOID;
 }
 
@@ -136,10 +169,83 @@ std::string typeToString(Type type) {
         case Type::STRING: return "string";
         case Type::BOOL: return "bool";
         case Type::VOID: return "void";
+        case Type::I8: return "i8";
+        case Type::I16: return "i16";
+        case Type::I32: return "i32";
+        case Type::I64: return "i64";
+        case Type::U8: return "u8";
+        case Type::U16: return "u16";
+        case Type::U32: return "u32";
+        case Type::U64: return "u64";
+        case Type::VEC4F: return "vec4f";
+        case Type::VEC8F: return "vec8f";
+        case Type::VEC4D: return "vec4d";
+        case Type::VEC8I: return "vec8i";
+        case Type::CLASS: return "class";
+        case Type::ARRAY: return "array";
+        case Type::SLICE: return "slice";
+        case Type::MAP: return "map";
         default: return "void";
     }
 }
 
+// Element type of a growable array; names that are not built-in types
+// refer to classes.
+Type arrayElementType(const std::string& elementName) {
+    Type type = stringToType(elementName);
+    if (type == Type::VOID && elementName != "void") {
+        return Type::CLASS;
+    }
+    return type;
+}
+
+// A map stores its key and value type names as "key,value".
+std::string mapKeyName(const std::string& mapTypes) {
+    return mapTypes.substr(0, mapTypes.find(','));
+}
+
+std::string mapValueName(const std::string& mapTypes) {
+    size_t comma = mapTypes.find(',');
+    return comma == std::string::npos ? "" : mapTypes.substr(comma + 1);
+}
+
+bool isVectorType(Type type) {
+    return type == Type::VEC4F || type == Type::VEC8F || type == Type::VEC4D || type == Type::VEC8I;
+}
+
+bool isIntegerType(Type type) {
+    return integerBits(type) != 0;
+}
+
+bool isNumericType(Type type) {
+    return isIntegerType(type) || type == Type::DOUBLE || type == Type::FLOAT;
+}
+
+bool isUnsignedType(Type type) {
+    return type == Type::U8 || type == Type::U16 || type == Type::U32 || type == Type::U64;
+}
+
+// Width of an integer type; int is 32 bits wide. 0 for everything else.
+int integerBits(Type type) {
+    switch (type) {
+        case Type::I8: case Type::U8: return 8;
+        case Type::I16: case Type::U16: return 16;
+        case Type::INT: case Type::I32: case Type::U32: return 32;
+        case Type::I64: case Type::U64: return 64;
+        default: return 0;
+    }
+}
+
+Type vectorElementType(Type type) {
+    switch (type) {
+        case Type::VEC4F: return Type::FLOAT;
+        case Type::VEC8F: return Type::FLOAT;
+        case Type::VEC4D: return Type::DOUBLE;
+        case Type::VEC8I: return Type::INT;
+        default: return type;
+    }
+}
+
 std::string binaryOpToString(BinaryOp op) {
     switch (op) {
         case BinaryOp::ADD: return "+";
@@ -11,7 +11,23 @@ enum class Type {
     FLOAT,
     STRING,
     BOOL,
-    VOID
+    VOID,
+    I8,     // sized integers, lowered to <stdint.h> types
+    I16,
+    I32,
+    I64,
+    U8,
+    U16,
+    U32,
+    U64,
+    VEC4F,
+    VEC8F,
+    VEC4D,
+    VEC8I,
+    CLASS,  // instance of a user class; the class name is stored alongside
+    ARRAY,  // growable array; the element type name is stored alongside
+    SLICE,  // pointer/length view of array elements; element type name as for ARRAY
+    MAP     // hash map; "key,value" type names are stored alongside
 };
 
 enum class BinaryOp {
@@ -25,6 +41,15 @@ enum class UnaryOp {
     NOT, NEG
 };
 
+// Storage behind an indexed name.
+enum class ArrayKind {
+    FIXED,   // C array declared with a size
+    DYNAMIC, // growable T[]
+    SLICE,   // T[:] view
+    MAP,     // map<K, V>, indexed by key
+    BITS     // fixed bool array packed 64 elements per uint64_t word
+};
+
 class ASTNode;
 class ProgramNode;
 class DirectiveNode;
@@ -54,6 +79,39 @@ class ContinueNode;
 class SwitchNode;
 class CaseNode;
 class TernaryExprNode;
+class SpawnNode;
+class SyncNode;
+class ExpressionStmtNode;
+class FieldAccessNode;
+class SliceExprNode;
+
+struct FieldDecl {
+    std::string name;
+    Type type;
+    std::string className;
+    bool isPrivate = false;
+    int line = 0;
+};
+
+struct LoopAnnotation {
+    std::string name;
+    int argument = 0;
+};
+
+// A bounds check moved in front of a loop: every index in
+// [low + lowOffset, high + highOffset) must be valid for arrayName. A null
+// bound is the constant offset alone; non-null bounds point into the loop
+// header and are evaluated once before it.
+struct BoundsCheck {
+    std::string arrayName;
+    ArrayKind arrayKind = ArrayKind::FIXED;
+    std::string className;
+    ExpressionNode* low = nullptr;
+    long lowOffset = 0;
+    ExpressionNode* high = nullptr;
+    long highOffset = 0;
+    int line = 0;
+};
 
 class ASTNode {
 public:
@@ -85,8 +143,11 @@ class FunctionNode : public ASTNode {
 public:
     std::string name;
     Type returnType;
+    std::string returnClass;
     std::vector<std::pair<std::string, Type>> parameters;
+    std::vector<std::string> parameterClasses;
     std::unique_ptr<BlockNode> body;
+    bool external = false; // loaded by an earlier REPL entry: only declared
 
     void accept(ASTVisitor* visitor) override;
 };
@@ -95,6 +156,9 @@ class TemplateNode : public ASTNode {
 public:
     std::string templateParam;
     std::unique_ptr<FunctionNode> function;
+    // One function per type argument, added by semantic analysis as calls
+    // are checked; the generic function itself is never emitted.
+    std::vector<std::unique_ptr<FunctionNode>> instances;
 
     void accept(ASTVisitor* visitor) override;
 };
@@ -102,8 +166,12 @@ public:
 class ClassNode : public ASTNode {
 public:
     std::string name;
+    bool isValue = false; // declared with 'struct': copied, passed and returned by value
+    std::vector<std::string> annotations; // e.g. "soa" for @soa
+    std::vector<FieldDecl> fields;
     std::vector<std::unique_ptr<MethodNode>> methods;
     std::unique_ptr<ConstructorNode> constructor;
+    bool external = false; // loaded by an earlier REPL entry: only declared
 
     void accept(ASTVisitor* visitor) override;
 };
@@ -112,7 +180,9 @@ class MethodNode : public ASTNode {
 public:
     std::string name;
     Type returnType;
+    std::string returnClass;
     std::vector<std::pair<std::string, Type>> parameters;
+    std::vector<std::string> parameterClasses;
     std::unique_ptr<BlockNode> body;
     bool isPrivate;
 
@@ -123,6 +193,7 @@ class ConstructorNode : public ASTNode {
 public:
     std::string className;
     std::vector<std::pair<std::string, Type>> parameters;
+    std::vector<std::string> parameterClasses;
     std::unique_ptr<BlockNode> body;
 
     void accept(ASTVisitor* visitor) override;
@@ -143,11 +214,14 @@ public:
 class VarDeclNode : public StatementNode {
 public:
     Type type;
+    std::string className;
     std::string name;
     bool isArray;
     bool isConst;
     std::unique_ptr<ExpressionNode> arraySize;
     std::unique_ptr<ExpressionNode> initializer;
+    bool stackAllocated = false; // set by EscapeAnalyzer
+    bool external = false; // global loaded by an earlier REPL entry: only declared
 
     void accept(ASTVisitor* visitor) override;
 };
@@ -155,8 +229,14 @@ public:
 class VarAssignNode : public StatementNode {
 public:
     std::string name;
+    std::string field; // assignment to name.field
+    std::string objectClass; // class of the instances name holds, if any
+    ArrayKind arrayKind = ArrayKind::FIXED; // storage behind name when indexed
+    std::unique_ptr<ExpressionNode> index;
     std::unique_ptr<ExpressionNode> value;
     BinaryOp assignOp;
+    bool isField = false; // name is a field of the class being constructed
+    bool boundsCheck = true; // cleared by RangeAnalyzer when the index needs no check
 
     void accept(ASTVisitor* visitor) override;
 };
@@ -166,6 +246,7 @@ public:
     std::string name;
     bool isIncrement;
     bool isPrefix;
+    bool isField = false;
 
     void accept(ASTVisitor* visitor) override;
 };
@@ -191,6 +272,7 @@ class WhileNode : public StatementNode {
 public:
     std::unique_ptr<ExpressionNode> condition;
     std::unique_ptr<BlockNode> body;
+    std::vector<LoopAnnotation> annotations;
 
     void accept(ASTVisitor* visitor) override;
 };
@@ -217,6 +299,8 @@ class CaseNode : public ASTNode {
 public:
     std::unique_ptr<ExpressionNode> value;
     std::unique_ptr<BlockNode> block;
+    long intValue = 0;       // constant value of an int case, set by semantic analysis
+    std::string stringValue; // constant value of a string case
 
     void accept(ASTVisitor* visitor) override;
 };
@@ -236,13 +320,41 @@ public:
     std::unique_ptr<ExpressionNode> condition;
     std::unique_ptr<ExpressionNode> increment;
     std::unique_ptr<BlockNode> body;
+    std::vector<LoopAnnotation> annotations;
+    bool isParallel = false;
+    std::vector<std::pair<BinaryOp, std::string>> reductions;
+    std::vector<BoundsCheck> boundsChecks; // hoisted out of the body by RangeAnalyzer
+
+    void accept(ASTVisitor* visitor) override;
+};
+
+class SpawnNode : public StatementNode {
+public:
+    std::string target;
+    Type targetType;
+    std::string targetClass;
+    bool declaresTarget = false;
+    std::unique_ptr<ExpressionNode> call;
+
+    void accept(ASTVisitor* visitor) override;
+};
+
+class SyncNode : public StatementNode {
+public:
+    void accept(ASTVisitor* visitor) override;
+};
+
+class ExpressionStmtNode : public StatementNode {
+public:
+    std::unique_ptr<ExpressionNode> expression;
 
     void accept(ASTVisitor* visitor) override;
 };
 
 class ExpressionNode : public ASTNode {
 public:
-    Type type;
+    Type type = Type::VOID;
+    std::string className;
     void accept(ASTVisitor* visitor) override;
 };
 
@@ -275,7 +387,7 @@ class LiteralNode : public ExpressionNode {
 public:
     Type literalType;
     union {
-        int intValue;
+        long intValue;
         double doubleValue;
         float floatValue;
         bool boolValue;
@@ -284,19 +396,13 @@ public:
 
     void accept(ASTVisitor* visitor) override;
 
-    LiteralNode() : literalType(Type::INT), intValue(0) {
-        new (&stringValue) std::string();
-    }
-    ~LiteralNode() {
-        if (literalType == Type::STRING) {
-            stringValue.~basic_string();
-        }
-    }
+    LiteralNode() : literalType(Type::INT), intValue(0) {}
 };
 
 class VarNode : public ExpressionNode {
 public:
     std::string name;
+    bool isField = false; // set by semantic analysis inside constructors
 
     void accept(ASTVisitor* visitor) override;
 };
@@ -306,6 +412,7 @@ public:
     std::string name;
     bool isIncrement;
     bool isPrefix;
+    bool isField = false;
 
     void accept(ASTVisitor* visitor) override;
 };
@@ -323,6 +430,29 @@ class ArrayAccessNode : public ExpressionNode {
 public:
     std::string arrayName;
     std::unique_ptr<ExpressionNode> index;
+    ArrayKind arrayKind = ArrayKind::FIXED; // set by semantic analysis
+    std::string keyName; // key type name when indexing a map
+    bool boundsCheck = true; // cleared by RangeAnalyzer when the index needs no check
+
+    void accept(ASTVisitor* visitor) override;
+};
+
+class FieldAccessNode : public ExpressionNode {
+public:
+    std::unique_ptr<ExpressionNode> object;
+    std::string field;
+
+    void accept(ASTVisitor* visitor) override;
+};
+
+// a[lo:hi], with either bound optional. Slicing an array or slice yields a
+// slice; slicing a string yields a string.
+class SliceExprNode : public ExpressionNode {
+public:
+    std::string arrayName;
+    std::unique_ptr<ExpressionNode> low;
+    std::unique_ptr<ExpressionNode> high;
+    ArrayKind arrayKind = ArrayKind::FIXED; // unused when slicing a string
 
     void accept(ASTVisitor* visitor) override;
 };
@@ -358,10 +488,24 @@ public:
     virtual void visit(SwitchNode* node) = 0;
     virtual void visit(CaseNode* node) = 0;
     virtual void visit(TernaryExprNode* node) = 0;
+    virtual void visit(SpawnNode* node) = 0;
+    virtual void visit(SyncNode* node) = 0;
+    virtual void visit(ExpressionStmtNode* node) = 0;
+    virtual void visit(FieldAccessNode* node) = 0;
+    virtual void visit(SliceExprNode* node) = 0;
 };
 
 Type stringToType(const std::string& typeStr);
 std::string typeToString(Type type);
+bool isVectorType(Type type);
+bool isIntegerType(Type type);
+bool isNumericType(Type type);
+bool isUnsignedType(Type type);
+int integerBits(Type type);
+Type vectorElementType(Type type);
+Type arrayElementType(const std::string& elementName);
+std::string mapKeyName(const std::string& mapTypes);
+std::string mapValueName(const std::string& mapTypes);
 std::string binaryOpToString(BinaryOp op);
 std::string unaryOpToString(UnaryOp op);
 
@@ -0,0 +1,54 @@
+#!/bin/sh
+# Compares build times of `slc --asm` with `slc -O0` through gcc on every
+# test program the x86-64 backend covers; both builds must print the same
+# and exit alike. Then the run time of a longer workload both ways, since
+# the assembly is unoptimized.
+# Usage: bench/asm.sh [program.sl]
+
+SLC=${SLC:-./bin/slc}
+SOURCE=${1:-bench/asm_loop.sl}
+BINARY=/tmp/sl_bench_$$
+
+now() {
+    date +%s.%N
+}
+
+echo "test                    --asm   gcc -O0"
+asm_total=0
+gcc_total=0
+for test in tests/*_test.sl; do
+    name=$(basename "$test" .sl)
+    $SLC "$test" "$BINARY.asm" --asm > /dev/null 2> "$BINARY.err" || continue
+    grep -q "not supported by --asm" "$BINARY.err" && continue
+    start=$(now)
+    $SLC "$test" "$BINARY.asm" --asm > /dev/null 2>&1
+    middle=$(now)
+    $SLC "$test" "$BINARY" -O0 > /dev/null 2>&1
+    end=$(now)
+    "$BINARY.asm" > "$BINARY.asm.out"; asm_status=$?
+    "$BINARY" > "$BINARY.out"; gcc_status=$?
+    if [ $asm_status -ne $gcc_status ] || ! cmp -s "$BINARY.asm.out" "$BINARY.out"; then
+        echo "$name: --asm and gcc builds differ"
+        exit 1
+    fi
+    asm=$(awk "BEGIN { print $middle - $start }")
+    compiled=$(awk "BEGIN { print $end - $middle }")
+    asm_total=$(awk "BEGIN { print $asm_total + $asm }")
+    gcc_total=$(awk "BEGIN { print $gcc_total + $compiled }")
+    awk "BEGIN { printf \"%-22s %7.3f  %7.3f\\n\", \"$name\", $asm, $compiled }"
+done
+awk "BEGIN { printf \"%-22s %7.3f  %7.3f  (%.0fx)\\n\", \"total\", $asm_total, $gcc_total, $gcc_total / $asm_total }"
+
+if $SLC "$SOURCE" "$BINARY.asm" --asm > /dev/null 2> "$BINARY.err" && ! grep -q "not supported" "$BINARY.err"; then
+    $SLC "$SOURCE" "$BINARY" -O0 > /dev/null 2>&1 || exit 1
+    start=$(now)
+    "$BINARY.asm" > /dev/null
+    middle=$(now)
+    "$BINARY" > /dev/null
+    end=$(now)
+    echo
+    echo "$SOURCE  run seconds"
+    awk "BEGIN { printf \"--asm    %7.3f\\ngcc -O0  %7.3f\\n\", $middle - $start, $end - $middle }"
+fi
+
+rm -f "$BINARY" "$BINARY.asm" "$BINARY.err" "$BINARY.out" "$BINARY.asm.out"
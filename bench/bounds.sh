@@ -0,0 +1,24 @@
+#!/bin/sh
+# Times an array-scan program built without and with --bounds-check.
+# Usage: bench/bounds.sh [program.sl]
+
+SLC=${SLC:-./bin/slc}
+SOURCE=${1:-bench/bounds_scan.sl}
+BINARY=/tmp/sl_bench_$$
+
+elapsed() {
+    $SLC "$SOURCE" "$BINARY" -O2 $1 > /dev/null 2>&1 || exit 1
+    start=$(date +%s.%N)
+    "$BINARY" > /dev/null
+    end=$(date +%s.%N)
+    awk "BEGIN { print $end - $start }"
+}
+
+plain=$(elapsed) || exit 1
+checked=$(elapsed --bounds-check) || exit 1
+$SLC "$SOURCE" "$BINARY" --bounds-check 2>&1 >/dev/null | tail -n 1
+echo "build    seconds"
+awk "BEGIN { printf \"plain    %7.3f\\n\", $plain }"
+awk "BEGIN { printf \"checked  %7.3f  (%+.1f%%)\\n\", $checked, ($checked / $plain - 1) * 100 }"
+
+rm -f "$BINARY"
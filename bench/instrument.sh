@@ -0,0 +1,33 @@
+#!/bin/sh
+# Run time of a program at -O2 with and without --instrument, and the
+# flat profile the instrumented build writes. The default workload is
+# almost nothing but small calls, the worst case for the hooks.
+# Usage: bench/instrument.sh [program.sl]
+
+SLC=${SLC:-./bin/slc}
+SOURCE=${1:-bench/asm_loop.sl}
+BINARY=/tmp/sl_bench_$$
+
+now() {
+    date +%s.%N
+}
+
+$SLC "$SOURCE" "$BINARY" -O2 > /dev/null || exit 1
+$SLC "$SOURCE" "$BINARY.prof" -O2 --instrument > /dev/null || exit 1
+
+start=$(now)
+"$BINARY" > "$BINARY.out"
+middle=$(now)
+SL_PROFILE="$BINARY.txt" "$BINARY.prof" > "$BINARY.prof.out"
+end=$(now)
+if ! cmp -s "$BINARY.out" "$BINARY.prof.out"; then
+    echo "builds with and without --instrument differ"
+    exit 1
+fi
+
+echo "$SOURCE  run seconds"
+awk "BEGIN { plain = $middle - $start; hooked = $end - $middle;
+             printf \"-O2               %7.3f\\n-O2 --instrument  %7.3f  (%+.1f%%)\\n\", plain, hooked, 100 * (hooked - plain) / plain }"
+echo
+cat "$BINARY.txt"
+rm -f "$BINARY" "$BINARY.prof" "$BINARY.out" "$BINARY.prof.out" "$BINARY.txt"
@@ -0,0 +1,39 @@
+#!/bin/sh
+# Times writing 100M integers through the buffered writer against the
+# printf-per-value C shim it replaces; both must print the same bytes.
+# Usage: bench/io.sh [program.sl]
+
+SLC=${SLC:-./bin/slc}
+SOURCE=${1:-bench/write_ints.sl}
+COUNT=100000000
+BINARY=/tmp/sl_bench_$$
+SHIM=/tmp/sl_bench_printf_$$
+
+$SLC "$SOURCE" "$BINARY" -O2 > /dev/null 2>&1 || exit 1
+cat > "$SHIM.c" <<EOC
+#include <stdio.h>
+int main(void) {
+    for (int i = 0; i < $COUNT; i++) printf("%d\n", i);
+    return 0;
+}
+EOC
+gcc -O2 "$SHIM.c" -o "$SHIM" || exit 1
+
+elapsed() {
+    start=$(date +%s.%N)
+    "$1" > /dev/null
+    end=$(date +%s.%N)
+    awk "BEGIN { print $end - $start }"
+}
+
+if [ "$("$BINARY" | cksum)" != "$("$SHIM" | cksum)" ]; then
+    echo "outputs differ"
+    exit 1
+fi
+shim=$(elapsed "$SHIM")
+sl=$(elapsed "$BINARY")
+echo "writer   seconds   Mints/s"
+awk "BEGIN { printf \"printf  %8.3f  %8.1f\\n\", $shim, $COUNT / $shim / 1e6 }"
+awk "BEGIN { printf \"write   %8.3f  %8.1f  (%.1fx)\\n\", $sl, $COUNT / $sl / 1e6, $shim / $sl }"
+
+rm -f "$BINARY" "$SHIM" "$SHIM.c"
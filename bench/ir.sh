@@ -0,0 +1,36 @@
+#!/bin/sh
+# Run time of a program built at -O0 plainly and with --ir, where the IR
+# passes are the only optimizer, then at -O2 both ways; the builds must
+# print the same. Ends with the time each pass took.
+# Usage: bench/ir.sh [program.sl]
+
+SLC=${SLC:-./bin/slc}
+SOURCE=${1:-bench/ir_loop.sl}
+BINARY=/tmp/sl_bench_$$
+
+now() {
+    date +%s.%N
+}
+
+run() {
+    start=$(now)
+    "$1" > "$1.out"
+    end=$(now)
+    awk "BEGIN { printf \"%-12s %7.3f\\n\", \"$2\", $end - $start }"
+}
+
+echo "$SOURCE  run seconds"
+for level in -O0 -O2; do
+    $SLC "$SOURCE" "$BINARY.ast" $level > /dev/null || exit 1
+    $SLC "$SOURCE" "$BINARY.ir" $level --ir > /dev/null || exit 1
+    run "$BINARY.ast" "$level"
+    run "$BINARY.ir" "$level --ir"
+    if ! cmp -s "$BINARY.ast.out" "$BINARY.ir.out"; then
+        echo "$level: builds with and without --ir differ"
+        exit 1
+    fi
+done
+
+echo
+$SLC "$SOURCE" "$BINARY.ir" --time-passes > /dev/null
+rm -f "$BINARY.ast" "$BINARY.ir" "$BINARY.ast.out" "$BINARY.ir.out"
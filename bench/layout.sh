@@ -0,0 +1,27 @@
+#!/bin/sh
+# Times a field-scan program with structure-of-arrays layout against the
+# same program with @soa removed (array of structs).
+# Usage: bench/layout.sh [program.sl]
+
+SLC=${SLC:-./bin/slc}
+SOURCE=${1:-bench/soa_scan.sl}
+AOS_SOURCE=/tmp/sl_bench_aos_$$.sl
+BINARY=/tmp/sl_bench_$$
+
+sed 's/@soa //' "$SOURCE" > "$AOS_SOURCE"
+
+elapsed() {
+    $SLC "$1" "$BINARY" -O2 > /dev/null || exit 1
+    start=$(date +%s.%N)
+    "$BINARY" > /dev/null
+    end=$(date +%s.%N)
+    awk "BEGIN { print $end - $start }"
+}
+
+aos=$(elapsed "$AOS_SOURCE") || exit 1
+soa=$(elapsed "$SOURCE") || exit 1
+echo "layout   seconds"
+awk "BEGIN { printf \"aos      %7.3f\\n\", $aos }"
+awk "BEGIN { printf \"soa      %7.3f  (%.2fx)\\n\", $soa, $aos / $soa }"
+
+rm -f "$BINARY" "$AOS_SOURCE"
@@ -0,0 +1,31 @@
+#!/bin/sh
+# Times the same lookups done by a linear scan over arrays and by a map.
+# Usage: bench/map.sh [scan.sl] [map.sl]
+
+SLC=${SLC:-./bin/slc}
+SCAN=${1:-bench/scan_lookup.sl}
+MAP=${2:-bench/map_lookup.sl}
+LOOKUPS=2000000
+BINARY=/tmp/sl_bench_$$
+
+# Prints "seconds exit-code"; both programs must compute the same result.
+elapsed() {
+    $SLC "$1" "$BINARY" -O2 > /dev/null 2>&1 || exit 1
+    start=$(date +%s.%N)
+    "$BINARY" > /dev/null
+    result=$?
+    end=$(date +%s.%N)
+    awk "BEGIN { print $end - $start, $result }"
+}
+
+set -- $(elapsed "$SCAN") $(elapsed "$MAP")
+[ $# -eq 4 ] || exit 1
+if [ "$2" != "$4" ]; then
+    echo "results differ: scan $2, map $4"
+    exit 1
+fi
+echo "lookup   seconds   Mlookups/s"
+awk "BEGIN { printf \"scan    %8.3f  %10.1f\\n\", $1, $LOOKUPS / $1 / 1e6 }"
+awk "BEGIN { printf \"map     %8.3f  %10.1f  (%.1fx)\\n\", $3, $LOOKUPS / $3 / 1e6, $1 / $3 }"
+
+rm -f "$BINARY"
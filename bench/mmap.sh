@@ -0,0 +1,34 @@
+#!/bin/sh
+# Times a scan of a 500 MB file read through read_line and through
+# map_file; both programs must compute the same result.
+# Usage: bench/mmap.sh [read.sl] [map.sl]
+
+SLC=${SLC:-./bin/slc}
+READ=${1:-bench/scan_read.sl}
+MAP=${2:-bench/scan_map.sl}
+INPUT=/tmp/sl_bench_input
+BINARY=/tmp/sl_bench_$$
+
+seq 1 60000000 > "$INPUT"
+SIZE=$(wc -c < "$INPUT")
+
+# Prints "seconds exit-code".
+elapsed() {
+    $SLC "$1" "$BINARY" -O2 > /dev/null 2>&1 || exit 1
+    start=$(date +%s.%N)
+    "$BINARY" < "$INPUT"
+    result=$?
+    end=$(date +%s.%N)
+    awk "BEGIN { print $end - $start, $result }"
+}
+
+set -- $(elapsed "$READ") $(elapsed "$MAP")
+rm -f "$BINARY" "$INPUT"
+[ $# -eq 4 ] || exit 1
+if [ "$2" != "$4" ]; then
+    echo "results differ: read_line $2, map_file $4"
+    exit 1
+fi
+echo "input      seconds   MB/s"
+awk "BEGIN { printf \"read_line %8.3f  %7.0f\\n\", $1, $SIZE / $1 / 1e6 }"
+awk "BEGIN { printf \"map_file  %8.3f  %7.0f  (%.1fx)\\n\", $3, $SIZE / $3 / 1e6, $1 / $3 }"
@@ -0,0 +1,27 @@
+#!/bin/sh
+# Latency of `slc repl`: each definition of a session file is timed as it
+# is entered, then one more entry after all of them, against recompiling
+# the whole session as a library, which is what every entry would cost
+# without incremental loading.
+# Usage: bench/repl.sh [session.sl]
+
+SLC=${SLC:-./bin/slc}
+SESSION=${1:-bench/repl_session.sl}
+LIBRARY=/tmp/sl_bench_$$.so
+TIMES=/tmp/sl_bench_$$.times
+
+now() {
+    date +%s.%N
+}
+
+(echo ":time"; cat "$SESSION"; echo "mix30(5)") | $SLC repl 2> "$TIMES" > /dev/null
+start=$(now)
+$SLC "$SESSION" "$LIBRARY" -shared -O1 > /dev/null
+end=$(now)
+
+echo "$SESSION: $(grep -c '^time:' "$TIMES") entries"
+awk '/^time:/ { n++; total += $2; if (n == 1) first = $2; last = $2 }
+     END { printf "first entry            %7.1f ms\nmean entry             %7.1f ms\nlast entry             %7.1f ms\n", first, total / n, last }' "$TIMES"
+awk "BEGIN { printf \"recompile everything   %7.1f ms\\n\", ($end - $start) * 1000 }"
+
+rm -f "$LIBRARY" "$TIMES"
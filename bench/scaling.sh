@@ -0,0 +1,36 @@
+#!/bin/sh
+# Runs a compiled SL program with 1..N workers and prints the speedup
+# relative to one worker. Usage: bench/scaling.sh [program.sl] [max_workers]
+
+SLC=${SLC:-./bin/slc}
+SOURCE=${1:-bench/spawn_fib.sl}
+MAX=${2:-$(nproc)}
+BINARY=/tmp/sl_bench_$$
+
+$SLC "$SOURCE" "$BINARY" -O2 > /dev/null || exit 1
+
+elapsed() {
+    start=$(date +%s.%N)
+    SL_WORKERS=$1 "$BINARY" > /dev/null
+    end=$(date +%s.%N)
+    awk "BEGIN { print $end - $start }"
+}
+
+report() {
+    awk "BEGIN { printf \"%7d  %7.3f  %7.2f\\n\", $1, $2, $3 / $2 }"
+}
+
+base=$(elapsed 1)
+echo "workers  seconds  speedup"
+report 1 "$base" "$base"
+workers=2
+while [ "$workers" -le "$MAX" ]; do
+    report "$workers" "$(elapsed $workers)" "$base"
+    last=$workers
+    workers=$((workers * 2))
+done
+if [ "$MAX" -gt 1 ] && [ "$last" -ne "$MAX" ]; then
+    report "$MAX" "$(elapsed $MAX)" "$base"
+fi
+
+rm -f "$BINARY"
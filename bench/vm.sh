@@ -0,0 +1,52 @@
+#!/bin/sh
+# Compares `slc --run` with compiling through gcc: time to first result on
+# every test program the VM covers, then steady-state speed on a longer
+# workload, whose output must be the same both ways.
+# Usage: bench/vm.sh [program.sl]
+
+SLC=${SLC:-./bin/slc}
+SOURCE=${1:-bench/vm_loop.sl}
+BINARY=/tmp/sl_bench_$$
+INPUT='alpha\nbeta\n\ngamma'
+
+now() {
+    date +%s.%N
+}
+
+echo "test                    --run   gcc+run"
+run_total=0
+gcc_total=0
+for test in tests/*_test.sl; do
+    name=$(basename "$test" .sl)
+    if ! printf "$INPUT" | $SLC "$test" --run > /dev/null 2> "$BINARY.err"; then
+        grep -q "not supported by --run" "$BINARY.err" && continue
+    fi
+    start=$(now)
+    printf "$INPUT" | $SLC "$test" --run > /dev/null 2>&1
+    middle=$(now)
+    $SLC "$test" "$BINARY" > /dev/null 2>&1 && printf "$INPUT" | "$BINARY" > /dev/null 2>&1
+    end=$(now)
+    run=$(awk "BEGIN { print $middle - $start }")
+    compiled=$(awk "BEGIN { print $end - $middle }")
+    run_total=$(awk "BEGIN { print $run_total + $run }")
+    gcc_total=$(awk "BEGIN { print $gcc_total + $compiled }")
+    awk "BEGIN { printf \"%-22s %7.3f  %7.3f\\n\", \"$name\", $run, $compiled }"
+done
+awk "BEGIN { printf \"%-22s %7.3f  %7.3f  (%.0fx)\\n\", \"total\", $run_total, $gcc_total, $gcc_total / $run_total }"
+
+$SLC "$SOURCE" "$BINARY" -O2 > /dev/null 2>&1 || exit 1
+if [ "$($SLC "$SOURCE" --run | cksum)" != "$("$BINARY" | cksum)" ]; then
+    echo "outputs differ"
+    exit 1
+fi
+start=$(now)
+$SLC "$SOURCE" --run > /dev/null
+middle=$(now)
+"$BINARY" > /dev/null
+end=$(now)
+echo
+echo "$SOURCE  seconds"
+awk "BEGIN { printf \"--run    %7.3f  (%.1fx the compiled time)\\n\", $middle - $start, ($middle - $start) / ($end - $middle) }"
+awk "BEGIN { printf \"gcc -O2  %7.3f  (run only)\\n\", $end - $middle }"
+
+rm -f "$BINARY" "$BINARY.err"
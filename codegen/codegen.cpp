@@ -1,20 +1,64 @@
 #include "codegen.h"
+#include "switch.h"
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 
 void CodeGenerator::indent() {
     for (int i = 0; i < indentLevel; ++i) {
-        out << "    ";
+        *target << "    ";
     }
 }
 
 void CodeGenerator::print(const std::string& str) {
-    out << str;
+    if (target == &code) {
+        for (char c : str) {
+            if (c == '\n') outputLine++;
+        }
+    }
+    *target << str;
 }
 
 void CodeGenerator::printLine(const std::string& str) {
     indent();
-    out << str << "\n";
+    print(str);
+    print("\n");
+}
+
+std::string CodeGenerator::getCompilerFlags() const {
+    std::string flags;
+    for (const auto& flag : compilerFlags) {
+        flags += " " + flag;
+    }
+    return flags;
+}
+
+bool CodeGenerator::emitLoopAnnotations(const std::vector<LoopAnnotation>& annotations) {
+    bool simd = false;
+    bool noalias = false;
+    int unroll = 0;
+
+    for (const auto& annotation : annotations) {
+        if (annotation.name == "simd") simd = true;
+        else if (annotation.name == "noalias") noalias = true;
+        else if (annotation.name == "unroll") unroll = annotation.argument;
+    }
+
+    // gcc does not accept other loop pragmas after "omp simd", which already
+    // asserts that iterations carry no dependencies.
+    if (simd) {
+        printLine("#pragma omp simd");
+        compilerFlags.insert("-fopenmp-simd");
+    } else {
+        if (noalias) {
+            printLine("#pragma GCC ivdep");
+        }
+        if (unroll > 0) {
+            printLine("#pragma GCC unroll " + std::to_string(unroll));
+        }
+    }
+
+    return simd || noalias;
 }
 
 std::string CodeGenerator::typeToCType(Type type) {
@@ -22,13 +66,173 @@ std::string CodeGenerator::typeToCType(Type type) {
         case Type::INT: return "int";
         case Type::DOUBLE: return "double";
         case Type::FLOAT: return "float";
-        case Type::STRING: return "char*";
-        case Type::BOOL: return "int";
+        case Type::STRING:
+            runtimeParts.insert(RuntimePart::STRINGS);
+            return "sl_str";
+        case Type::BOOL: return "_Bool";
         case Type::VOID: return "void";
+        case Type::I8: return "int8_t";
+        case Type::I16: return "int16_t";
+        case Type::I32: return "int32_t";
+        case Type::I64: return "int64_t";
+        case Type::U8: return "uint8_t";
+        case Type::U16: return "uint16_t";
+        case Type::U32: return "uint32_t";
+        case Type::U64: return "uint64_t";
+        case Type::VEC4F:
+        case Type::VEC8F:
+        case Type::VEC4D:
+        case Type::VEC8I:
+            runtimeParts.insert(RuntimePart::VECTORS);
+            return "sl_" + typeToString(type);
+        case Type::ARRAY:
+            runtimeParts.insert(RuntimePart::ARRAYS);
+            return "sl_array*";
+        case Type::SLICE:
+            runtimeParts.insert(RuntimePart::SLICES);
+            return "sl_slice";
+        case Type::MAP:
+            runtimeParts.insert(RuntimePart::STRINGS);
+            runtimeParts.insert(RuntimePart::MAPS);
+            return "sl_map*";
         default: return "void";
     }
 }
 
+std::string CodeGenerator::typeToCType(Type type, const std::string& className) {
+    if (type == Type::CLASS) {
+        return isValueClass(className) ? className : className + "*";
+    }
+    return typeToCType(type);
+}
+
+std::string CodeGenerator::elementCType(const std::string& elementName) {
+    return typeToCType(arrayElementType(elementName), elementName);
+}
+
+bool CodeGenerator::isValueClass(const std::string& className) const {
+    auto cls = classTable.find(className);
+    return cls != classTable.end() && cls->second->isValue;
+}
+
+bool CodeGenerator::isSoaClass(const std::string& className) const {
+    auto cls = classTable.find(className);
+    if (cls == classTable.end()) return false;
+    const auto& annotations = cls->second->annotations;
+    return std::count(annotations.begin(), annotations.end(), "soa") > 0;
+}
+
+std::string CodeGenerator::memberAccess(const std::string& className) const {
+    return isValueClass(className) ? "." : "->";
+}
+
+// Inside a constructor, fields are reached through the object being initialized.
+std::string CodeGenerator::variableName(const std::string& name, bool isField) const {
+    return isField ? "obj->" + name : name;
+}
+
+// Alignment of a field in the generated struct, matching the x86-64 ABI for
+// the C types typeToCType produces.
+int CodeGenerator::typeAlignment(Type type, const std::string& className) const {
+    switch (type) {
+        case Type::BOOL:
+        case Type::I8:
+        case Type::U8:
+            return 1;
+        case Type::I16:
+        case Type::U16:
+            return 2;
+        case Type::DOUBLE:
+        case Type::STRING:
+        case Type::ARRAY:
+        case Type::SLICE:
+        case Type::MAP:
+        case Type::I64:
+        case Type::U64:
+            return 8;
+        case Type::VEC4F:
+            return 16;
+        case Type::VEC8F:
+        case Type::VEC4D:
+        case Type::VEC8I:
+            return 32;
+        case Type::CLASS: {
+            if (!isValueClass(className)) return 8;
+            int alignment = 1;
+            for (const auto& field : classTable.at(className)->fields) {
+                alignment = std::max(alignment, typeAlignment(field.type, field.className));
+            }
+            return alignment;
+        }
+        default:
+            return 4;
+    }
+}
+
+// Number of elements behind an indexed name. Fixed arrays are C arrays in
+// scope, so sizeof gives their length; @soa arrays use their first field
+// and packed bool arrays the bit count declared next to their words.
+std::string CodeGenerator::arrayLength(const std::string& name, ArrayKind kind,
+                                       const std::string& className) const {
+    if (kind == ArrayKind::DYNAMIC) return name + "->len";
+    if (kind == ArrayKind::SLICE) return name + ".len";
+    if (kind == ArrayKind::BITS) return name + "_bits";
+    std::string storage = name;
+    if (isSoaClass(className) && !classTable.at(className)->fields.empty()) {
+        storage += "_" + classTable.at(className)->fields.front().name;
+    }
+    return "(int)(sizeof(" + storage + ") / sizeof(" + storage + "[0]))";
+}
+
+void CodeGenerator::emitIndex(ExpressionNode* index, bool check, const std::string& length, int line) {
+    if (!index) return;
+    if (!boundsChecking || !check) {
+        index->accept(this);
+        return;
+    }
+    runtimeParts.insert(RuntimePart::BOUNDS);
+    print("sl_bounds(");
+    index->accept(this);
+    print(", " + length + ", " + std::to_string(line) + ")");
+}
+
+// Checks that RangeAnalyzer moved out of a loop body run once, before the
+// loop and any pragma that has to stay attached to it.
+void CodeGenerator::emitHoistedChecks(ForNode* node) {
+    if (!boundsChecking) return;
+    for (const auto& check : node->boundsChecks) {
+        runtimeParts.insert(RuntimePart::BOUNDS);
+        indent();
+        print("sl_bounds_range(");
+        if (check.low) {
+            check.low->accept(this);
+            if (check.lowOffset != 0) print(" + " + std::to_string(check.lowOffset));
+        } else {
+            print(std::to_string(check.lowOffset));
+        }
+        print(", ");
+        if (check.high) {
+            check.high->accept(this);
+            if (check.highOffset != 0) print(" + " + std::to_string(check.highOffset));
+        } else {
+            print(std::to_string(check.highOffset));
+        }
+        print(", " + arrayLength(check.arrayName, check.arrayKind, check.className) + ", " +
+              std::to_string(check.line) + ");\n");
+    }
+}
+
+std::string CodeGenerator::parameterList(const std::vector<std::pair<std::string, Type>>& parameters,
+                                         const std::vector<std::string>& parameterClasses) {
+    std::stringstream ss;
+    for (size_t i = 0; i < parameters.size(); ++i) {
+        if (i > 0) ss << ", ";
+        std::string className = i < parameterClasses.size() ? parameterClasses[i] : "";
+        ss << typeToCType(parameters[i].second, className) << " " << parameters[i].first;
+    }
+    return ss.str();
+}
+
 std::string CodeGenerator::escapeString(const std::string& str) {
     std::stringstream ss;
     for (char c : str) {
@@ -41,36 +245,265 @@ std::string CodeGenerator::escapeString(const std::string& str) {
     return ss.str();
 }
 
+// The program body is generated first so that only the runtime parts and
+// helpers it actually uses are emitted in front of it.
 void CodeGenerator::generate(ProgramNode* program) {
-    printLine("#include <stdio.h>");
-    printLine("#include <stdlib.h>");
-    printLine("#include <string.h>");
-    print("");
-
     program->accept(this);
+    if (sharedLibrary) {
+        emitModuleTable(program);
+    }
+    if (!profiledFunctions.empty()) {
+        emitProfileNames();
+    }
+
+    std::stringstream preamble;
+    preamble << "#include <stdio.h>\n";
+    preamble << "#include <stdlib.h>\n";
+    preamble << "#include <string.h>\n";
+    preamble << "#include <stdint.h>\n";
+    for (RuntimePart part : runtimeParts) {
+        preamble << runtimeSource(part);
+    }
+    preamble << helpers.str();
+
+    // Without AVX the 256-bit vector types are split into SSE halves, which
+    // gcc reports as an ABI change on every function passing them.
+    if (runtimeParts.count(RuntimePart::VECTORS)) {
+        compilerFlags.insert("-Wno-psabi");
+    }
+
+    std::string text = preamble.str();
+    int offset = 0;
+    for (char c : text) {
+        if (c == '\n') offset++;
+    }
+    for (auto& loop : loops) {
+        loop.beginLine += offset;
+        loop.endLine += offset;
+    }
+
+    out << text << code.str();
+
+    // Output is buffered per library; its host flushes it before printing
+    // anything itself. A static library's output is flushed at exit.
+    if (sharedLibrary && runtimeParts.count(RuntimePart::IO)) {
+        out << "\nvoid sl_flush_output(void) {\n    sl_flush_all();\n}\n";
+    }
+}
+
+// Opens a function body with the profiling frame of slc --instrument.
+void CodeGenerator::emitProfileHook(const std::string& name) {
+    if (!instrumenting) return;
+    runtimeParts.insert(RuntimePart::PROFILE);
+    printLine("SL_PROFILE(" + std::to_string(profiledFunctions.size()) + ");");
+    profiledFunctions.push_back(name);
+}
+
+// Names of the instrumented functions by id; registering them also sets
+// up the profile dump at exit.
+void CodeGenerator::emitProfileNames() {
+    target = &code;
+    print("\nstatic const char* const sl_profile_function_names[] = {\n");
+    for (const auto& name : profiledFunctions) {
+        print("    \"" + name + "\",\n");
+    }
+    print("};\n\n");
+    print("__attribute__((constructor)) static void sl_profile_init(void) {\n");
+    print("    sl_profile_start(sl_profile_function_names, " + std::to_string(profiledFunctions.size()) + ", " +
+          (libraryMode ? "1" : "0") + ");\n");
+    print("}\n");
+}
+
+// How a type is written in SL source, for export signatures.
+static std::string sourceTypeName(Type type, const std::string& className) {
+    switch (type) {
+        case Type::CLASS: return className;
+        case Type::ARRAY: return className + "[]";
+        case Type::SLICE: return className + "[:]";
+        case Type::MAP: return "map<" + className + ">";
+        default: return typeToString(type);
+    }
+}
+
+// Libraries export every function they define through one table, sorted
+// by name, so that a host can look functions up by name and check their
+// signatures when it loads a new build. The interface hash changes
+// whenever a name or a signature does.
+void CodeGenerator::emitModuleTable(ProgramNode* program) {
+    std::map<std::string, std::string> signatures;
+    for (auto& func : program->functions) {
+        if (func->external) continue;
+        std::string signature = sourceTypeName(func->returnType, func->returnClass) + "(";
+        for (size_t i = 0; i < func->parameters.size(); ++i) {
+            if (i > 0) signature += ",";
+            signature += sourceTypeName(func->parameters[i].second,
+                                        i < func->parameterClasses.size() ? func->parameterClasses[i] : "");
+        }
+        signatures[func->name] = signature + ")";
+    }
+
+    runtimeParts.insert(RuntimePart::MODULE);
+    uint64_t hash = 14695981039346656037ULL;
+    target = &code;
+    print("\nstatic const sl_export sl_exports[] = {\n");
+    for (const auto& entry : signatures) {
+        for (char c : entry.first + " " + entry.second + ";") {
+            hash = (hash ^ (unsigned char)c) * 1099511628211ULL;
+        }
+        print("    { \"" + entry.first + "\", \"" + entry.second + "\", (void (*)(void))" + entry.first + " },\n");
+    }
+    if (signatures.empty()) {
+        print("    { 0, 0, 0 },\n");
+    }
+    print("};\n\n");
+    std::stringstream module;
+    module << "const sl_module sl_module_info = { SL_MODULE_ABI, " << signatures.size() << ", 0x" << std::hex
+           << hash << "ULL, sl_exports };\n";
+    print(module.str());
+}
+
+static bool containsSpawn(BlockNode* block);
+
+static bool statementContainsSpawn(StatementNode* stmt) {
+    if (!stmt) return false;
+    if (dynamic_cast<SpawnNode*>(stmt)) return true;
+    if (auto* ifNode = dynamic_cast<IfNode*>(stmt)) {
+        return containsSpawn(ifNode->thenBlock.get()) || containsSpawn(ifNode->elseBlock.get()) ||
+               statementContainsSpawn(ifNode->elseIf.get());
+    }
+    if (auto* whileNode = dynamic_cast<WhileNode*>(stmt)) return containsSpawn(whileNode->body.get());
+    if (auto* doWhile = dynamic_cast<DoWhileNode*>(stmt)) return containsSpawn(doWhile->body.get());
+    if (auto* forNode = dynamic_cast<ForNode*>(stmt)) return containsSpawn(forNode->body.get());
+    if (auto* switchNode = dynamic_cast<SwitchNode*>(stmt)) {
+        for (auto& caseNode : switchNode->cases) {
+            if (containsSpawn(caseNode->block.get())) return true;
+        }
+        return containsSpawn(switchNode->defaultCase.get());
+    }
+    return false;
+}
+
+static bool containsSpawn(BlockNode* block) {
+    if (!block) return false;
+    for (auto& stmt : block->statements) {
+        if (statementContainsSpawn(stmt.get())) return true;
+    }
+    return false;
+}
+
+// Functions that spawn tasks keep a counter of outstanding children and
+// wait for them before returning.
+void CodeGenerator::beginTaskFrame(BlockNode* body) {
+    currentFunctionSpawns = containsSpawn(body);
+    if (currentFunctionSpawns) {
+        runtimeParts.insert(RuntimePart::TASKS);
+        compilerFlags.insert("-pthread");
+        printLine("atomic_int sl_pending = 0;");
+    }
+}
+
+// Whether nothing after the block's last statement runs: a sync there
+// would be dead code.
+static bool endsInJump(BlockNode* block) {
+    if (!block || block->statements.empty()) return false;
+    StatementNode* last = block->statements.back().get();
+    return dynamic_cast<ReturnNode*>(last) || dynamic_cast<BreakNode*>(last) || dynamic_cast<ContinueNode*>(last);
+}
+
+// Whether a sync among the block's first `end` statements already waited
+// for every task started before statement `end`: another sync there would
+// find nothing pending.
+static bool syncedBefore(BlockNode* block, size_t end) {
+    for (size_t i = end; i > 0; --i) {
+        StatementNode* stmt = block->statements[i - 1].get();
+        if (dynamic_cast<SyncNode*>(stmt)) return true;
+        if (statementContainsSpawn(stmt)) return false;
+    }
+    return false;
+}
+
+void CodeGenerator::endTaskFrame(BlockNode* body) {
+    if (currentFunctionSpawns && body && !endsInJump(body) && !syncedBefore(body, body->statements.size())) {
+        printLine("sl_task_sync(&sl_pending);");
+    }
+    currentFunctionSpawns = false;
+}
+
+// A spawn target declared in a nested block goes out of scope with the
+// block while its task may still write it. A break or continue leaving
+// such a block waits for the tasks first; the block's own end does the
+// same in visit(BlockNode).
+void CodeGenerator::emitScopeSync() {
+    if (currentFunctionSpawns && std::count(spawnTargetScopes.begin(), spawnTargetScopes.end(), true)) {
+        printLine("sl_task_sync(&sl_pending);");
+    }
 }
 
 void CodeGenerator::visit(ProgramNode* node) {
-    // First pass: generate all struct definitions
+    for (auto& func : node->functions) {
+        functionTable[func->name] = func.get();
+    }
+    for (auto& templ : node->templates) {
+        for (auto& instance : templ->instances) {
+            functionTable[instance->name] = instance.get();
+        }
+    }
+
+    // Forward declarations let runtime helpers such as spawn task records
+    // refer to class pointers before the structs are defined.
+    target = &helpers;
     for (auto& cls : node->classes) {
-        printLine("typedef struct " + cls->name + " {");
-        printLine("} " + cls->name + ";");
-        print("");
+        classTable[cls->name] = cls.get();
+        printLine("typedef struct " + cls->name + " " + cls->name + ";");
+        if (!cls->isValue && !cls->external) {
+            runtimeParts.insert(RuntimePart::POOL);
+        }
+    }
+    target = &code;
+
+    // First pass: generate all struct definitions. Semantic analysis makes
+    // sure embedded structs come first.
+    for (auto& cls : node->classes) {
+        cls->accept(this);
     }
 
+    fileScope = true;
     for (auto& global : node->globals) {
-        global->accept(this);
+        if (global->external) {
+            declareExternal(global.get());
+        } else {
+            global->accept(this);
+        }
     }
+    fileScope = false;
 
+    // Functions loaded by earlier REPL entries are only declared.
+    for (auto& func : node->functions) {
+        if (func->external) {
+            printLine(functionSignature(func.get()) + ";");
+        }
+    }
+
+    // Template instances may call each other in any order.
+    for (auto& templ : node->templates) {
+        for (auto& instance : templ->instances) {
+            printLine(functionSignature(instance.get()) + ";");
+        }
+    }
     for (auto& templ : node->templates) {
         templ->accept(this);
     }
 
     // Second pass: generate all functions and methods
     for (auto& cls : node->classes) {
-        // Generate constructor
-        if (cls->constructor) {
-            cls->constructor->accept(this);
+        if (cls->external) {
+            declareExternal(cls.get());
+            continue;
+        }
+        if (cls->isValue) {
+            emitValueConstructor(cls.get());
+        } else {
+            emitClassPool(cls.get());
         }
 
         // Generate methods
@@ -80,99 +513,329 @@ void CodeGenerator::visit(ProgramNode* node) {
     }
 
     for (auto& func : node->functions) {
-        func->accept(this);
+        if (!func->external) {
+            func->accept(this);
+        }
+    }
+}
+
+// A global defined by an earlier REPL entry. Constants are defined again so
+// that each entry keeps its own copy; everything else refers to the storage
+// of the entry that defined it.
+void CodeGenerator::declareExternal(VarDeclNode* node) {
+    if (node->isConst) {
+        print("static ");
+        node->accept(this);
+        return;
+    }
+    if (node->isArray && isSoaClass(node->className)) {
+        for (const auto& field : classTable.at(node->className)->fields) {
+            print("extern " + typeToCType(field.type, field.className) + " " + node->name + "_" + field.name + "[");
+            node->arraySize->accept(this);
+            print("];\n");
+        }
+        return;
+    }
+    if (node->isArray && node->type == Type::BOOL && node->arraySize) {
+        runtimeParts.insert(RuntimePart::BITS);
+        print("static const int " + node->name + "_bits = ");
+        node->arraySize->accept(this);
+        print(";\n");
+        print("extern uint64_t " + node->name + "[((");
+        node->arraySize->accept(this);
+        print(") + 63) / 64];\n");
+        return;
+    }
+    print("extern " + typeToCType(node->type, node->className) + " " + node->name);
+    if (node->isArray) {
+        print("[");
+        if (node->arraySize) node->arraySize->accept(this);
+        print("]");
+    }
+    print(";\n");
+}
+
+// A class defined by an earlier REPL entry: its struct is emitted as usual,
+// its functions are only declared. The inline helpers of structs are
+// static, so they are defined again.
+void CodeGenerator::declareExternal(ClassNode* cls) {
+    const std::string& name = cls->name;
+    std::string params;
+    std::string args;
+    constructorParameters(cls, params, args);
+    printLine(name + "* " + name + "_init(" + name + "* obj" + (params.empty() ? "" : ", " + params) + ");");
+    if (cls->isValue) {
+        emitValueMake(cls, params, args);
+    } else {
+        printLine(name + "* " + name + "_new(" + params + ");");
+        printLine("void " + name + "_free(" + name + "* obj);");
+        printLine("void " + name + "_reset(void);");
+    }
+    for (auto& method : cls->methods) {
+        printLine(methodSignature(method.get()) + ";");
     }
+    print("\n");
 }
 
 void CodeGenerator::visit(DirectiveNode* node) {
 }
 
-void CodeGenerator::visit(FunctionNode* node) {
-    std::stringstream ss;
-    ss << typeToCType(node->returnType) << " " << node->name << "(";
+// Every class gets a thread-local pool; <Class>_new allocates from it,
+// <Class>_free returns one object to the pool that allocated it, on
+// whichever thread, and <Class>_reset drops the calling thread's pool.
+void CodeGenerator::emitClassPool(ClassNode* cls) {
+    const std::string& name = cls->name;
+    printLine("static _Thread_local sl_pool " + name + "_pool = SL_POOL_INIT(sizeof(" + name + "));");
+    print("\n");
 
-    for (size_t i = 0; i < node->parameters.size(); ++i) {
-        if (i > 0) ss << ", ";
-        ss << typeToCType(node->parameters[i].second) << " " << node->parameters[i].first;
+    std::string params;
+    std::string args;
+    emitConstructor(cls, params, args);
+
+    printLine(name + "* " + name + "_new(" + params + ") {");
+    printLine("    return " + name + "_init((" + name + "*)sl_pool_alloc(&" + name + "_pool)" + args + ");");
+    printLine("}");
+    print("\n");
+
+    printLine("void " + name + "_free(" + name + "* obj) {");
+    printLine("    sl_pool_free(&" + name + "_pool, obj);");
+    printLine("}");
+    print("\n");
+    printLine("void " + name + "_reset(void) {");
+    printLine("    sl_pool_reset(&" + name + "_pool);");
+    printLine("}");
+    print("\n");
+}
+
+// <Class>_init runs the constructor body on storage supplied by the caller:
+// a pool slot from <Class>_new, a stack slot for instances that escape
+// analysis keeps local, or the local copy built by <Struct>_make.
+void CodeGenerator::emitConstructor(ClassNode* cls, std::string& params, std::string& args) {
+    const std::string& name = cls->name;
+    constructorParameters(cls, params, args);
+    if (cls->constructor) {
+        cls->constructor->accept(this);
+    } else {
+        printLine(name + "* " + name + "_init(" + name + "* obj) {");
+        indentLevel++;
+        emitArrayFieldInit(name);
+        indentLevel--;
+        printLine("    return obj;");
+        printLine("}");
     }
+    print("\n");
+}
 
-    ss << ") {";
-    printLine(ss.str());
+// The constructor's parameter list and the arguments forwarding them.
+void CodeGenerator::constructorParameters(ClassNode* cls, std::string& params, std::string& args) {
+    if (!cls->constructor) return;
+    params = parameterList(cls->constructor->parameters, cls->constructor->parameterClasses);
+    for (const auto& param : cls->constructor->parameters) {
+        args += ", " + param.first;
+    }
+}
+
+void CodeGenerator::emitValueConstructor(ClassNode* cls) {
+    std::string params;
+    std::string args;
+    emitConstructor(cls, params, args);
+    emitValueMake(cls, params, args);
+}
+
+// Structs never touch the pool: <Struct>_make builds the value in a local
+// and returns it, which the ABI passes back in registers when it is small.
+void CodeGenerator::emitValueMake(ClassNode* cls, const std::string& params, const std::string& args) {
+    const std::string& name = cls->name;
+    printLine("static inline " + name + " " + name + "_make(" + params + ") {");
+    printLine("    " + name + " obj;");
+    printLine("    " + name + "_init(&obj" + args + ");");
+    printLine("    return obj;");
+    printLine("}");
+    print("\n");
+
+    if (isSoaClass(name)) {
+        emitSoaAccessors(cls);
+    }
+}
+
+// An array of a @soa struct is one array per field. Field accesses index
+// the field array directly; the whole element is gathered and scattered by
+// <Struct>_soa_load/_soa_store so the index is evaluated only once.
+void CodeGenerator::emitSoaAccessors(ClassNode* cls) {
+    const std::string& name = cls->name;
+    std::string arrays;
+    for (const auto& field : cls->fields) {
+        arrays += typeToCType(field.type, field.className) + "* " + field.name + ", ";
+    }
+
+    printLine("static inline " + name + " " + name + "_soa_load(" + arrays + "int i) {");
+    printLine("    " + name + " obj;");
+    for (const auto& field : cls->fields) {
+        printLine("    obj." + field.name + " = " + field.name + "[i];");
+    }
+    printLine("    return obj;");
+    printLine("}");
+    print("\n");
+
+    printLine("static inline void " + name + "_soa_store(" + arrays + "int i, " + name + " obj) {");
+    for (const auto& field : cls->fields) {
+        printLine("    " + field.name + "[i] = obj." + field.name + ";");
+    }
+    printLine("}");
+    print("\n");
+}
+
+// Objects start zeroed; array fields start out as empty arrays.
+void CodeGenerator::emitArrayFieldInit(const std::string& className) {
+    auto cls = classTable.find(className);
+    if (cls == classTable.end() || cls->second->fields.empty()) return;
+    printLine("memset(obj, 0, sizeof(*obj));");
+    for (const auto& field : cls->second->fields) {
+        if (field.type == Type::ARRAY) {
+            printLine("obj->" + field.name + " = sl_array_new(sizeof(" + elementCType(field.className) + "));");
+        } else if (field.type == Type::MAP) {
+            printLine("obj->" + field.name + " = " + mapNew(field.className) + ";");
+        }
+    }
+}
+
+std::string CodeGenerator::mapNew(const std::string& mapTypes) {
+    return "sl_map_new(sizeof(" + elementCType(mapKeyName(mapTypes)) + "), sizeof(" +
+           elementCType(mapValueName(mapTypes)) + "))";
+}
+
+// The map runtime has one set of functions per key type.
+std::string CodeGenerator::mapFunction(const std::string& operation, const std::string& keyName) const {
+    std::string suffix = keyName == "string" ? "str" : keyName;
+    return "sl_map_" + operation + "_" + suffix + "(";
+}
+
+// Arguments naming every field array of a @soa array, in declaration order.
+void CodeGenerator::emitSoaArrays(const std::string& name, const std::string& className) {
+    for (const auto& field : classTable.at(className)->fields) {
+        print(name + "_" + field.name + ", ");
+    }
+}
+
+std::string CodeGenerator::functionSignature(FunctionNode* node) {
+    std::stringstream ss;
+    ss << typeToCType(node->returnType, node->returnClass) << " " << node->name << "(";
+    ss << parameterList(node->parameters, node->parameterClasses);
+    ss << ")";
+    return ss.str();
+}
+
+void CodeGenerator::visit(FunctionNode* node) {
+    const IRFunction* lowered = irModule ? irModule->find(node->name) : nullptr;
+    if (lowered && lowered->source == node) {
+        emitFunction(node, *lowered);
+        return;
+    }
+    printLine(functionSignature(node) + " {");
 
-    currentFunctionReturnType = typeToString(node->returnType);
+    currentFunctionReturnType = typeToCType(node->returnType, node->returnClass);
     indentLevel++;
+    emitProfileHook(node->name);
+    beginTaskFrame(node->body.get());
 
     if (node->body) {
         node->body->accept(this);
     }
 
+    endTaskFrame(node->body.get());
     indentLevel--;
     printLine("}");
     print("");
 }
 
 void CodeGenerator::visit(TemplateNode* node) {
-    if (node->function) {
-        node->function->accept(this);
+    for (auto& instance : node->instances) {
+        if (!instance->external) {
+            instance->accept(this);
+        }
     }
 }
 
+// Fields are laid out in decreasing alignment so the struct carries no
+// padding between them; SL code only ever names fields, never offsets.
 void CodeGenerator::visit(ClassNode* node) {
+    std::vector<const FieldDecl*> fields;
+    for (const auto& field : node->fields) {
+        fields.push_back(&field);
+    }
+    std::stable_sort(fields.begin(), fields.end(), [this](const FieldDecl* a, const FieldDecl* b) {
+        return typeAlignment(a->type, a->className) > typeAlignment(b->type, b->className);
+    });
+
     printLine("typedef struct " + node->name + " {");
+    for (const FieldDecl* field : fields) {
+        printLine("    " + typeToCType(field->type, field->className) + " " + field->name + ";");
+    }
     printLine("} " + node->name + ";");
     print("");
 }
 
-void CodeGenerator::visit(MethodNode* node) {
+std::string CodeGenerator::methodSignature(MethodNode* node) {
     std::stringstream ss;
-    ss << typeToCType(node->returnType) << " " << node->name << "(";
-
-    for (size_t i = 0; i < node->parameters.size(); ++i) {
-        if (i > 0) ss << ", ";
-        ss << typeToCType(node->parameters[i].second) << " " << node->parameters[i].first;
-    }
+    ss << typeToCType(node->returnType, node->returnClass) << " " << node->name << "(";
+    ss << parameterList(node->parameters, node->parameterClasses);
+    ss << ")";
+    return ss.str();
+}
 
-    ss << ") {";
-    printLine(ss.str());
+void CodeGenerator::visit(MethodNode* node) {
+    printLine(methodSignature(node) + " {");
 
-    currentFunctionReturnType = typeToString(node->returnType);
+    currentFunctionReturnType = typeToCType(node->returnType, node->returnClass);
     indentLevel++;
+    emitProfileHook(node->name);
+    beginTaskFrame(node->body.get());
 
     if (node->body) {
         node->body->accept(this);
     }
 
+    endTaskFrame(node->body.get());
     indentLevel--;
     printLine("}");
 }
 
 void CodeGenerator::visit(ConstructorNode* node) {
     std::stringstream ss;
-    ss << node->className << "* " << node->className << "_new(";
-
-    for (size_t i = 0; i < node->parameters.size(); ++i) {
-        if (i > 0) ss << ", ";
-        ss << typeToCType(node->parameters[i].second) << " " << node->parameters[i].first;
+    ss << node->className << "* " << node->className << "_init(" << node->className << "* obj";
+    if (!node->parameters.empty()) {
+        ss << ", " << parameterList(node->parameters, node->parameterClasses);
     }
-
     ss << ") {";
     printLine(ss.str());
 
+    currentFunctionReturnType = node->className + "*";
     indentLevel++;
-    printLine(node->className + "* obj = (" + node->className + "*)malloc(sizeof(" + node->className + "));");
+    emitProfileHook(node->className + "_init");
+    emitArrayFieldInit(node->className);
+    beginTaskFrame(node->body.get());
 
     if (node->body) {
         node->body->accept(this);
     }
 
+    endTaskFrame(node->body.get());
+
     printLine("return obj;");
     indentLevel--;
     printLine("}");
 }
 
 void CodeGenerator::visit(BlockNode* node) {
-    for (auto& stmt : node->statements) {
-        stmt->accept(this);
+    spawnTargetScopes.push_back(false);
+    for (size_t i = 0; i < node->statements.size(); ++i) {
+        returnSynced = syncedBefore(node, i);
+        node->statements[i]->accept(this);
+    }
+    bool declaresTargets = spawnTargetScopes.back();
+    spawnTargetScopes.pop_back();
+    if (declaresTargets && !endsInJump(node) && !syncedBefore(node, node->statements.size())) {
+        printLine("sl_task_sync(&sl_pending);");
     }
 }
 
@@ -182,7 +845,51 @@ void CodeGenerator::visit(VarDeclNode* node) {
     if (node->isConst) {
         ss << "const ";
     }
-    ss << typeToCType(node->type) << " " << node->name;
+    if (node->stackAllocated) {
+        auto* call = static_cast<CallExprNode*>(node->initializer.get());
+        print(node->className + " sl_obj_" + node->name + ";\n");
+        indent();
+        print(node->className + "* " + node->name + " = " + node->className + "_init(&sl_obj_" + node->name);
+        for (auto& arg : call->arguments) {
+            print(", ");
+            arg->accept(this);
+        }
+        print(");\n");
+        return;
+    }
+
+    if (node->isArray && isSoaClass(node->className)) {
+        bool first = true;
+        for (const auto& field : classTable.at(node->className)->fields) {
+            if (!first) indent();
+            first = false;
+            print(ss.str() + typeToCType(field.type, field.className) + " " + node->name + "_" + field.name + "[");
+            node->arraySize->accept(this);
+            print("];\n");
+        }
+        if (first) print(";\n");
+        return;
+    }
+
+    // Packed bool arrays start all false: the bits past the end of the last
+    // word must stay clear for bits_count. Globals are zeroed already.
+    if (node->isArray && node->type == Type::BOOL && node->arraySize) {
+        runtimeParts.insert(RuntimePart::BITS);
+        print(std::string(fileScope ? "static " : "") + "const int " + node->name + "_bits = ");
+        node->arraySize->accept(this);
+        print(";\n");
+        indent();
+        print("uint64_t " + node->name + "[((");
+        node->arraySize->accept(this);
+        print(") + 63) / 64];\n");
+        if (!fileScope) {
+            indent();
+            print("memset(" + node->name + ", 0, sizeof(" + node->name + "));\n");
+        }
+        return;
+    }
+
+    ss << typeToCType(node->type, node->className) << " " << node->name;
     
     if (node->isArray) {
         ss << "[";
@@ -208,6 +915,20 @@ void CodeGenerator::visit(VarDeclNode* node) {
         }
         node->initializer->accept(this);
         print(";\n");
+    } else if ((node->type == Type::ARRAY || node->type == Type::MAP) && !node->isArray && fileScope) {
+        // C only takes constants at file scope: a constructor function
+        // creates global arrays and maps before main, or when a library
+        // is loaded.
+        print(";\n");
+        printLine("__attribute__((constructor)) static void sl_init_" + node->name + "(void) {");
+        printLine("    " + node->name + " = " +
+                  (node->type == Type::ARRAY ? "sl_array_new(sizeof(" + elementCType(node->className) + "))"
+                                             : mapNew(node->className)) + ";");
+        printLine("}");
+    } else if (node->type == Type::ARRAY && !node->isArray) {
+        print(" = sl_array_new(sizeof(" + elementCType(node->className) + "));\n");
+    } else if (node->type == Type::MAP && !node->isArray) {
+        print(" = " + mapNew(node->className) + ";\n");
     } else {
         if (!node->isArray) {
             print(";\n");
@@ -217,22 +938,85 @@ void CodeGenerator::visit(VarDeclNode* node) {
     }
 }
 
+static const char* assignOperator(BinaryOp op) {
+    switch (op) {
+        case BinaryOp::PLUS_ASSIGN: return " += ";
+        case BinaryOp::MINUS_ASSIGN: return " -= ";
+        case BinaryOp::STAR_ASSIGN: return " *= ";
+        case BinaryOp::SLASH_ASSIGN: return " /= ";
+        default: return " = ";
+    }
+}
+
 void CodeGenerator::visit(VarAssignNode* node) {
     indent();
     std::stringstream ss;
-    
-    if (node->assignOp == BinaryOp::PLUS_ASSIGN) {
-        ss << node->name << " += ";
-    } else if (node->assignOp == BinaryOp::MINUS_ASSIGN) {
-        ss << node->name << " -= ";
-    } else if (node->assignOp == BinaryOp::STAR_ASSIGN) {
-        ss << node->name << " *= ";
-    } else if (node->assignOp == BinaryOp::SLASH_ASSIGN) {
-        ss << node->name << " /= ";
-    } else {
-        ss << node->name << " = ";
+    std::string name = variableName(node->name, node->isField);
+
+    if (node->index && node->arrayKind == ArrayKind::MAP) {
+        // Writing to a missing key inserts it with a zeroed value first,
+        // which may rehash the table: the value, which can read the map,
+        // is computed before the slot is taken.
+        std::string valueName = mapValueName(node->objectClass);
+        std::string target = "(*(" + elementCType(valueName) + "*)0)";
+        if (!node->field.empty()) {
+            target += memberAccess(valueName) + node->field;
+        }
+        print("{ __typeof__(" + target + ") sl_map_value_ = ");
+        node->value->accept(this);
+        print("; (*(" + elementCType(valueName) + "*)" + mapFunction("slot", mapKeyName(node->objectClass)) +
+              name + ", ");
+        node->index->accept(this);
+        print("))");
+        if (!node->field.empty()) {
+            print(memberAccess(valueName) + node->field);
+        }
+        print(std::string(assignOperator(node->assignOp)) + "sl_map_value_; }\n");
+        return;
+    } else if (node->index && node->arrayKind == ArrayKind::BITS) {
+        print("sl_bits_set(" + name + ", ");
+        emitIndex(node->index.get(), node->boundsCheck, arrayLength(name, node->arrayKind, ""), node->line);
+        print(", ");
+        node->value->accept(this);
+        print(");\n");
+        return;
+    } else if (node->index && node->arrayKind != ArrayKind::FIXED) {
+        std::string at = node->arrayKind == ArrayKind::SLICE ? "sl_slice_at(" : "sl_array_at(";
+        print(at + elementCType(node->objectClass) + ", " + name + ", ");
+        emitIndex(node->index.get(), node->boundsCheck, arrayLength(name, node->arrayKind, node->objectClass),
+                  node->line);
+        print(")");
+        if (!node->field.empty()) {
+            print(memberAccess(node->objectClass) + node->field);
+        }
+        name = "";
+    } else if (node->index) {
+        bool soa = isSoaClass(node->objectClass);
+        if (soa && node->field.empty()) {
+            print(node->objectClass + "_soa_store(");
+            emitSoaArrays(name, node->objectClass);
+            emitIndex(node->index.get(), node->boundsCheck, arrayLength(name, node->arrayKind, node->objectClass),
+                      node->line);
+            print(", ");
+            if (node->value) {
+                node->value->accept(this);
+            }
+            print(");\n");
+            return;
+        }
+        print((soa ? name + "_" + node->field : name) + "[");
+        emitIndex(node->index.get(), node->boundsCheck, arrayLength(name, node->arrayKind, node->objectClass),
+                  node->line);
+        print("]");
+        if (!soa && !node->field.empty()) {
+            print(memberAccess(node->objectClass) + node->field);
+        }
+        name = "";
+    } else if (!node->field.empty()) {
+        name += memberAccess(node->objectClass) + node->field;
     }
     
+    ss << name << assignOperator(node->assignOp);
     print(ss.str());
     
     if (node->value) {
@@ -246,16 +1030,20 @@ void CodeGenerator::visit(IncDecNode* node) {
     indent();
     std::stringstream ss;
     
+    std::string name = variableName(node->name, node->isField);
     if (node->isPrefix) {
-        ss << (node->isIncrement ? "++" : "--") << node->name;
+        ss << (node->isIncrement ? "++" : "--") << name;
     } else {
-        ss << node->name << (node->isIncrement ? "++" : "--");
+        ss << name << (node->isIncrement ? "++" : "--");
     }
     ss << ";";
     printLine(ss.str());
 }
 
 void CodeGenerator::visit(ReturnNode* node) {
+    if (currentFunctionSpawns && !returnSynced) {
+        printLine("sl_task_sync(&sl_pending);");
+    }
     indent();
     std::stringstream ss;
     ss << "return";
@@ -303,6 +1091,11 @@ void CodeGenerator::visit(IfNode* node) {
 }
 
 void CodeGenerator::visit(WhileNode* node) {
+    LoopRecord record;
+    record.sourceLine = node->line;
+    record.vectorizeHint = emitLoopAnnotations(node->annotations);
+    record.beginLine = outputLine;
+
     indent();
     print("while (");
     if (node->condition) {
@@ -318,15 +1111,34 @@ void CodeGenerator::visit(WhileNode* node) {
     
     indent();
     print("}\n");
+
+    record.endLine = outputLine - 1;
+    loops.push_back(record);
 }
 
 void CodeGenerator::visit(ForNode* node) {
+    emitHoistedChecks(node);
+    if (node->isParallel) {
+        std::stringstream ss;
+        ss << "#pragma omp parallel for";
+        for (const auto& reduction : node->reductions) {
+            ss << " reduction(" << binaryOpToString(reduction.first) << ":" << reduction.second << ")";
+        }
+        printLine(ss.str());
+        compilerFlags.insert("-fopenmp");
+    }
+
+    LoopRecord record;
+    record.sourceLine = node->line;
+    record.vectorizeHint = emitLoopAnnotations(node->annotations);
+    record.beginLine = outputLine;
+
     indent();
     print("for (");
     
     if (node->init) {
         std::stringstream ss;
-        ss << typeToCType(node->init->type) << " " << node->init->name;
+        ss << typeToCType(node->init->type, node->init->className) << " " << node->init->name;
         if (node->init->initializer) {
             ss << " = ";
             print(ss.str());
@@ -356,13 +1168,73 @@ void CodeGenerator::visit(ForNode* node) {
     
     indent();
     print("}\n");
+
+    record.endLine = outputLine - 1;
+    loops.push_back(record);
+}
+
+void CodeGenerator::emitOperand(ExpressionNode* operand, Type resultType) {
+    bool needParens = dynamic_cast<BinaryExprNode*>(operand) || dynamic_cast<TernaryExprNode*>(operand);
+    // Scalars mixed with a vector are converted to the lane type first; gcc
+    // refuses implicit narrowing such as double -> float lanes.
+    bool needCast = isVectorType(resultType) && !isVectorType(operand->type);
+
+    if (needCast) print("(" + typeToCType(vectorElementType(resultType)) + ")");
+    if (needParens || needCast) print("(");
+    operand->accept(this);
+    if (needParens || needCast) print(")");
+}
+
+static void collectConcatParts(ExpressionNode* expr, std::vector<ExpressionNode*>& parts) {
+    auto* bin = dynamic_cast<BinaryExprNode*>(expr);
+    if (bin && bin->op == BinaryOp::ADD && bin->type == Type::STRING) {
+        collectConcatParts(bin->left.get(), parts);
+        collectConcatParts(bin->right.get(), parts);
+    } else {
+        parts.push_back(expr);
+    }
+}
+
+void CodeGenerator::emitStringBinary(BinaryExprNode* node) {
+    runtimeParts.insert(RuntimePart::STRINGS);
+
+    if (node->op == BinaryOp::ADD) {
+        std::vector<ExpressionNode*> parts;
+        collectConcatParts(node, parts);
+        print("sl_str_concat(" + std::to_string(parts.size()) + ", (sl_str[]){");
+        for (size_t i = 0; i < parts.size(); ++i) {
+            if (i > 0) print(", ");
+            parts[i]->accept(this);
+        }
+        print("})");
+        return;
+    }
+
+    bool equality = node->op == BinaryOp::EQ || node->op == BinaryOp::NE;
+    if (node->op == BinaryOp::NE) print("!");
+    print(equality ? "sl_str_eq(" : "(sl_str_cmp(");
+    node->left->accept(this);
+    print(", ");
+    node->right->accept(this);
+    print(")");
+    if (!equality) {
+        switch (node->op) {
+            case BinaryOp::LT: print(" < 0)"); break;
+            case BinaryOp::GT: print(" > 0)"); break;
+            case BinaryOp::LE: print(" <= 0)"); break;
+            default: print(" >= 0)"); break;
+        }
+    }
 }
 
 void CodeGenerator::visit(BinaryExprNode* node) {
-    bool needParens = false;
-    
+    if (node->left && node->left->type == Type::STRING) {
+        emitStringBinary(node);
+        return;
+    }
+
     if (node->left) {
-        node->left->accept(this);
+        emitOperand(node->left.get(), node->type);
     }
     
     std::string op;
@@ -385,7 +1257,7 @@ void CodeGenerator::visit(BinaryExprNode* node) {
     print(op);
     
     if (node->right) {
-        node->right->accept(this);
+        emitOperand(node->right.get(), node->type);
     }
 }
 
@@ -404,7 +1276,71 @@ void CodeGenerator::visit(UnaryExprNode* node) {
 }
 
 void CodeGenerator::visit(CallExprNode* node) {
+    RuntimePart part;
+    bool builtin = runtimeBuiltinPart(node->functionName, part);
+    if (builtin && !node->arguments.empty() && node->arguments[0]->type == Type::MAP) {
+        part = RuntimePart::MAPS; // len
+    }
+    if (builtin) {
+        runtimeParts.insert(part);
+        if (part == RuntimePart::IO || part == RuntimePart::FILES || part == RuntimePart::ASYNC) {
+            runtimeParts.insert(RuntimePart::STRINGS);
+        }
+        if (part == RuntimePart::FILES) runtimeParts.insert(RuntimePart::SLICES);
+        if (part == RuntimePart::ASYNC) compilerFlags.insert("-pthread");
+    }
+
+    // Map built-ins that take a key go through the functions for its type.
+    if (builtin && part == RuntimePart::MAPS) {
+        if (node->functionName == "has" || node->functionName == "remove") {
+            print(mapFunction(node->functionName, mapKeyName(node->arguments[0]->className)));
+        } else {
+            print(node->functionName == "len" ? "sl_map_len(" : "sl_map_free(");
+        }
+        for (size_t i = 0; i < node->arguments.size(); ++i) {
+            if (i > 0) print(", ");
+            node->arguments[i]->accept(this);
+        }
+        print(")");
+        return;
+    }
+
+    // Array built-ins map onto the sl_array runtime; push also needs the
+    // element type to store the value.
+    if (builtin && part == RuntimePart::ARRAYS) {
+        if (node->functionName == "push") {
+            print("sl_array_push(" + elementCType(node->arguments[0]->className) + ", ");
+        } else if (node->functionName == "array_free") {
+            print("sl_array_free(");
+        } else if (node->arguments[0]->type == Type::SLICE) {
+            print("sl_slice_" + node->functionName + "(");
+        } else {
+            print("sl_array_" + node->functionName + "(");
+        }
+        for (size_t i = 0; i < node->arguments.size(); ++i) {
+            if (i > 0) print(", ");
+            node->arguments[i]->accept(this);
+        }
+        print(")");
+        return;
+    }
+
+    // Packed bool built-ins also take the bit count of their array.
+    if (builtin && part == RuntimePart::BITS) {
+        auto* bits = static_cast<VarNode*>(node->arguments[0].get());
+        print(node->functionName + "(" + bits->name + ", " + arrayLength(bits->name, ArrayKind::BITS, ""));
+        for (size_t i = 1; i < node->arguments.size(); ++i) {
+            print(", ");
+            node->arguments[i]->accept(this);
+        }
+        print(")");
+        return;
+    }
+
     print(node->functionName);
+    if (classTable.count(node->functionName)) {
+        print(isValueClass(node->functionName) ? "_make" : "_new");
+    }
     print("(");
     for (size_t i = 0; i < node->arguments.size(); ++i) {
         if (i > 0) print(", ");
@@ -416,6 +1352,7 @@ void CodeGenerator::visit(CallExprNode* node) {
 void CodeGenerator::visit(LiteralNode* node) {
     switch (node->literalType) {
         case Type::INT:
+        case Type::I64:
             print(std::to_string(node->intValue));
             break;
         case Type::DOUBLE:
@@ -428,7 +1365,8 @@ void CodeGenerator::visit(LiteralNode* node) {
             print(node->boolValue ? "1" : "0");
             break;
         case Type::STRING:
-            print("\"" + escapeString(node->stringValue) + "\"");
+            runtimeParts.insert(RuntimePart::STRINGS);
+            print("SL_STR_LIT(\"" + escapeString(node->stringValue) + "\")");
             break;
         default:
             print("0");
@@ -436,15 +1374,41 @@ void CodeGenerator::visit(LiteralNode* node) {
 }
 
 void CodeGenerator::visit(VarNode* node) {
-    print(node->name);
+    print(variableName(node->name, node->isField));
 }
 
 void CodeGenerator::visit(ArrayAccessNode* node) {
-    print(node->arrayName);
-    print("[");
-    if (node->index) {
+    if (node->arrayKind == ArrayKind::MAP) {
+        print("(*(" + typeToCType(node->type, node->className) + "*)" + mapFunction("get", node->keyName) +
+              node->arrayName + ", ");
         node->index->accept(this);
+        print("))");
+        return;
     }
+    std::string length = arrayLength(node->arrayName, node->arrayKind, node->className);
+    if (node->arrayKind == ArrayKind::BITS) {
+        print("sl_bits_get(" + node->arrayName + ", ");
+        emitIndex(node->index.get(), node->boundsCheck, length, node->line);
+        print(")");
+        return;
+    }
+    if (node->arrayKind != ArrayKind::FIXED) {
+        std::string at = node->arrayKind == ArrayKind::SLICE ? "sl_slice_at(" : "sl_array_at(";
+        print(at + typeToCType(node->type, node->className) + ", " + node->arrayName + ", ");
+        emitIndex(node->index.get(), node->boundsCheck, length, node->line);
+        print(")");
+        return;
+    }
+    if (isSoaClass(node->className)) {
+        print(node->className + "_soa_load(");
+        emitSoaArrays(node->arrayName, node->className);
+        emitIndex(node->index.get(), node->boundsCheck, length, node->line);
+        print(")");
+        return;
+    }
+    print(node->arrayName);
+    print("[");
+    emitIndex(node->index.get(), node->boundsCheck, length, node->line);
     print("]");
 }
 
@@ -465,67 +1429,193 @@ void CodeGenerator::visit(DoWhileNode* node) {
 }
 
 void CodeGenerator::visit(BreakNode* node) {
+    emitScopeSync();
     indent();
     print("break;\n");
 }
 
 void CodeGenerator::visit(ContinueNode* node) {
+    emitScopeSync();
     indent();
     print("continue;\n");
 }
 
+// Dense int cases stay a C switch, which gcc turns into a jump table.
+// Sparse int cases and string cases are first mapped to their position
+// 1..n, by a compile-time perfect hash or, for a few strings, by
+// comparisons, and the C switch then runs on that dense number. The key
+// keeps the type of the switch expression and is hashed in full, so a
+// 64-bit value never matches a case by its low bits.
 void CodeGenerator::visit(SwitchNode* node) {
-    indent();
-    print("switch (");
-    if (node->expression) {
+    size_t count = node->cases.size();
+    bool isString = node->expression && node->expression->type == Type::STRING;
+    long low = 0;
+    long high = 0;
+    for (size_t i = 0; i < count; i++) {
+        long value = node->cases[i]->intValue;
+        low = i == 0 ? value : std::min(low, value);
+        high = i == 0 ? value : std::max(high, value);
+    }
+
+    bool direct = !isString && (count < 8 || (unsigned long)high - (unsigned long)low < 3 * count);
+
+    std::vector<std::string> labels;
+    if (direct) {
+        for (auto& caseNode : node->cases) {
+            labels.push_back(std::to_string(caseNode->intValue));
+        }
+        indent();
+        print("switch (");
+        if (node->expression) {
+            node->expression->accept(this);
+        }
+        print(") {\n");
+    } else {
+        std::string prefix = "sl_switch" + std::to_string(switchCounter++);
+        std::string key = prefix + "_key";
+        std::string keyType = typeToCType(node->expression->type);
+        indent();
+        print("{\n");
+        indentLevel++;
+        indent();
+        print(keyType + " " + key + " = ");
         node->expression->accept(this);
+        print(";\n");
+
+        if (isString && count < 4) {
+            indent();
+            print("int " + prefix + "_case = ");
+            for (size_t i = 0; i < count; i++) {
+                print("sl_str_eq(" + key + ", SL_STR_LIT(\"" + escapeString(node->cases[i]->stringValue) +
+                      "\")) ? " + std::to_string(i + 1) + " : ");
+            }
+            print("0;\n");
+        } else {
+            runtimeParts.insert(RuntimePart::STRINGS);
+            runtimeParts.insert(RuntimePart::SWITCH);
+            PerfectHash table = buildPerfectHash(count, [&](size_t i, uint64_t seed) {
+                return isString ? switchHashString(node->cases[i]->stringValue, seed)
+                                : switchHashInt(node->cases[i]->intValue, seed);
+            });
+
+            std::vector<std::string> keys;
+            std::vector<std::string> cases;
+            for (int slot : table.slots) {
+                cases.push_back(std::to_string(slot + 1));
+                if (!isString) {
+                    keys.push_back(slot < 0 ? "0" : std::to_string(node->cases[slot]->intValue));
+                } else if (slot < 0) {
+                    keys.push_back("{ 0, 0, { .ptr = \"\" } }");
+                } else {
+                    std::string text = escapeString(node->cases[slot]->stringValue);
+                    keys.push_back("{ sizeof(\"" + text + "\") - 1, 0, { .ptr = \"" + text + "\" } }");
+                }
+            }
+            std::vector<std::string> seeds;
+            for (unsigned seed : table.bucketSeeds) {
+                seeds.push_back(std::to_string(seed));
+            }
+            emitSwitchTable(keyType, prefix + "_keys", keys);
+            emitSwitchTable(count < 256 ? "unsigned char" : "unsigned short", prefix + "_cases", cases);
+            emitSwitchTable("unsigned short", prefix + "_seeds", seeds);
+
+            std::stringstream ss;
+            ss << "uint64_t " << prefix << "_hash = sl_switch_hash_" << (isString ? "str" : "int") << "(" << key
+               << ", 0x" << std::hex << table.seed << std::dec << "ULL);\n";
+            indent();
+            print(ss.str());
+            indent();
+            print("unsigned " + prefix + "_slot = sl_switch_slot(" + prefix + "_hash, " + prefix + "_seeds[" +
+                  prefix + "_hash & " + std::to_string(table.bucketSeeds.size() - 1) + "], " +
+                  std::to_string(table.slots.size() - 1) + ");\n");
+            std::string slotKey = prefix + "_keys[" + prefix + "_slot]";
+            indent();
+            print("int " + prefix + "_case = " +
+                  (isString ? "sl_str_eq(" + slotKey + ", " + key + ")" : slotKey + " == " + key) + " ? " +
+                  prefix + "_cases[" + prefix + "_slot] : 0;\n");
+        }
+        for (size_t i = 0; i < count; i++) {
+            labels.push_back(std::to_string(i + 1));
+        }
+        indent();
+        print("switch (" + prefix + "_case) {\n");
     }
-    print(") {\n");
+
     indentLevel++;
-    for (auto& caseNode : node->cases) {
-        caseNode->accept(this);
+    for (size_t i = 0; i < count; i++) {
+        indent();
+        print("case " + labels[i] + ": ");
+        node->cases[i]->accept(this);
     }
     if (node->defaultCase) {
         indent();
-        print("default:\n");
+        print("default: {\n");
         indentLevel++;
         node->defaultCase->accept(this);
         indentLevel--;
+        indent();
+        print("}\n");
     }
     indentLevel--;
     indent();
     print("}\n");
+    if (!direct) {
+        indentLevel--;
+        indent();
+        print("}\n");
+    }
 }
 
-void CodeGenerator::visit(CaseNode* node) {
+void CodeGenerator::emitSwitchTable(const std::string& type, const std::string& name,
+                                    const std::vector<std::string>& entries) {
     indent();
-    print("case ");
-    if (node->value) {
-        node->value->accept(this);
+    print("static const " + type + " " + name + "[" + std::to_string(entries.size()) + "] = {");
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (i > 0) print(",");
+        if (i % 8 == 0) {
+            print("\n");
+            indentLevel++;
+            indent();
+            indentLevel--;
+        } else {
+            print(" ");
+        }
+        print(entries[i]);
     }
-    print(":\n");
+    print("\n");
+    indent();
+    print("};\n");
+}
+
+// Case bodies are braced so they may declare variables; falling through
+// into the next label works as in C.
+void CodeGenerator::visit(CaseNode* node) {
+    print("{\n");
     indentLevel++;
     if (node->block) {
         node->block->accept(this);
     }
     indentLevel--;
+    indent();
+    print("}\n");
 }
 
 void CodeGenerator::visit(IncDecExprNode* node) {
+    std::string name = variableName(node->name, node->isField);
     if (node->isIncrement) {
         if (node->isPrefix) {
             print("++");
-            print(node->name);
+            print(name);
         } else {
-            print(node->name);
+            print(name);
             print("++");
         }
     } else {
         if (node->isPrefix) {
             print("--");
-            print(node->name);
+            print(name);
         } else {
-            print(node->name);
+            print(name);
             print("--");
         }
     }
@@ -547,3 +1637,150 @@ void CodeGenerator::visit(TernaryExprNode* node) {
     }
     if (needParen) print(")");
 }
+
+void CodeGenerator::visit(SpawnNode* node) {
+    auto* call = static_cast<CallExprNode*>(node->call.get());
+    FunctionNode* callee = functionTable[call->functionName];
+    std::string task = "sl_spawn_" + std::to_string(++spawnCounter);
+    std::string resultType = typeToCType(callee->returnType, callee->returnClass);
+
+    // Task record and trampoline that runs the call on a worker.
+    target = &helpers;
+    int savedIndent = indentLevel;
+    indentLevel = 0;
+    printLine("typedef struct " + task + " {");
+    printLine("    sl_task base;");
+    if (!node->target.empty()) {
+        printLine("    " + resultType + "* result;");
+    }
+    for (size_t i = 0; i < callee->parameters.size(); ++i) {
+        std::string className = i < callee->parameterClasses.size() ? callee->parameterClasses[i] : "";
+        printLine("    " + typeToCType(callee->parameters[i].second, className) + " arg" + std::to_string(i) + ";");
+    }
+    printLine("} " + task + ";");
+    std::stringstream proto;
+    proto << resultType << " " << callee->name << "(";
+    proto << parameterList(callee->parameters, callee->parameterClasses);
+    proto << ");";
+    printLine(proto.str());
+    printLine("static void " + task + "_run(sl_task* task) {");
+    printLine("    " + task + "* t = (" + task + "*)task;");
+    std::stringstream invoke;
+    invoke << (node->target.empty() ? "    " : "    *t->result = ") << callee->name << "(";
+    for (size_t i = 0; i < callee->parameters.size(); ++i) {
+        if (i > 0) invoke << ", ";
+        invoke << "t->arg" << i;
+    }
+    invoke << ");";
+    printLine(invoke.str());
+    printLine("}");
+    print("\n");
+    indentLevel = savedIndent;
+    target = &code;
+
+    if (node->declaresTarget) {
+        printLine(typeToCType(node->targetType, node->targetClass) + " " + node->target + ";");
+        // The function body's targets live until its final sync.
+        if (spawnTargetScopes.size() > 1) spawnTargetScopes.back() = true;
+    }
+
+    printLine("if (sl_task_should_inline()) {");
+    indentLevel++;
+    indent();
+    if (!node->target.empty()) {
+        print(node->target + " = ");
+    }
+    call->accept(this);
+    print(";\n");
+    indentLevel--;
+    printLine("} else {");
+    indentLevel++;
+    printLine(task + "* " + task + "_task = (" + task + "*)malloc(sizeof(" + task + "));");
+    printLine(task + "_task->base.run = " + task + "_run;");
+    if (!node->target.empty()) {
+        printLine(task + "_task->result = &" + node->target + ";");
+    }
+    for (size_t i = 0; i < call->arguments.size(); ++i) {
+        indent();
+        print(task + "_task->arg" + std::to_string(i) + " = ");
+        call->arguments[i]->accept(this);
+        print(";\n");
+    }
+    printLine("sl_task_spawn(&" + task + "_task->base, &sl_pending);");
+    indentLevel--;
+    printLine("}");
+}
+
+void CodeGenerator::visit(SyncNode* node) {
+    if (currentFunctionSpawns) {
+        printLine("sl_task_sync(&sl_pending);");
+    }
+}
+
+void CodeGenerator::visit(ExpressionStmtNode* node) {
+    indent();
+    if (node->expression) {
+        node->expression->accept(this);
+    }
+    print(";\n");
+}
+
+void CodeGenerator::visit(FieldAccessNode* node) {
+    auto* element = dynamic_cast<ArrayAccessNode*>(node->object.get());
+    if (element && element->arrayKind == ArrayKind::FIXED && isSoaClass(element->className)) {
+        print(element->arrayName + "_" + node->field + "[");
+        emitIndex(element->index.get(), element->boundsCheck,
+                  arrayLength(element->arrayName, element->arrayKind, element->className), element->line);
+        print("]");
+        return;
+    }
+    if (node->object) {
+        node->object->accept(this);
+        print(memberAccess(node->object->className));
+    }
+    print(node->field);
+}
+
+// Slicing only computes a new pointer and length, after checking the bounds
+// against what is being sliced, as --run does. A missing low bound is 0 and
+// a missing high bound is the length.
+void CodeGenerator::visit(SliceExprNode* node) {
+    const std::string& name = node->arrayName;
+    std::string data;
+    std::string size;
+    std::string length;
+    if (node->type == Type::STRING) {
+        runtimeParts.insert(RuntimePart::STRINGS);
+        print("sl_str_slice(" + name + ", ");
+        length = "(int)" + name + ".len";
+    } else {
+        runtimeParts.insert(RuntimePart::SLICES);
+        if (node->arrayKind == ArrayKind::DYNAMIC) {
+            data = name + "->data";
+            size = name + "->elem_size";
+            length = name + "->len";
+        } else if (node->arrayKind == ArrayKind::SLICE) {
+            data = name + ".data";
+            size = "sizeof(" + elementCType(node->className) + ")";
+            length = name + ".len";
+        } else {
+            data = name;
+            size = "sizeof(" + name + "[0])";
+            length = "(int)(sizeof(" + name + ") / sizeof(" + name + "[0]))";
+        }
+        print("sl_slice_of(" + data + ", " + size + ", " + length + ", ");
+    }
+
+    if (node->low) {
+        node->low->accept(this);
+    } else {
+        print("0");
+    }
+    print(", ");
+    if (node->high) {
+        node->high->accept(this);
+    } else {
+        print(length);
+    }
+    print(", " + std::to_string(node->line) + ")");
+}
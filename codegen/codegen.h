@@ -2,28 +2,125 @@
 #define CODEGEN_H
 
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <map>
+#include <set>
+#include <vector>
 #include "../ast/ast.h"
+#include "../ir/ir.h"
+#include "runtime.h"
+
+// Location of a generated loop, used to map gcc optimization reports back to SL source.
+struct LoopRecord {
+    int sourceLine;
+    int beginLine;
+    int endLine;
+    bool vectorizeHint;
+};
 
 class CodeGenerator : public ASTVisitor {
 private:
     std::ostream& out;
+    std::stringstream code;
+    std::stringstream helpers;
+    std::ostream* target;
     int indentLevel;
     std::string currentFunctionReturnType;
     bool libraryMode;
+    bool sharedLibrary;
+    int outputLine;
+    std::set<std::string> compilerFlags;
+    std::vector<LoopRecord> loops;
+    std::set<RuntimePart> runtimeParts;
+    std::map<std::string, FunctionNode*> functionTable;
+    std::map<std::string, ClassNode*> classTable;
+    bool currentFunctionSpawns;
+    std::vector<bool> spawnTargetScopes; // blocks being written, true once one declares a spawn target
+    bool returnSynced;                   // a sync earlier in the return's block left nothing pending
+    int spawnCounter;
+    int switchCounter;
+    bool boundsChecking;
+    bool fileScope;
+    const IRModule* irModule;
+    std::map<const IRValue*, const IRValue*> phiResults; // values computed straight into the phi they feed
+    bool instrumenting;
+    std::vector<std::string> profiledFunctions; // names by profile id
 
     void indent();
     void print(const std::string& str);
     void printLine(const std::string& str);
     std::string typeToCType(Type type);
+    std::string typeToCType(Type type, const std::string& className);
+    std::string functionSignature(FunctionNode* node);
+    std::string parameterList(const std::vector<std::pair<std::string, Type>>& parameters,
+                              const std::vector<std::string>& parameterClasses);
+    void emitOperand(ExpressionNode* operand, Type resultType);
+    void emitStringBinary(BinaryExprNode* node);
     std::string escapeString(const std::string& str);
+    bool emitLoopAnnotations(const std::vector<LoopAnnotation>& annotations);
+    void beginTaskFrame(BlockNode* body);
+    void endTaskFrame(BlockNode* body);
+    void emitScopeSync();
+    void emitClassPool(ClassNode* cls);
+    void emitValueConstructor(ClassNode* cls);
+    void emitValueMake(ClassNode* cls, const std::string& params, const std::string& args);
+    void emitConstructor(ClassNode* cls, std::string& params, std::string& args);
+    void constructorParameters(ClassNode* cls, std::string& params, std::string& args);
+    std::string methodSignature(MethodNode* node);
+    void declareExternal(VarDeclNode* node);
+    void declareExternal(ClassNode* cls);
+    void emitModuleTable(ProgramNode* program);
+    bool isValueClass(const std::string& className) const;
+    bool isSoaClass(const std::string& className) const;
+    void emitSoaAccessors(ClassNode* cls);
+    void emitSoaArrays(const std::string& name, const std::string& className);
+    std::string elementCType(const std::string& elementName);
+    void emitArrayFieldInit(const std::string& className);
+    std::string mapNew(const std::string& mapTypes);
+    std::string mapFunction(const std::string& operation, const std::string& keyName) const;
+    std::string memberAccess(const std::string& className) const;
+    std::string variableName(const std::string& name, bool isField) const;
+    int typeAlignment(Type type, const std::string& className) const;
+    std::string arrayLength(const std::string& name, ArrayKind kind, const std::string& className) const;
+    void emitIndex(ExpressionNode* index, bool check, const std::string& length, int line);
+    void emitHoistedChecks(ForNode* node);
+    void emitSwitchTable(const std::string& type, const std::string& name,
+                         const std::vector<std::string>& entries);
+    void emitProfileHook(const std::string& name);
+    void emitProfileNames();
+    void emitFunction(FunctionNode* node, const IRFunction& function);
+    void emitPhiCopies(const IRBlock* from, const IRBlock* to, int occurrence);
+    void coalescePhiResults(const IRFunction& function);
+    std::string irName(const IRValue* value);
+    std::string irOperand(const IRValue* value);
+    std::string irExpression(const IRValue* instr);
+    std::string irCall(const IRValue* instr);
 
 public:
-    CodeGenerator(std::ostream& output) : out(output), indentLevel(0), libraryMode(false) {}
+    CodeGenerator(std::ostream& output)
+        : out(output), target(&code), indentLevel(0), libraryMode(false), sharedLibrary(false), outputLine(1),
+          currentFunctionSpawns(false), returnSynced(false), spawnCounter(0), switchCounter(0), boundsChecking(false),
+          fileScope(false), irModule(nullptr), instrumenting(false) {}
     ~CodeGenerator() = default;
 
     void setLibraryMode(bool mode) { libraryMode = mode; }
+    // Shared libraries export a table of their functions (sl_module_info)
+    // for hosts that reload them, see host/sl_reload.h, and sl_flush_output.
+    // Static ones do not, so that several can be linked into one program.
+    void setSharedLibrary(bool shared) { sharedLibrary = shared; }
+    // Checks every index that RangeAnalyzer left marked.
+    void setBoundsChecking(bool enabled) { boundsChecking = enabled; }
+    // Functions in the module are written from their SSA form (slc --ir).
+    void setIR(const IRModule* module) { irModule = module; }
+    // Every function counts its calls and time and the program writes a
+    // flat profile when it exits (slc --instrument).
+    void setInstrumentation(bool enabled) { instrumenting = enabled; }
     void generate(ProgramNode* program);
+
+    // Extra gcc flags required by the generated code (e.g. -fopenmp-simd).
+    std::string getCompilerFlags() const;
+    const std::vector<LoopRecord>& getLoops() const { return loops; }
     
     // Visitor methods
     void visit(ProgramNode* node) override;
@@ -54,6 +151,11 @@ public:
     void visit(SwitchNode* node) override;
     void visit(CaseNode* node) override;
     void visit(TernaryExprNode* node) override;
+    void visit(SpawnNode* node) override;
+    void visit(SyncNode* node) override;
+    void visit(ExpressionStmtNode* node) override;
+    void visit(FieldAccessNode* node) override;
+    void visit(SliceExprNode* node) override;
 };
 
 #endif
\ No newline at end of file
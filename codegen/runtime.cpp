@@ -0,0 +1,1803 @@
+#include "runtime.h"
+
+// Work-stealing task scheduler used by spawn/sync. Every worker owns a
+// Chase-Lev deque: the owner pushes and takes at the bottom, thieves steal
+// from the top. The thread that spawns first becomes worker 0.
+static const char* TASKS_SOURCE = R"SL(
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SL_DEQUE_CAPACITY 4096
+#define SL_MAX_WORKERS 256
+
+typedef struct sl_task {
+    void (*run)(struct sl_task* task);
+    atomic_int* pending;
+} sl_task;
+
+typedef struct sl_deque {
+    atomic_long top;
+    char topPadding[64 - sizeof(atomic_long)];
+    atomic_long bottom;
+    char bottomPadding[64 - sizeof(atomic_long)];
+    _Atomic(sl_task*) buffer[SL_DEQUE_CAPACITY];
+} sl_deque;
+
+static sl_deque* sl_deques;
+static int sl_worker_count = 1;
+static long sl_task_cutoff = 8;
+static pthread_once_t sl_task_once = PTHREAD_ONCE_INIT;
+static _Thread_local int sl_worker_id = -1;
+static _Thread_local unsigned int sl_steal_seed = 1;
+
+static int sl_deque_push(sl_deque* q, sl_task* task) {
+    long b = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&q->top, memory_order_acquire);
+    if (b - t >= SL_DEQUE_CAPACITY) return 0;
+    atomic_store_explicit(&q->buffer[b & (SL_DEQUE_CAPACITY - 1)], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    return 1;
+}
+
+static sl_task* sl_deque_take(sl_deque* q) {
+    long b = atomic_load_explicit(&q->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&q->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&q->top, memory_order_relaxed);
+    sl_task* task = NULL;
+    if (t <= b) {
+        task = atomic_load_explicit(&q->buffer[b & (SL_DEQUE_CAPACITY - 1)], memory_order_relaxed);
+        if (t == b) {
+            if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+                    memory_order_seq_cst, memory_order_relaxed)) {
+                task = NULL;
+            }
+            atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+static sl_task* sl_deque_steal(sl_deque* q) {
+    long t = atomic_load_explicit(&q->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&q->bottom, memory_order_acquire);
+    if (t >= b) return NULL;
+    sl_task* task = atomic_load_explicit(&q->buffer[t & (SL_DEQUE_CAPACITY - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1,
+            memory_order_seq_cst, memory_order_relaxed)) {
+        return NULL;
+    }
+    return task;
+}
+
+static void sl_task_run(sl_task* task) {
+    atomic_int* pending = task->pending;
+    task->run(task);
+    free(task);
+    atomic_fetch_sub_explicit(pending, 1, memory_order_release);
+}
+
+static sl_task* sl_task_find(void) {
+    sl_task* task = sl_deque_take(&sl_deques[sl_worker_id]);
+    if (task) return task;
+    for (int attempt = 0; attempt < sl_worker_count; attempt++) {
+        sl_steal_seed ^= sl_steal_seed << 13;
+        sl_steal_seed ^= sl_steal_seed >> 17;
+        sl_steal_seed ^= sl_steal_seed << 5;
+        int victim = (int)(sl_steal_seed % (unsigned int)sl_worker_count);
+        if (victim == sl_worker_id) continue;
+        task = sl_deque_steal(&sl_deques[victim]);
+        if (task) return task;
+    }
+    return NULL;
+}
+
+static void* sl_worker_main(void* arg) {
+    sl_worker_id = (int)(long)arg;
+    sl_steal_seed = 2654435761u * (unsigned int)(sl_worker_id + 1);
+    int idle = 0;
+    for (;;) {
+        sl_task* task = sl_task_find();
+        if (task) {
+            sl_task_run(task);
+            idle = 0;
+        } else if (++idle < 64) {
+            sched_yield();
+        } else {
+            struct timespec delay = { 0, idle < 1024 ? 50000 : 1000000 };
+            nanosleep(&delay, NULL);
+        }
+    }
+    return NULL;
+}
+
+static void sl_task_init(void) {
+    const char* env = getenv("SL_WORKERS");
+    long workers = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers < 1) workers = 1;
+    if (workers > SL_MAX_WORKERS) workers = SL_MAX_WORKERS;
+    env = getenv("SL_TASK_CUTOFF");
+    if (env && atol(env) > 0) sl_task_cutoff = atol(env);
+
+    sl_worker_count = (int)workers;
+    sl_deques = (sl_deque*)calloc((size_t)workers, sizeof(sl_deque));
+    sl_worker_id = 0;
+    for (long i = 1; i < workers; i++) {
+        pthread_t thread;
+        pthread_create(&thread, NULL, sl_worker_main, (void*)i);
+        pthread_detach(thread);
+    }
+}
+
+/* Granularity cutoff: spawn runs the call serially when there is a single
+   worker, when called from a thread outside the pool, or when the worker's
+   deque already holds enough stealable work. */
+static int sl_task_should_inline(void) {
+    pthread_once(&sl_task_once, sl_task_init);
+    if (sl_worker_id < 0 || sl_worker_count == 1) return 1;
+    sl_deque* q = &sl_deques[sl_worker_id];
+    long size = atomic_load_explicit(&q->bottom, memory_order_relaxed) -
+                atomic_load_explicit(&q->top, memory_order_relaxed);
+    return size >= sl_task_cutoff;
+}
+
+static void sl_task_spawn(sl_task* task, atomic_int* pending) {
+    task->pending = pending;
+    atomic_fetch_add_explicit(pending, 1, memory_order_relaxed);
+    if (!sl_deque_push(&sl_deques[sl_worker_id], task)) {
+        sl_task_run(task);
+    }
+}
+
+static void sl_task_sync(atomic_int* pending) {
+    while (atomic_load_explicit(pending, memory_order_acquire) > 0) {
+        sl_task* task = sl_task_find();
+        if (task) {
+            sl_task_run(task);
+        } else {
+            sched_yield();
+        }
+    }
+}
+)SL";
+
+// GCC vector extension types behind vec4f/vec8f/vec4d/vec8i. Loads and stores
+// go through memcpy so SL arrays need no particular alignment.
+static const char* VECTORS_SOURCE = R"SL(
+typedef float sl_vec4f __attribute__((vector_size(16)));
+typedef float sl_vec8f __attribute__((vector_size(32)));
+typedef double sl_vec4d __attribute__((vector_size(32)));
+typedef int sl_vec8i __attribute__((vector_size(32)));
+
+#define SL_VECTOR_OPS(name, vtype, etype, lanes) \
+static inline vtype name##_load(const etype* p, int i) { \
+    vtype v; \
+    memcpy(&v, p + i, sizeof(v)); \
+    return v; \
+} \
+static inline void name##_store(etype* p, int i, vtype v) { \
+    memcpy(p + i, &v, sizeof(v)); \
+} \
+static inline vtype name##_splat(etype x) { \
+    vtype v = {0}; \
+    return v + x; \
+} \
+static inline etype name##_sum(vtype v) { \
+    etype sum = 0; \
+    for (int k = 0; k < lanes; k++) sum += v[k]; \
+    return sum; \
+}
+
+SL_VECTOR_OPS(vec4f, sl_vec4f, float, 4)
+SL_VECTOR_OPS(vec8f, sl_vec8f, float, 8)
+SL_VECTOR_OPS(vec4d, sl_vec4d, double, 4)
+SL_VECTOR_OPS(vec8i, sl_vec8i, int, 8)
+)SL";
+
+// Length-prefixed strings. Up to 15 bytes are stored inline in the struct,
+// longer ones point into a per-thread arena that lives until the program
+// exits or str_reset() empties it. Literals point straight at the C string
+// constant.
+static const char* STRINGS_SOURCE = R"SL(
+#include <stdint.h>
+
+#define SL_STR_INLINE 15
+#define SL_ARENA_CHUNK 65536
+
+typedef struct sl_str {
+    uint32_t len;
+    uint32_t small;
+    union {
+        const char* ptr;
+        char sso[SL_STR_INLINE + 1];
+    } data;
+} sl_str;
+
+#define SL_STR_LIT(s) ((sl_str){ sizeof(s) - 1, 0, { .ptr = (s) } })
+
+typedef struct sl_arena_chunk {
+    struct sl_arena_chunk* next;
+    size_t used;
+    size_t size;
+    char bytes[];
+} sl_arena_chunk;
+
+static _Thread_local sl_arena_chunk* sl_str_arena;
+
+static sl_arena_chunk* sl_arena_chunk_new(size_t size, sl_arena_chunk* next) {
+    sl_arena_chunk* chunk = (sl_arena_chunk*)malloc(sizeof(sl_arena_chunk) + size);
+    if (!chunk) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    chunk->next = next;
+    chunk->used = 0;
+    chunk->size = size;
+    return chunk;
+}
+
+static char* sl_str_alloc(size_t size) {
+    sl_arena_chunk* chunk = sl_str_arena;
+    if (size > SL_ARENA_CHUNK / 4) {
+        /* Large strings get their own chunk behind the current one so the
+           free space left in the current chunk is not abandoned. */
+        sl_arena_chunk* own = sl_arena_chunk_new(size, chunk ? chunk->next : NULL);
+        if (chunk) chunk->next = own; else sl_str_arena = own;
+        own->used = size;
+        return own->bytes;
+    }
+    if (!chunk || chunk->size - chunk->used < size) {
+        chunk = sl_arena_chunk_new(SL_ARENA_CHUNK, chunk);
+        sl_str_arena = chunk;
+    }
+    char* bytes = chunk->bytes + chunk->used;
+    chunk->used += size;
+    return bytes;
+}
+
+/* Releases every long string this thread has built. The current chunk is
+   kept, emptied, for the strings that follow. */
+static void str_reset(void) {
+    sl_arena_chunk* chunk = sl_str_arena;
+    if (!chunk) return;
+    sl_arena_chunk* rest = chunk->next;
+    if (chunk->size == SL_ARENA_CHUNK) {
+        chunk->next = NULL;
+        chunk->used = 0;
+    } else {
+        rest = chunk;
+        sl_str_arena = NULL;
+    }
+    while (rest) {
+        sl_arena_chunk* next = rest->next;
+        free(rest);
+        rest = next;
+    }
+}
+
+static inline const char* sl_str_data(const sl_str* s) {
+    return s->small ? s->data.sso : s->data.ptr;
+}
+
+/* a + b + ... + z is lowered to one call: lengths are summed first, then
+   every part is copied into a single allocation. */
+static sl_str sl_str_concat(int count, const sl_str* parts) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) total += parts[i].len;
+
+    sl_str result;
+    char* out;
+    result.len = (uint32_t)total;
+    if (total <= SL_STR_INLINE) {
+        result.small = 1;
+        out = result.data.sso;
+    } else {
+        result.small = 0;
+        out = sl_str_alloc(total + 1);
+        result.data.ptr = out;
+    }
+    for (int i = 0; i < count; i++) {
+        memcpy(out, sl_str_data(&parts[i]), parts[i].len);
+        out += parts[i].len;
+    }
+    *out = '\0';
+    return result;
+}
+
+static inline int sl_str_eq(sl_str a, sl_str b) {
+    return a.len == b.len && memcmp(sl_str_data(&a), sl_str_data(&b), a.len) == 0;
+}
+
+static int sl_str_cmp(sl_str a, sl_str b) {
+    uint32_t n = a.len < b.len ? a.len : b.len;
+    int c = memcmp(sl_str_data(&a), sl_str_data(&b), n);
+    if (c != 0) return c;
+    return (a.len > b.len) - (a.len < b.len);
+}
+
+static inline int str_len(sl_str s) {
+    return (int)s.len;
+}
+
+/* s[lo:hi] shares the bytes of s; results short enough to be stored
+   inline are copied instead, so they never point into a temporary.
+   Bounds outside the string abort the program with the SL line. */
+static sl_str sl_str_slice(sl_str s, int lo, int hi, int line) {
+    sl_str result;
+    if (__builtin_expect(lo < 0 || hi < lo || hi > (int)s.len, 0)) {
+        fprintf(stderr, "line %d: slice [%d:%d] out of bounds for length %d\n", line, lo, hi, (int)s.len);
+        abort();
+    }
+    result.len = (uint32_t)(hi - lo);
+    if (result.len <= SL_STR_INLINE) {
+        result.small = 1;
+        memcpy(result.data.sso, sl_str_data(&s) + lo, result.len);
+        result.data.sso[result.len] = '\0';
+    } else {
+        result.small = 0;
+        result.data.ptr = sl_str_data(&s) + lo;
+    }
+    return result;
+}
+)SL";
+
+// Slab allocator behind <Class>_new. Every class has one pool per thread:
+// freed objects go onto an intrusive free list and are handed out again
+// before the slab is bumped; reset releases every slab of the pool at once.
+// Slabs are aligned to their size and name the pool that carved them, so an
+// object freed on another thread goes back to its owner: onto a lock-free
+// list the owner takes over once its own free list runs dry.
+static const char* POOL_SOURCE = R"SL(
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define SL_POOL_SLAB_BYTES 16384
+#define SL_POOL_STRIDE(size) \
+    ((((size) < sizeof(void*) ? sizeof(void*) : (size)) + _Alignof(max_align_t) - 1) & \
+     ~(_Alignof(max_align_t) - 1))
+#define SL_POOL_INIT(size) { SL_POOL_STRIDE(size), NULL, NULL, NULL, NULL, NULL }
+
+typedef union sl_pool_slab {
+    struct {
+        union sl_pool_slab* next;
+        struct sl_pool* owner;
+    } header;
+    max_align_t align;
+} sl_pool_slab;
+
+typedef struct sl_pool {
+    size_t stride;
+    void* free_list;
+    char* cursor;
+    char* limit;
+    sl_pool_slab* slabs;
+    _Atomic(void*) remote_free; /* objects freed by other threads */
+} sl_pool;
+
+/* The same for every pool of a class, so any thread can find the slab of
+   an object from its address. */
+static inline size_t sl_pool_slab_bytes(size_t stride) {
+    size_t bytes = SL_POOL_SLAB_BYTES;
+    while (bytes - sizeof(sl_pool_slab) < stride) bytes *= 2;
+    return bytes;
+}
+
+static void* sl_pool_alloc(sl_pool* pool) {
+    void* obj = pool->free_list;
+    if (!obj && atomic_load_explicit(&pool->remote_free, memory_order_relaxed)) {
+        obj = atomic_exchange_explicit(&pool->remote_free, NULL, memory_order_acquire);
+    }
+    if (obj) {
+        pool->free_list = *(void**)obj;
+        return obj;
+    }
+    if (pool->cursor == pool->limit) {
+        size_t bytes = sl_pool_slab_bytes(pool->stride);
+        sl_pool_slab* slab = (sl_pool_slab*)aligned_alloc(bytes, bytes);
+        if (!slab) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        slab->header.next = pool->slabs;
+        slab->header.owner = pool;
+        pool->slabs = slab;
+        pool->cursor = (char*)(slab + 1);
+        pool->limit = pool->cursor + (bytes - sizeof(sl_pool_slab)) / pool->stride * pool->stride;
+    }
+    obj = pool->cursor;
+    pool->cursor += pool->stride;
+    return obj;
+}
+
+static inline void sl_pool_free(sl_pool* pool, void* obj) {
+    uintptr_t mask = ~(uintptr_t)(sl_pool_slab_bytes(pool->stride) - 1);
+    sl_pool* owner = ((sl_pool_slab*)((uintptr_t)obj & mask))->header.owner;
+    if (owner == pool) {
+        *(void**)obj = pool->free_list;
+        pool->free_list = obj;
+        return;
+    }
+    void* head = atomic_load_explicit(&owner->remote_free, memory_order_relaxed);
+    do {
+        *(void**)obj = head;
+    } while (!atomic_compare_exchange_weak_explicit(&owner->remote_free, &head, obj,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+/* Objects of this pool still held by other threads die with it; they must
+   not be freed afterwards. */
+static void sl_pool_reset(sl_pool* pool) {
+    sl_pool_slab* slab = pool->slabs;
+    while (slab) {
+        sl_pool_slab* next = slab->header.next;
+        free(slab);
+        slab = next;
+    }
+    pool->free_list = NULL;
+    pool->cursor = NULL;
+    pool->limit = NULL;
+    pool->slabs = NULL;
+    atomic_store_explicit(&pool->remote_free, NULL, memory_order_relaxed);
+}
+)SL";
+
+// Growable arrays. The header is heap allocated so an array can be passed
+// around and grown by any holder. Data blocks are always a whole size
+// class: powers of two up to 64 KiB, then multiples of 64 KiB. The slack
+// of a class counts as capacity, growth is geometric (2x for small blocks,
+// 1.5x for large ones) and goes through realloc, which extends the block
+// in place when the allocator can.
+static const char* ARRAYS_SOURCE = R"SL(
+#define SL_ARRAY_LARGE 65536
+
+typedef struct sl_array {
+    char* data;
+    int len;
+    int cap;
+    int elem_size;
+} sl_array;
+
+#define sl_array_at(T, a, i) (((T*)(a)->data)[i])
+/* The value is computed before the slot: it may read the array, which
+   taking the slot grows and may move. */
+#define sl_array_push(T, a, v) ({ T sl_array_value_ = (v); *(T*)sl_array_slot(a) = sl_array_value_; })
+
+static size_t sl_size_class(size_t bytes) {
+    if (bytes > SL_ARRAY_LARGE) {
+        return (bytes + SL_ARRAY_LARGE - 1) & ~(size_t)(SL_ARRAY_LARGE - 1);
+    }
+    size_t size = 32;
+    while (size < bytes) size <<= 1;
+    return size;
+}
+
+static sl_array* sl_array_new(int elem_size) {
+    sl_array* a = (sl_array*)calloc(1, sizeof(sl_array));
+    if (!a) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    a->elem_size = elem_size;
+    return a;
+}
+
+static void sl_array_resize(sl_array* a, size_t count) {
+    size_t bytes = sl_size_class(count * (size_t)a->elem_size);
+    char* data = (char*)realloc(a->data, bytes);
+    if (!data) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    a->data = data;
+    a->cap = (int)(bytes / (size_t)a->elem_size);
+}
+
+/* Returns the slot for a pushed element, growing the array first if it
+   is full. */
+static void* sl_array_slot(sl_array* a) {
+    if (a->len == a->cap) {
+        size_t bytes = (size_t)a->cap * (size_t)a->elem_size;
+        size_t count = bytes < SL_ARRAY_LARGE ? (size_t)a->cap * 2 : (size_t)a->cap + a->cap / 2;
+        sl_array_resize(a, count ? count : 1);
+    }
+    return a->data + (size_t)a->len++ * (size_t)a->elem_size;
+}
+
+static inline int sl_array_len(sl_array* a) {
+    return a->len;
+}
+
+static void sl_array_reserve(sl_array* a, int count) {
+    if (count > a->cap) {
+        sl_array_resize(a, (size_t)count);
+    }
+}
+
+/* Gives back everything beyond the size class of the current length. */
+static void sl_array_shrink(sl_array* a) {
+    if (a->len == 0) {
+        free(a->data);
+        a->data = NULL;
+        a->cap = 0;
+    } else if (sl_size_class((size_t)a->len * (size_t)a->elem_size) < (size_t)a->cap * (size_t)a->elem_size) {
+        sl_array_resize(a, (size_t)a->len);
+    }
+}
+
+static void sl_array_free(sl_array* a) {
+    free(a->data);
+    free(a);
+}
+)SL";
+
+// Slices: a pointer to the first element and a length, passed by value.
+// Taking a slice copies nothing; the slice is valid as long as the array
+// it points into (a growable array may move when it grows).
+static const char* SLICES_SOURCE = R"SL(
+typedef struct sl_slice {
+    char* data;
+    int len;
+} sl_slice;
+
+#define sl_slice_at(T, s, i) (((T*)(s).data)[i])
+
+/* Bounds outside [0, len] abort the program with the SL line: a slice
+   never reaches outside what it was taken from. */
+static inline sl_slice sl_slice_of(void* data, size_t elem_size, int len, int lo, int hi, int line) {
+    if (__builtin_expect(lo < 0 || hi < lo || hi > len, 0)) {
+        fprintf(stderr, "line %d: slice [%d:%d] out of bounds for length %d\n", line, lo, hi, len);
+        abort();
+    }
+    sl_slice s = { (char*)data + (size_t)lo * elem_size, hi - lo };
+    return s;
+}
+
+static inline int sl_slice_len(sl_slice s) {
+    return s.len;
+}
+)SL";
+
+// Bounds checks for --bounds-check. A failed check reports the SL source
+// line and aborts. sl_bounds_range checks a whole loop's worth of indexes
+// [lo, hi) at once and passes when the range is empty.
+static const char* BOUNDS_SOURCE = R"SL(
+static void sl_bounds_fail(int index, int len, int line) {
+    fprintf(stderr, "line %d: index %d out of bounds for length %d\n", line, index, len);
+    abort();
+}
+
+static inline int sl_bounds(int index, int len, int line) {
+    if (__builtin_expect((unsigned)index >= (unsigned)len, 0)) {
+        sl_bounds_fail(index, len, line);
+    }
+    return index;
+}
+
+static inline void sl_bounds_range(int lo, int hi, int len, int line) {
+    if (lo < hi && (lo < 0 || hi > len)) {
+        sl_bounds_fail(lo < 0 ? lo : hi - 1, len, line);
+    }
+}
+)SL";
+
+// Hash maps for map<K, V>: Swiss-table open addressing. Every slot has a
+// control byte holding 7 bits of its key's hash, or EMPTY/DELETED. A
+// lookup compares a whole group of 16 control bytes against those bits at
+// once (one SSE2 compare) and only inspects keys whose byte matches; the
+// other 57 hash bits pick the first group, and groups are probed
+// triangularly. Control bytes past the end mirror the first group so a
+// group can start at any slot. Reading a missing key yields a zeroed
+// value; writing one inserts it. Each key type gets its own functions so
+// hashing and comparison inline into the probe loop.
+static const char* MAPS_SOURCE = R"SL(
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define SL_MAP_GROUP 16
+#define SL_CTRL_EMPTY ((int8_t)-128)
+#define SL_CTRL_DELETED ((int8_t)-2)
+
+typedef struct sl_map {
+    int8_t* ctrl;
+    char* keys;
+    char* values;
+    int cap;         /* 0 or a power of two >= SL_MAP_GROUP */
+    int len;
+    int growth_left; /* inserts into EMPTY slots left before a rehash */
+    int key_size;
+    int value_size;
+    char* zero;      /* what reading a missing key yields */
+} sl_map;
+
+static sl_map* sl_map_new(int key_size, int value_size) {
+    sl_map* m = (sl_map*)calloc(1, sizeof(sl_map));
+    char* zero = (char*)calloc(1, (size_t)value_size);
+    if (!m || !zero) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    m->key_size = key_size;
+    m->value_size = value_size;
+    m->zero = zero;
+    return m;
+}
+
+static inline int sl_map_len(sl_map* m) {
+    return m->len;
+}
+
+static void sl_map_free(sl_map* m) {
+    free(m->ctrl);
+    free(m->keys);
+    free(m->values);
+    free(m->zero);
+    free(m);
+}
+
+/* Bit i is set when control byte i of the group equals h. */
+static inline uint32_t sl_group_match(const int8_t* group, int8_t h) {
+#ifdef __SSE2__
+    __m128i bytes = _mm_loadu_si128((const __m128i*)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(h)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < SL_MAP_GROUP; i++) mask |= (uint32_t)(group[i] == h) << i;
+    return mask;
+#endif
+}
+
+/* Bit i is set when slot i of the group is EMPTY or DELETED, the only
+   control bytes with the sign bit set. */
+static inline uint32_t sl_group_match_free(const int8_t* group) {
+#ifdef __SSE2__
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < SL_MAP_GROUP; i++) mask |= (uint32_t)(group[i] < 0) << i;
+    return mask;
+#endif
+}
+
+static inline void sl_map_set_ctrl(sl_map* m, size_t i, int8_t h) {
+    m->ctrl[i] = h;
+    if (i < SL_MAP_GROUP) m->ctrl[(size_t)m->cap + i] = h;
+}
+
+static size_t sl_map_free_slot(const sl_map* m, uint64_t hash) {
+    size_t mask = (size_t)m->cap - 1;
+    size_t pos = (size_t)(hash >> 7) & mask;
+    for (size_t stride = SL_MAP_GROUP;; stride += SL_MAP_GROUP) {
+        uint32_t bits = sl_group_match_free(m->ctrl + pos);
+        if (bits) return (pos + (size_t)__builtin_ctz(bits)) & mask;
+        pos = (pos + stride) & mask;
+    }
+}
+
+/* The table stays at most 7/8 full, so every probe ends at an EMPTY byte. */
+static void sl_map_alloc(sl_map* m, int cap) {
+    m->ctrl = (int8_t*)malloc((size_t)cap + SL_MAP_GROUP);
+    m->keys = (char*)malloc((size_t)cap * (size_t)m->key_size);
+    m->values = (char*)malloc((size_t)cap * (size_t)m->value_size);
+    if (!m->ctrl || !m->keys || !m->values) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    memset(m->ctrl, SL_CTRL_EMPTY, (size_t)cap + SL_MAP_GROUP);
+    m->cap = cap;
+    m->growth_left = cap - cap / 8 - m->len;
+}
+
+static inline uint64_t sl_hash_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static inline uint64_t sl_hash_int(int key) {
+    return sl_hash_mix((uint64_t)(uint32_t)key);
+}
+
+static inline uint64_t sl_hash_double(double key) {
+    uint64_t bits;
+    if (key == 0) key = 0; /* -0.0 and 0.0 are the same key */
+    memcpy(&bits, &key, sizeof(bits));
+    return sl_hash_mix(bits);
+}
+
+static inline uint64_t sl_hash_str(sl_str key) {
+    const unsigned char* p = (const unsigned char*)sl_str_data(&key);
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ key.len;
+    uint32_t i = 0;
+    for (; i + 8 <= key.len; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, sizeof(word));
+        h = (h ^ word) * 0x9fb21c651e98df25ULL;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p + i, key.len - i);
+    return sl_hash_mix(h ^ tail);
+}
+
+#define SL_MAP_EQ(a, b) ((a) == (b))
+
+/* Deleted slots count against growth_left, so a table full of tombstones
+   is rebuilt at the same size instead of growing. */
+#define SL_MAP_DEFINE(NAME, K, HASH, EQ) \
+static inline int sl_map_find_##NAME(const sl_map* m, K key, uint64_t hash) { \
+    if (m->cap == 0) return -1; \
+    size_t mask = (size_t)m->cap - 1; \
+    size_t pos = (size_t)(hash >> 7) & mask; \
+    int8_t h2 = (int8_t)(hash & 0x7f); \
+    const K* keys = (const K*)m->keys; \
+    for (size_t stride = SL_MAP_GROUP;; stride += SL_MAP_GROUP) { \
+        const int8_t* group = m->ctrl + pos; \
+        for (uint32_t bits = sl_group_match(group, h2); bits; bits &= bits - 1) { \
+            size_t i = (pos + (size_t)__builtin_ctz(bits)) & mask; \
+            if (EQ(keys[i], key)) return (int)i; \
+        } \
+        if (sl_group_match(group, SL_CTRL_EMPTY)) return -1; \
+        pos = (pos + stride) & mask; \
+    } \
+} \
+static void sl_map_rehash_##NAME(sl_map* m, int cap) { \
+    sl_map old = *m; \
+    sl_map_alloc(m, cap); \
+    for (int i = 0; i < old.cap; i++) { \
+        if (old.ctrl[i] < 0) continue; \
+        K key = ((K*)old.keys)[i]; \
+        uint64_t hash = HASH(key); \
+        size_t j = sl_map_free_slot(m, hash); \
+        sl_map_set_ctrl(m, j, (int8_t)(hash & 0x7f)); \
+        ((K*)m->keys)[j] = key; \
+        memcpy(m->values + j * (size_t)m->value_size, old.values + (size_t)i * (size_t)m->value_size, \
+               (size_t)m->value_size); \
+    } \
+    free(old.ctrl); \
+    free(old.keys); \
+    free(old.values); \
+} \
+static inline void* sl_map_get_##NAME(const sl_map* m, K key) { \
+    int i = sl_map_find_##NAME(m, key, HASH(key)); \
+    return i < 0 ? m->zero : m->values + (size_t)i * (size_t)m->value_size; \
+} \
+static inline int sl_map_has_##NAME(const sl_map* m, K key) { \
+    return sl_map_find_##NAME(m, key, HASH(key)) >= 0; \
+} \
+static void* sl_map_slot_##NAME(sl_map* m, K key) { \
+    uint64_t hash = HASH(key); \
+    int found = sl_map_find_##NAME(m, key, hash); \
+    if (found >= 0) return m->values + (size_t)found * (size_t)m->value_size; \
+    if (m->growth_left == 0) { \
+        int cap = m->cap == 0 ? SL_MAP_GROUP : m->len >= m->cap / 16 * 7 ? m->cap * 2 : m->cap; \
+        sl_map_rehash_##NAME(m, cap); \
+    } \
+    size_t i = sl_map_free_slot(m, hash); \
+    if (m->ctrl[i] == SL_CTRL_EMPTY) m->growth_left--; \
+    sl_map_set_ctrl(m, i, (int8_t)(hash & 0x7f)); \
+    ((K*)m->keys)[i] = key; \
+    char* value = m->values + i * (size_t)m->value_size; \
+    memset(value, 0, (size_t)m->value_size); \
+    m->len++; \
+    return value; \
+} \
+static inline int sl_map_remove_##NAME(sl_map* m, K key) { \
+    int i = sl_map_find_##NAME(m, key, HASH(key)); \
+    if (i < 0) return 0; \
+    sl_map_set_ctrl(m, (size_t)i, SL_CTRL_DELETED); \
+    m->len--; \
+    return 1; \
+}
+
+SL_MAP_DEFINE(int, int, sl_hash_int, SL_MAP_EQ)
+SL_MAP_DEFINE(double, double, sl_hash_double, SL_MAP_EQ)
+SL_MAP_DEFINE(str, sl_str, sl_hash_str, sl_str_eq)
+)SL";
+
+// Hashes behind the perfect-hash switch dispatch; codegen/switch.cpp
+// computes the same functions at compile time to build the tables.
+static const char* SWITCH_SOURCE = R"SL(
+#include <stdint.h>
+
+static inline uint64_t sl_switch_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static inline uint64_t sl_switch_hash_int(int64_t key, uint64_t seed) {
+    return sl_switch_mix((uint64_t)key ^ seed);
+}
+
+static inline uint64_t sl_switch_hash_str(sl_str key, uint64_t seed) {
+    const unsigned char* p = (const unsigned char*)sl_str_data(&key);
+    uint64_t h = seed ^ (key.len * 0x9e3779b97f4a7c15ULL);
+    uint32_t i = 0;
+    for (; i + 8 <= key.len; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, sizeof(word));
+        h = (h ^ word) * 0x9fb21c651e98df25ULL;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p + i, key.len - i);
+    return sl_switch_mix(h ^ tail);
+}
+
+static inline unsigned sl_switch_slot(uint64_t hash, unsigned seed, unsigned mask) {
+    uint32_t x = (uint32_t)(hash >> 32) ^ seed;
+    x ^= x >> 16;
+    x *= 0x85ebca6bU;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35U;
+    x ^= x >> 16;
+    return x & mask;
+}
+)SL";
+
+// Packed bool arrays: element i is bit i % 64 of word i / 64. Bits past
+// the last element stay clear, so whole-array operations can work a word
+// at a time without masking the tail on every read.
+static const char* BITS_SOURCE = R"SL(
+#include <stdint.h>
+
+static inline _Bool sl_bits_get(const uint64_t* bits, int i) {
+    return (bits[i >> 6] >> (i & 63)) & 1;
+}
+
+static inline void sl_bits_set(uint64_t* bits, int i, _Bool value) {
+    uint64_t mask = (uint64_t)1 << (i & 63);
+    bits[i >> 6] = (bits[i >> 6] & ~mask) | (value ? mask : 0);
+}
+
+static inline int bits_count(const uint64_t* bits, int n) {
+    int count = 0;
+    for (int w = 0; w < (n + 63) / 64; w++) {
+        count += __builtin_popcountll(bits[w]);
+    }
+    return count;
+}
+
+static inline void bits_fill(uint64_t* bits, int n, _Bool value) {
+    memset(bits, value ? 0xff : 0, (size_t)(n / 64) * sizeof(uint64_t));
+    if (n % 64) {
+        bits[n / 64] = value ? ((uint64_t)1 << (n % 64)) - 1 : 0;
+    }
+}
+)SL";
+
+// Buffered standard I/O. Every thread writes into its own buffer, and the
+// buffers are written to stdout with write(2) when full, on flush() and at
+// exit, so output from one thread stays in order. Numbers are formatted by
+// hand instead of through printf. read_line reads stdin in large blocks.
+static const char* IO_SOURCE = R"SL(
+#include <errno.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#define SL_OUT_BUFFER (1 << 16)
+#define SL_IN_BUFFER (1 << 16)
+
+typedef struct sl_writer {
+    struct sl_writer* next;
+    size_t len;
+    char data[SL_OUT_BUFFER];
+} sl_writer;
+
+/* Writers are never freed: the list keeps them reachable until exit. */
+static _Atomic(sl_writer*) sl_writers;
+static _Thread_local sl_writer* sl_out;
+
+static void sl_write_all(const char* bytes, size_t n) {
+    fflush(stdout); /* keep order with anything printed through stdio */
+    while (n > 0) {
+        ssize_t written = write(STDOUT_FILENO, bytes, n);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        bytes += written;
+        n -= (size_t)written;
+    }
+}
+
+static void sl_writer_flush(sl_writer* w) {
+    sl_write_all(w->data, w->len);
+    w->len = 0;
+}
+
+static void sl_flush_all(void) {
+    for (sl_writer* w = atomic_load(&sl_writers); w; w = w->next) {
+        sl_writer_flush(w);
+    }
+}
+
+static sl_writer* sl_writer_new(void) {
+    sl_writer* w = (sl_writer*)malloc(sizeof(sl_writer));
+    if (!w) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    w->len = 0;
+    w->next = atomic_load(&sl_writers);
+    while (!atomic_compare_exchange_weak(&sl_writers, &w->next, w)) {
+    }
+    if (!w->next) atexit(sl_flush_all); /* the first writer registers the final flush */
+    sl_out = w;
+    return w;
+}
+
+/* Returns room for n <= SL_OUT_BUFFER bytes; the caller advances len. */
+static inline sl_writer* sl_out_reserve(size_t n) {
+    sl_writer* w = sl_out;
+    if (__builtin_expect(!w, 0)) w = sl_writer_new();
+    if (__builtin_expect(w->len + n > SL_OUT_BUFFER, 0)) sl_writer_flush(w);
+    return w;
+}
+
+static void sl_out_write(const char* bytes, size_t n) {
+    if (n > SL_OUT_BUFFER) {
+        sl_writer_flush(sl_out_reserve(0));
+        sl_write_all(bytes, n);
+        return;
+    }
+    sl_writer* w = sl_out_reserve(n);
+    memcpy(w->data + w->len, bytes, n);
+    w->len += n;
+}
+
+static const char sl_digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+/* Writes the digits of v backwards, two at a time, ending at end. */
+static inline char* sl_format_u64(char* end, uint64_t v) {
+    while (v >= 100) {
+        end -= 2;
+        memcpy(end, sl_digit_pairs + 2 * (v % 100), 2);
+        v /= 100;
+    }
+    if (v >= 10) {
+        end -= 2;
+        memcpy(end, sl_digit_pairs + 2 * v, 2);
+    } else {
+        *--end = (char)('0' + v);
+    }
+    return end;
+}
+
+static inline int sl_digit_count(uint64_t v) {
+    int n = 1;
+    for (;;) {
+        if (v < 10) return n;
+        if (v < 100) return n + 1;
+        if (v < 1000) return n + 2;
+        if (v < 10000) return n + 3;
+        v /= 10000;
+        n += 4;
+    }
+}
+
+/* Digits go straight into the buffer, right to left from their end. */
+static inline void write_uint(uint64_t v) {
+    sl_writer* w = sl_out_reserve(20);
+    w->len += (size_t)sl_digit_count(v);
+    sl_format_u64(w->data + w->len, v);
+}
+
+static inline void write_int(int64_t v) {
+    sl_writer* w = sl_out_reserve(20);
+    uint64_t magnitude = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+    if (v < 0) w->data[w->len++] = '-';
+    w->len += (size_t)sl_digit_count(magnitude);
+    sl_format_u64(w->data + w->len, magnitude);
+}
+
+/* Six decimals, rounded like printf("%f"): the fraction is scaled in
+   exact 128-bit integer arithmetic, with ties going to even. Values of
+   2^64 and above fall back to snprintf. */
+static void write_double(double v) {
+    char text[320]; /* DBL_MAX has 309 digits */
+    size_t n = 0;
+    if (signbit(v)) {
+        text[n++] = '-';
+        v = -v;
+    }
+    if (isnan(v) || isinf(v)) {
+        memcpy(text + n, isnan(v) ? "nan" : "inf", 3);
+        n += 3;
+    } else if (v < 18446744073709551616.0) {
+        uint64_t whole = (uint64_t)v;
+        double fraction = v - (double)whole;
+        uint64_t bits;
+        memcpy(&bits, &fraction, sizeof(bits));
+        int exponent = (int)(bits >> 52);
+        uint64_t mantissa = bits & ((1ULL << 52) - 1);
+        if (exponent) mantissa |= 1ULL << 52; else exponent = 1;
+        int shift = 1075 - exponent; /* fraction = mantissa / 2^shift */
+        uint64_t micros = 0;
+        if (shift < 128) {
+            unsigned __int128 scaled = (unsigned __int128)mantissa * 1000000;
+            unsigned __int128 half = (unsigned __int128)1 << (shift - 1);
+            unsigned __int128 rest = scaled & ((half << 1) - 1);
+            micros = (uint64_t)(scaled >> shift);
+            if (rest > half || (rest == half && (micros & 1))) micros++;
+        }
+        if (micros == 1000000) {
+            whole++;
+            micros = 0;
+        }
+        char digits[20];
+        char* start = sl_format_u64(digits + 20, whole);
+        memcpy(text + n, start, (size_t)(digits + 20 - start));
+        n += (size_t)(digits + 20 - start);
+        text[n++] = '.';
+        for (int i = 5; i >= 0; i--) {
+            text[n + i] = (char)('0' + micros % 10);
+            micros /= 10;
+        }
+        n += 6;
+    } else {
+        n += (size_t)snprintf(text + n, sizeof(text) - n, "%f", v);
+    }
+    sl_out_write(text, n);
+}
+
+static inline void write_bool(_Bool v) {
+    sl_out_write(v ? "true" : "false", v ? 4 : 5);
+}
+
+static inline void write_str(sl_str s) {
+    sl_out_write(sl_str_data(&s), s.len);
+}
+
+static inline void write_newline(void) {
+    sl_writer* w = sl_out_reserve(1);
+    w->data[w->len++] = '\n';
+}
+
+static void flush(void) {
+    if (sl_out) sl_writer_flush(sl_out);
+}
+
+/* stdin is shared, so the reader is too; read from one thread at a time. */
+static struct {
+    char data[SL_IN_BUFFER];
+    size_t pos;
+    size_t len;
+    char* line; /* lines that span two blocks are gathered here */
+    size_t lineCap;
+    _Bool eof;
+} sl_in;
+
+static int sl_in_fill(void) {
+    flush(); /* a prompt written before reading must be visible */
+    ssize_t n;
+    do {
+        n = read(STDIN_FILENO, sl_in.data, SL_IN_BUFFER);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return 0;
+    sl_in.pos = 0;
+    sl_in.len = (size_t)n;
+    return 1;
+}
+
+static sl_str sl_str_copy(const char* bytes, size_t n) {
+    sl_str s;
+    s.len = (uint32_t)n;
+    if (n <= SL_STR_INLINE) {
+        s.small = 1;
+        memcpy(s.data.sso, bytes, n);
+        s.data.sso[n] = '\0';
+    } else {
+        s.small = 0;
+        char* out = sl_str_alloc(n + 1);
+        memcpy(out, bytes, n);
+        out[n] = '\0';
+        s.data.ptr = out;
+    }
+    return s;
+}
+
+/* Next line of stdin without its '\n'. At the end of input returns ""
+   and at_eof() becomes true. */
+static sl_str read_line(void) {
+    size_t pending = 0;
+    for (;;) {
+        if (sl_in.pos == sl_in.len && !sl_in_fill()) {
+            sl_in.eof = pending == 0;
+            return sl_str_copy(sl_in.line, pending);
+        }
+        char* start = sl_in.data + sl_in.pos;
+        size_t avail = sl_in.len - sl_in.pos;
+        char* newline = (char*)memchr(start, '\n', avail);
+        size_t n = newline ? (size_t)(newline - start) : avail;
+        sl_in.pos += newline ? n + 1 : n;
+        if (newline && pending == 0) return sl_str_copy(start, n);
+        if (pending + n > sl_in.lineCap) {
+            sl_in.lineCap = (pending + n) * 2;
+            sl_in.line = (char*)realloc(sl_in.line, sl_in.lineCap);
+            if (!sl_in.line) {
+                fprintf(stderr, "out of memory\n");
+                exit(1);
+            }
+        }
+        memcpy(sl_in.line + pending, start, n);
+        pending += n;
+        if (newline) return sl_str_copy(sl_in.line, pending);
+    }
+}
+
+static inline _Bool at_eof(void) {
+    return sl_in.eof;
+}
+)SL";
+
+// Memory-mapped input files. Mappings are private, so writes through the
+// slice stay in this process, and the kernel is told that they will be
+// read front to back. A file that cannot be opened or mapped gives an
+// empty slice.
+static const char* FILES_SOURCE = R"SL(
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int sl_open_read(sl_str path) {
+    char* name = (char*)malloc(path.len + 1);
+    if (!name) return -1;
+    memcpy(name, sl_str_data(&path), path.len);
+    name[path.len] = '\0';
+    int fd = open(name, O_RDONLY | O_CLOEXEC);
+    free(name);
+    return fd;
+}
+
+/* Maps length bytes at offset and closes fd. mmap needs a page-aligned
+   offset, so the mapping may start up to a page early; the slice skips
+   those bytes and unmap finds the page start again. */
+static sl_slice sl_map_fd(int fd, int64_t offset, int64_t length) {
+    sl_slice bytes = { NULL, 0 };
+    if (length > 0) {
+        int64_t skip = offset % sysconf(_SC_PAGESIZE);
+        void* mapping = mmap(NULL, (size_t)(length + skip), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+                             (off_t)(offset - skip));
+        if (mapping != MAP_FAILED) {
+            madvise(mapping, (size_t)(length + skip), MADV_SEQUENTIAL);
+            bytes.data = (char*)mapping + skip;
+            bytes.len = (int)length;
+        }
+    }
+    close(fd);
+    return bytes;
+}
+
+static int64_t file_size(sl_str path) {
+    int fd = sl_open_read(path);
+    if (fd < 0) return -1;
+    struct stat st;
+    int64_t size = fstat(fd, &st) == 0 ? (int64_t)st.st_size : -1;
+    close(fd);
+    return size;
+}
+
+/* Slices hold an int length: larger files are read through map_window. */
+static sl_slice map_file(sl_str path) {
+    sl_slice none = { NULL, 0 };
+    int fd = sl_open_read(path);
+    if (fd < 0) return none;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size > INT_MAX) {
+        close(fd);
+        return none;
+    }
+    return sl_map_fd(fd, 0, st.st_size);
+}
+
+/* Up to length bytes starting at offset; shorter at the end of the file. */
+static sl_slice map_window(sl_str path, int64_t offset, int length) {
+    sl_slice none = { NULL, 0 };
+    int fd = sl_open_read(path);
+    if (fd < 0) return none;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || offset < 0 || offset >= st.st_size) {
+        close(fd);
+        return none;
+    }
+    int64_t rest = st.st_size - offset;
+    return sl_map_fd(fd, offset, length < rest ? length : rest);
+}
+
+static void unmap(sl_slice bytes) {
+    if (!bytes.data) return;
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)bytes.data & ~(page - 1);
+    munmap((void*)start, (size_t)((uintptr_t)bytes.data - start) + (size_t)bytes.len);
+}
+
+/* The string shares the bytes: it is valid until the mapping is unmapped. */
+static inline sl_str str_view(sl_slice bytes) {
+    sl_str s = { (uint32_t)bytes.len, 0, { .ptr = bytes.data } };
+    return s;
+}
+)SL";
+
+// Asynchronous whole-file reads. read_async opens the file and queues the
+// request; the queue is handed to io_uring in one batch when the program
+// waits, and completions are reaped from the shared ring without further
+// system calls. Where io_uring is missing or disabled (SL_IO_URING=0) a
+// small pool of threads does blocking reads instead. Requests are made and
+// awaited from one thread.
+static const char* ASYNC_SOURCE = R"SL(
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define SL_RING_ENTRIES 256
+#define SL_IO_THREADS 4
+#define SL_IO_CHUNK (1 << 16)
+#define SL_IO_MAX_READ (1U << 30)
+
+typedef struct sl_io_request {
+    struct sl_io_request* next; /* in the pending or completed queue */
+    int id;
+    int fd;
+    int done;
+    int claimed;     /* returned by await_any or await_read */
+    int seekable;    /* regular file of known size: read at explicit offsets */
+    size_t size;
+    char* data;
+    size_t len;
+    size_t cap;
+} sl_io_request;
+
+typedef struct sl_io_queue {
+    sl_io_request* head;
+    sl_io_request* tail;
+} sl_io_queue;
+
+static struct {
+    int mode; /* 0 before first use, 1 io_uring, 2 threads */
+    sl_io_request** requests; /* indexed by request id */
+    int count;
+    int cap;
+    int outstanding;
+    sl_io_queue pending;
+    sl_io_queue completed;
+    /* io_uring */
+    int ring;
+    unsigned inflight;
+    unsigned toSubmit;
+    unsigned entries;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned* sqMask;
+    unsigned* sqArray;
+    struct io_uring_sqe* sqes;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned* cqMask;
+    struct io_uring_cqe* cqes;
+    /* thread pool */
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t finished;
+} sl_aio = { .lock = PTHREAD_MUTEX_INITIALIZER, .work = PTHREAD_COND_INITIALIZER,
+             .finished = PTHREAD_COND_INITIALIZER };
+
+static void sl_io_push(sl_io_queue* q, sl_io_request* r) {
+    r->next = NULL;
+    if (q->tail) q->tail->next = r; else q->head = r;
+    q->tail = r;
+}
+
+static sl_io_request* sl_io_pop(sl_io_queue* q) {
+    sl_io_request* r = q->head;
+    if (r) {
+        q->head = r->next;
+        if (!q->head) q->tail = NULL;
+    }
+    return r;
+}
+
+/* Makes room for the next read; returns 0 when out of memory. */
+static int sl_io_reserve(sl_io_request* r) {
+    if (r->len < r->cap) return 1;
+    size_t cap = r->cap ? r->cap * 2 : SL_IO_CHUNK;
+    char* data = (char*)realloc(r->data, cap);
+    if (!data) return 0;
+    r->data = data;
+    r->cap = cap;
+    return 1;
+}
+
+/* Accounts for a read that returned result; returns 1 when r is finished. */
+static int sl_io_advance(sl_io_request* r, long result) {
+    if (result > 0) r->len += (size_t)result;
+    if (result == -EINTR || result == -EAGAIN) return 0;
+    if (result <= 0 || (r->seekable && r->len == r->size)) return 1;
+    return !sl_io_reserve(r);
+}
+
+static void sl_io_finish(sl_io_request* r) {
+    close(r->fd);
+    r->done = 1;
+    sl_io_push(&sl_aio.completed, r);
+}
+
+static int sl_uring_setup(void) {
+    const char* enabled = getenv("SL_IO_URING");
+    if (enabled && enabled[0] == '0') return 0;
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = (int)syscall(__NR_io_uring_setup, SL_RING_ENTRIES, &p);
+    if (fd < 0) return 0;
+    if (!(p.features & IORING_FEAT_RW_CUR_POS)) { /* no IORING_OP_READ before 5.6 */
+        close(fd);
+        return 0;
+    }
+    size_t sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    int single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && cqSize > sqSize) sqSize = cqSize;
+    char* sq = (char*)mmap(NULL, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                           IORING_OFF_SQ_RING);
+    char* cq = single ? sq : (char*)mmap(NULL, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                         fd, IORING_OFF_CQ_RING);
+    void* sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED) {
+        close(fd);
+        return 0;
+    }
+    sl_aio.ring = fd;
+    sl_aio.entries = p.sq_entries;
+    sl_aio.sqHead = (unsigned*)(sq + p.sq_off.head);
+    sl_aio.sqTail = (unsigned*)(sq + p.sq_off.tail);
+    sl_aio.sqMask = (unsigned*)(sq + p.sq_off.ring_mask);
+    sl_aio.sqArray = (unsigned*)(sq + p.sq_off.array);
+    sl_aio.sqes = (struct io_uring_sqe*)sqes;
+    sl_aio.cqHead = (unsigned*)(cq + p.cq_off.head);
+    sl_aio.cqTail = (unsigned*)(cq + p.cq_off.tail);
+    sl_aio.cqMask = (unsigned*)(cq + p.cq_off.ring_mask);
+    sl_aio.cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return 1;
+}
+
+static void sl_uring_queue(sl_io_request* r) {
+    unsigned tail = *sl_aio.sqTail;
+    unsigned index = tail & *sl_aio.sqMask;
+    struct io_uring_sqe* sqe = &sl_aio.sqes[index];
+    size_t room = r->cap - r->len;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = r->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(r->data + r->len);
+    sqe->len = room < SL_IO_MAX_READ ? (unsigned)room : SL_IO_MAX_READ;
+    sqe->off = r->seekable ? (uint64_t)r->len : (uint64_t)-1;
+    sqe->user_data = (uint64_t)(uintptr_t)r;
+    sl_aio.sqArray[index] = index;
+    __atomic_store_n(sl_aio.sqTail, tail + 1, __ATOMIC_RELEASE);
+    sl_aio.toSubmit++;
+    sl_aio.inflight++;
+}
+
+/* Moves pending reads into the ring, submits them in one call, optionally
+   waits for a completion, and reaps every completion that has arrived. */
+static void sl_uring_pump(int wait) {
+    while (sl_aio.pending.head && sl_aio.inflight < sl_aio.entries) {
+        sl_uring_queue(sl_io_pop(&sl_aio.pending));
+    }
+    unsigned head = *sl_aio.cqHead;
+    int empty = head == __atomic_load_n(sl_aio.cqTail, __ATOMIC_ACQUIRE);
+    if (sl_aio.toSubmit || (wait && empty)) {
+        unsigned flags = wait && empty ? IORING_ENTER_GETEVENTS : 0;
+        int submitted = (int)syscall(__NR_io_uring_enter, sl_aio.ring, sl_aio.toSubmit,
+                                     wait && empty ? 1 : 0, flags, NULL, 0);
+        if (submitted > 0) sl_aio.toSubmit -= (unsigned)submitted;
+    }
+    unsigned tail = __atomic_load_n(sl_aio.cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        struct io_uring_cqe* cqe = &sl_aio.cqes[head & *sl_aio.cqMask];
+        sl_io_request* r = (sl_io_request*)(uintptr_t)cqe->user_data;
+        sl_aio.inflight--;
+        if (sl_io_advance(r, cqe->res)) sl_io_finish(r); else sl_io_push(&sl_aio.pending, r);
+    }
+    __atomic_store_n(sl_aio.cqHead, head, __ATOMIC_RELEASE);
+}
+
+static void sl_io_read_blocking(sl_io_request* r) {
+    for (;;) {
+        size_t room = r->cap - r->len;
+        if (room > SL_IO_MAX_READ) room = SL_IO_MAX_READ;
+        ssize_t n = r->seekable ? pread(r->fd, r->data + r->len, room, (off_t)r->len)
+                                : read(r->fd, r->data + r->len, room);
+        if (sl_io_advance(r, n < 0 ? -errno : (long)n)) return;
+    }
+}
+
+static void* sl_io_worker(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&sl_aio.lock);
+    for (;;) {
+        sl_io_request* r = sl_io_pop(&sl_aio.pending);
+        if (!r) {
+            pthread_cond_wait(&sl_aio.work, &sl_aio.lock);
+            continue;
+        }
+        pthread_mutex_unlock(&sl_aio.lock);
+        sl_io_read_blocking(r);
+        pthread_mutex_lock(&sl_aio.lock);
+        sl_io_finish(r);
+        pthread_cond_broadcast(&sl_aio.finished);
+    }
+    return NULL;
+}
+
+static void sl_io_start(void) {
+    if (sl_uring_setup()) {
+        sl_aio.mode = 1;
+        return;
+    }
+    sl_aio.mode = 2;
+    for (int i = 0; i < SL_IO_THREADS; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, sl_io_worker, NULL) == 0) pthread_detach(thread);
+    }
+}
+
+/* Starts reading the whole file at path. Returns the request id, or -1
+   when the file cannot be opened. */
+static int read_async(sl_str path) {
+    char* name = (char*)malloc(path.len + 1);
+    if (!name) return -1;
+    memcpy(name, sl_str_data(&path), path.len);
+    name[path.len] = '\0';
+    int fd = open(name, O_RDONLY | O_CLOEXEC);
+    free(name);
+    if (fd < 0) return -1;
+
+    sl_io_request* r = (sl_io_request*)calloc(1, sizeof(sl_io_request));
+    struct stat st;
+    if (r && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        r->seekable = 1;
+        r->size = (size_t)st.st_size;
+        r->data = (char*)malloc(r->size);
+        r->cap = r->data ? r->size : 0;
+    }
+    if (!r || (!r->data && !sl_io_reserve(r))) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    r->id = sl_aio.count;
+    r->fd = fd;
+    if (sl_aio.count == sl_aio.cap) {
+        sl_aio.cap = sl_aio.cap ? sl_aio.cap * 2 : 16;
+        sl_aio.requests = (sl_io_request**)realloc(sl_aio.requests, sl_aio.cap * sizeof(sl_io_request*));
+        if (!sl_aio.requests) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+    sl_aio.requests[sl_aio.count] = r;
+    sl_aio.outstanding++;
+
+    if (!sl_aio.mode) sl_io_start();
+    if (sl_aio.mode == 1) {
+        sl_io_push(&sl_aio.pending, r);
+    } else {
+        pthread_mutex_lock(&sl_aio.lock);
+        sl_io_push(&sl_aio.pending, r);
+        pthread_cond_signal(&sl_aio.work);
+        pthread_mutex_unlock(&sl_aio.lock);
+    }
+    return sl_aio.count++;
+}
+
+static void sl_io_wait(sl_io_request* r) {
+    if (sl_aio.mode == 1) {
+        while (!r->done) sl_uring_pump(1);
+    } else {
+        pthread_mutex_lock(&sl_aio.lock);
+        while (!r->done) pthread_cond_wait(&sl_aio.finished, &sl_aio.lock);
+        pthread_mutex_unlock(&sl_aio.lock);
+    }
+}
+
+/* Id of a finished request not yet returned, waiting if none has
+   finished; -1 when every request has been returned. */
+static int await_any(void) {
+    for (;;) {
+        if (!sl_aio.outstanding) return -1;
+        sl_io_request* r;
+        if (sl_aio.mode == 1) {
+            r = sl_io_pop(&sl_aio.completed);
+            if (!r) {
+                sl_uring_pump(1);
+                continue;
+            }
+        } else {
+            pthread_mutex_lock(&sl_aio.lock);
+            while (!(r = sl_io_pop(&sl_aio.completed))) pthread_cond_wait(&sl_aio.finished, &sl_aio.lock);
+            pthread_mutex_unlock(&sl_aio.lock);
+        }
+        if (r->claimed) continue;
+        r->claimed = 1;
+        sl_aio.outstanding--;
+        return r->id;
+    }
+}
+
+/* Waits for request id and returns the bytes read; "" for unknown ids.
+   The string stays valid for the rest of the program. */
+static sl_str await_read(int id) {
+    sl_str empty = { 0, 0, { .ptr = "" } };
+    if (id < 0 || id >= sl_aio.count) return empty;
+    sl_io_request* r = sl_aio.requests[id];
+    sl_io_wait(r);
+    if (!r->claimed) {
+        r->claimed = 1;
+        sl_aio.outstanding--;
+    }
+    sl_str s = { (uint32_t)r->len, 0, { .ptr = r->len ? r->data : "" } };
+    return s;
+}
+)SL";
+
+// Function table of a library, read by hosts that reload it
+// (host/sl_reload.c keeps a copy of these types). Bump SL_MODULE_ABI when
+// the layout changes.
+static const char* MODULE_SOURCE = R"SL(
+#define SL_MODULE_ABI 1
+
+typedef struct sl_export {
+    const char* name;
+    const char* signature; /* SL types, e.g. "int(int,double)" */
+    void (*function)(void);
+} sl_export;
+
+typedef struct sl_module {
+    uint32_t abi;
+    uint32_t count;
+    uint64_t interface; /* hash of every name and signature */
+    const sl_export* exports; /* sorted by name */
+} sl_module;
+)SL";
+
+// Entry and exit hooks of slc --instrument. Every generated function
+// opens with SL_PROFILE(id): a frame on its stack whose cleanup runs the
+// exit hook on every return. Counters live in a table per thread, so the
+// hooks take no locks; the tables are never freed and are summed into a
+// flat profile, sorted by self time, when the program exits. Time is read
+// with rdtsc on x86-64 and converted with the rate measured against
+// clock_gettime over the whole run; elsewhere it is clock_gettime itself.
+static const char* PROFILE_SOURCE = R"SL(
+#include <stdatomic.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SL_PROFILE_TSC 1
+#endif
+
+typedef struct sl_profile_counts {
+    uint64_t calls;
+    uint64_t self;  /* ticks in the function itself */
+    uint64_t total; /* ticks including callees, outermost activation only */
+    int64_t active; /* activations on this thread's stack */
+} sl_profile_counts;
+
+typedef struct sl_profile_thread {
+    struct sl_profile_thread* next;
+    struct sl_profile_frame* top;
+    sl_profile_counts counts[];
+} sl_profile_thread;
+
+typedef struct sl_profile_frame {
+    sl_profile_thread* thread;
+    struct sl_profile_frame* parent;
+    int id;
+    uint64_t start;
+    uint64_t callees;
+} sl_profile_frame;
+
+static const char* const* sl_profile_names;
+static int sl_profile_count;
+static int sl_profile_append; /* libraries add to the file instead of replacing it */
+static _Atomic(sl_profile_thread*) sl_profile_threads;
+static _Thread_local sl_profile_thread* sl_profile_current;
+static uint64_t sl_profile_start_ticks;
+static uint64_t sl_profile_start_ns;
+
+static inline uint64_t sl_profile_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t sl_profile_ticks(void) {
+#ifdef SL_PROFILE_TSC
+    return __rdtsc();
+#else
+    return sl_profile_ns();
+#endif
+}
+
+static sl_profile_thread* sl_profile_thread_new(void) {
+    sl_profile_thread* t = (sl_profile_thread*)calloc(1, sizeof(sl_profile_thread) +
+                                                          sl_profile_count * sizeof(sl_profile_counts));
+    if (!t) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    t->next = atomic_load(&sl_profile_threads);
+    while (!atomic_compare_exchange_weak(&sl_profile_threads, &t->next, t)) {
+    }
+    sl_profile_current = t;
+    return t;
+}
+
+static inline void sl_profile_enter(sl_profile_frame* f, int id) {
+    sl_profile_thread* t = sl_profile_current;
+    if (__builtin_expect(!t, 0)) t = sl_profile_thread_new();
+    f->thread = t;
+    f->parent = t->top;
+    f->id = id;
+    f->callees = 0;
+    t->top = f;
+    t->counts[id].calls++;
+    t->counts[id].active++;
+    f->start = sl_profile_ticks();
+}
+
+static inline void sl_profile_leave(sl_profile_frame* f) {
+    uint64_t elapsed = sl_profile_ticks() - f->start;
+    sl_profile_counts* c = &f->thread->counts[f->id];
+    c->self += elapsed - f->callees;
+    if (--c->active == 0) c->total += elapsed;
+    f->thread->top = f->parent;
+    if (f->parent) f->parent->callees += elapsed;
+}
+
+#define SL_PROFILE(id) \
+    sl_profile_frame sl_profile_frame_ __attribute__((cleanup(sl_profile_leave))); \
+    sl_profile_enter(&sl_profile_frame_, id)
+
+static sl_profile_counts* sl_profile_sums;
+
+static int sl_profile_by_self(const void* a, const void* b) {
+    uint64_t x = sl_profile_sums[*(const int*)a].self;
+    uint64_t y = sl_profile_sums[*(const int*)b].self;
+    return x < y ? 1 : x > y ? -1 : *(const int*)a - *(const int*)b;
+}
+
+static void sl_profile_dump(void) {
+    double nsPerTick = 1.0;
+#ifdef SL_PROFILE_TSC
+    uint64_t ticks = sl_profile_ticks() - sl_profile_start_ticks;
+    uint64_t ns = sl_profile_ns() - sl_profile_start_ns;
+    if (ticks > 0) nsPerTick = (double)ns / (double)ticks;
+#endif
+    sl_profile_sums = (sl_profile_counts*)calloc(sl_profile_count, sizeof(sl_profile_counts));
+    int* order = (int*)malloc(sl_profile_count * sizeof(int));
+    if (!sl_profile_sums || !order) return;
+    uint64_t calls = 0, self = 0;
+    for (sl_profile_thread* t = atomic_load(&sl_profile_threads); t; t = t->next) {
+        for (int i = 0; i < sl_profile_count; ++i) {
+            sl_profile_sums[i].calls += t->counts[i].calls;
+            sl_profile_sums[i].self += t->counts[i].self;
+            sl_profile_sums[i].total += t->counts[i].total;
+        }
+    }
+    int used = 0;
+    for (int i = 0; i < sl_profile_count; ++i) {
+        if (sl_profile_sums[i].calls == 0) continue;
+        order[used++] = i;
+        calls += sl_profile_sums[i].calls;
+        self += sl_profile_sums[i].self;
+    }
+    qsort(order, used, sizeof(int), sl_profile_by_self);
+
+    const char* path = getenv("SL_PROFILE");
+    FILE* out = fopen(path && *path ? path : "sl_profile.txt", sl_profile_append ? "a" : "w");
+    if (!out) return;
+    fprintf(out, "# SL flat profile: %d functions called, %llu calls, %.3f ms in SL code\n", used,
+            (unsigned long long)calls, self * nsPerTick / 1e6);
+    fprintf(out, "#  self %%    self ms   total ms        calls    self ns/call  function\n");
+    for (int k = 0; k < used; ++k) {
+        const sl_profile_counts* c = &sl_profile_sums[order[k]];
+        fprintf(out, "%8.2f %10.3f %10.3f %12llu %15.1f  %s\n", self ? 100.0 * c->self / self : 0.0,
+                c->self * nsPerTick / 1e6, c->total * nsPerTick / 1e6, (unsigned long long)c->calls,
+                c->self * nsPerTick / c->calls, sl_profile_names[order[k]]);
+    }
+    fclose(out);
+}
+
+static void sl_profile_start(const char* const* names, int count, int append) {
+    sl_profile_names = names;
+    sl_profile_count = count;
+    sl_profile_append = append;
+    sl_profile_start_ns = sl_profile_ns();
+    sl_profile_start_ticks = sl_profile_ticks();
+    atexit(sl_profile_dump);
+}
+)SL";
+
+const char* runtimeSource(RuntimePart part) {
+    switch (part) {
+        case RuntimePart::TASKS: return TASKS_SOURCE;
+        case RuntimePart::VECTORS: return VECTORS_SOURCE;
+        case RuntimePart::STRINGS: return STRINGS_SOURCE;
+        case RuntimePart::POOL: return POOL_SOURCE;
+        case RuntimePart::ARRAYS: return ARRAYS_SOURCE;
+        case RuntimePart::SLICES: return SLICES_SOURCE;
+        case RuntimePart::BOUNDS: return BOUNDS_SOURCE;
+        case RuntimePart::MAPS: return MAPS_SOURCE;
+        case RuntimePart::SWITCH: return SWITCH_SOURCE;
+        case RuntimePart::BITS: return BITS_SOURCE;
+        case RuntimePart::IO: return IO_SOURCE;
+        case RuntimePart::FILES: return FILES_SOURCE;
+        case RuntimePart::ASYNC: return ASYNC_SOURCE;
+        case RuntimePart::MODULE: return MODULE_SOURCE;
+        case RuntimePart::PROFILE: return PROFILE_SOURCE;
+        default: return "";
+    }
+}
+
+struct RuntimeBuiltin {
+    const char* name;
+    RuntimePart part;
+};
+
+static const RuntimeBuiltin BUILTINS[] = {
+    {"vec4f_load", RuntimePart::VECTORS}, {"vec4f_store", RuntimePart::VECTORS},
+    {"vec4f_splat", RuntimePart::VECTORS}, {"vec4f_sum", RuntimePart::VECTORS},
+    {"vec8f_load", RuntimePart::VECTORS}, {"vec8f_store", RuntimePart::VECTORS},
+    {"vec8f_splat", RuntimePart::VECTORS}, {"vec8f_sum", RuntimePart::VECTORS},
+    {"vec4d_load", RuntimePart::VECTORS}, {"vec4d_store", RuntimePart::VECTORS},
+    {"vec4d_splat", RuntimePart::VECTORS}, {"vec4d_sum", RuntimePart::VECTORS},
+    {"vec8i_load", RuntimePart::VECTORS}, {"vec8i_store", RuntimePart::VECTORS},
+    {"vec8i_splat", RuntimePart::VECTORS}, {"vec8i_sum", RuntimePart::VECTORS},
+    {"str_len", RuntimePart::STRINGS}, {"str_reset", RuntimePart::STRINGS},
+    {"push", RuntimePart::ARRAYS}, {"reserve", RuntimePart::ARRAYS}, {"len", RuntimePart::ARRAYS},
+    {"shrink", RuntimePart::ARRAYS}, {"array_free", RuntimePart::ARRAYS},
+    {"has", RuntimePart::MAPS}, {"remove", RuntimePart::MAPS}, {"map_free", RuntimePart::MAPS},
+    {"bits_count", RuntimePart::BITS}, {"bits_fill", RuntimePart::BITS},
+    {"write_int", RuntimePart::IO}, {"write_uint", RuntimePart::IO}, {"write_double", RuntimePart::IO},
+    {"write_bool", RuntimePart::IO}, {"write_str", RuntimePart::IO}, {"write_newline", RuntimePart::IO},
+    {"flush", RuntimePart::IO}, {"read_line", RuntimePart::IO}, {"at_eof", RuntimePart::IO},
+    {"map_file", RuntimePart::FILES}, {"map_window", RuntimePart::FILES}, {"file_size", RuntimePart::FILES},
+    {"unmap", RuntimePart::FILES}, {"str_view", RuntimePart::FILES},
+    {"read_async", RuntimePart::ASYNC}, {"await_read", RuntimePart::ASYNC}, {"await_any", RuntimePart::ASYNC},
+};
+
+bool runtimeBuiltinPart(const std::string& name, RuntimePart& part) {
+    for (const auto& builtin : BUILTINS) {
+        if (name == builtin.name) {
+            part = builtin.part;
+            return true;
+        }
+    }
+    return false;
+}
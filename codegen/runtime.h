@@ -0,0 +1,33 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <string>
+
+// Pieces of the C support library that CodeGenerator copies into the
+// generated program when they are used. Parts are emitted in enum order,
+// so a part may only depend on parts declared before it.
+enum class RuntimePart {
+    TASKS,
+    VECTORS,
+    STRINGS,
+    POOL,
+    ARRAYS,
+    SLICES,
+    BOUNDS,
+    MAPS,
+    SWITCH,
+    BITS,
+    IO,
+    FILES,
+    ASYNC,
+    MODULE,
+    PROFILE
+};
+
+const char* runtimeSource(RuntimePart part);
+
+// Finds the runtime part that defines the built-in function `name`.
+// Returns false for names that are not runtime built-ins.
+bool runtimeBuiltinPart(const std::string& name, RuntimePart& part);
+
+#endif // RUNTIME_H
@@ -0,0 +1,267 @@
+#include "codegen.h"
+#include <climits>
+#include <cstdio>
+
+namespace {
+
+bool wanted(const IRValue* instr) {
+    return instr->type != Type::VOID && (!instr->users.empty() || instr->op == IROp::PHI);
+}
+
+std::string temporary(const IRValue* value) {
+    return "sl_t" + std::to_string(value->id);
+}
+
+std::string incoming(const IRValue* phi) {
+    return "sl_p" + std::to_string(phi->id);
+}
+
+std::string label(const IRBlock* block) {
+    return "sl_b" + std::to_string(block->id);
+}
+
+std::string realLiteral(double value, const char* format) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), format, value);
+    std::string text = buffer;
+    if (text.find_first_of(".en") == std::string::npos) text += ".0";
+    return text;
+}
+
+const char* binaryOperator(IROp op) {
+    switch (op) {
+        case IROp::ADD: return " + ";
+        case IROp::SUB: return " - ";
+        case IROp::MUL: return " * ";
+        case IROp::DIV: return " / ";
+        case IROp::MOD: return " % ";
+        case IROp::EQ: return " == ";
+        case IROp::NE: return " != ";
+        case IROp::LT: return " < ";
+        case IROp::GT: return " > ";
+        case IROp::LE: return " <= ";
+        case IROp::GE: return " >= ";
+        default: return nullptr;
+    }
+}
+
+// Index in to->preds of the occurrence-th edge from `from`.
+size_t edgeIndex(const IRBlock* from, const IRBlock* to, int occurrence) {
+    size_t edge = 0;
+    for (;; ++edge) {
+        if (to->preds[edge] == from && occurrence-- == 0) return edge;
+    }
+}
+
+// Whether a copy on the edge reads another phi of `to`, which an earlier
+// copy may already have overwritten (a swap in a loop).
+bool copiesReadPhis(const IRBlock* to, size_t edge) {
+    for (size_t i = 0; i < to->phiCount(); ++i) {
+        const IRValue* value = to->instructions[i]->operands[edge];
+        if (value != to->instructions[i].get() && value->op == IROp::PHI && value->block == to) return true;
+    }
+    return false;
+}
+
+// Whether some edge into the block needs the incoming variables.
+bool staged(const IRBlock* block) {
+    for (size_t edge = 0; edge < block->preds.size(); ++edge) {
+        if (copiesReadPhis(block, edge)) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+// At -O0 every copy is a store and a load; a value that only feeds a phi
+// across a jump is computed into the phi's variable instead, provided
+// nothing in its block reads the phi's old value afterwards.
+void CodeGenerator::coalescePhiResults(const IRFunction& function) {
+    phiResults.clear();
+    for (const auto& block : function.blocks) {
+        const IRValue* last = block->terminator();
+        if (last->op != IROp::JUMP) continue;
+        const IRBlock* target = last->targets[0];
+        size_t edge = edgeIndex(block.get(), target, 0);
+        if (copiesReadPhis(target, edge)) continue;
+        for (size_t i = 0; i < target->phiCount(); ++i) {
+            const IRValue* phi = target->instructions[i].get();
+            const IRValue* value = phi->operands[edge];
+            if (value->block != block.get() || value->op == IROp::PHI || value->users.size() != 1) continue;
+            bool oldValueRead = false;
+            bool after = false;
+            for (const auto& instr : block->instructions) {
+                if (after) {
+                    for (const IRValue* operand : instr->operands) {
+                        oldValueRead = oldValueRead || operand == phi;
+                    }
+                }
+                after = after || instr.get() == value;
+            }
+            if (!oldValueRead) phiResults[value] = phi;
+        }
+    }
+}
+
+std::string CodeGenerator::irName(const IRValue* value) {
+    auto found = phiResults.find(value);
+    return temporary(found == phiResults.end() ? value : found->second);
+}
+
+std::string CodeGenerator::irOperand(const IRValue* value) {
+    if (value->op == IROp::PARAM) return value->name;
+    if (!value->isConstant()) return irName(value);
+    switch (value->type) {
+        case Type::BOOL:
+            return value->intValue ? "1" : "0";
+        case Type::FLOAT: {
+            std::string text = realLiteral(value->realValue, "%.9g") + "f";
+            return value->realValue < 0 || text[0] == '-' ? "(" + text + ")" : text;
+        }
+        case Type::DOUBLE: {
+            std::string text = realLiteral(value->realValue, "%.17g");
+            return text[0] == '-' ? "(" + text + ")" : text;
+        }
+        default:
+            if (value->intValue == INT_MIN) return "(-2147483647 - 1)";
+            return value->intValue < 0 ? "(" + std::to_string(value->intValue) + ")" : std::to_string(value->intValue);
+    }
+}
+
+std::string CodeGenerator::irCall(const IRValue* instr) {
+    RuntimePart part;
+    if (runtimeBuiltinPart(instr->name, part)) {
+        runtimeParts.insert(part);
+        if (part == RuntimePart::IO) runtimeParts.insert(RuntimePart::STRINGS);
+    }
+    std::string text = instr->name + "(";
+    for (size_t i = 0; i < instr->operands.size(); ++i) {
+        if (i > 0) text += ", ";
+        text += irOperand(instr->operands[i]);
+    }
+    return text + ")";
+}
+
+// Arithmetic LICM ran ahead of its condition wraps instead of overflowing.
+std::string CodeGenerator::irExpression(const IRValue* instr) {
+    const std::vector<IRValue*>& ops = instr->operands;
+    switch (instr->op) {
+        case IROp::NEG:
+            if (instr->speculative) return "(int)-(unsigned)" + irOperand(ops[0]);
+            return "-" + irOperand(ops[0]);
+        case IROp::NOT:
+            return "!" + irOperand(ops[0]);
+        case IROp::CONVERT:
+            return "(" + typeToCType(instr->type) + ")" + irOperand(ops[0]);
+        case IROp::LOAD:
+            return instr->name;
+        case IROp::CALL:
+            return irCall(instr);
+        default:
+            break;
+    }
+    if (instr->speculative) {
+        return "(int)((unsigned)" + irOperand(ops[0]) + binaryOperator(instr->op) + "(unsigned)" +
+               irOperand(ops[1]) + ")";
+    }
+    return irOperand(ops[0]) + binaryOperator(instr->op) + irOperand(ops[1]);
+}
+
+// The phis of `to` are assigned on each edge into it, right before the
+// goto. Copies that read each other go through the phis' incoming
+// variables first so that they all see the values from before the edge.
+void CodeGenerator::emitPhiCopies(const IRBlock* from, const IRBlock* to, int occurrence) {
+    size_t edge = edgeIndex(from, to, occurrence);
+    bool staged = copiesReadPhis(to, edge);
+    for (size_t i = 0; i < to->phiCount(); ++i) {
+        const IRValue* phi = to->instructions[i].get();
+        if (phi->operands[edge] == phi || phiResults.count(phi->operands[edge])) continue;
+        printLine((staged ? incoming(phi) : temporary(phi)) + " = " + irOperand(phi->operands[edge]) + ";");
+    }
+    for (size_t i = 0; staged && i < to->phiCount(); ++i) {
+        const IRValue* phi = to->instructions[i].get();
+        if (phi->operands[edge] == phi) continue;
+        printLine(temporary(phi) + " = " + incoming(phi) + ";");
+    }
+}
+
+// Writes a function from its SSA form: every value is a local assigned
+// once, blocks are labels and edges gotos, in the order the IR keeps them
+// so most jumps fall through. A branch whose targets take phi values gets
+// the copies for each edge on its own arm.
+void CodeGenerator::emitFunction(FunctionNode* node, const IRFunction& function) {
+    printLine(functionSignature(node) + " {");
+    indentLevel++;
+    emitProfileHook(node->name);
+    coalescePhiResults(function);
+
+    for (const auto& block : function.blocks) {
+        bool stagedPhis = staged(block.get());
+        for (const auto& instr : block->instructions) {
+            if (!wanted(instr.get()) || phiResults.count(instr.get())) continue;
+            std::string names = temporary(instr.get());
+            if (instr->op == IROp::PHI && stagedPhis) names += ", " + incoming(instr.get());
+            printLine(typeToCType(instr->type) + " " + names + ";");
+        }
+    }
+
+    for (size_t b = 0; b < function.blocks.size(); ++b) {
+        const IRBlock* block = function.blocks[b].get();
+        const IRBlock* next = b + 1 < function.blocks.size() ? function.blocks[b + 1].get() : nullptr;
+        if (b > 0) {
+            indentLevel--;
+            printLine(label(block) + ":;");
+            indentLevel++;
+        }
+        for (const auto& owned : block->instructions) {
+            const IRValue* instr = owned.get();
+            switch (instr->op) {
+                case IROp::PHI:
+                    break;
+                case IROp::STORE:
+                    printLine(instr->name + " = " + irOperand(instr->operands[0]) + ";");
+                    break;
+                case IROp::CALL:
+                    printLine((wanted(instr) ? irName(instr) + " = " : "") + irCall(instr) + ";");
+                    break;
+                case IROp::RETURN:
+                    printLine(instr->operands.empty() ? "return;" : "return " + irOperand(instr->operands[0]) + ";");
+                    break;
+                case IROp::JUMP:
+                    emitPhiCopies(block, instr->targets[0], 0);
+                    if (instr->targets[0] != next) printLine("goto " + label(instr->targets[0]) + ";");
+                    break;
+                case IROp::BRANCH: {
+                    // The arm that jumps away is the one not falling through.
+                    bool fallFirst = instr->targets[0] == next && instr->targets[1] != next;
+                    const IRBlock* away = instr->targets[fallFirst ? 1 : 0];
+                    const IRBlock* fall = instr->targets[fallFirst ? 0 : 1];
+                    int awayOccurrence = 0;
+                    int fallOccurrence = away == fall ? 1 : 0;
+                    std::string condition = irOperand(instr->operands[0]);
+                    if (fallFirst) condition = "!" + condition;
+                    if (away->phiCount() == 0) {
+                        printLine("if (" + condition + ") goto " + label(away) + ";");
+                    } else {
+                        printLine("if (" + condition + ") {");
+                        indentLevel++;
+                        emitPhiCopies(block, away, awayOccurrence);
+                        printLine("goto " + label(away) + ";");
+                        indentLevel--;
+                        printLine("}");
+                    }
+                    emitPhiCopies(block, fall, fallOccurrence);
+                    if (fall != next) printLine("goto " + label(fall) + ";");
+                    break;
+                }
+                default:
+                    if (wanted(instr)) printLine(irName(instr) + " = " + irExpression(instr) + ";");
+                    break;
+            }
+        }
+    }
+
+    indentLevel--;
+    printLine("}");
+    print("");
+}
@@ -0,0 +1,105 @@
+#include "switch.h"
+#include <algorithm>
+#include <cstring>
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+uint64_t switchHashInt(int64_t key, uint64_t seed) {
+    return mix64((uint64_t)key ^ seed);
+}
+
+uint64_t switchHashString(const std::string& key, uint64_t seed) {
+    return switchHashString(key.data(), key.size(), seed);
+}
+
+uint64_t switchHashString(const char* bytes, size_t size, uint64_t seed) {
+    const unsigned char* p = (const unsigned char*)bytes;
+    uint32_t len = (uint32_t)size;
+    uint64_t h = seed ^ (len * 0x9e3779b97f4a7c15ULL);
+    uint32_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, p + i, sizeof(word));
+        h = (h ^ word) * 0x9fb21c651e98df25ULL;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p + i, len - i);
+    return mix64(h ^ tail);
+}
+
+unsigned switchSlot(uint64_t hash, unsigned bucketSeed, unsigned mask) {
+    uint32_t x = (uint32_t)(hash >> 32) ^ bucketSeed;
+    x ^= x >> 16;
+    x *= 0x85ebca6bU;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35U;
+    x ^= x >> 16;
+    return x & mask;
+}
+
+// Buckets are placed largest first, while the table is still empty enough
+// for their keys to find free slots together.
+static bool placePerfectHash(const std::vector<uint64_t>& hashes, PerfectHash& table) {
+    size_t bucketCount = size_t(1) << table.bucketBits;
+    unsigned mask = (1U << table.slotBits) - 1;
+    std::vector<std::vector<size_t>> buckets(bucketCount);
+    for (size_t i = 0; i < hashes.size(); i++) {
+        buckets[hashes[i] & (bucketCount - 1)].push_back(i);
+    }
+    std::vector<size_t> order(bucketCount);
+    for (size_t b = 0; b < bucketCount; b++) order[b] = b;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    table.bucketSeeds.assign(bucketCount, 0);
+    table.slots.assign(size_t(mask) + 1, -1);
+    std::vector<unsigned> chosen;
+    for (size_t b : order) {
+        const auto& keys = buckets[b];
+        if (keys.empty()) break;
+        bool placed = false;
+        for (unsigned seed = 0; seed < 65536 && !placed; seed++) {
+            chosen.clear();
+            placed = true;
+            for (size_t key : keys) {
+                unsigned slot = switchSlot(hashes[key], seed, mask);
+                if (table.slots[slot] != -1 || std::count(chosen.begin(), chosen.end(), slot)) {
+                    placed = false;
+                    break;
+                }
+                chosen.push_back(slot);
+            }
+            if (placed) {
+                table.bucketSeeds[b] = seed;
+                for (size_t k = 0; k < keys.size(); k++) table.slots[chosen[k]] = (int)keys[k];
+            }
+        }
+        if (!placed) return false;
+    }
+    return true;
+}
+
+PerfectHash buildPerfectHash(size_t count, const std::function<uint64_t(size_t, uint64_t)>& hashOf) {
+    PerfectHash table;
+    table.slotBits = 1;
+    while ((size_t(1) << table.slotBits) < count + count / 4) table.slotBits++;
+    while ((size_t(1) << (table.bucketBits + 1)) <= count / 2) table.bucketBits++;
+
+    std::vector<uint64_t> hashes(count);
+    for (int attempt = 0;; attempt++) {
+        // A table that keeps failing is made sparser.
+        if (attempt > 0 && attempt % 8 == 0) table.slotBits++;
+        table.seed = 0x9e3779b97f4a7c15ULL * (uint64_t)(attempt + 1);
+        for (size_t i = 0; i < count; i++) hashes[i] = hashOf(i, table.seed);
+        if (placePerfectHash(hashes, table)) return table;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef SWITCH_H
+#define SWITCH_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Perfect hash over the case values of a switch, built at compile time.
+// Keys are hashed once with `seed`; the low bits of that hash pick a
+// bucket, and every bucket has its own 16-bit seed that scatters its keys
+// into free slots (hash and displace). Every key gets a slot of its own,
+// so dispatch is one hash, one table load and one key compare.
+// The hash functions must stay identical to the SWITCH runtime part.
+struct PerfectHash {
+    uint64_t seed = 0;
+    int bucketBits = 0;
+    int slotBits = 0;
+    std::vector<unsigned> bucketSeeds; // 1 << bucketBits entries
+    std::vector<int> slots;            // key index per slot, -1 when empty
+};
+
+uint64_t switchHashInt(int64_t key, uint64_t seed);
+uint64_t switchHashString(const std::string& key, uint64_t seed);
+uint64_t switchHashString(const char* bytes, size_t size, uint64_t seed);
+unsigned switchSlot(uint64_t hash, unsigned bucketSeed, unsigned mask);
+
+// hashOf(i, seed) hashes key i. The keys must be distinct.
+PerfectHash buildPerfectHash(size_t count, const std::function<uint64_t(size_t, uint64_t)>& hashOf);
+
+#endif // SWITCH_H
@@ -0,0 +1,285 @@
+#include "sl_reload.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/* The table slc emits in library mode (MODULE_SOURCE in codegen/runtime.cpp). */
+#define SL_MODULE_ABI 1
+
+typedef struct sl_export {
+    const char* name;
+    const char* signature;
+    void (*function)(void);
+} sl_export;
+
+typedef struct sl_module {
+    uint32_t abi;
+    uint32_t count;
+    uint64_t interface;
+    const sl_export* exports;
+} sl_module;
+
+/* Builds are never freed before sl_library_close: a caller that read a
+ * build just as it was replaced may still touch its counter. Only the
+ * code is unloaded once the counter drops to zero. */
+typedef struct sl_build {
+    sl_version version;
+    void* handle;
+    atomic_long calls;
+    struct sl_build* older;
+} sl_build;
+
+struct sl_library {
+    char* path;
+    sl_binding* bindings;
+    int count;
+    _Atomic(sl_build*) current;
+    sl_build* builds;      /* newest first */
+    pthread_mutex_t lock;  /* serializes loads */
+    struct stat seen;      /* file of the last load attempt */
+    uint64_t generation;
+    pthread_t watcher;
+    atomic_int watching;
+    int interval_ms;
+};
+
+static _Thread_local char sl_reload_message[512];
+
+static void sl_reload_fail(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(sl_reload_message, sizeof(sl_reload_message), format, args);
+    va_end(args);
+}
+
+const char* sl_reload_error(void) {
+    return sl_reload_message;
+}
+
+static int sl_same_file(const struct stat* a, const struct stat* b) {
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino && a->st_size == b->st_size &&
+           a->st_mtim.tv_sec == b->st_mtim.tv_sec && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+/* dlopen hands back the loaded handle for a path it already has open, and
+ * the build may overwrite the file while it is mapped, so every build is
+ * loaded from a private copy. */
+static void* sl_open_copy(const char* path) {
+    char copy[] = "/tmp/sl_reload_XXXXXX";
+    int out = mkstemp(copy);
+    if (out < 0) {
+        sl_reload_fail("cannot copy %s: %s", path, strerror(errno));
+        return NULL;
+    }
+    int in = open(path, O_RDONLY);
+    int ok = in >= 0;
+    char buffer[1 << 16];
+    ssize_t n;
+    while (ok && (n = read(in, buffer, sizeof(buffer))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ok = 0;
+            break;
+        }
+        for (ssize_t done = 0; ok && done < n;) {
+            ssize_t written = write(out, buffer + done, (size_t)(n - done));
+            if (written < 0 && errno != EINTR) ok = 0;
+            if (written > 0) done += written;
+        }
+    }
+    if (!ok) sl_reload_fail("cannot copy %s: %s", path, strerror(errno));
+    if (in >= 0) close(in);
+    close(out);
+
+    void* handle = NULL;
+    if (ok) {
+        handle = dlopen(copy, RTLD_NOW | RTLD_LOCAL);
+        if (!handle) sl_reload_fail("%s", dlerror());
+    }
+    unlink(copy);
+    return handle;
+}
+
+static int sl_compare_export(const void* key, const void* entry) {
+    return strcmp((const char*)key, ((const sl_export*)entry)->name);
+}
+
+/* Loads the file and makes it current. Returns 1, 0 if the file changed
+ * while it was read, or -1. */
+static int sl_load(sl_library* lib, const struct stat* expected) {
+    void* handle = sl_open_copy(lib->path);
+    struct stat after;
+    if (stat(lib->path, &after) != 0 || !sl_same_file(expected, &after)) {
+        if (handle) dlclose(handle);
+        return 0;
+    }
+    if (!handle) return -1;
+
+    const sl_module* module = (const sl_module*)dlsym(handle, "sl_module_info");
+    if (!module) {
+        sl_reload_fail("%s was not built with slc -shared", lib->path);
+        dlclose(handle);
+        return -1;
+    }
+    if (module->abi != SL_MODULE_ABI) {
+        sl_reload_fail("%s has function table version %u, expected %d", lib->path, module->abi, SL_MODULE_ABI);
+        dlclose(handle);
+        return -1;
+    }
+
+    void (**functions)(void) = calloc((size_t)lib->count + 1, sizeof(*functions));
+    for (int i = 0; i < lib->count; i++) {
+        const sl_binding* binding = &lib->bindings[i];
+        const sl_export* found =
+            bsearch(binding->name, module->exports, module->count, sizeof(sl_export), sl_compare_export);
+        if (!found) {
+            sl_reload_fail("%s does not export '%s'", lib->path, binding->name);
+        } else if (binding->signature && strcmp(binding->signature, found->signature) != 0) {
+            sl_reload_fail("'%s' in %s is %s, expected %s", binding->name, lib->path, found->signature,
+                           binding->signature);
+            found = NULL;
+        }
+        if (!found) {
+            free(functions);
+            dlclose(handle);
+            return -1;
+        }
+        functions[i] = found->function;
+    }
+
+    sl_build* build = calloc(1, sizeof(sl_build));
+    build->version.functions = functions;
+    build->version.generation = ++lib->generation;
+    build->handle = handle;
+    build->older = lib->builds;
+    lib->builds = build;
+    atomic_store(&lib->current, build);
+    return 1;
+}
+
+/* A build that is no longer current and has no calls left cannot gain
+ * any: sl_enter only keeps a build it still finds current after counting
+ * itself in. */
+static void sl_unload_finished(sl_library* lib) {
+    sl_build* current = atomic_load(&lib->current);
+    for (sl_build* build = lib->builds; build; build = build->older) {
+        if (build != current && build->handle && atomic_load(&build->calls) == 0) {
+            dlclose(build->handle);
+            build->handle = NULL;
+        }
+    }
+}
+
+sl_library* sl_library_open(const char* path, const sl_binding* bindings, int count) {
+    sl_library* lib = calloc(1, sizeof(sl_library));
+    lib->path = strdup(path);
+    lib->count = count;
+    lib->bindings = calloc((size_t)count + 1, sizeof(sl_binding));
+    for (int i = 0; i < count; i++) {
+        lib->bindings[i].name = strdup(bindings[i].name);
+        lib->bindings[i].signature = bindings[i].signature ? strdup(bindings[i].signature) : NULL;
+    }
+    pthread_mutex_init(&lib->lock, NULL);
+
+    int loaded = 0;
+    while (loaded == 0) {
+        if (stat(path, &lib->seen) != 0) {
+            sl_reload_fail("cannot open %s: %s", path, strerror(errno));
+            loaded = -1;
+        } else {
+            loaded = sl_load(lib, &lib->seen);
+        }
+    }
+    if (loaded < 0) {
+        sl_library_close(lib);
+        return NULL;
+    }
+    return lib;
+}
+
+int sl_library_poll(sl_library* lib) {
+    pthread_mutex_lock(&lib->lock);
+    sl_unload_finished(lib);
+    int result = 0;
+    struct stat now;
+    if (stat(lib->path, &now) == 0 && !sl_same_file(&now, &lib->seen)) {
+        result = sl_load(lib, &now);
+        /* A refused build is not retried until the file changes again. */
+        if (result != 0) lib->seen = now;
+    }
+    pthread_mutex_unlock(&lib->lock);
+    return result;
+}
+
+static void* sl_watch_main(void* arg) {
+    sl_library* lib = arg;
+    struct timespec interval = { lib->interval_ms / 1000, (long)(lib->interval_ms % 1000) * 1000000L };
+    while (atomic_load(&lib->watching)) {
+        nanosleep(&interval, NULL);
+        if (sl_library_poll(lib) < 0) {
+            fprintf(stderr, "sl_reload: %s\n", sl_reload_error());
+        }
+    }
+    return NULL;
+}
+
+int sl_library_watch(sl_library* lib, int interval_ms) {
+    if (atomic_load(&lib->watching)) return 0;
+    lib->interval_ms = interval_ms > 0 ? interval_ms : 1;
+    atomic_store(&lib->watching, 1);
+    if (pthread_create(&lib->watcher, NULL, sl_watch_main, lib) != 0) {
+        atomic_store(&lib->watching, 0);
+        return -1;
+    }
+    return 0;
+}
+
+/* Count in, then check the build is still current: a swap that happens in
+ * between either sees the count or makes the check fail. Both sides use
+ * sequentially consistent operations. */
+sl_version* sl_enter(sl_library* lib) {
+    for (;;) {
+        sl_build* build = atomic_load(&lib->current);
+        atomic_fetch_add(&build->calls, 1);
+        if (atomic_load(&lib->current) == build) return &build->version;
+        atomic_fetch_sub(&build->calls, 1);
+    }
+}
+
+void sl_leave(sl_version* version) {
+    atomic_fetch_sub(&((sl_build*)version)->calls, 1);
+}
+
+void sl_library_close(sl_library* lib) {
+    if (atomic_exchange(&lib->watching, 0)) {
+        pthread_join(lib->watcher, NULL);
+    }
+    for (sl_build* build = lib->builds; build;) {
+        while (atomic_load(&build->calls) > 0) {
+            sched_yield();
+        }
+        sl_build* older = build->older;
+        if (build->handle) dlclose(build->handle);
+        free(build->version.functions);
+        free(build);
+        build = older;
+    }
+    for (int i = 0; i < lib->count; i++) {
+        free((char*)lib->bindings[i].name);
+        free((char*)lib->bindings[i].signature);
+    }
+    free(lib->bindings);
+    free(lib->path);
+    pthread_mutex_destroy(&lib->lock);
+    free(lib);
+}
@@ -0,0 +1,70 @@
+#ifndef SL_RELOAD_H
+#define SL_RELOAD_H
+
+/* Host-side loader for libraries built with `slc -shared`. The host names
+ * the functions it calls once, as bindings; sl_library_poll (or a watcher
+ * thread) loads a new build when the file changes, checks that it still
+ * exports every binding with the same signature, and swaps it in
+ * atomically. Calls already running finish in the build they started in,
+ * which is unloaded once the last of them returns. A build that fails the
+ * checks is refused and the running one stays.
+ *
+ *     static const sl_binding BINDINGS[] = { { "score", "int(int)" } };
+ *     sl_library* lib = sl_library_open("./libgame.so", BINDINGS, 1);
+ *     ...
+ *     sl_version* v = sl_enter(lib);
+ *     int s = SL_FUNCTION(v, 0, int (*)(int))(10);
+ *     sl_leave(v);
+ *
+ * Globals of the library start over in every build; keep state that must
+ * survive a reload in the host. Link with -ldl -pthread. */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sl_binding {
+    const char* name;
+    const char* signature; /* as slc writes it, e.g. "int(int,double)"; NULL skips the check */
+} sl_binding;
+
+typedef struct sl_library sl_library;
+
+/* One loaded build. Valid between sl_enter and sl_leave. */
+typedef struct sl_version {
+    void (**functions)(void); /* by binding index */
+    uint64_t generation;      /* 1 for the first build, then one more per reload */
+} sl_version;
+
+#define SL_FUNCTION(version, binding, type) ((type)(version)->functions[binding])
+
+/* Loads path; NULL if it cannot be loaded or lacks a binding. */
+sl_library* sl_library_open(const char* path, const sl_binding* bindings, int count);
+
+/* Reloads when the file changed since the last attempt. Returns 1 after a
+ * swap, 0 if nothing changed or the file is still being written, -1 if the
+ * new build was refused. Also unloads builds whose calls have finished. */
+int sl_library_poll(sl_library* lib);
+
+/* Polls from a background thread every interval_ms; refused builds are
+ * reported on stderr. Returns 0, or -1 if the thread cannot start. */
+int sl_library_watch(sl_library* lib, int interval_ms);
+
+/* Pins the current build for the calls that follow. Cheap: two atomic
+ * operations, no lock. */
+sl_version* sl_enter(sl_library* lib);
+void sl_leave(sl_version* version);
+
+/* Stops the watcher, waits for running calls and unloads every build. */
+void sl_library_close(sl_library* lib);
+
+/* Why the last open or poll on this thread failed. */
+const char* sl_reload_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SL_RELOAD_H */
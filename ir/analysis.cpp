@@ -0,0 +1,144 @@
+#include "analysis.h"
+#include <algorithm>
+#include <map>
+
+std::vector<IRBlock*> reversePostorder(const IRFunction& function) {
+    std::vector<IRBlock*> postorder;
+    if (function.blocks.empty()) return postorder;
+    std::set<IRBlock*> visited;
+    // Each entry is a block and the index of the next successor to visit.
+    std::vector<std::pair<IRBlock*, size_t>> stack;
+    stack.push_back({function.entry(), 0});
+    visited.insert(function.entry());
+    while (!stack.empty()) {
+        IRBlock* block = stack.back().first;
+        std::vector<IRBlock*> succs = block->successors();
+        size_t& next = stack.back().second;
+        if (next < succs.size()) {
+            IRBlock* succ = succs[next++];
+            if (visited.insert(succ).second) {
+                stack.push_back({succ, 0});
+            }
+        } else {
+            postorder.push_back(block);
+            stack.pop_back();
+        }
+    }
+    std::reverse(postorder.begin(), postorder.end());
+    return postorder;
+}
+
+DominatorTree::DominatorTree(const IRFunction& function) : blocks(reversePostorder(function)) {
+    int count = (int)blocks.size();
+    for (int i = 0; i < count; ++i) {
+        index[blocks[i]] = i;
+    }
+    idoms.assign(count, -1);
+    if (count == 0) return;
+    idoms[0] = 0;
+
+    auto intersect = [&](int a, int b) {
+        while (a != b) {
+            while (a > b) a = idoms[a];
+            while (b > a) b = idoms[b];
+        }
+        return a;
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 1; i < count; ++i) {
+            int idom = -1;
+            for (IRBlock* pred : blocks[i]->preds) {
+                auto found = index.find(pred);
+                if (found == index.end() || idoms[found->second] == -1) continue;
+                idom = idom == -1 ? found->second : intersect(found->second, idom);
+            }
+            if (idoms[i] != idom) {
+                idoms[i] = idom;
+                changed = true;
+            }
+        }
+    }
+
+    children.assign(count, {});
+    for (int i = 1; i < count; ++i) {
+        children[idoms[i]].push_back(blocks[i]);
+    }
+    enter.assign(count, 0);
+    leave.assign(count, 0);
+    int clock = 0;
+    std::vector<std::pair<int, size_t>> stack = {{0, 0}};
+    enter[0] = clock++;
+    while (!stack.empty()) {
+        int node = stack.back().first;
+        size_t& next = stack.back().second;
+        if (next < children[node].size()) {
+            int child = index[children[node][next++]];
+            enter[child] = clock++;
+            stack.push_back({child, 0});
+        } else {
+            leave[node] = clock++;
+            stack.pop_back();
+        }
+    }
+}
+
+IRBlock* DominatorTree::idom(const IRBlock* block) const {
+    auto found = index.find(block);
+    if (found == index.end() || found->second == 0) return nullptr;
+    return blocks[idoms[found->second]];
+}
+
+bool DominatorTree::dominates(const IRBlock* a, const IRBlock* b) const {
+    auto ia = index.find(a);
+    auto ib = index.find(b);
+    if (ia == index.end() || ib == index.end()) return false;
+    return enter[ia->second] <= enter[ib->second] && leave[ib->second] <= leave[ia->second];
+}
+
+const std::vector<IRBlock*>& DominatorTree::childrenOf(const IRBlock* block) const {
+    static const std::vector<IRBlock*> none;
+    auto found = index.find(block);
+    return found == index.end() ? none : children[found->second];
+}
+
+std::vector<std::unique_ptr<IRLoop>> findLoops(const IRFunction& function, const DominatorTree& dominators) {
+    std::map<IRBlock*, IRLoop*> byHeader;
+    std::vector<std::unique_ptr<IRLoop>> loops;
+    for (IRBlock* block : dominators.order()) {
+        for (IRBlock* header : block->successors()) {
+            if (!dominators.dominates(header, block)) continue;
+            IRLoop*& loop = byHeader[header];
+            if (!loop) {
+                loops.push_back(std::make_unique<IRLoop>());
+                loop = loops.back().get();
+                loop->header = header;
+                loop->blocks.insert(header);
+            }
+            std::vector<IRBlock*> work = {block};
+            while (!work.empty()) {
+                IRBlock* member = work.back();
+                work.pop_back();
+                if (!loop->blocks.insert(member).second) continue;
+                for (IRBlock* pred : member->preds) {
+                    if (dominators.reachable(pred)) work.push_back(pred);
+                }
+            }
+        }
+    }
+
+    // A loop lies inside the smallest other loop holding its header.
+    std::stable_sort(loops.begin(), loops.end(), [](const std::unique_ptr<IRLoop>& a, const std::unique_ptr<IRLoop>& b) {
+        return a->blocks.size() < b->blocks.size();
+    });
+    for (size_t i = 0; i < loops.size(); ++i) {
+        for (size_t j = i + 1; j < loops.size(); ++j) {
+            if (loops[j]->contains(loops[i]->header)) {
+                loops[i]->parent = loops[j].get();
+                break;
+            }
+        }
+    }
+    return loops;
+}
@@ -0,0 +1,46 @@
+#ifndef IR_ANALYSIS_H
+#define IR_ANALYSIS_H
+
+#include <set>
+#include <unordered_map>
+#include <vector>
+#include "ir.h"
+
+// Blocks reachable from the entry, each after all of its predecessors
+// except those reaching it through a back edge.
+std::vector<IRBlock*> reversePostorder(const IRFunction& function);
+
+// Dominator tree of the reachable blocks (Cooper, Harvey and Kennedy,
+// "A Simple, Fast Dominance Algorithm"). Valid until the CFG changes.
+class DominatorTree {
+private:
+    std::vector<IRBlock*> blocks; // reverse postorder
+    std::unordered_map<const IRBlock*, int> index;
+    std::vector<int> idoms;
+    std::vector<std::vector<IRBlock*>> children;
+    std::vector<int> enter, leave; // preorder interval of each subtree
+
+public:
+    explicit DominatorTree(const IRFunction& function);
+
+    bool reachable(const IRBlock* block) const { return index.count(block) != 0; }
+    IRBlock* idom(const IRBlock* block) const;
+    bool dominates(const IRBlock* a, const IRBlock* b) const;
+    const std::vector<IRBlock*>& childrenOf(const IRBlock* block) const;
+    const std::vector<IRBlock*>& order() const { return blocks; }
+};
+
+// A natural loop: the header and every block that reaches one of its back
+// edges without passing the header.
+struct IRLoop {
+    IRBlock* header = nullptr;
+    std::set<IRBlock*> blocks;
+    IRLoop* parent = nullptr;
+
+    bool contains(const IRBlock* block) const { return blocks.count(const_cast<IRBlock*>(block)) != 0; }
+};
+
+// Loops of the function, inner loops before the loops containing them.
+std::vector<std::unique_ptr<IRLoop>> findLoops(const IRFunction& function, const DominatorTree& dominators);
+
+#endif // IR_ANALYSIS_H
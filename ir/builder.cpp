@@ -0,0 +1,835 @@
+#include "builder.h"
+
+namespace {
+
+bool isFloating(Type type) {
+    return type == Type::FLOAT || type == Type::DOUBLE;
+}
+
+// The scalars the IR holds.
+bool isScalar(Type type) {
+    return type == Type::INT || type == Type::BOOL || isFloating(type);
+}
+
+// C's usual arithmetic conversions over the scalars: bool promotes to int.
+Type arithmeticType(Type left, Type right) {
+    if (left == Type::DOUBLE || right == Type::DOUBLE) return Type::DOUBLE;
+    if (left == Type::FLOAT || right == Type::FLOAT) return Type::FLOAT;
+    return Type::INT;
+}
+
+IROp binaryOp(BinaryOp op) {
+    switch (op) {
+        case BinaryOp::ADD: case BinaryOp::PLUS_ASSIGN: return IROp::ADD;
+        case BinaryOp::SUB: case BinaryOp::MINUS_ASSIGN: return IROp::SUB;
+        case BinaryOp::MUL: case BinaryOp::STAR_ASSIGN: return IROp::MUL;
+        case BinaryOp::DIV: case BinaryOp::SLASH_ASSIGN: return IROp::DIV;
+        case BinaryOp::MOD: return IROp::MOD;
+        case BinaryOp::EQ: return IROp::EQ;
+        case BinaryOp::NE: return IROp::NE;
+        case BinaryOp::LT: return IROp::LT;
+        case BinaryOp::GT: return IROp::GT;
+        case BinaryOp::LE: return IROp::LE;
+        default: return IROp::GE;
+    }
+}
+
+bool isComparison(BinaryOp op) {
+    return op == BinaryOp::EQ || op == BinaryOp::NE || op == BinaryOp::LT || op == BinaryOp::GT ||
+           op == BinaryOp::LE || op == BinaryOp::GE;
+}
+
+// What a type the IR leaves out is called when a function is skipped.
+std::string describe(Type type) {
+    switch (type) {
+        case Type::STRING: return "strings";
+        case Type::CLASS: return "classes and structs";
+        case Type::ARRAY: case Type::SLICE: return "arrays";
+        case Type::MAP: return "maps";
+        case Type::VEC4F: case Type::VEC8F: case Type::VEC4D: case Type::VEC8I: return "vector types";
+        default: return "sized integers";
+    }
+}
+
+// The scalar output built-ins; anything else in the runtime is left to the AST.
+bool isOutputBuiltin(const std::string& name) {
+    return name == "write_int" || name == "write_uint" || name == "write_double" || name == "write_bool" ||
+           name == "write_newline" || name == "flush";
+}
+
+} // namespace
+
+IRBuilder::IRBuilder()
+    : module(nullptr), function(nullptr), current(nullptr), resultValue(nullptr) {}
+
+void IRBuilder::unsupported(const std::string& what, int line) {
+    if (error.empty()) {
+        error = what + " (line " + std::to_string(line) + ")";
+    }
+}
+
+bool IRBuilder::supported(Type type, const std::string& className, int line) {
+    if (isScalar(type)) return true;
+    unsupported(describe(type), line);
+    return false;
+}
+
+IRValue* IRBuilder::emit(IROp op, Type type, const std::vector<IRValue*>& operands) {
+    IRValue* instr = current->append(function->newInstruction(op, type));
+    for (IRValue* operand : operands) {
+        instr->addOperand(resolve(operand));
+    }
+    return instr;
+}
+
+void IRBuilder::jump(IRBlock* target) {
+    IRValue* instr = emit(IROp::JUMP, Type::VOID, {});
+    instr->targets.push_back(target);
+    target->preds.push_back(current);
+}
+
+void IRBuilder::branch(IRValue* condition, IRBlock* ifTrue, IRBlock* ifFalse) {
+    IRValue* instr = emit(IROp::BRANCH, Type::VOID, {condition});
+    instr->targets = {ifTrue, ifFalse};
+    ifTrue->preds.push_back(current);
+    ifFalse->preds.push_back(current);
+}
+
+// Code after return, break or continue goes into a block nothing reaches,
+// which is deleted once the function is done.
+void IRBuilder::startUnreachable() {
+    current = function->newBlock();
+    sealed.insert(current);
+}
+
+void IRBuilder::enterScope() {
+    scopes.emplace_back();
+}
+
+void IRBuilder::exitScope() {
+    scopes.pop_back();
+}
+
+IRBuilder::Variable* IRBuilder::lookup(const std::string& name) {
+    for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+        auto found = scope->find(name);
+        if (found != scope->end()) {
+            return &found->second;
+        }
+    }
+    return nullptr;
+}
+
+void IRBuilder::declare(const std::string& name, Type type, IRValue* value) {
+    Variable var;
+    var.id = (int)variableTypes.size();
+    var.type = type;
+    variableTypes.push_back(type);
+    scopes.back()[name] = var;
+    write(var, name, value);
+}
+
+IRValue* IRBuilder::read(const Variable& var, const std::string& name) {
+    if (var.global) {
+        IRValue* load = emit(IROp::LOAD, var.type, {});
+        load->name = name;
+        return load;
+    }
+    return readVariable(var.id, current);
+}
+
+void IRBuilder::write(const Variable& var, const std::string& name, IRValue* value) {
+    if (var.global) {
+        IRValue* store = emit(IROp::STORE, Type::VOID, {value});
+        store->name = name;
+        return;
+    }
+    definitions[current][var.id] = value;
+}
+
+IRValue* IRBuilder::resolve(IRValue* value) {
+    auto found = replacedPhis.find(value);
+    while (found != replacedPhis.end()) {
+        value = found->second;
+        found = replacedPhis.find(value);
+    }
+    return value;
+}
+
+IRValue* IRBuilder::readVariable(int var, IRBlock* block) {
+    auto defs = definitions.find(block);
+    if (defs != definitions.end()) {
+        auto found = defs->second.find(var);
+        if (found != defs->second.end()) {
+            return found->second = resolve(found->second);
+        }
+    }
+    return readVariableRecursive(var, block);
+}
+
+IRValue* IRBuilder::readVariableRecursive(int var, IRBlock* block) {
+    IRValue* value;
+    if (!sealed.count(block)) {
+        value = block->insertPhi(variableTypes[var]);
+        incompletePhis[block].push_back({var, value});
+    } else if (block->preds.empty()) {
+        value = function->zero(variableTypes[var]); // only in blocks nothing reaches
+    } else if (block->preds.size() == 1) {
+        value = readVariable(var, block->preds[0]);
+    } else {
+        // Defined first so that a loop back to this block finds the phi.
+        IRValue* phi = block->insertPhi(variableTypes[var]);
+        definitions[block][var] = phi;
+        value = addPhiOperands(var, phi);
+    }
+    definitions[block][var] = value;
+    return value;
+}
+
+IRValue* IRBuilder::addPhiOperands(int var, IRValue* phi) {
+    fillingPhis.insert(phi);
+    for (IRBlock* pred : phi->block->preds) {
+        phi->addOperand(readVariable(var, pred));
+    }
+    fillingPhis.erase(phi);
+    return tryRemoveTrivialPhi(phi);
+}
+
+// A phi whose operands are all one value (or itself) is that value. Its
+// users are rewritten now; the phi stays in place, unused, until the
+// function is finished, since definitions may still name it.
+IRValue* IRBuilder::tryRemoveTrivialPhi(IRValue* phi) {
+    IRValue* same = nullptr;
+    for (IRValue* operand : phi->operands) {
+        if (operand == same || operand == phi) continue;
+        if (same) return phi;
+        same = operand;
+    }
+    if (!same) {
+        same = function->zero(phi->type);
+    }
+    std::vector<IRValue*> users;
+    for (IRValue* user : phi->users) {
+        if (user != phi) users.push_back(user);
+    }
+    phi->replaceAllUsesWith(same);
+    replacedPhis[phi] = same;
+    // Phis still missing operands are checked once they have them all.
+    for (IRValue* user : users) {
+        if (user->op == IROp::PHI && !replacedPhis.count(user) && !fillingPhis.count(user) &&
+            sealed.count(user->block)) {
+            tryRemoveTrivialPhi(user);
+        }
+    }
+    return resolve(same);
+}
+
+// Filling in the phis may read other variables around a loop back into
+// this block and add phis to it, which are filled in the next round.
+void IRBuilder::seal(IRBlock* block) {
+    for (;;) {
+        auto incomplete = incompletePhis.find(block);
+        if (incomplete == incompletePhis.end()) break;
+        std::vector<std::pair<int, IRValue*>> phis = std::move(incomplete->second);
+        incompletePhis.erase(incomplete);
+        for (auto& entry : phis) {
+            addPhiOperands(entry.first, entry.second);
+        }
+    }
+    sealed.insert(block);
+}
+
+IRValue* IRBuilder::expression(ExpressionNode* expr) {
+    resultValue = nullptr;
+    expr->accept(this);
+    if (!resultValue) {
+        resultValue = function->zero(Type::INT);
+    }
+    return resultValue;
+}
+
+IRValue* IRBuilder::expressionAs(ExpressionNode* expr, Type to) {
+    return convert(expression(expr), to);
+}
+
+IRValue* IRBuilder::convert(IRValue* value, Type to) {
+    if (value->type == to || !isScalar(value->type) || !isScalar(to)) {
+        return value;
+    }
+    return emit(IROp::CONVERT, to, {value});
+}
+
+// Both operands go to their common type first, as C converts them.
+IRValue* IRBuilder::arithmetic(BinaryOp op, IRValue* left, IRValue* right, int line) {
+    Type common = arithmeticType(left->type, right->type);
+    left = convert(left, common);
+    right = convert(right, common);
+    if (op == BinaryOp::MOD && isFloating(common)) {
+        unsupported("% on floating-point values", line);
+    }
+    return emit(binaryOp(op), isComparison(op) ? Type::BOOL : common, {left, right});
+}
+
+// Branches to ifTrue or ifFalse, evaluating && and || only as far as needed.
+void IRBuilder::condition(ExpressionNode* expr, IRBlock* ifTrue, IRBlock* ifFalse) {
+    auto* bin = dynamic_cast<BinaryExprNode*>(expr);
+    if (bin && (bin->op == BinaryOp::AND || bin->op == BinaryOp::OR)) {
+        IRBlock* right = function->newBlock();
+        if (bin->op == BinaryOp::AND) {
+            condition(bin->left.get(), right, ifFalse);
+        } else {
+            condition(bin->left.get(), ifTrue, right);
+        }
+        seal(right);
+        current = right;
+        condition(bin->right.get(), ifTrue, ifFalse);
+        return;
+    }
+    auto* unary = dynamic_cast<UnaryExprNode*>(expr);
+    if (unary && unary->op == UnaryOp::NOT) {
+        condition(unary->operand.get(), ifFalse, ifTrue);
+        return;
+    }
+    branch(expressionAs(expr, Type::BOOL), ifTrue, ifFalse);
+}
+
+// x++ is x = x + 1 in the arithmetic type of x and int.
+IRValue* IRBuilder::increment(const Variable& var, const std::string& name, bool up, bool prefix) {
+    IRValue* old = read(var, name);
+    Type common = arithmeticType(var.type, Type::INT);
+    IRValue* one = isFloating(common) ? function->constant(common, 1.0) : function->constant(common, 1L);
+    IRValue* updated = convert(emit(up ? IROp::ADD : IROp::SUB, common, {convert(old, common), one}), var.type);
+    write(var, name, updated);
+    return prefix ? updated : old;
+}
+
+void IRBuilder::statement(StatementNode* stmt) {
+    stmt->accept(this);
+}
+
+void IRBuilder::lowerFunction(FunctionNode* node) {
+    auto owned = std::make_unique<IRFunction>();
+    function = owned.get();
+    function->name = node->name;
+    function->returnType = node->returnType;
+    function->source = node;
+    error.clear();
+    variableTypes.clear();
+    definitions.clear();
+    sealed.clear();
+    incompletePhis.clear();
+    replacedPhis.clear();
+    fillingPhis.clear();
+    jumpTargets.clear();
+
+    if (node->returnType != Type::VOID) {
+        supported(node->returnType, node->returnClass, node->line);
+    }
+    current = function->newBlock();
+    sealed.insert(current);
+    enterScope();
+    for (size_t i = 0; i < node->parameters.size(); ++i) {
+        const auto& param = node->parameters[i];
+        std::string className = i < node->parameterClasses.size() ? node->parameterClasses[i] : "";
+        if (!supported(param.second, className, node->line)) break;
+        function->params.push_back(std::make_unique<IRValue>(IROp::PARAM, param.second));
+        function->params.back()->name = param.first;
+        declare(param.first, param.second, function->params.back().get());
+    }
+    if (error.empty() && node->body) {
+        node->body->accept(this);
+    }
+    exitScope();
+
+    if (!error.empty()) {
+        module->skipped.push_back(node->name + ": " + error);
+        function = nullptr;
+        return;
+    }
+
+    // Falling off the end returns 0, which is what main needs.
+    if (function->returnType == Type::VOID) {
+        emit(IROp::RETURN, Type::VOID, {});
+    } else {
+        emit(IROp::RETURN, Type::VOID, {function->zero(function->returnType)});
+    }
+
+    for (auto& block : function->blocks) {
+        for (auto it = block->instructions.begin(); it != block->instructions.end();) {
+            if (replacedPhis.count(it->get())) {
+                (*it)->dropOperands();
+                it = block->instructions.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    function->removeUnreachable();
+    function->orderBlocks();
+    module->functions.push_back(std::move(owned));
+    function = nullptr;
+}
+
+void IRBuilder::build(ProgramNode* root, IRModule& target) {
+    module = &target;
+    root->accept(this);
+}
+
+void IRBuilder::visit(ProgramNode* node) {
+    std::vector<FunctionNode*> bodies;
+    for (auto& func : node->functions) {
+        if (!func->external) bodies.push_back(func.get());
+    }
+    for (auto& templ : node->templates) {
+        for (auto& instance : templ->instances) {
+            if (!instance->external) bodies.push_back(instance.get());
+        }
+    }
+    for (auto& func : node->functions) {
+        functions[func->name] = func.get();
+    }
+    for (auto& templ : node->templates) {
+        for (auto& instance : templ->instances) {
+            functions[instance->name] = instance.get();
+        }
+    }
+
+    // Globals stay in memory: every read loads and every write stores, so
+    // calls see them as the AST path does.
+    scopes.emplace_back();
+    for (auto& global : node->globals) {
+        Variable var;
+        var.type = global->isArray ? Type::ARRAY : global->type;
+        var.global = true;
+        scopes.back()[global->name] = var;
+    }
+    for (FunctionNode* func : bodies) {
+        lowerFunction(func);
+    }
+    scopes.pop_back();
+}
+
+void IRBuilder::visit(DirectiveNode* node) {
+}
+
+void IRBuilder::visit(FunctionNode* node) {
+}
+
+void IRBuilder::visit(TemplateNode* node) {
+}
+
+void IRBuilder::visit(ClassNode* node) {
+    unsupported("classes and structs", node->line);
+}
+
+void IRBuilder::visit(MethodNode* node) {
+    unsupported("classes and structs", node->line);
+}
+
+void IRBuilder::visit(ConstructorNode* node) {
+    unsupported("classes and structs", node->line);
+}
+
+void IRBuilder::visit(BlockNode* node) {
+    enterScope();
+    for (auto& stmt : node->statements) {
+        if (!error.empty()) break;
+        statement(stmt.get());
+    }
+    exitScope();
+}
+
+// Locals without an initializer start at zero.
+void IRBuilder::visit(VarDeclNode* node) {
+    if (node->isArray) {
+        unsupported("arrays", node->line);
+        return;
+    }
+    if (!supported(node->type, node->className, node->line)) return;
+    IRValue* value = node->initializer ? expressionAs(node->initializer.get(), node->type) : function->zero(node->type);
+    declare(node->name, node->type, value);
+}
+
+void IRBuilder::visit(VarAssignNode* node) {
+    if (!node->field.empty() || node->isField) {
+        unsupported("classes and structs", node->line);
+        return;
+    }
+    if (node->index) {
+        unsupported(node->arrayKind == ArrayKind::MAP ? "maps" : "arrays", node->line);
+        return;
+    }
+    Variable* found = lookup(node->name);
+    if (!found || !supported(found->type, "", node->line)) return;
+    Variable var = *found;
+    IRValue* value;
+    if (node->assignOp != BinaryOp::ADD) { // plain = is parsed as ADD
+        IRValue* old = read(var, node->name);
+        value = arithmetic(node->assignOp, old, expression(node->value.get()), node->line);
+    } else {
+        value = expression(node->value.get());
+    }
+    write(var, node->name, convert(value, var.type));
+}
+
+void IRBuilder::visit(ReturnNode* node) {
+    if (node->value && function->returnType != Type::VOID) {
+        emit(IROp::RETURN, Type::VOID, {expressionAs(node->value.get(), function->returnType)});
+    } else {
+        if (node->value) expression(node->value.get());
+        emit(IROp::RETURN, Type::VOID, {});
+    }
+    startUnreachable();
+}
+
+void IRBuilder::visit(IfNode* node) {
+    IRBlock* thenBlock = function->newBlock();
+    IRBlock* end = function->newBlock();
+    IRBlock* elseBlock = node->elseIf || node->elseBlock ? function->newBlock() : end;
+    condition(node->condition.get(), thenBlock, elseBlock);
+    seal(thenBlock);
+    current = thenBlock;
+    if (node->thenBlock) {
+        node->thenBlock->accept(this);
+    }
+    jump(end);
+    if (elseBlock != end) {
+        seal(elseBlock);
+        current = elseBlock;
+        if (node->elseIf) {
+            statement(node->elseIf.get());
+        } else {
+            node->elseBlock->accept(this);
+        }
+        jump(end);
+    }
+    seal(end);
+    current = end;
+}
+
+void IRBuilder::visit(WhileNode* node) {
+    if (!node->annotations.empty()) {
+        unsupported("loop annotations", node->line);
+        return;
+    }
+    IRBlock* header = function->newBlock();
+    IRBlock* body = function->newBlock();
+    IRBlock* exit = function->newBlock();
+    jump(header);
+    current = header;
+    condition(node->condition.get(), body, exit);
+    seal(body);
+    current = body;
+    jumpTargets.push_back({true, exit, header});
+    if (node->body) {
+        node->body->accept(this);
+    }
+    jumpTargets.pop_back();
+    jump(header);
+    seal(header);
+    seal(exit);
+    current = exit;
+}
+
+void IRBuilder::visit(ForNode* node) {
+    if (node->isParallel) {
+        unsupported("parallel for", node->line);
+        return;
+    }
+    if (!node->annotations.empty()) {
+        unsupported("loop annotations", node->line);
+        return;
+    }
+    enterScope();
+    if (node->init) {
+        statement(node->init.get());
+    }
+    IRBlock* header = function->newBlock();
+    IRBlock* body = function->newBlock();
+    IRBlock* step = function->newBlock();
+    IRBlock* exit = function->newBlock();
+    jump(header);
+    current = header;
+    if (node->condition) {
+        condition(node->condition.get(), body, exit);
+    } else {
+        jump(body);
+    }
+    seal(body);
+    current = body;
+    jumpTargets.push_back({true, exit, step});
+    if (node->body) {
+        node->body->accept(this);
+    }
+    jumpTargets.pop_back();
+    jump(step);
+    seal(step);
+    current = step;
+    if (node->increment) {
+        expression(node->increment.get());
+    }
+    jump(header);
+    seal(header);
+    seal(exit);
+    current = exit;
+    exitScope();
+}
+
+void IRBuilder::visit(DoWhileNode* node) {
+    IRBlock* body = function->newBlock();
+    IRBlock* test = function->newBlock();
+    IRBlock* exit = function->newBlock();
+    jump(body);
+    current = body;
+    jumpTargets.push_back({true, exit, test});
+    if (node->body) {
+        node->body->accept(this);
+    }
+    jumpTargets.pop_back();
+    jump(test);
+    seal(test);
+    current = test;
+    condition(node->condition.get(), body, exit);
+    seal(body);
+    seal(exit);
+    current = exit;
+}
+
+void IRBuilder::visit(BinaryExprNode* node) {
+    if (node->op == BinaryOp::AND || node->op == BinaryOp::OR) {
+        IRBlock* ifTrue = function->newBlock();
+        IRBlock* ifFalse = function->newBlock();
+        IRBlock* end = function->newBlock();
+        condition(node, ifTrue, ifFalse);
+        seal(ifTrue);
+        seal(ifFalse);
+        current = ifTrue;
+        jump(end);
+        current = ifFalse;
+        jump(end);
+        seal(end);
+        current = end;
+        IRValue* phi = end->insertPhi(Type::BOOL);
+        phi->addOperand(function->constant(Type::BOOL, 1L));
+        phi->addOperand(function->constant(Type::BOOL, 0L));
+        resultValue = phi;
+        return;
+    }
+    if (!isScalar(node->left->type) || !isScalar(node->right->type)) {
+        unsupported(describe(isScalar(node->left->type) ? node->right->type : node->left->type), node->line);
+        return;
+    }
+    IRValue* left = expression(node->left.get());
+    IRValue* right = expression(node->right.get());
+    resultValue = arithmetic(node->op, left, right, node->line);
+}
+
+void IRBuilder::visit(UnaryExprNode* node) {
+    IRValue* operand = expression(node->operand.get());
+    if (node->op == UnaryOp::NOT) {
+        resultValue = emit(IROp::NOT, Type::BOOL, {convert(operand, Type::BOOL)});
+    } else {
+        Type type = arithmeticType(operand->type, operand->type);
+        resultValue = emit(IROp::NEG, type, {convert(operand, type)});
+    }
+}
+
+void IRBuilder::visit(CallExprNode* node) {
+    for (auto& argument : node->arguments) {
+        if (!isScalar(argument->type)) {
+            unsupported(describe(argument->type), node->line);
+            return;
+        }
+    }
+    auto callee = functions.find(node->functionName);
+    std::vector<IRValue*> arguments;
+    Type type;
+    if (callee != functions.end()) {
+        FunctionNode* func = callee->second;
+        if (func->returnType != Type::VOID && !supported(func->returnType, func->returnClass, node->line)) return;
+        for (size_t i = 0; i < node->arguments.size(); ++i) {
+            arguments.push_back(expressionAs(node->arguments[i].get(), func->parameters[i].second));
+        }
+        type = func->returnType;
+    } else if (isOutputBuiltin(node->functionName)) {
+        // The runtime's C prototypes convert the arguments.
+        for (auto& argument : node->arguments) {
+            arguments.push_back(expression(argument.get()));
+        }
+        type = Type::VOID;
+    } else {
+        unsupported("calls to '" + node->functionName + "'", node->line);
+        return;
+    }
+    IRValue* call = emit(IROp::CALL, type, arguments);
+    call->name = node->functionName;
+    resultValue = call;
+}
+
+// Literals take the value the C path prints for them: doubles and floats
+// go through std::to_string.
+void IRBuilder::visit(LiteralNode* node) {
+    switch (node->literalType) {
+        case Type::INT:
+            resultValue = function->constant(Type::INT, (long)node->intValue);
+            break;
+        case Type::BOOL:
+            resultValue = function->constant(Type::BOOL, (long)node->boolValue);
+            break;
+        case Type::DOUBLE:
+            resultValue = function->constant(Type::DOUBLE, std::stod(std::to_string(node->doubleValue)));
+            break;
+        case Type::FLOAT:
+            resultValue = function->constant(Type::FLOAT, (double)std::stof(std::to_string(node->floatValue)));
+            break;
+        default:
+            unsupported(describe(node->literalType), node->line);
+    }
+}
+
+void IRBuilder::visit(VarNode* node) {
+    Variable* var = node->isField ? nullptr : lookup(node->name);
+    if (!var) {
+        unsupported("classes and structs", node->line);
+        return;
+    }
+    if (!supported(var->type, node->className, node->line)) return;
+    resultValue = read(*var, node->name);
+}
+
+void IRBuilder::visit(ArrayAccessNode* node) {
+    unsupported(node->arrayKind == ArrayKind::MAP ? "maps" : "arrays", node->line);
+}
+
+void IRBuilder::visit(IncDecNode* node) {
+    Variable* var = node->isField ? nullptr : lookup(node->name);
+    if (!var) {
+        unsupported("classes and structs", node->line);
+        return;
+    }
+    if (!supported(var->type, "", node->line)) return;
+    increment(*var, node->name, node->isIncrement, true);
+}
+
+void IRBuilder::visit(IncDecExprNode* node) {
+    Variable* var = node->isField ? nullptr : lookup(node->name);
+    if (!var) {
+        unsupported("classes and structs", node->line);
+        return;
+    }
+    if (!supported(var->type, "", node->line)) return;
+    resultValue = increment(*var, node->name, node->isIncrement, node->isPrefix);
+}
+
+void IRBuilder::visit(BreakNode* node) {
+    jump(jumpTargets.back().breakTarget);
+    startUnreachable();
+}
+
+void IRBuilder::visit(ContinueNode* node) {
+    for (auto target = jumpTargets.rbegin(); target != jumpTargets.rend(); ++target) {
+        if (target->isLoop) {
+            jump(target->continueTarget);
+            break;
+        }
+    }
+    startUnreachable();
+}
+
+// A chain of compares in front of the case bodies, which fall through
+// into each other.
+void IRBuilder::visit(SwitchNode* node) {
+    if (!isScalar(node->expression->type) || isFloating(node->expression->type)) {
+        unsupported(describe(node->expression->type), node->line);
+        return;
+    }
+    IRValue* value = expressionAs(node->expression.get(), Type::INT);
+    std::vector<IRBlock*> starts;
+    for (auto& caseNode : node->cases) {
+        starts.push_back(function->newBlock());
+        IRBlock* next = function->newBlock();
+        IRValue* equal = emit(IROp::EQ, Type::BOOL, {value, function->constant(Type::INT, caseNode->intValue)});
+        branch(equal, starts.back(), next);
+        seal(next);
+        current = next;
+    }
+    IRBlock* defaultBlock = function->newBlock();
+    IRBlock* end = function->newBlock();
+    jump(defaultBlock);
+    jumpTargets.push_back({false, end, nullptr});
+    for (size_t i = 0; i < node->cases.size(); ++i) {
+        if (i > 0) {
+            jump(starts[i]);
+        }
+        seal(starts[i]);
+        current = starts[i];
+        node->cases[i]->accept(this);
+    }
+    if (!node->cases.empty()) {
+        jump(defaultBlock);
+    }
+    seal(defaultBlock);
+    current = defaultBlock;
+    if (node->defaultCase) {
+        node->defaultCase->accept(this);
+    }
+    jumpTargets.pop_back();
+    jump(end);
+    seal(end);
+    current = end;
+}
+
+void IRBuilder::visit(CaseNode* node) {
+    if (node->block) {
+        node->block->accept(this);
+    }
+}
+
+void IRBuilder::visit(TernaryExprNode* node) {
+    Type type = node->trueExpr->type;
+    if (isScalar(type) && isScalar(node->falseExpr->type) && type != node->falseExpr->type) {
+        type = arithmeticType(type, node->falseExpr->type);
+    }
+    if (!supported(type, node->className, node->line)) return;
+    IRBlock* ifTrue = function->newBlock();
+    IRBlock* ifFalse = function->newBlock();
+    IRBlock* end = function->newBlock();
+    condition(node->condition.get(), ifTrue, ifFalse);
+    seal(ifTrue);
+    seal(ifFalse);
+    current = ifTrue;
+    IRValue* trueValue = expressionAs(node->trueExpr.get(), type);
+    jump(end);
+    current = ifFalse;
+    IRValue* falseValue = expressionAs(node->falseExpr.get(), type);
+    jump(end);
+    seal(end);
+    current = end;
+    IRValue* phi = end->insertPhi(type);
+    phi->addOperand(resolve(trueValue));
+    phi->addOperand(resolve(falseValue));
+    resultValue = phi;
+}
+
+// Spawned calls run on other threads in the C the AST path writes.
+void IRBuilder::visit(SpawnNode* node) {
+    unsupported("spawn", node->line);
+}
+
+void IRBuilder::visit(SyncNode* node) {
+    unsupported("sync", node->line);
+}
+
+void IRBuilder::visit(ExpressionStmtNode* node) {
+    if (node->expression) {
+        expression(node->expression.get());
+    }
+}
+
+void IRBuilder::visit(FieldAccessNode* node) {
+    unsupported("classes and structs", node->line);
+}
+
+void IRBuilder::visit(SliceExprNode* node) {
+    unsupported(node->type == Type::STRING ? "strings" : "arrays", node->line);
+}
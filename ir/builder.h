@@ -0,0 +1,125 @@
+#ifndef IR_BUILDER_H
+#define IR_BUILDER_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "../ast/ast.h"
+#include "ir.h"
+
+// Lowers the functions of a checked program to SSA for `slc --ir`. Phis are
+// placed while the tree is walked (Braun et al., "Simple and Efficient
+// Construction of Static Single Assignment Form"): a variable read in a
+// block without a definition asks its predecessors, and blocks whose
+// predecessors are not all known yet get provisional phis until they are
+// sealed. Covers int, bool, float and double locals, parameters and
+// globals, all control flow, calls and the scalar output built-ins.
+// Functions using anything else, spawn or loop annotations are skipped and
+// compiled from the AST.
+class IRBuilder : public ASTVisitor {
+private:
+    struct Variable {
+        int id = -1;            // SSA variable, for locals
+        Type type = Type::INT;
+        bool global = false;
+    };
+
+    struct JumpTarget {
+        bool isLoop;
+        IRBlock* breakTarget;
+        IRBlock* continueTarget;
+    };
+
+    IRModule* module;
+    std::map<std::string, FunctionNode*> functions;
+    std::vector<std::map<std::string, Variable>> scopes; // globals first
+    std::vector<JumpTarget> jumpTargets;
+
+    // State of the function being lowered.
+    IRFunction* function;
+    IRBlock* current;
+    std::string error; // first thing the IR does not cover
+    std::vector<Type> variableTypes;
+    std::map<IRBlock*, std::map<int, IRValue*>> definitions;
+    std::set<IRBlock*> sealed;
+    std::map<IRBlock*, std::vector<std::pair<int, IRValue*>>> incompletePhis;
+    std::map<IRValue*, IRValue*> replacedPhis; // trivial phis and what replaced them
+    std::set<IRValue*> fillingPhis;            // phis getting their operands
+
+    IRValue* resultValue; // value of the last expression lowered
+
+    void unsupported(const std::string& what, int line);
+    bool supported(Type type, const std::string& className, int line);
+
+    IRValue* emit(IROp op, Type type, const std::vector<IRValue*>& operands);
+    void jump(IRBlock* target);
+    void branch(IRValue* condition, IRBlock* ifTrue, IRBlock* ifFalse);
+    void startUnreachable();
+
+    void enterScope();
+    void exitScope();
+    Variable* lookup(const std::string& name);
+    void declare(const std::string& name, Type type, IRValue* value);
+    IRValue* read(const Variable& var, const std::string& name);
+    void write(const Variable& var, const std::string& name, IRValue* value);
+
+    IRValue* readVariable(int var, IRBlock* block);
+    IRValue* readVariableRecursive(int var, IRBlock* block);
+    IRValue* addPhiOperands(int var, IRValue* phi);
+    IRValue* tryRemoveTrivialPhi(IRValue* phi);
+    IRValue* resolve(IRValue* value);
+    void seal(IRBlock* block);
+
+    IRValue* expression(ExpressionNode* expr);
+    IRValue* expressionAs(ExpressionNode* expr, Type to);
+    IRValue* convert(IRValue* value, Type to);
+    IRValue* arithmetic(BinaryOp op, IRValue* left, IRValue* right, int line);
+    void condition(ExpressionNode* expr, IRBlock* ifTrue, IRBlock* ifFalse);
+    IRValue* increment(const Variable& var, const std::string& name, bool up, bool prefix);
+    void statement(StatementNode* stmt);
+    void lowerFunction(FunctionNode* node);
+
+public:
+    IRBuilder();
+
+    // Adds a function to the module for every function it can lower and
+    // records why the others were skipped.
+    void build(ProgramNode* root, IRModule& module);
+
+    void visit(ProgramNode* node) override;
+    void visit(DirectiveNode* node) override;
+    void visit(FunctionNode* node) override;
+    void visit(TemplateNode* node) override;
+    void visit(ClassNode* node) override;
+    void visit(MethodNode* node) override;
+    void visit(ConstructorNode* node) override;
+    void visit(BlockNode* node) override;
+    void visit(VarDeclNode* node) override;
+    void visit(VarAssignNode* node) override;
+    void visit(ReturnNode* node) override;
+    void visit(IfNode* node) override;
+    void visit(WhileNode* node) override;
+    void visit(ForNode* node) override;
+    void visit(BinaryExprNode* node) override;
+    void visit(UnaryExprNode* node) override;
+    void visit(CallExprNode* node) override;
+    void visit(LiteralNode* node) override;
+    void visit(VarNode* node) override;
+    void visit(ArrayAccessNode* node) override;
+    void visit(IncDecNode* node) override;
+    void visit(IncDecExprNode* node) override;
+    void visit(DoWhileNode* node) override;
+    void visit(BreakNode* node) override;
+    void visit(ContinueNode* node) override;
+    void visit(SwitchNode* node) override;
+    void visit(CaseNode* node) override;
+    void visit(TernaryExprNode* node) override;
+    void visit(SpawnNode* node) override;
+    void visit(SyncNode* node) override;
+    void visit(ExpressionStmtNode* node) override;
+    void visit(FieldAccessNode* node) override;
+    void visit(SliceExprNode* node) override;
+};
+
+#endif // IR_BUILDER_H
@@ -0,0 +1,97 @@
+#include "analysis.h"
+#include "passes.h"
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+namespace {
+
+// Global value numbering over the dominator tree: an instruction computing
+// what a dominating one already computed (same operation, type and
+// operands, commutative operands in either order) is replaced by it. Phis
+// are numbered per block, and a phi whose operands are all one value is
+// replaced by that value.
+class GVNPass : public IRPass {
+private:
+    struct Key {
+        IROp op;
+        Type type;
+        const IRBlock* block; // phis only: equal operands mean equal values per block
+        std::vector<IRValue*> operands;
+
+        bool operator<(const Key& other) const {
+            return std::tie(op, type, block, operands) < std::tie(other.op, other.type, other.block, other.operands);
+        }
+    };
+
+    std::map<Key, IRValue*> available;
+
+    static bool commutative(IROp op) {
+        return op == IROp::ADD || op == IROp::MUL || op == IROp::EQ || op == IROp::NE;
+    }
+
+    static IRValue* trivialPhiValue(IRValue* phi) {
+        IRValue* same = nullptr;
+        for (IRValue* operand : phi->operands) {
+            if (operand == phi || operand == same) continue;
+            if (same) return nullptr;
+            same = operand;
+        }
+        return same;
+    }
+
+    bool number(IRBlock* block, const DominatorTree& dominators) {
+        bool changed = false;
+        std::vector<Key> added;
+        for (size_t i = 0; i < block->instructions.size();) {
+            IRValue* instr = block->instructions[i].get();
+            if (instr->op != IROp::PHI && !instr->isPure()) {
+                ++i;
+                continue;
+            }
+            if (instr->op == IROp::PHI) {
+                if (IRValue* same = trivialPhiValue(instr)) {
+                    instr->replaceAllUsesWith(same);
+                    block->erase(instr);
+                    changed = true;
+                    continue;
+                }
+            }
+
+            Key key{instr->op, instr->type, instr->op == IROp::PHI ? block : nullptr, instr->operands};
+            if (commutative(instr->op)) std::sort(key.operands.begin(), key.operands.end());
+            auto found = available.find(key);
+            if (found != available.end()) {
+                instr->replaceAllUsesWith(found->second);
+                block->erase(instr);
+                changed = true;
+                continue;
+            }
+            available[key] = instr;
+            added.push_back(key);
+            ++i;
+        }
+        for (IRBlock* child : dominators.childrenOf(block)) {
+            changed = number(child, dominators) || changed;
+        }
+        for (const Key& key : added) {
+            available.erase(key);
+        }
+        return changed;
+    }
+
+public:
+    const char* name() const override { return "gvn"; }
+
+    bool run(IRFunction& function) override {
+        available.clear();
+        DominatorTree dominators(function);
+        return number(function.entry(), dominators);
+    }
+};
+
+} // namespace
+
+std::unique_ptr<IRPass> createGVNPass() {
+    return std::make_unique<GVNPass>();
+}
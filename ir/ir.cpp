@@ -0,0 +1,605 @@
+#include "ir.h"
+#include "analysis.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <set>
+
+namespace {
+
+void removeUser(IRValue* value, IRValue* user) {
+    auto it = std::find(value->users.begin(), value->users.end(), user);
+    if (it != value->users.end()) {
+        *it = value->users.back();
+        value->users.pop_back();
+    }
+}
+
+bool isFloating(Type type) {
+    return type == Type::FLOAT || type == Type::DOUBLE;
+}
+
+std::string operandText(const IRValue* value) {
+    if (value->op == IROp::PARAM) {
+        return "%" + value->name;
+    }
+    if (value->op != IROp::CONST) {
+        return "%" + std::to_string(value->id);
+    }
+    char text[64];
+    switch (value->type) {
+        case Type::BOOL:
+            return value->intValue ? "true" : "false";
+        case Type::FLOAT:
+            snprintf(text, sizeof(text), "%.9gf", value->realValue);
+            return text;
+        case Type::DOUBLE:
+            snprintf(text, sizeof(text), "%.17g", value->realValue);
+            if (!strpbrk(text, ".eni")) strcat(text, ".0");
+            return text;
+        default:
+            return std::to_string(value->intValue);
+    }
+}
+
+std::string blockName(const IRBlock* block) {
+    return "b" + std::to_string(block->id);
+}
+
+void printInstruction(std::ostream& out, const IRValue* instr) {
+    out << "    ";
+    if (instr->type != Type::VOID) {
+        out << "%" << instr->id << " = ";
+    }
+    switch (instr->op) {
+        case IROp::PHI:
+            out << "phi " << typeToString(instr->type);
+            for (size_t i = 0; i < instr->operands.size(); ++i) {
+                out << (i ? ", [" : " [") << operandText(instr->operands[i]) << ", "
+                    << blockName(instr->block->preds[i]) << "]";
+            }
+            break;
+        case IROp::LOAD:
+            out << "load " << typeToString(instr->type) << " @" << instr->name;
+            break;
+        case IROp::STORE:
+            out << "store @" << instr->name << ", " << operandText(instr->operands[0]);
+            break;
+        case IROp::CALL:
+            out << "call ";
+            if (instr->type != Type::VOID) out << typeToString(instr->type) << " ";
+            out << instr->name << "(";
+            for (size_t i = 0; i < instr->operands.size(); ++i) {
+                out << (i ? ", " : "") << operandText(instr->operands[i]);
+            }
+            out << ")";
+            break;
+        case IROp::JUMP:
+            out << "jump " << blockName(instr->targets[0]);
+            break;
+        case IROp::BRANCH:
+            out << "branch " << operandText(instr->operands[0]) << ", " << blockName(instr->targets[0]) << ", "
+                << blockName(instr->targets[1]);
+            break;
+        case IROp::RETURN:
+            out << "return";
+            if (!instr->operands.empty()) out << " " << operandText(instr->operands[0]);
+            break;
+        default:
+            out << opName(instr->op) << (instr->speculative ? " wrap " : " ") << typeToString(instr->type);
+            for (size_t i = 0; i < instr->operands.size(); ++i) {
+                out << (i ? ", " : " ") << operandText(instr->operands[i]);
+            }
+    }
+    out << "\n";
+}
+
+} // namespace
+
+bool IRValue::isPure() const {
+    switch (op) {
+        case IROp::ADD: case IROp::SUB: case IROp::MUL: case IROp::DIV: case IROp::MOD:
+        case IROp::EQ: case IROp::NE: case IROp::LT: case IROp::GT: case IROp::LE: case IROp::GE:
+        case IROp::NEG: case IROp::NOT: case IROp::CONVERT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool IRValue::hasSideEffects() const {
+    return op == IROp::STORE || op == IROp::CALL || isTerminator();
+}
+
+void IRValue::addOperand(IRValue* value) {
+    operands.push_back(value);
+    value->users.push_back(this);
+}
+
+void IRValue::setOperand(size_t index, IRValue* value) {
+    removeUser(operands[index], this);
+    operands[index] = value;
+    value->users.push_back(this);
+}
+
+void IRValue::removeOperand(size_t index) {
+    removeUser(operands[index], this);
+    operands.erase(operands.begin() + index);
+}
+
+void IRValue::dropOperands() {
+    for (IRValue* operand : operands) {
+        removeUser(operand, this);
+    }
+    operands.clear();
+}
+
+void IRValue::replaceAllUsesWith(IRValue* value) {
+    if (value == this) return;
+    std::vector<IRValue*> old;
+    old.swap(users);
+    for (IRValue* user : old) {
+        for (auto& operand : user->operands) {
+            if (operand == this) {
+                operand = value;
+                value->users.push_back(user);
+                break; // one use per entry in `users`
+            }
+        }
+    }
+}
+
+IRValue* IRBlock::terminator() const {
+    if (instructions.empty() || !instructions.back()->isTerminator()) return nullptr;
+    return instructions.back().get();
+}
+
+std::vector<IRBlock*> IRBlock::successors() const {
+    IRValue* last = terminator();
+    return last ? last->targets : std::vector<IRBlock*>();
+}
+
+size_t IRBlock::phiCount() const {
+    size_t count = 0;
+    while (count < instructions.size() && instructions[count]->op == IROp::PHI) {
+        count++;
+    }
+    return count;
+}
+
+IRValue* IRBlock::append(std::unique_ptr<IRValue> instruction) {
+    instruction->block = this;
+    instructions.push_back(std::move(instruction));
+    return instructions.back().get();
+}
+
+IRValue* IRBlock::insertBeforeTerminator(std::unique_ptr<IRValue> instruction) {
+    instruction->block = this;
+    auto at = terminator() ? instructions.end() - 1 : instructions.end();
+    return instructions.insert(at, std::move(instruction))->get();
+}
+
+IRValue* IRBlock::insertPhi(Type type) {
+    auto phi = function->newInstruction(IROp::PHI, type);
+    phi->block = this;
+    return instructions.insert(instructions.begin() + phiCount(), std::move(phi))->get();
+}
+
+std::unique_ptr<IRValue> IRBlock::release(IRValue* instruction) {
+    for (auto it = instructions.begin(); it != instructions.end(); ++it) {
+        if (it->get() == instruction) {
+            std::unique_ptr<IRValue> owned = std::move(*it);
+            instructions.erase(it);
+            owned->block = nullptr;
+            return owned;
+        }
+    }
+    return nullptr;
+}
+
+void IRBlock::erase(IRValue* instruction) {
+    instruction->dropOperands();
+    release(instruction);
+}
+
+void IRBlock::removePredecessor(IRBlock* pred) {
+    auto it = std::find(preds.begin(), preds.end(), pred);
+    if (it == preds.end()) return;
+    size_t index = it - preds.begin();
+    preds.erase(it);
+    for (size_t i = 0; i < phiCount(); ++i) {
+        instructions[i]->removeOperand(index);
+    }
+}
+
+void IRBlock::retarget(IRBlock* from, IRBlock* to) {
+    IRValue* last = terminator();
+    for (auto& target : last->targets) {
+        if (target == from) {
+            target = to;
+            from->removePredecessor(this);
+            to->preds.push_back(this);
+        }
+    }
+}
+
+IRBlock* IRFunction::newBlock() {
+    blocks.push_back(std::make_unique<IRBlock>());
+    blocks.back()->id = nextBlock++;
+    blocks.back()->function = this;
+    return blocks.back().get();
+}
+
+std::unique_ptr<IRValue> IRFunction::newInstruction(IROp op, Type type) {
+    auto instruction = std::make_unique<IRValue>(op, type);
+    instruction->id = nextValue++;
+    return instruction;
+}
+
+IRValue* IRFunction::constant(Type type, long value) {
+    if (type == Type::BOOL) value = value != 0;
+    if (type == Type::INT) value = (int)value;
+    auto& slot = intConstants[{(int)type, value}];
+    if (!slot) {
+        slot = std::make_unique<IRValue>(IROp::CONST, type);
+        slot->intValue = value;
+    }
+    return slot.get();
+}
+
+IRValue* IRFunction::constant(Type type, double value) {
+    if (type == Type::FLOAT) value = (float)value;
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    auto& slot = realConstants[{(int)type, bits}];
+    if (!slot) {
+        slot = std::make_unique<IRValue>(IROp::CONST, type);
+        slot->realValue = value;
+    }
+    return slot.get();
+}
+
+IRValue* IRFunction::zero(Type type) {
+    return isFloating(type) ? constant(type, 0.0) : constant(type, 0L);
+}
+
+bool IRFunction::removeUnreachable() {
+    std::set<IRBlock*> reached;
+    std::vector<IRBlock*> work = {entry()};
+    reached.insert(entry());
+    while (!work.empty()) {
+        IRBlock* block = work.back();
+        work.pop_back();
+        for (IRBlock* succ : block->successors()) {
+            if (reached.insert(succ).second) work.push_back(succ);
+        }
+    }
+    if (reached.size() == blocks.size()) return false;
+
+    for (auto& block : blocks) {
+        if (reached.count(block.get())) continue;
+        for (IRBlock* succ : block->successors()) {
+            if (reached.count(succ)) succ->removePredecessor(block.get());
+        }
+    }
+    // Values of dead blocks are only used in dead blocks and in the phi
+    // operands just removed.
+    for (auto& block : blocks) {
+        if (reached.count(block.get())) continue;
+        for (auto& instr : block->instructions) {
+            instr->dropOperands();
+        }
+    }
+    for (auto& block : blocks) {
+        if (reached.count(block.get())) continue;
+        for (auto& instr : block->instructions) {
+            if (!instr->users.empty()) instr->replaceAllUsesWith(zero(instr->type));
+        }
+    }
+    blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                                [&](const std::unique_ptr<IRBlock>& block) { return !reached.count(block.get()); }),
+                 blocks.end());
+    return true;
+}
+
+void IRFunction::orderBlocks() {
+    std::vector<IRBlock*> order = reversePostorder(*this);
+    std::map<IRBlock*, size_t> position;
+    for (size_t i = 0; i < order.size(); ++i) {
+        position[order[i]] = i;
+    }
+    std::stable_sort(blocks.begin(), blocks.end(), [&](const std::unique_ptr<IRBlock>& a, const std::unique_ptr<IRBlock>& b) {
+        auto pa = position.find(a.get());
+        auto pb = position.find(b.get());
+        size_t ia = pa == position.end() ? order.size() : pa->second;
+        size_t ib = pb == position.end() ? order.size() : pb->second;
+        return ia < ib;
+    });
+}
+
+IRFunction* IRModule::find(const std::string& name) const {
+    for (const auto& function : functions) {
+        if (function->name == name) return function.get();
+    }
+    return nullptr;
+}
+
+void IRModule::remove(IRFunction* function) {
+    functions.erase(std::remove_if(functions.begin(), functions.end(),
+                                   [&](const std::unique_ptr<IRFunction>& f) { return f.get() == function; }),
+                    functions.end());
+}
+
+// Integer arithmetic is done in 32 bits, wrapping where C would overflow;
+// float arithmetic in float, as C does on x86-64.
+IRValue* foldConstant(IRFunction& function, IROp op, Type type, const std::vector<IRValue*>& operands) {
+    for (IRValue* operand : operands) {
+        if (!operand->isConstant()) return nullptr;
+    }
+    const IRValue* a = operands.empty() ? nullptr : operands[0];
+    const IRValue* b = operands.size() > 1 ? operands[1] : nullptr;
+    if (!a) return nullptr;
+    bool floating = isFloating(a->type);
+
+    switch (op) {
+        case IROp::ADD: case IROp::SUB: case IROp::MUL: case IROp::DIV: case IROp::MOD: {
+            if (type == Type::INT) {
+                int x = (int)a->intValue;
+                int y = (int)b->intValue;
+                uint32_t ux = (uint32_t)x;
+                uint32_t uy = (uint32_t)y;
+                switch (op) {
+                    case IROp::ADD: return function.constant(type, (long)(int)(ux + uy));
+                    case IROp::SUB: return function.constant(type, (long)(int)(ux - uy));
+                    case IROp::MUL: return function.constant(type, (long)(int)(ux * uy));
+                    default:
+                        if (y == 0 || (x == INT_MIN && y == -1)) return nullptr;
+                        return function.constant(type, (long)(op == IROp::DIV ? x / y : x % y));
+                }
+            }
+            double result;
+            if (type == Type::FLOAT) {
+                float x = (float)a->realValue;
+                float y = (float)b->realValue;
+                switch (op) {
+                    case IROp::ADD: result = x + y; break;
+                    case IROp::SUB: result = x - y; break;
+                    case IROp::MUL: result = x * y; break;
+                    case IROp::DIV: result = x / y; break;
+                    default: return nullptr;
+                }
+            } else if (type == Type::DOUBLE) {
+                double x = a->realValue;
+                double y = b->realValue;
+                switch (op) {
+                    case IROp::ADD: result = x + y; break;
+                    case IROp::SUB: result = x - y; break;
+                    case IROp::MUL: result = x * y; break;
+                    case IROp::DIV: result = x / y; break;
+                    default: return nullptr;
+                }
+            } else {
+                return nullptr;
+            }
+            if (!std::isfinite(result)) return nullptr;
+            return function.constant(type, result);
+        }
+        case IROp::EQ: case IROp::NE: case IROp::LT: case IROp::GT: case IROp::LE: case IROp::GE: {
+            bool result;
+            if (floating) {
+                double x = a->realValue;
+                double y = b->realValue;
+                result = op == IROp::EQ ? x == y : op == IROp::NE ? x != y : op == IROp::LT ? x < y
+                       : op == IROp::GT ? x > y : op == IROp::LE ? x <= y : x >= y;
+            } else {
+                long x = a->intValue;
+                long y = b->intValue;
+                result = op == IROp::EQ ? x == y : op == IROp::NE ? x != y : op == IROp::LT ? x < y
+                       : op == IROp::GT ? x > y : op == IROp::LE ? x <= y : x >= y;
+            }
+            return function.constant(Type::BOOL, (long)result);
+        }
+        case IROp::NEG:
+            if (type == Type::INT) return function.constant(type, (long)(int)(0u - (uint32_t)a->intValue));
+            if (type == Type::FLOAT) return function.constant(type, (double)-(float)a->realValue);
+            if (type == Type::DOUBLE) return function.constant(type, -a->realValue);
+            return nullptr;
+        case IROp::NOT:
+            return function.constant(Type::BOOL, (long)!a->intValue);
+        case IROp::CONVERT:
+            switch (type) {
+                case Type::BOOL:
+                    return function.constant(type, (long)(floating ? a->realValue != 0 : a->intValue != 0));
+                case Type::INT:
+                    if (!floating) return function.constant(type, a->intValue);
+                    if (!(a->realValue > -2147483649.0 && a->realValue < 2147483648.0)) return nullptr;
+                    return function.constant(type, (long)(int)a->realValue);
+                case Type::FLOAT:
+                    return function.constant(type, floating ? (double)(float)a->realValue : (double)(float)a->intValue);
+                case Type::DOUBLE:
+                    return function.constant(type, floating ? a->realValue : (double)a->intValue);
+                default:
+                    return nullptr;
+            }
+        default:
+            return nullptr;
+    }
+}
+
+const char* opName(IROp op) {
+    switch (op) {
+        case IROp::CONST: return "const";
+        case IROp::PARAM: return "param";
+        case IROp::PHI: return "phi";
+        case IROp::ADD: return "add";
+        case IROp::SUB: return "sub";
+        case IROp::MUL: return "mul";
+        case IROp::DIV: return "div";
+        case IROp::MOD: return "mod";
+        case IROp::EQ: return "eq";
+        case IROp::NE: return "ne";
+        case IROp::LT: return "lt";
+        case IROp::GT: return "gt";
+        case IROp::LE: return "le";
+        case IROp::GE: return "ge";
+        case IROp::NEG: return "neg";
+        case IROp::NOT: return "not";
+        case IROp::CONVERT: return "convert";
+        case IROp::LOAD: return "load";
+        case IROp::STORE: return "store";
+        case IROp::CALL: return "call";
+        case IROp::JUMP: return "jump";
+        case IROp::BRANCH: return "branch";
+        case IROp::RETURN: return "return";
+    }
+    return "?";
+}
+
+void printFunction(std::ostream& out, const IRFunction& function) {
+    out << "function " << function.name << "(";
+    for (size_t i = 0; i < function.params.size(); ++i) {
+        out << (i ? ", " : "") << typeToString(function.params[i]->type) << " %" << function.params[i]->name;
+    }
+    out << ") -> " << typeToString(function.returnType) << " {\n";
+    for (const auto& block : function.blocks) {
+        out << blockName(block.get()) << ":";
+        if (!block->preds.empty()) {
+            out << "    ; preds";
+            for (size_t i = 0; i < block->preds.size(); ++i) {
+                out << (i ? ", " : " ") << blockName(block->preds[i]);
+            }
+        }
+        out << "\n";
+        for (const auto& instr : block->instructions) {
+            printInstruction(out, instr.get());
+        }
+    }
+    out << "}\n";
+}
+
+void printModule(std::ostream& out, const IRModule& module) {
+    for (const auto& function : module.functions) {
+        printFunction(out, *function);
+        out << "\n";
+    }
+    for (const auto& skipped : module.skipped) {
+        out << "; not lowered: " << skipped << "\n";
+    }
+}
+
+std::string verifyFunction(IRFunction& function) {
+    if (function.blocks.empty()) return "no blocks";
+    if (!function.entry()->preds.empty()) return "the entry block has predecessors";
+
+    std::set<IRBlock*> blocks;
+    for (auto& block : function.blocks) {
+        blocks.insert(block.get());
+    }
+    std::map<std::pair<IRBlock*, IRBlock*>, int> edges;
+    for (auto& block : function.blocks) {
+        std::string where = blockName(block.get()) + ": ";
+        if (block->function != &function) return where + "belongs to another function";
+        if (!block->terminator()) return where + "does not end in a terminator";
+        size_t phis = block->phiCount();
+        for (size_t i = 0; i < block->instructions.size(); ++i) {
+            IRValue* instr = block->instructions[i].get();
+            std::string at = where + "%" + std::to_string(instr->id) + " (" + opName(instr->op) + ") ";
+            if (instr->block != block.get()) return at + "names another block";
+            if (instr->op == IROp::PHI && i >= phis) return at + "follows a non-phi";
+            if (instr->isTerminator() && i + 1 != block->instructions.size()) return at + "is not last";
+            if (instr->op == IROp::PHI && instr->operands.size() != block->preds.size()) {
+                return at + "has " + std::to_string(instr->operands.size()) + " operands for " +
+                       std::to_string(block->preds.size()) + " predecessors";
+            }
+            for (IRValue* operand : instr->operands) {
+                if (operand->block && !blocks.count(operand->block)) return at + "uses a deleted value";
+                if (std::count(operand->users.begin(), operand->users.end(), instr) !=
+                    std::count(instr->operands.begin(), instr->operands.end(), operand)) {
+                    return at + "is missing from the users of " + operandText(operand);
+                }
+                if (operand->type == Type::VOID) return at + "uses a value without a result";
+            }
+            switch (instr->op) {
+                case IROp::PHI:
+                    for (IRValue* operand : instr->operands) {
+                        if (operand->type != instr->type) return at + "mixes types";
+                    }
+                    break;
+                case IROp::ADD: case IROp::SUB: case IROp::MUL: case IROp::DIV: case IROp::MOD: case IROp::NEG:
+                    for (IRValue* operand : instr->operands) {
+                        if (operand->type != instr->type) return at + "mixes types";
+                    }
+                    break;
+                case IROp::EQ: case IROp::NE: case IROp::LT: case IROp::GT: case IROp::LE: case IROp::GE:
+                    if (instr->operands.size() != 2 || instr->operands[0]->type != instr->operands[1]->type) {
+                        return at + "compares different types";
+                    }
+                    break;
+                case IROp::NOT:
+                    if (instr->operands.size() != 1 || instr->operands[0]->type != Type::BOOL) return at + "needs a bool";
+                    break;
+                case IROp::BRANCH:
+                    if (instr->operands.size() != 1 || instr->operands[0]->type != Type::BOOL) return at + "needs a bool";
+                    if (instr->targets.size() != 2) return at + "needs two targets";
+                    break;
+                case IROp::JUMP:
+                    if (instr->targets.size() != 1) return at + "needs one target";
+                    break;
+                case IROp::RETURN:
+                    if (function.returnType == Type::VOID ? !instr->operands.empty()
+                                                          : instr->operands.size() != 1 ||
+                                                                instr->operands[0]->type != function.returnType) {
+                        return at + "returns the wrong type";
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        for (IRBlock* succ : block->successors()) {
+            if (!blocks.count(succ)) return where + "jumps to a deleted block";
+            edges[{block.get(), succ}]++;
+        }
+    }
+    for (auto& block : function.blocks) {
+        for (IRBlock* pred : block->preds) {
+            if (--edges[{pred, block.get()}] < 0) {
+                return blockName(block.get()) + ": lists " + blockName(pred) + " as a predecessor it is not";
+            }
+        }
+    }
+    for (const auto& edge : edges) {
+        if (edge.second != 0) {
+            return blockName(edge.first.second) + ": does not list " + blockName(edge.first.first) +
+                   " as a predecessor";
+        }
+    }
+
+    DominatorTree dominators(function);
+    for (auto& block : function.blocks) {
+        if (!dominators.reachable(block.get())) return blockName(block.get()) + ": is unreachable";
+        std::set<IRValue*> seen;
+        for (auto& instr : block->instructions) {
+            for (size_t i = 0; i < instr->operands.size(); ++i) {
+                IRValue* operand = instr->operands[i];
+                if (!operand->block) continue;
+                bool ok;
+                if (instr->op == IROp::PHI) {
+                    ok = dominators.dominates(operand->block, block->preds[i]);
+                } else if (operand->block == block.get()) {
+                    ok = seen.count(operand) != 0;
+                } else {
+                    ok = dominators.dominates(operand->block, block.get());
+                }
+                if (!ok) {
+                    return blockName(block.get()) + ": %" + std::to_string(instr->id) +
+                           " is not dominated by its operand " + operandText(operand);
+                }
+            }
+            seen.insert(instr.get());
+        }
+    }
+    return "";
+}
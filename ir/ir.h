@@ -0,0 +1,142 @@
+#ifndef IR_H
+#define IR_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "../ast/ast.h"
+
+// Typed SSA form of the scalar functions of a program, for optimizations
+// that need control flow. IRBuilder lowers functions from the AST, the
+// passes in passes.h rewrite them and CodeGenerator writes their C.
+//
+// A function is a list of basic blocks, entry first. A block holds its phis,
+// then ordinary instructions, then exactly one terminator. Constants and
+// parameters belong to the function and sit in no block. Every value keeps
+// its users, so replacing one is cheap; operands must only be changed
+// through the methods below, which keep the use lists in step.
+
+enum class IROp {
+    CONST, PARAM,
+    PHI,
+    ADD, SUB, MUL, DIV, MOD,
+    EQ, NE, LT, GT, LE, GE, // result BOOL, operands of the same type
+    NEG, NOT,
+    CONVERT,
+    LOAD,  // global variable `name`
+    STORE, // global variable `name` = operand 0
+    CALL,  // function or runtime built-in `name`
+    JUMP, BRANCH, RETURN
+};
+
+struct IRBlock;
+struct IRFunction;
+
+struct IRValue {
+    IROp op;
+    Type type;           // INT, BOOL, FLOAT, DOUBLE, or VOID without a result
+    int id = 0;          // unique in its function
+    std::vector<IRValue*> operands; // of a phi: one per predecessor, in order
+    std::vector<IRValue*> users;    // one entry per use
+    std::vector<IRBlock*> targets;  // JUMP: one; BRANCH: taken when true, then false
+    IRBlock* block = nullptr;       // null for constants and parameters
+    std::string name;
+    long intValue = 0;   // INT and BOOL constants
+    double realValue = 0; // FLOAT and DOUBLE constants
+    // Integer arithmetic LICM moved to where the source may not have run
+    // it: overflow has to wrap there instead of being undefined.
+    bool speculative = false;
+
+    IRValue(IROp op, Type type) : op(op), type(type) {}
+
+    bool isTerminator() const { return op == IROp::JUMP || op == IROp::BRANCH || op == IROp::RETURN; }
+    bool isConstant() const { return op == IROp::CONST; }
+    // No effect beyond its result, which depends on the operands alone.
+    bool isPure() const;
+    // Kept even when the result is unused.
+    bool hasSideEffects() const;
+
+    void addOperand(IRValue* value);
+    void setOperand(size_t index, IRValue* value);
+    void removeOperand(size_t index);
+    void dropOperands();
+    void replaceAllUsesWith(IRValue* value);
+};
+
+struct IRBlock {
+    int id = 0;
+    IRFunction* function = nullptr;
+    std::vector<std::unique_ptr<IRValue>> instructions;
+    std::vector<IRBlock*> preds; // a block reached twice from one branch is listed twice
+
+    IRValue* terminator() const;
+    std::vector<IRBlock*> successors() const;
+    size_t phiCount() const;
+
+    IRValue* append(std::unique_ptr<IRValue> instruction);
+    IRValue* insertBeforeTerminator(std::unique_ptr<IRValue> instruction);
+    IRValue* insertPhi(Type type);
+    // Takes an instruction out, keeping its operands and users.
+    std::unique_ptr<IRValue> release(IRValue* instruction);
+    // Deletes an instruction nothing uses any more.
+    void erase(IRValue* instruction);
+
+    // Drops the first edge from pred and the matching phi operands.
+    void removePredecessor(IRBlock* pred);
+    // Points the terminator's edges to `from` at `to` instead. The edges
+    // leave `from` as with removePredecessor; the caller gives the phis of
+    // `to` their operands for the new ones.
+    void retarget(IRBlock* from, IRBlock* to);
+};
+
+struct IRFunction {
+    std::string name;
+    Type returnType = Type::VOID;
+    FunctionNode* source = nullptr;
+    std::vector<std::unique_ptr<IRValue>> params;
+    std::vector<std::unique_ptr<IRBlock>> blocks; // entry first
+    int nextValue = 1;
+    int nextBlock = 0;
+
+    IRBlock* entry() const { return blocks.front().get(); }
+    IRBlock* newBlock();
+    std::unique_ptr<IRValue> newInstruction(IROp op, Type type);
+    IRValue* constant(Type type, long value);
+    IRValue* constant(Type type, double value);
+    IRValue* zero(Type type);
+
+    // Deletes the blocks the entry no longer reaches. Returns whether any were.
+    bool removeUnreachable();
+    // Puts the blocks in reverse postorder, which dumps and C read best in.
+    void orderBlocks();
+
+private:
+    std::map<std::pair<int, long>, std::unique_ptr<IRValue>> intConstants;
+    std::map<std::pair<int, uint64_t>, std::unique_ptr<IRValue>> realConstants; // by bits: 0.0 is not -0.0
+};
+
+struct IRModule {
+    std::vector<std::unique_ptr<IRFunction>> functions;
+    std::vector<std::string> skipped; // "name: reason" for functions left to the AST
+
+    IRFunction* find(const std::string& name) const;
+    void remove(IRFunction* function);
+};
+
+// The constant an instruction over constant operands computes, or null
+// when C leaves the result undefined (division by zero, overflowing
+// conversions) or it is not finite.
+IRValue* foldConstant(IRFunction& function, IROp op, Type type, const std::vector<IRValue*>& operands);
+
+const char* opName(IROp op);
+void printFunction(std::ostream& out, const IRFunction& function);
+void printModule(std::ostream& out, const IRModule& module);
+
+// Checks the invariants above and that definitions dominate their uses.
+// Returns the first problem found, or an empty string.
+std::string verifyFunction(IRFunction& function);
+
+#endif // IR_H
@@ -0,0 +1,157 @@
+#include "analysis.h"
+#include "passes.h"
+#include <algorithm>
+#include <map>
+
+namespace {
+
+// Loop-invariant code motion. Every loop first gets a preheader: a block
+// that only jumps to the header and is its one predecessor from outside.
+// Then, innermost loops first, pure instructions whose operands all come
+// from outside the loop move to the end of the preheader. One that runs on
+// every trip through the loop moves as it is. One that might not run (in
+// an if inside the loop) moves only if running it anyway cannot trap or
+// overflow into undefined behaviour: int add, sub, mul and neg are marked
+// to wrap, division needs a constant divisor other than 0 and -1, and
+// float to int conversions stay.
+class LICMPass : public IRPass {
+private:
+    static bool insertPreheaders(IRFunction& function);
+    static bool safeToSpeculate(const IRValue* instr);
+
+public:
+    const char* name() const override { return "licm"; }
+    bool run(IRFunction& function) override;
+};
+
+bool LICMPass::insertPreheaders(IRFunction& function) {
+    DominatorTree dominators(function);
+    std::vector<std::unique_ptr<IRLoop>> loops = findLoops(function, dominators);
+    bool changed = false;
+    for (auto& loop : loops) {
+        IRBlock* header = loop->header;
+        std::vector<size_t> outside;
+        for (size_t i = 0; i < header->preds.size(); ++i) {
+            if (!loop->contains(header->preds[i])) outside.push_back(i);
+        }
+        if (outside.empty() || (outside.size() == 1 && header->preds[outside[0]]->terminator()->op == IROp::JUMP)) {
+            continue;
+        }
+
+        // What each phi of the header takes from each edge entering the loop.
+        std::map<IRBlock*, std::vector<std::vector<IRValue*>>> incoming;
+        std::vector<IRBlock*> order;
+        for (size_t i : outside) {
+            IRBlock* pred = header->preds[i];
+            if (!incoming.count(pred)) order.push_back(pred);
+            std::vector<IRValue*> values;
+            for (size_t p = 0; p < header->phiCount(); ++p) {
+                values.push_back(header->instructions[p]->operands[i]);
+            }
+            incoming[pred].push_back(values);
+        }
+
+        IRBlock* preheader = function.newBlock();
+        for (IRBlock* pred : order) {
+            pred->retarget(header, preheader);
+        }
+        auto jump = function.newInstruction(IROp::JUMP, Type::VOID);
+        jump->targets = {header};
+        preheader->append(std::move(jump));
+        header->preds.push_back(preheader);
+
+        std::map<IRBlock*, size_t> taken;
+        for (size_t p = 0; p < header->phiCount(); ++p) {
+            IRValue* phi = header->instructions[p].get();
+            IRValue* same = nullptr;
+            bool differ = false;
+            for (IRBlock* pred : order) {
+                for (const auto& values : incoming[pred]) {
+                    if (same && values[p] != same) differ = true;
+                    same = values[p];
+                }
+            }
+            if (differ) {
+                IRValue* merged = preheader->insertPhi(phi->type);
+                taken.clear();
+                for (IRBlock* pred : preheader->preds) {
+                    merged->addOperand(incoming[pred][taken[pred]++][p]);
+                }
+                same = merged;
+            }
+            phi->addOperand(same);
+        }
+        changed = true;
+    }
+    return changed;
+}
+
+bool LICMPass::safeToSpeculate(const IRValue* instr) {
+    switch (instr->op) {
+        case IROp::DIV:
+        case IROp::MOD: {
+            if (instr->type == Type::FLOAT || instr->type == Type::DOUBLE) return true;
+            const IRValue* divisor = instr->operands[1];
+            return divisor->isConstant() && divisor->intValue != 0 && divisor->intValue != -1;
+        }
+        case IROp::CONVERT: {
+            Type from = instr->operands[0]->type;
+            return !(instr->type == Type::INT && (from == Type::FLOAT || from == Type::DOUBLE));
+        }
+        default:
+            return true;
+    }
+}
+
+bool LICMPass::run(IRFunction& function) {
+    bool changed = insertPreheaders(function);
+    DominatorTree dominators(function);
+    std::vector<std::unique_ptr<IRLoop>> loops = findLoops(function, dominators);
+    for (auto& loop : loops) {
+        IRBlock* preheader = nullptr;
+        for (IRBlock* pred : loop->header->preds) {
+            if (!loop->contains(pred)) preheader = pred;
+        }
+        if (!preheader) continue;
+        std::vector<IRBlock*> exiting;
+        for (IRBlock* block : loop->blocks) {
+            for (IRBlock* succ : block->successors()) {
+                if (!loop->contains(succ)) {
+                    exiting.push_back(block);
+                    break;
+                }
+            }
+        }
+
+        for (IRBlock* block : dominators.order()) {
+            if (!loop->contains(block)) continue;
+            bool everyTrip = !exiting.empty() && std::all_of(exiting.begin(), exiting.end(), [&](IRBlock* exit) {
+                return dominators.dominates(block, exit);
+            });
+            for (size_t i = 0; i < block->instructions.size();) {
+                IRValue* instr = block->instructions[i].get();
+                bool invariant = instr->isPure() && std::none_of(instr->operands.begin(), instr->operands.end(),
+                                                                 [&](IRValue* operand) {
+                                                                     return operand->block && loop->contains(operand->block);
+                                                                 });
+                if (!invariant || (!everyTrip && !safeToSpeculate(instr))) {
+                    ++i;
+                    continue;
+                }
+                if (!everyTrip && instr->type == Type::INT &&
+                    (instr->op == IROp::ADD || instr->op == IROp::SUB || instr->op == IROp::MUL || instr->op == IROp::NEG)) {
+                    instr->speculative = true;
+                }
+                preheader->insertBeforeTerminator(block->release(instr));
+                changed = true;
+            }
+        }
+    }
+    return changed;
+}
+
+} // namespace
+
+std::unique_ptr<IRPass> createLICMPass() {
+    return std::make_unique<LICMPass>();
+}
@@ -0,0 +1,315 @@
+#include "passes.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+const char* const DEFAULT_PIPELINE = "simplify,sccp,gvn,licm,dce,simplify";
+
+namespace {
+
+const char* const PASS_NAMES = "simplify, sccp, gvn, licm, dce";
+
+// Folds branches that always go one way or both ways to one block, removes
+// phis with a single value and the blocks nothing reaches, merges a block
+// into its only predecessor, and skips blocks that only jump on.
+class SimplifyPass : public IRPass {
+private:
+    static bool foldBranches(IRFunction& function);
+    static bool removeTrivialPhis(IRFunction& function);
+    static bool mergeBlocks(IRFunction& function);
+    static bool forwardEmptyBlocks(IRFunction& function);
+
+public:
+    const char* name() const override { return "simplify"; }
+    bool run(IRFunction& function) override;
+};
+
+// Whether each phi of `block` takes the same value from every edge out of pred.
+bool sameFromEachEdge(IRBlock* block, IRBlock* pred) {
+    for (size_t p = 0; p < block->phiCount(); ++p) {
+        IRValue* phi = block->instructions[p].get();
+        IRValue* value = nullptr;
+        for (size_t i = 0; i < block->preds.size(); ++i) {
+            if (block->preds[i] != pred) continue;
+            if (value && phi->operands[i] != value) return false;
+            value = phi->operands[i];
+        }
+    }
+    return true;
+}
+
+void makeJump(IRValue* terminator, IRBlock* target) {
+    terminator->dropOperands();
+    terminator->op = IROp::JUMP;
+    terminator->targets = {target};
+}
+
+bool SimplifyPass::foldBranches(IRFunction& function) {
+    bool changed = false;
+    for (auto& block : function.blocks) {
+        IRValue* last = block->terminator();
+        if (last->op != IROp::BRANCH) continue;
+        IRValue* condition = last->operands[0];
+        if (condition->isConstant()) {
+            IRBlock* keep = last->targets[condition->intValue ? 0 : 1];
+            IRBlock* drop = last->targets[condition->intValue ? 1 : 0];
+            drop->removePredecessor(block.get());
+            makeJump(last, keep);
+            changed = true;
+        } else if (last->targets[0] == last->targets[1] && sameFromEachEdge(last->targets[0], block.get())) {
+            last->targets[0]->removePredecessor(block.get());
+            makeJump(last, last->targets[0]);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+bool SimplifyPass::removeTrivialPhis(IRFunction& function) {
+    bool changed = false;
+    bool again = true;
+    while (again) {
+        again = false;
+        for (auto& block : function.blocks) {
+            for (size_t i = 0; i < block->phiCount();) {
+                IRValue* phi = block->instructions[i].get();
+                IRValue* same = nullptr;
+                bool trivial = true;
+                for (IRValue* operand : phi->operands) {
+                    if (operand == phi || operand == same) continue;
+                    if (same) {
+                        trivial = false;
+                        break;
+                    }
+                    same = operand;
+                }
+                if (!trivial || !same) {
+                    ++i;
+                    continue;
+                }
+                phi->replaceAllUsesWith(same);
+                block->erase(phi);
+                changed = again = true;
+            }
+        }
+    }
+    return changed;
+}
+
+bool SimplifyPass::mergeBlocks(IRFunction& function) {
+    bool changed = false;
+    for (size_t b = 0; b < function.blocks.size(); ++b) {
+        IRBlock* block = function.blocks[b].get();
+        for (;;) {
+            IRValue* last = block->terminator();
+            if (last->op != IROp::JUMP) break;
+            IRBlock* next = last->targets[0];
+            if (next == block || next == function.entry() || next->preds.size() != 1) break;
+
+            // Single predecessor: its phis, if any are left, have one operand.
+            while (next->phiCount() > 0) {
+                IRValue* phi = next->instructions[0].get();
+                phi->replaceAllUsesWith(phi->operands[0]);
+                next->erase(phi);
+            }
+            block->erase(last);
+            while (!next->instructions.empty()) {
+                block->append(next->release(next->instructions.front().get()));
+            }
+            for (IRBlock* succ : block->successors()) {
+                std::replace(succ->preds.begin(), succ->preds.end(), next, block);
+            }
+            next->preds.clear();
+            function.blocks.erase(std::find_if(function.blocks.begin(), function.blocks.end(),
+                                               [&](const std::unique_ptr<IRBlock>& other) { return other.get() == next; }));
+            if (function.blocks[b].get() != block) {
+                b = std::find_if(function.blocks.begin(), function.blocks.end(),
+                                 [&](const std::unique_ptr<IRBlock>& other) { return other.get() == block; }) -
+                    function.blocks.begin();
+            }
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// A block holding only a jump hands its predecessors to its target. The
+// target's phis take, from each of them, what they took from the block.
+bool SimplifyPass::forwardEmptyBlocks(IRFunction& function) {
+    bool changed = false;
+    for (auto& owned : function.blocks) {
+        IRBlock* block = owned.get();
+        if (block == function.entry() || block->instructions.size() != 1 || block->preds.empty()) continue;
+        IRValue* last = block->terminator();
+        if (last->op != IROp::JUMP) continue;
+        IRBlock* target = last->targets[0];
+        if (target == block) continue;
+
+        bool clash = false;
+        for (IRBlock* pred : block->preds) {
+            if (target->phiCount() > 0 && std::count(target->preds.begin(), target->preds.end(), pred)) clash = true;
+        }
+        if (clash) continue;
+
+        size_t index = std::find(target->preds.begin(), target->preds.end(), block) - target->preds.begin();
+        std::vector<IRValue*> values;
+        for (size_t p = 0; p < target->phiCount(); ++p) {
+            values.push_back(target->instructions[p]->operands[index]);
+        }
+        std::vector<IRBlock*> preds = block->preds;
+        std::set<IRBlock*> done;
+        for (IRBlock* pred : preds) {
+            if (!done.insert(pred).second) continue;
+            size_t before = target->preds.size();
+            pred->retarget(block, target);
+            for (size_t added = before; added < target->preds.size(); ++added) {
+                for (size_t p = 0; p < values.size(); ++p) {
+                    target->instructions[p]->addOperand(values[p]);
+                }
+            }
+        }
+        changed = true; // the block is left unreachable
+    }
+    return changed;
+}
+
+bool SimplifyPass::run(IRFunction& function) {
+    bool changed = false;
+    bool again = true;
+    while (again) {
+        again = foldBranches(function);
+        again = function.removeUnreachable() || again;
+        again = removeTrivialPhis(function) || again;
+        again = mergeBlocks(function) || again;
+        again = forwardEmptyBlocks(function) || again;
+        again = function.removeUnreachable() || again;
+        changed = changed || again;
+    }
+    return changed;
+}
+
+// Keeps what has side effects and what that uses, transitively; everything
+// else goes, including phis that only feed each other.
+class DCEPass : public IRPass {
+public:
+    const char* name() const override { return "dce"; }
+
+    bool run(IRFunction& function) override {
+        std::set<IRValue*> live;
+        std::vector<IRValue*> work;
+        for (auto& block : function.blocks) {
+            for (auto& instr : block->instructions) {
+                if (instr->hasSideEffects() && live.insert(instr.get()).second) work.push_back(instr.get());
+            }
+        }
+        while (!work.empty()) {
+            IRValue* instr = work.back();
+            work.pop_back();
+            for (IRValue* operand : instr->operands) {
+                if (operand->block && live.insert(operand).second) work.push_back(operand);
+            }
+        }
+
+        std::vector<IRValue*> dead;
+        for (auto& block : function.blocks) {
+            for (auto& instr : block->instructions) {
+                if (!live.count(instr.get())) dead.push_back(instr.get());
+            }
+        }
+        for (IRValue* instr : dead) {
+            instr->dropOperands();
+        }
+        for (IRValue* instr : dead) {
+            instr->block->release(instr);
+        }
+        return !dead.empty();
+    }
+};
+
+} // namespace
+
+std::unique_ptr<IRPass> createSimplifyPass() {
+    return std::make_unique<SimplifyPass>();
+}
+
+std::unique_ptr<IRPass> createDCEPass() {
+    return std::make_unique<DCEPass>();
+}
+
+std::unique_ptr<IRPass> createPass(const std::string& name) {
+    if (name == "simplify") return createSimplifyPass();
+    if (name == "sccp") return createSCCPPass();
+    if (name == "gvn") return createGVNPass();
+    if (name == "licm") return createLICMPass();
+    if (name == "dce") return createDCEPass();
+    return nullptr;
+}
+
+bool PassManager::add(const std::string& pipeline, std::string& error) {
+    std::stringstream names(pipeline);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        if (name.empty()) continue;
+        std::unique_ptr<IRPass> pass = createPass(name);
+        if (!pass) {
+            error = "unknown pass '" + name + "' (passes: " + PASS_NAMES + ")";
+            return false;
+        }
+        passes.push_back({std::move(pass)});
+    }
+    return true;
+}
+
+void PassManager::run(IRModule& module) {
+    std::vector<IRFunction*> functions;
+    for (auto& function : module.functions) {
+        functions.push_back(function.get());
+    }
+    for (IRFunction* function : functions) {
+        std::string problem = verifyFunction(*function);
+        const char* stage = "lowering";
+        if (problem.empty() && dump) {
+            *dump << "; " << function->name << " after lowering\n";
+            printFunction(*dump, *function);
+            *dump << "\n";
+        }
+        for (auto& entry : passes) {
+            if (!problem.empty()) break;
+            auto start = std::chrono::steady_clock::now();
+            bool changed = entry.pass->run(*function);
+            if (changed) {
+                function->orderBlocks();
+            }
+            entry.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (!changed) continue;
+            entry.changed++;
+            stage = entry.pass->name();
+            problem = verifyFunction(*function);
+            if (problem.empty() && dump) {
+                *dump << "; " << function->name << " after " << stage << "\n";
+                printFunction(*dump, *function);
+                *dump << "\n";
+            }
+        }
+        if (!problem.empty()) {
+            std::cerr << "warning: invalid IR for '" << function->name << "' after " << stage << ": " << problem
+                      << "; compiling it from the AST" << std::endl;
+            module.remove(function);
+        }
+    }
+}
+
+void PassManager::printTiming(std::ostream& out) const {
+    double total = 0;
+    out << "IR pass     time (ms)  functions changed" << std::endl;
+    for (const auto& entry : passes) {
+        out << std::left << std::setw(10) << entry.pass->name() << std::right << std::setw(11) << std::fixed
+            << std::setprecision(3) << entry.seconds * 1000 << std::setw(19) << entry.changed << std::endl;
+        total += entry.seconds;
+    }
+    out << std::left << std::setw(10) << "total" << std::right << std::setw(11) << std::fixed << std::setprecision(3)
+        << total * 1000 << std::endl;
+}
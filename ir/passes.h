@@ -0,0 +1,59 @@
+#ifndef IR_PASSES_H
+#define IR_PASSES_H
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "ir.h"
+
+// A transformation of one function. run returns whether it changed it.
+class IRPass {
+public:
+    virtual ~IRPass() = default;
+    virtual const char* name() const = 0;
+    virtual bool run(IRFunction& function) = 0;
+};
+
+std::unique_ptr<IRPass> createSimplifyPass(); // folds branches, drops dead blocks, merges straight lines
+std::unique_ptr<IRPass> createSCCPPass();     // sparse conditional constant propagation
+std::unique_ptr<IRPass> createGVNPass();      // global value numbering over the dominator tree
+std::unique_ptr<IRPass> createLICMPass();     // loop-invariant code motion into preheaders
+std::unique_ptr<IRPass> createDCEPass();      // dead-code elimination
+
+// By name, as given to --passes; null for an unknown name.
+std::unique_ptr<IRPass> createPass(const std::string& name);
+
+// What slc --ir runs.
+extern const char* const DEFAULT_PIPELINE;
+
+// Runs passes in order over every function of a module. The IR is checked
+// after each pass; a function a pass leaves broken is dropped from the
+// module with a warning and compiled from the AST instead.
+class PassManager {
+private:
+    struct Entry {
+        std::unique_ptr<IRPass> pass;
+        double seconds = 0;
+        int changed = 0; // functions the pass changed
+    };
+
+    std::vector<Entry> passes;
+    std::ostream* dump = nullptr;
+
+public:
+    // Adds the comma-separated passes of `pipeline`. Returns false and sets
+    // `error` for an unknown name.
+    bool add(const std::string& pipeline, std::string& error);
+
+    // Prints every function after lowering and again after each pass that
+    // changed it.
+    void setDump(std::ostream* out) { dump = out; }
+
+    void run(IRModule& module);
+
+    // Time spent and functions changed, per pass in pipeline order.
+    void printTiming(std::ostream& out) const;
+};
+
+#endif // IR_PASSES_H
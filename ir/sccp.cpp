@@ -0,0 +1,172 @@
+#include "passes.h"
+#include <set>
+#include <unordered_map>
+
+namespace {
+
+// Sparse conditional constant propagation (Wegman and Zadeck, "Constant
+// Propagation with Conditional Branches"). Values start unknown and only
+// rise, to a constant and then to varying; a block counts only once an
+// executable edge reaches it, so a phi ignores what comes from branches
+// that never run and a constant condition keeps its dead side out.
+class SCCPPass : public IRPass {
+private:
+    enum class Level { UNKNOWN, CONSTANT, VARYING };
+
+    struct State {
+        Level level = Level::UNKNOWN;
+        IRValue* constant = nullptr;
+    };
+
+    std::unordered_map<IRValue*, State> states;
+    std::set<IRBlock*> executable;
+    std::set<std::pair<IRBlock*, IRBlock*>> edges;
+    std::vector<std::pair<IRBlock*, IRBlock*>> edgeWork;
+    std::vector<IRValue*> valueWork;
+    IRFunction* function;
+
+    State stateOf(IRValue* value) {
+        if (value->isConstant()) return {Level::CONSTANT, value};
+        if (value->op == IROp::PARAM) return {Level::VARYING, nullptr};
+        return states[value];
+    }
+
+    void update(IRValue* instr, State state) {
+        State& old = states[instr];
+        if (old.level == state.level && old.constant == state.constant) return;
+        old = state;
+        for (IRValue* user : instr->users) {
+            if (executable.count(user->block)) valueWork.push_back(user);
+        }
+    }
+
+    void markEdge(IRBlock* from, IRBlock* to) {
+        if (edges.insert({from, to}).second) edgeWork.push_back({from, to});
+    }
+
+    void visitPhi(IRValue* phi) {
+        State result;
+        for (size_t i = 0; i < phi->operands.size(); ++i) {
+            if (!edges.count({phi->block->preds[i], phi->block})) continue;
+            State state = stateOf(phi->operands[i]);
+            if (state.level == Level::UNKNOWN) continue;
+            if (state.level == Level::VARYING || (result.level == Level::CONSTANT && result.constant != state.constant)) {
+                result = {Level::VARYING, nullptr};
+                break;
+            }
+            result = state;
+        }
+        update(phi, result);
+    }
+
+    void visit(IRValue* instr) {
+        switch (instr->op) {
+            case IROp::PHI:
+                visitPhi(instr);
+                return;
+            case IROp::JUMP:
+                markEdge(instr->block, instr->targets[0]);
+                return;
+            case IROp::BRANCH: {
+                State state = stateOf(instr->operands[0]);
+                if (state.level == Level::CONSTANT) {
+                    markEdge(instr->block, instr->targets[state.constant->intValue ? 0 : 1]);
+                } else if (state.level == Level::VARYING) {
+                    markEdge(instr->block, instr->targets[0]);
+                    markEdge(instr->block, instr->targets[1]);
+                }
+                return;
+            }
+            case IROp::LOAD:
+            case IROp::CALL:
+                update(instr, {Level::VARYING, nullptr});
+                return;
+            default:
+                break;
+        }
+        if (!instr->isPure()) return;
+
+        std::vector<IRValue*> constants;
+        for (IRValue* operand : instr->operands) {
+            State state = stateOf(operand);
+            if (state.level == Level::UNKNOWN) return;
+            if (state.level == Level::VARYING) {
+                update(instr, {Level::VARYING, nullptr});
+                return;
+            }
+            constants.push_back(state.constant);
+        }
+        IRValue* folded = foldConstant(*function, instr->op, instr->type, constants);
+        update(instr, folded ? State{Level::CONSTANT, folded} : State{Level::VARYING, nullptr});
+    }
+
+    bool rewrite() {
+        bool changed = false;
+        for (auto& block : function->blocks) {
+            if (!executable.count(block.get())) continue;
+            std::vector<IRValue*> instructions;
+            for (auto& instr : block->instructions) {
+                instructions.push_back(instr.get());
+            }
+            for (IRValue* instr : instructions) {
+                auto found = states.find(instr);
+                if (found == states.end() || found->second.level != Level::CONSTANT) continue;
+                instr->replaceAllUsesWith(found->second.constant);
+                block->erase(instr);
+                changed = true;
+            }
+            IRValue* last = block->terminator();
+            if (last->op == IROp::BRANCH && last->operands[0]->isConstant() && last->targets[0] != last->targets[1]) {
+                bool taken = last->operands[0]->intValue != 0;
+                last->targets[taken ? 1 : 0]->removePredecessor(block.get());
+                IRBlock* target = last->targets[taken ? 0 : 1];
+                last->dropOperands();
+                last->op = IROp::JUMP;
+                last->targets = {target};
+                changed = true;
+            }
+        }
+        return function->removeUnreachable() || changed;
+    }
+
+public:
+    const char* name() const override { return "sccp"; }
+
+    bool run(IRFunction& target) override {
+        function = &target;
+        states.clear();
+        executable.clear();
+        edges.clear();
+        edgeWork.clear();
+        valueWork.clear();
+
+        edgeWork.push_back({nullptr, function->entry()});
+        while (!edgeWork.empty() || !valueWork.empty()) {
+            while (!edgeWork.empty()) {
+                IRBlock* block = edgeWork.back().second;
+                edgeWork.pop_back();
+                if (executable.insert(block).second) {
+                    for (auto& instr : block->instructions) {
+                        visit(instr.get());
+                    }
+                } else {
+                    for (size_t i = 0; i < block->phiCount(); ++i) {
+                        visitPhi(block->instructions[i].get());
+                    }
+                }
+            }
+            while (!valueWork.empty()) {
+                IRValue* instr = valueWork.back();
+                valueWork.pop_back();
+                if (executable.count(instr->block)) visit(instr);
+            }
+        }
+        return rewrite();
+    }
+};
+
+} // namespace
+
+std::unique_ptr<IRPass> createSCCPPass() {
+    return std::make_unique<SCCPPass>();
+}
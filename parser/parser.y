@@ -6,16 +6,30 @@
     #include <vector>
     #include <fstream>
     #include <unistd.h>
+    #include <sys/wait.h>
     #include <cstdlib>
     #include <cstring>
+    #include <cerrno>
+    #include <climits>
     #include "../ast/ast.h"
     #include "../semantic/semantic.h"
+    #include "../semantic/escape.h"
+    #include "../semantic/range.h"
     #include "../codegen/codegen.h"
+    #include "../ir/builder.h"
+    #include "../ir/passes.h"
+    #include "../vm/compiler.h"
+    #include "../vm/vm.h"
+    #include "../asm/x86.h"
+    #include "../repl/repl.h"
     
     extern int yylex();
     extern int yyparse();
     extern FILE* yyin;
     extern int yylineno;
+    typedef struct yy_buffer_state* YY_BUFFER_STATE;
+    extern YY_BUFFER_STATE yy_scan_string(const char* text);
+    extern void yy_delete_buffer(YY_BUFFER_STATE buffer);
 
     std::unique_ptr<ProgramNode> programRoot;
     
@@ -23,8 +37,71 @@
         std::cerr << "Syntax error at line " << yylineno << ": " << s << std::endl;
     }
     
+    // Any type name that is not built in refers to a class; semantic
+    // analysis reports the ones that are never declared.
     Type parseType(const char* typeStr) {
-        return stringToType(typeStr);
+        size_t length = strlen(typeStr);
+        if (strncmp(typeStr, "map<", 4) == 0) {
+            return Type::MAP;
+        }
+        if (length > 2 && strcmp(typeStr + length - 2, "[]") == 0) {
+            return Type::ARRAY;
+        }
+        if (length > 3 && strcmp(typeStr + length - 3, "[:]") == 0) {
+            return Type::SLICE;
+        }
+        Type type = stringToType(typeStr);
+        if (type == Type::VOID && strcmp(typeStr, "void") != 0) {
+            return Type::CLASS;
+        }
+        return type;
+    }
+
+    // Class instances carry their class name, growable arrays and slices
+    // their element type name, maps "key,value".
+    std::string parseClassName(const char* typeStr) {
+        Type type = parseType(typeStr);
+        if (type == Type::MAP) {
+            return std::string(typeStr + 4, strlen(typeStr) - 5);
+        }
+        if (type == Type::ARRAY) {
+            return std::string(typeStr, strlen(typeStr) - 2);
+        }
+        if (type == Type::SLICE) {
+            return std::string(typeStr, strlen(typeStr) - 3);
+        }
+        return type == Type::CLASS ? typeStr : "";
+    }
+
+    struct ParamList {
+        std::vector<std::pair<std::string, Type>> params;
+        std::vector<std::string> classes;
+    };
+
+    struct ClassBody {
+        ConstructorNode* constructor = nullptr;
+        std::vector<MethodNode*> methods;
+        std::vector<FieldDecl> fields;
+    };
+
+    ClassNode* buildClass(char* name, void* members, bool isValue) {
+        auto* cls = new ClassNode();
+        cls->line = yylineno;
+        cls->name = name;
+        cls->isValue = isValue;
+        if (members) {
+            auto* body = static_cast<ClassBody*>(members);
+            if (body->constructor) {
+                cls->constructor = std::unique_ptr<ConstructorNode>(body->constructor);
+            }
+            for (auto* method : body->methods) {
+                cls->methods.push_back(std::unique_ptr<MethodNode>(method));
+            }
+            cls->fields = body->fields;
+            delete body;
+        }
+        free(name);
+        return cls;
     }
 %}
 
@@ -48,14 +125,19 @@
     void* method_def;
     void* constructor_def;
     void* class_body;
+    void* annotation_list;
+    void* reduction_list;
 }
 
-%token <str> DIRECTIVE
-%token RETURN FUNCTION IF ELSE WHILE DO FOR
-%token CLASS PRIVATE PUBLIC TEMPLATE
+%token <str> DIRECTIVE ANNOTATION
+%token RETURN FUNCTION IF ELSE DO
+%token <int_val> WHILE FOR
+%token CLASS STRUCT MAP PRIVATE PUBLIC TEMPLATE
 %token BREAK CONTINUE SWITCH CASE DEFAULT
 %token CONST
-%token <int_val> INTEGER
+%token PARALLEL REDUCE
+%token SPAWN SYNC
+%token <str> INTEGER
 %token <double_val> DOUBLE
 %token <float_val> FLOAT
 %token <bool_val> BOOLEAN
@@ -70,6 +152,7 @@
 %token ARROW
 %token LBRACKET RBRACKET
 %token COLON QUESTION
+%token DOT
 
 %type <node> top_level_item directive program
 %type <func> function_def
@@ -79,9 +162,13 @@
 %type <constructor_def> constructor_def
 %type <str> access_specifier
 %type <class_body> class_body
-%type <node> class_members class_member
+%type <node> class_members class_member field_def
 %type <block> function_body block
 %type <stmt> statement return_stmt var_decl var_assign inc_dec_stmt if_stmt while_stmt do_while_stmt for_stmt switch_stmt break_stmt continue_stmt
+%type <stmt> annotated_loop parallel_for_stmt spawn_stmt sync_stmt
+%type <reduction_list> reduce_clause reduce_vars
+%type <int_val> reduce_op
+%type <annotation_list> loop_annotations
 %type <block> default_case
 %type <expr> expression
 %type <param_list> param_list
@@ -100,6 +187,7 @@
 %right ARROW
 %right QUESTION
 %left COLON
+%left DOT
 
 %%
 
@@ -189,6 +277,39 @@ directive:
 
 type_spec:
     TYPE { $$ = $1; }
+    | VAR { $$ = $1; }
+    | TYPE LBRACKET RBRACKET
+    {
+        $$ = strdup((std::string($1) + "[]").c_str());
+        free($1);
+    }
+    | VAR LBRACKET RBRACKET
+    {
+        $$ = strdup((std::string($1) + "[]").c_str());
+        free($1);
+    }
+    | TYPE LBRACKET COLON RBRACKET
+    {
+        $$ = strdup((std::string($1) + "[:]").c_str());
+        free($1);
+    }
+    | VAR LBRACKET COLON RBRACKET
+    {
+        $$ = strdup((std::string($1) + "[:]").c_str());
+        free($1);
+    }
+    | MAP LT TYPE COMMA TYPE GT
+    {
+        $$ = strdup(("map<" + std::string($3) + "," + $5 + ">").c_str());
+        free($3);
+        free($5);
+    }
+    | MAP LT TYPE COMMA VAR GT
+    {
+        $$ = strdup(("map<" + std::string($3) + "," + $5 + ">").c_str());
+        free($3);
+        free($5);
+    }
     ;
 
 function_def:
@@ -198,9 +319,11 @@ function_def:
         func->line = yylineno;
         func->name = $2;
         func->returnType = parseType($7);
+        func->returnClass = parseClassName($7);
         if ($4) {
-            auto* list = static_cast<std::vector<std::pair<std::string, Type>>*>($4);
-            func->parameters = *list;
+            auto* list = static_cast<ParamList*>($4);
+            func->parameters = list->params;
+            func->parameterClasses = list->classes;
             delete list;
         }
         if ($9) {
@@ -218,6 +341,7 @@ function_def:
         func->line = yylineno;
         func->name = $2;
         func->returnType = parseType($6);
+        func->returnClass = parseClassName($6);
         if ($8) {
             func->body = std::unique_ptr<BlockNode>(static_cast<BlockNode*>($8));
         } else {
@@ -234,8 +358,9 @@ function_def:
         func->name = $2;
         func->returnType = Type::VOID;
         if ($4) {
-            auto* list = static_cast<std::vector<std::pair<std::string, Type>>*>($4);
-            func->parameters = *list;
+            auto* list = static_cast<ParamList*>($4);
+            func->parameters = list->params;
+            func->parameterClasses = list->classes;
             delete list;
         }
         if ($7) {
@@ -265,17 +390,19 @@ function_def:
 param_list:
     param_list COMMA type_spec VAR
     {
-        auto* list = static_cast<std::vector<std::pair<std::string, Type>>*>($1);
-        if (!list) list = new std::vector<std::pair<std::string, Type>>();
-        list->push_back({$4, parseType($3)});
+        auto* list = static_cast<ParamList*>($1);
+        if (!list) list = new ParamList();
+        list->params.push_back({$4, parseType($3)});
+        list->classes.push_back(parseClassName($3));
         $$ = list;
         free($3);
         free($4);
     }
     | type_spec VAR
     {
-        auto* list = new std::vector<std::pair<std::string, Type>>();
-        list->push_back({$2, parseType($1)});
+        auto* list = new ParamList();
+        list->params.push_back({$2, parseType($1)});
+        list->classes.push_back(parseClassName($1));
         $$ = list;
         free($1);
         free($2);
@@ -322,10 +449,20 @@ statement:
     | while_stmt { $$ = $1; }
     | do_while_stmt { $$ = $1; }
     | for_stmt { $$ = $1; }
+    | annotated_loop { $$ = $1; }
+    | parallel_for_stmt { $$ = $1; }
+    | spawn_stmt { $$ = $1; }
+    | sync_stmt { $$ = $1; }
     | switch_stmt { $$ = $1; }
     | break_stmt { $$ = $1; }
     | continue_stmt { $$ = $1; }
-    | expression SEMICOLON { $$ = nullptr; if ($1) delete static_cast<ExpressionNode*>($1); }
+    | expression SEMICOLON
+    {
+        auto* exprStmt = new ExpressionStmtNode();
+        exprStmt->line = yylineno;
+        exprStmt->expression = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($1));
+        $$ = exprStmt;
+    }
     ;
 
 return_stmt:
@@ -362,24 +499,25 @@ template_def:
 class_def:
     CLASS VAR LBRACE class_body RBRACE
     {
-        auto* cls = new ClassNode();
-        cls->line = yylineno;
-        cls->name = $2;
-        if ($4) {
-            auto* body = static_cast<std::pair<ConstructorNode*, std::vector<MethodNode*>*>*>($4);
-            if (body->first) {
-                cls->constructor = std::unique_ptr<ConstructorNode>(body->first);
-            }
-            if (body->second) {
-                for (auto* method : *body->second) {
-                    cls->methods.push_back(std::unique_ptr<MethodNode>(method));
-                }
-                delete body->second;
-            }
-            delete body;
-        }
+        $$ = buildClass($2, $4, false);
+    }
+    | STRUCT VAR LBRACE class_body RBRACE
+    {
+        $$ = buildClass($2, $4, true);
+    }
+    | ANNOTATION CLASS VAR LBRACE class_body RBRACE
+    {
+        auto* cls = buildClass($3, $5, false);
+        cls->annotations.push_back($1);
         $$ = cls;
-        free($2);
+        free($1);
+    }
+    | ANNOTATION STRUCT VAR LBRACE class_body RBRACE
+    {
+        auto* cls = buildClass($3, $5, true);
+        cls->annotations.push_back($1);
+        $$ = cls;
+        free($1);
     }
     ;
 
@@ -397,24 +535,19 @@ class_body:
 class_members:
     class_members class_member
     {
-        if ($1 && $2) {
-            auto* result = static_cast<std::pair<ConstructorNode*, std::vector<MethodNode*>*>*>($1);
-            auto* member = static_cast<std::pair<ConstructorNode*, std::vector<MethodNode*>*>*>($2);
-
-            if (member->first) {
-                result->first = member->first;
-            }
-            if (member->second) {
-                for (auto* method : *member->second) {
-                    result->second->push_back(method);
-                }
-                delete member->second;
-            }
-            delete member;
-            $$ = result;
-        } else {
-            $$ = $1 ? $1 : $2;
+        auto* result = static_cast<ClassBody*>($1);
+        auto* member = static_cast<ClassBody*>($2);
+        if (member->constructor) {
+            result->constructor = member->constructor;
         }
+        for (auto* method : member->methods) {
+            result->methods.push_back(method);
+        }
+        for (auto& field : member->fields) {
+            result->fields.push_back(field);
+        }
+        delete member;
+        $$ = result;
     }
     | class_member
     {
@@ -425,19 +558,79 @@ class_members:
 class_member:
     constructor_def
     {
-        auto* result = new std::pair<ConstructorNode*, std::vector<MethodNode*>*>();
-        result->first = static_cast<ConstructorNode*>($1);
-        result->second = nullptr;
+        auto* result = new ClassBody();
+        result->constructor = static_cast<ConstructorNode*>($1);
         $$ = result;
     }
     | method_def
     {
-        auto* result = new std::pair<ConstructorNode*, std::vector<MethodNode*>*>();
-        result->first = nullptr;
-        result->second = new std::vector<MethodNode*>();
-        result->second->push_back(static_cast<MethodNode*>($1));
+        auto* result = new ClassBody();
+        result->methods.push_back(static_cast<MethodNode*>($1));
         $$ = result;
     }
+    | field_def
+    {
+        $$ = $1;
+    }
+    ;
+
+field_def:
+    access_specifier type_spec VAR SEMICOLON
+    {
+        auto* result = new ClassBody();
+        FieldDecl field;
+        field.line = yylineno;
+        field.name = $3;
+        field.type = parseType($2);
+        field.className = parseClassName($2);
+        field.isPrivate = ($1 && strcmp($1, "private") == 0);
+        result->fields.push_back(field);
+        $$ = result;
+        if ($1) free($1);
+        free($2);
+        free($3);
+    }
+    | VAR VAR SEMICOLON
+    {
+        // Spelled out so that a class-typed field without an access
+        // specifier is not mistaken for the start of a constructor.
+        auto* result = new ClassBody();
+        FieldDecl field;
+        field.line = yylineno;
+        field.name = $2;
+        field.type = parseType($1);
+        field.className = parseClassName($1);
+        result->fields.push_back(field);
+        $$ = result;
+        free($1);
+        free($2);
+    }
+    | VAR LBRACKET RBRACKET VAR SEMICOLON
+    {
+        auto* result = new ClassBody();
+        FieldDecl field;
+        field.line = yylineno;
+        field.name = $4;
+        field.type = Type::ARRAY;
+        field.className = $1;
+        result->fields.push_back(field);
+        $$ = result;
+        free($1);
+        free($4);
+    }
+    | VAR LBRACKET COLON RBRACKET VAR SEMICOLON
+    {
+        auto* result = new ClassBody();
+        FieldDecl field;
+        field.line = yylineno;
+        field.name = $5;
+        field.type = Type::SLICE;
+        field.className = $1;
+        result->fields.push_back(field);
+        $$ = result;
+        free($1);
+        free($5);
+    }
     ;
 
 constructor_def:
@@ -447,8 +640,9 @@ constructor_def:
         ctor->line = yylineno;
         ctor->className = $1;
         if ($3) {
-            auto* list = static_cast<std::vector<std::pair<std::string, Type>>*>($3);
-            ctor->parameters = *list;
+            auto* list = static_cast<ParamList*>($3);
+            ctor->parameters = list->params;
+            ctor->parameterClasses = list->classes;
             delete list;
         }
         if ($6) {
@@ -481,10 +675,12 @@ method_def:
         method->line = yylineno;
         method->name = $3;
         method->returnType = parseType($2);
+        method->returnClass = parseClassName($2);
         method->isPrivate = ($1 && strcmp($1, "private") == 0);
         if ($5) {
-            auto* list = static_cast<std::vector<std::pair<std::string, Type>>*>($5);
-            method->parameters = *list;
+            auto* list = static_cast<ParamList*>($5);
+            method->parameters = list->params;
+            method->parameterClasses = list->classes;
             delete list;
         }
         if ($8) {
@@ -503,6 +699,7 @@ method_def:
         method->line = yylineno;
         method->name = $3;
         method->returnType = parseType($2);
+        method->returnClass = parseClassName($2);
         method->isPrivate = ($1 && strcmp($1, "private") == 0);
         if ($7) {
             method->body = std::unique_ptr<BlockNode>(static_cast<BlockNode*>($7));
@@ -522,8 +719,9 @@ method_def:
         method->returnType = Type::VOID;
         method->isPrivate = ($1 && strcmp($1, "private") == 0);
         if ($4) {
-            auto* list = static_cast<std::vector<std::pair<std::string, Type>>*>($4);
-            method->parameters = *list;
+            auto* list = static_cast<ParamList*>($4);
+            method->parameters = list->params;
+            method->parameterClasses = list->classes;
             delete list;
         }
         if ($7) {
@@ -565,6 +763,7 @@ var_decl:
         auto* var = new VarDeclNode();
         var->line = yylineno;
         var->type = parseType($2);
+        var->className = parseClassName($2);
         var->name = $3;
         var->isArray = false;
         var->isConst = true;
@@ -581,6 +780,7 @@ var_decl:
         auto* var = new VarDeclNode();
         var->line = yylineno;
         var->type = parseType($2);
+        var->className = parseClassName($2);
         var->name = $3;
         var->isArray = false;
         var->isConst = true;
@@ -595,6 +795,7 @@ var_decl:
         auto* var = new VarDeclNode();
         var->line = yylineno;
         var->type = parseType($1);
+        var->className = parseClassName($1);
         var->name = $2;
         var->isArray = false;
         var->isConst = false;
@@ -611,6 +812,7 @@ var_decl:
         auto* var = new VarDeclNode();
         var->line = yylineno;
         var->type = parseType($1);
+        var->className = parseClassName($1);
         var->name = $2;
         var->isArray = true;
         var->isConst = false;
@@ -627,6 +829,7 @@ var_decl:
         auto* var = new VarDeclNode();
         var->line = yylineno;
         var->type = parseType($1);
+        var->className = parseClassName($1);
         var->name = $2;
         var->isArray = false;
         var->isConst = false;
@@ -644,13 +847,75 @@ var_assign:
         auto* assign = new VarAssignNode();
         assign->line = yylineno;
         assign->name = $1;
+        if ($3) {
+            assign->index = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
+        }
         if ($6) {
             assign->value = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($6));
         }
         assign->assignOp = BinaryOp::ADD;
         $$ = assign;
         free($1);
-        if ($3) delete static_cast<ExpressionNode*>($3);
+    }
+    | VAR LBRACKET expression RBRACKET PLUS_ASSIGN expression SEMICOLON
+    {
+        auto* assign = new VarAssignNode();
+        assign->line = yylineno;
+        assign->name = $1;
+        if ($3) {
+            assign->index = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
+        }
+        if ($6) {
+            assign->value = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($6));
+        }
+        assign->assignOp = BinaryOp::PLUS_ASSIGN;
+        $$ = assign;
+        free($1);
+    }
+    | VAR LBRACKET expression RBRACKET MINUS_ASSIGN expression SEMICOLON
+    {
+        auto* assign = new VarAssignNode();
+        assign->line = yylineno;
+        assign->name = $1;
+        if ($3) {
+            assign->index = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
+        }
+        if ($6) {
+            assign->value = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($6));
+        }
+        assign->assignOp = BinaryOp::MINUS_ASSIGN;
+        $$ = assign;
+        free($1);
+    }
+    | VAR LBRACKET expression RBRACKET STAR_ASSIGN expression SEMICOLON
+    {
+        auto* assign = new VarAssignNode();
+        assign->line = yylineno;
+        assign->name = $1;
+        if ($3) {
+            assign->index = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
+        }
+        if ($6) {
+            assign->value = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($6));
+        }
+        assign->assignOp = BinaryOp::STAR_ASSIGN;
+        $$ = assign;
+        free($1);
+    }
+    | VAR LBRACKET expression RBRACKET SLASH_ASSIGN expression SEMICOLON
+    {
+        auto* assign = new VarAssignNode();
+        assign->line = yylineno;
+        assign->name = $1;
+        if ($3) {
+            assign->index = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
+        }
+        if ($6) {
+            assign->value = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($6));
+        }
+        assign->assignOp = BinaryOp::SLASH_ASSIGN;
+        $$ = assign;
+        free($1);
     }
     | VAR ASSIGN expression SEMICOLON
     {
@@ -712,6 +977,161 @@ var_assign:
         $$ = assign;
         free($1);
     }
+    | VAR DOT VAR ASSIGN expression SEMICOLON
+    {
+        auto* assign = new VarAssignNode();
+        assign->line = yylineno;
+        assign->name = $1;
+        assign->field = $3;
+        if ($5) {
+            assign->value = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($5));
+        }
+        assign->assignOp = BinaryOp::ADD;
+        $$ = assign;
+        free($1);
+        free($3);
+    }
+    | VAR DOT VAR PLUS_ASSIGN expression SEMICOLON
+    {
+        auto* assign = new VarAssignNode();
+        assign->line = yylineno;
+        assign->name = $1;
+        assign->field = $3;
+        if ($5) {
+            assign->value = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($5));
+        }
+        assign->assignOp = BinaryOp::PLUS_ASSIGN;
+        $$ = assign;
+        free($1);
+        free($3);
+    }
+    | VAR DOT VAR MINUS_ASSIGN expression SEMICOLON
+    {
+        auto* assign = new VarAssignNode();
+        assign->line = yylineno;
+        assign->name = $1;
+        assign->field = $3;
+        if ($5) {
+            assign->value = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($5));
+        }
+        assign->assignOp = BinaryOp::MINUS_ASSIGN;
+        $$ = assign;
+        free($1);
+        free($3);
+    }
+    | VAR DOT VAR STAR_ASSIGN expression SEMICOLON
+    {
+        auto* assign = new VarAssignNode();
+        assign->line = yylineno;
+        assign->name = $1;
+        assign->field = $3;
+        if ($5) {
+            assign->value = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($5));
+        }
+        assign->assignOp = BinaryOp::STAR_ASSIGN;
+        $$ = assign;
+        free($1);
+        free($3);
+    }
+    | VAR DOT VAR SLASH_ASSIGN expression SEMICOLON
+    {
+        auto* assign = new VarAssignNode();
+        assign->line = yylineno;
+        assign->name = $1;
+        assign->field = $3;
+        if ($5) {
+            assign->value = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($5));
+        }
+        assign->assignOp = BinaryOp::SLASH_ASSIGN;
+        $$ = assign;
+        free($1);
+        free($3);
+    }
+    | VAR LBRACKET expression RBRACKET DOT VAR ASSIGN expression SEMICOLON
+    {
+        auto* assign = new VarAssignNode();
+        assign->line = yylineno;
+        assign->name = $1;
+        assign->field = $6;
+        if ($3) {
+            assign->index = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
+        }
+        if ($8) {
+            assign->value = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($8));
+        }
+        assign->assignOp = BinaryOp::ADD;
+        $$ = assign;
+        free($1);
+        free($6);
+    }
+    | VAR LBRACKET expression RBRACKET DOT VAR PLUS_ASSIGN expression SEMICOLON
+    {
+        auto* assign = new VarAssignNode();
+        assign->line = yylineno;
+        assign->name = $1;
+        assign->field = $6;
+        if ($3) {
+            assign->index = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
+        }
+        if ($8) {
+            assign->value = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($8));
+        }
+        assign->assignOp = BinaryOp::PLUS_ASSIGN;
+        $$ = assign;
+        free($1);
+        free($6);
+    }
+    | VAR LBRACKET expression RBRACKET DOT VAR MINUS_ASSIGN expression SEMICOLON
+    {
+        auto* assign = new VarAssignNode();
+        assign->line = yylineno;
+        assign->name = $1;
+        assign->field = $6;
+        if ($3) {
+            assign->index = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
+        }
+        if ($8) {
+            assign->value = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($8));
+        }
+        assign->assignOp = BinaryOp::MINUS_ASSIGN;
+        $$ = assign;
+        free($1);
+        free($6);
+    }
+    | VAR LBRACKET expression RBRACKET DOT VAR STAR_ASSIGN expression SEMICOLON
+    {
+        auto* assign = new VarAssignNode();
+        assign->line = yylineno;
+        assign->name = $1;
+        assign->field = $6;
+        if ($3) {
+            assign->index = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
+        }
+        if ($8) {
+            assign->value = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($8));
+        }
+        assign->assignOp = BinaryOp::STAR_ASSIGN;
+        $$ = assign;
+        free($1);
+        free($6);
+    }
+    | VAR LBRACKET expression RBRACKET DOT VAR SLASH_ASSIGN expression SEMICOLON
+    {
+        auto* assign = new VarAssignNode();
+        assign->line = yylineno;
+        assign->name = $1;
+        assign->field = $6;
+        if ($3) {
+            assign->index = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
+        }
+        if ($8) {
+            assign->value = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($8));
+        }
+        assign->assignOp = BinaryOp::SLASH_ASSIGN;
+        $$ = assign;
+        free($1);
+        free($6);
+    }
     ;
 
 inc_dec_stmt:
@@ -816,7 +1236,7 @@ while_stmt:
     WHILE LPAREN expression RPAREN block
     {
         auto* whileNode = new WhileNode();
-        whileNode->line = yylineno;
+        whileNode->line = $1;
         if ($3) {
             whileNode->condition = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
         }
@@ -958,7 +1378,7 @@ for_stmt:
     FOR LPAREN var_decl expression SEMICOLON expression RPAREN block
     {
         auto* forNode = new ForNode();
-        forNode->line = yylineno;
+        forNode->line = $1;
         if ($3) {
             forNode->init = std::unique_ptr<VarDeclNode>(static_cast<VarDeclNode*>($3));
         }
@@ -976,7 +1396,7 @@ for_stmt:
     | FOR LPAREN SEMICOLON expression SEMICOLON expression RPAREN block
     {
         auto* forNode = new ForNode();
-        forNode->line = yylineno;
+        forNode->line = $1;
         forNode->init = nullptr;
         if ($4) {
             forNode->condition = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($4));
@@ -991,10 +1411,165 @@ for_stmt:
     }
     ;
 
+spawn_stmt:
+    SPAWN expression SEMICOLON
+    {
+        auto* spawn = new SpawnNode();
+        spawn->line = yylineno;
+        spawn->call = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($2));
+        $$ = spawn;
+    }
+    | type_spec VAR ASSIGN SPAWN expression SEMICOLON
+    {
+        auto* spawn = new SpawnNode();
+        spawn->line = yylineno;
+        spawn->target = $2;
+        spawn->targetType = parseType($1);
+        spawn->targetClass = parseClassName($1);
+        spawn->declaresTarget = true;
+        spawn->call = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($5));
+        $$ = spawn;
+        free($1);
+        free($2);
+    }
+    | VAR ASSIGN SPAWN expression SEMICOLON
+    {
+        auto* spawn = new SpawnNode();
+        spawn->line = yylineno;
+        spawn->target = $1;
+        spawn->call = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($4));
+        $$ = spawn;
+        free($1);
+    }
+    ;
+
+sync_stmt:
+    SYNC SEMICOLON
+    {
+        auto* sync = new SyncNode();
+        sync->line = yylineno;
+        $$ = sync;
+    }
+    ;
+
+parallel_for_stmt:
+    PARALLEL FOR LPAREN var_decl expression SEMICOLON expression RPAREN block
+    {
+        auto* forNode = new ForNode();
+        forNode->line = $2;
+        forNode->isParallel = true;
+        forNode->init = std::unique_ptr<VarDeclNode>(static_cast<VarDeclNode*>($4));
+        forNode->condition = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($5));
+        forNode->increment = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($7));
+        forNode->body = std::unique_ptr<BlockNode>(static_cast<BlockNode*>($9));
+        $$ = forNode;
+    }
+    | PARALLEL FOR LPAREN var_decl expression SEMICOLON expression RPAREN reduce_clause block
+    {
+        auto* forNode = new ForNode();
+        forNode->line = $2;
+        forNode->isParallel = true;
+        forNode->init = std::unique_ptr<VarDeclNode>(static_cast<VarDeclNode*>($4));
+        forNode->condition = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($5));
+        forNode->increment = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($7));
+        auto* reductions = static_cast<std::vector<std::pair<BinaryOp, std::string>>*>($9);
+        forNode->reductions = *reductions;
+        delete reductions;
+        forNode->body = std::unique_ptr<BlockNode>(static_cast<BlockNode*>($10));
+        $$ = forNode;
+    }
+    ;
+
+reduce_clause:
+    REDUCE LPAREN reduce_op COLON reduce_vars RPAREN
+    {
+        auto* reductions = static_cast<std::vector<std::pair<BinaryOp, std::string>>*>($5);
+        for (auto& reduction : *reductions) {
+            reduction.first = static_cast<BinaryOp>($3);
+        }
+        $$ = reductions;
+    }
+    ;
+
+reduce_op:
+    PLUS { $$ = static_cast<int>(BinaryOp::ADD); }
+    | STAR { $$ = static_cast<int>(BinaryOp::MUL); }
+    | AND { $$ = static_cast<int>(BinaryOp::AND); }
+    | OR { $$ = static_cast<int>(BinaryOp::OR); }
+    ;
+
+reduce_vars:
+    reduce_vars COMMA VAR
+    {
+        auto* reductions = static_cast<std::vector<std::pair<BinaryOp, std::string>>*>($1);
+        reductions->push_back({BinaryOp::ADD, $3});
+        $$ = reductions;
+        free($3);
+    }
+    | VAR
+    {
+        auto* reductions = new std::vector<std::pair<BinaryOp, std::string>>();
+        reductions->push_back({BinaryOp::ADD, $1});
+        $$ = reductions;
+        free($1);
+    }
+    ;
+
+annotated_loop:
+    loop_annotations for_stmt
+    {
+        auto* list = static_cast<std::vector<LoopAnnotation>*>($1);
+        static_cast<ForNode*>($2)->annotations = *list;
+        delete list;
+        $$ = $2;
+    }
+    | loop_annotations while_stmt
+    {
+        auto* list = static_cast<std::vector<LoopAnnotation>*>($1);
+        static_cast<WhileNode*>($2)->annotations = *list;
+        delete list;
+        $$ = $2;
+    }
+    ;
+
+loop_annotations:
+    loop_annotations ANNOTATION
+    {
+        auto* list = static_cast<std::vector<LoopAnnotation>*>($1);
+        list->push_back({$2, 0});
+        $$ = list;
+        free($2);
+    }
+    | loop_annotations ANNOTATION LPAREN INTEGER RPAREN
+    {
+        auto* list = static_cast<std::vector<LoopAnnotation>*>($1);
+        list->push_back({$2, atoi($4)});
+        $$ = list;
+        free($2);
+        free($4);
+    }
+    | ANNOTATION
+    {
+        auto* list = new std::vector<LoopAnnotation>();
+        list->push_back({$1, 0});
+        $$ = list;
+        free($1);
+    }
+    | ANNOTATION LPAREN INTEGER RPAREN
+    {
+        auto* list = new std::vector<LoopAnnotation>();
+        list->push_back({$1, atoi($3)});
+        $$ = list;
+        free($1);
+        free($3);
+    }
+    ;
+
 expression:
     expression PLUS expression
     {
         auto* bin = new BinaryExprNode();
+        bin->line = yylineno;
         bin->op = BinaryOp::ADD;
         bin->left = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($1));
         bin->right = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
@@ -1003,6 +1578,7 @@ expression:
     | expression MINUS expression
     {
         auto* bin = new BinaryExprNode();
+        bin->line = yylineno;
         bin->op = BinaryOp::SUB;
         bin->left = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($1));
         bin->right = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
@@ -1011,6 +1587,7 @@ expression:
     | expression STAR expression
     {
         auto* bin = new BinaryExprNode();
+        bin->line = yylineno;
         bin->op = BinaryOp::MUL;
         bin->left = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($1));
         bin->right = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
@@ -1019,6 +1596,7 @@ expression:
     | expression SLASH expression
     {
         auto* bin = new BinaryExprNode();
+        bin->line = yylineno;
         bin->op = BinaryOp::DIV;
         bin->left = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($1));
         bin->right = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
@@ -1027,6 +1605,7 @@ expression:
     | expression MOD expression
     {
         auto* bin = new BinaryExprNode();
+        bin->line = yylineno;
         bin->op = BinaryOp::MOD;
         bin->left = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($1));
         bin->right = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
@@ -1035,6 +1614,7 @@ expression:
     | expression EQ expression
     {
         auto* bin = new BinaryExprNode();
+        bin->line = yylineno;
         bin->op = BinaryOp::EQ;
         bin->left = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($1));
         bin->right = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
@@ -1043,6 +1623,7 @@ expression:
     | expression NE expression
     {
         auto* bin = new BinaryExprNode();
+        bin->line = yylineno;
         bin->op = BinaryOp::NE;
         bin->left = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($1));
         bin->right = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
@@ -1051,6 +1632,7 @@ expression:
     | expression LT expression
     {
         auto* bin = new BinaryExprNode();
+        bin->line = yylineno;
         bin->op = BinaryOp::LT;
         bin->left = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($1));
         bin->right = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
@@ -1059,6 +1641,7 @@ expression:
     | expression GT expression
     {
         auto* bin = new BinaryExprNode();
+        bin->line = yylineno;
         bin->op = BinaryOp::GT;
         bin->left = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($1));
         bin->right = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
@@ -1067,6 +1650,7 @@ expression:
     | expression LE expression
     {
         auto* bin = new BinaryExprNode();
+        bin->line = yylineno;
         bin->op = BinaryOp::LE;
         bin->left = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($1));
         bin->right = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
@@ -1075,6 +1659,7 @@ expression:
     | expression GE expression
     {
         auto* bin = new BinaryExprNode();
+        bin->line = yylineno;
         bin->op = BinaryOp::GE;
         bin->left = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($1));
         bin->right = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
@@ -1083,6 +1668,7 @@ expression:
     | expression AND expression
     {
         auto* bin = new BinaryExprNode();
+        bin->line = yylineno;
         bin->op = BinaryOp::AND;
         bin->left = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($1));
         bin->right = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
@@ -1091,6 +1677,7 @@ expression:
     | expression OR expression
     {
         auto* bin = new BinaryExprNode();
+        bin->line = yylineno;
         bin->op = BinaryOp::OR;
         bin->left = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($1));
         bin->right = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
@@ -1135,10 +1722,18 @@ expression:
     }
     | INTEGER
     {
+        // Literals are 64-bit; one too large for int is an i64, as in C.
+        errno = 0;
+        long value = strtol($1, nullptr, 10);
+        free($1);
+        if (errno == ERANGE) {
+            yyerror("integer literal out of range");
+            YYABORT;
+        }
         auto* lit = new LiteralNode();
         lit->line = yylineno;
-        lit->literalType = Type::INT;
-        lit->intValue = $1;
+        lit->literalType = value > INT_MAX ? Type::I64 : Type::INT;
+        lit->intValue = value;
         $$ = lit;
     }
     | DOUBLE
@@ -1170,7 +1765,7 @@ expression:
         auto* lit = new LiteralNode();
         lit->line = yylineno;
         lit->literalType = Type::STRING;
-        new (&lit->stringValue) std::string($1);
+        lit->stringValue = $1;
         $$ = lit;
         free($1);
     }
@@ -1182,6 +1777,61 @@ expression:
         $$ = var;
         free($1);
     }
+    | expression DOT VAR
+    {
+        auto* access = new FieldAccessNode();
+        access->line = yylineno;
+        if ($1) {
+            access->object = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($1));
+        }
+        access->field = $3;
+        $$ = access;
+        free($3);
+    }
+    | VAR LBRACKET expression COLON expression RBRACKET
+    {
+        auto* slice = new SliceExprNode();
+        slice->line = yylineno;
+        slice->arrayName = $1;
+        if ($3) {
+            slice->low = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
+        }
+        if ($5) {
+            slice->high = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($5));
+        }
+        $$ = slice;
+        free($1);
+    }
+    | VAR LBRACKET expression COLON RBRACKET
+    {
+        auto* slice = new SliceExprNode();
+        slice->line = yylineno;
+        slice->arrayName = $1;
+        if ($3) {
+            slice->low = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($3));
+        }
+        $$ = slice;
+        free($1);
+    }
+    | VAR LBRACKET COLON expression RBRACKET
+    {
+        auto* slice = new SliceExprNode();
+        slice->line = yylineno;
+        slice->arrayName = $1;
+        if ($4) {
+            slice->high = std::unique_ptr<ExpressionNode>(static_cast<ExpressionNode*>($4));
+        }
+        $$ = slice;
+        free($1);
+    }
+    | VAR LBRACKET COLON RBRACKET
+    {
+        auto* slice = new SliceExprNode();
+        slice->line = yylineno;
+        slice->arrayName = $1;
+        $$ = slice;
+        free($1);
+    }
     | VAR LBRACKET expression RBRACKET
     {
         auto* arr = new ArrayAccessNode();
@@ -1273,14 +1923,119 @@ expression_list:
 
 %%
 
+// Reads a gcc -fopt-info-vec report and warns about annotated loops that were
+// not vectorized. Report locations are matched against the C line ranges that
+// the code generator recorded for each loop.
+void reportVectorization(const std::string& reportFile, const std::string& cFile,
+                         const std::string& sourceFile, const std::vector<LoopRecord>& loops) {
+    std::vector<bool> vectorized(loops.size(), false);
+    std::vector<std::string> reasons(loops.size());
+
+    std::ifstream report(reportFile);
+    std::string line;
+    std::string prefix = cFile + ":";
+    while (std::getline(report, line)) {
+        if (line.compare(0, prefix.size(), prefix) != 0) continue;
+        int reportLine = atoi(line.c_str() + prefix.size());
+
+        int owner = -1;
+        for (size_t i = 0; i < loops.size(); ++i) {
+            if (reportLine < loops[i].beginLine || reportLine > loops[i].endLine) continue;
+            if (owner < 0 || loops[i].beginLine >= loops[owner].beginLine) {
+                owner = i;
+            }
+        }
+        if (owner < 0) continue;
+
+        size_t message = line.find(": optimized: ");
+        if (message != std::string::npos && line.find("loop vectorized", message) != std::string::npos) {
+            vectorized[owner] = true;
+            continue;
+        }
+        message = line.find(": missed: not vectorized: ");
+        if (message != std::string::npos && reasons[owner].empty()) {
+            reasons[owner] = line.substr(message + 26);
+        }
+    }
+
+    int failed = 0;
+    for (size_t i = 0; i < loops.size(); ++i) {
+        if (!loops[i].vectorizeHint || vectorized[i]) continue;
+        failed++;
+        std::cerr << sourceFile << ":" << loops[i].sourceLine << ": warning: annotated loop was not vectorized";
+        if (!reasons[i].empty()) {
+            std::cerr << " (" << reasons[i] << ")";
+        }
+        std::cerr << std::endl;
+    }
+    if (failed == 0) {
+        std::cerr << "All annotated loops were vectorized" << std::endl;
+    }
+}
+
+// Lists the indexes that still carry a check and summarizes how many were
+// proven safe or moved in front of their loop.
+void reportBoundsChecks(const std::string& sourceFile, const RangeAnalyzer& ranges) {
+    for (const auto& check : ranges.getKept()) {
+        std::cerr << sourceFile << ":" << check.first << ": note: bounds check kept on '" << check.second << "'"
+                  << std::endl;
+    }
+    std::cerr << "Bounds checks: " << ranges.getTotal() << " indexed accesses, " << ranges.getProven()
+              << " proven safe, " << ranges.getHoisted() << " hoisted out of loops, " << ranges.getKept().size()
+              << " kept" << std::endl;
+}
+
+std::unique_ptr<ProgramNode> parseProgram(const std::string& source) {
+    yylineno = 1;
+    YY_BUFFER_STATE buffer = yy_scan_string(source.c_str());
+    int result = yyparse();
+    yy_delete_buffer(buffer);
+    std::unique_ptr<ProgramNode> program = std::move(programRoot);
+    if (result != 0) {
+        return nullptr;
+    }
+    return program;
+}
+
 int main(int argc, char** argv) {
+    if (argc >= 2 && std::string(argv[1]) == "repl") {
+        std::string optimizationFlag = " -O1";
+        for (int i = 2; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "-O0" || arg == "-O1" || arg == "-O2" || arg == "-O3" || arg == "-Os") {
+                optimizationFlag = " " + arg;
+            } else {
+                std::cerr << "Unknown argument: " << arg << std::endl;
+                return 1;
+            }
+        }
+        Repl repl(optimizationFlag);
+        return repl.run(std::cin, isatty(STDIN_FILENO));
+    }
+
     if (argc < 2) {
         std::cerr << "Usage: " << argv[0] << " <input.sl> <output> [options]" << std::endl;
+        std::cerr << "       " << argv[0] << " <input.sl> --run" << std::endl;
+        std::cerr << "       " << argv[0] << " repl [-O0 .. -O3]" << std::endl;
         std::cerr << "Options:" << std::endl;
         std::cerr << "  -o <file>           Output executable" << std::endl;
         std::cerr << "  -shared             Generate shared library (.so)" << std::endl;
         std::cerr << "  -static             Generate static library (.a)" << std::endl;
         std::cerr << "  -c <file>           Keep intermediate C file" << std::endl;
+        std::cerr << "  -O0 .. -O3, -Os     Optimization level passed to gcc" << std::endl;
+        std::cerr << "  --check-vectorize   Report annotated loops that gcc failed to vectorize" << std::endl;
+        std::cerr << "  --bounds-check      Check array indexes at run time and report the checks kept" << std::endl;
+        std::cerr << "  --run               Run the program on the bytecode VM, or through C when the VM cannot" << std::endl;
+        std::cerr << "  --asm               Build the executable with the x86-64 backend, as and ld, without gcc"
+                  << std::endl;
+        std::cerr << "  --ir                Optimize scalar functions in SSA form before writing C" << std::endl;
+        std::cerr << "  --passes=<list>     IR passes to run, comma-separated (implies --ir; default "
+                  << DEFAULT_PIPELINE << ")" << std::endl;
+        std::cerr << "  --dump-ir           Print the IR after lowering and after each pass that changes it (implies --ir)"
+                  << std::endl;
+        std::cerr << "  --time-passes       Report the time spent in each IR pass (implies --ir)" << std::endl;
+        std::cerr << "  --instrument        Count calls and time per function; the program writes a flat profile"
+                  << " to sl_profile.txt ($SL_PROFILE) at exit" << std::endl;
         return 1;
     }
 
@@ -1290,6 +2045,16 @@ int main(int argc, char** argv) {
     std::string outputFile;
     std::string intermediateCFile;
     bool keepIntermediate = false;
+    std::string optimizationFlag;
+    bool checkVectorize = false;
+    bool boundsCheck = false;
+    bool runInProcess = false;
+    bool directAssembly = false;
+    bool useIR = false;
+    std::string pipeline = DEFAULT_PIPELINE;
+    bool dumpIR = false;
+    bool timePasses = false;
+    bool instrument = false;
 
     int i = 1;
     inputFile = argv[i++];
@@ -1306,6 +2071,29 @@ int main(int argc, char** argv) {
         } else if (arg == "-c" && i < argc) {
             intermediateCFile = argv[i++];
             keepIntermediate = true;
+        } else if (arg == "-O0" || arg == "-O1" || arg == "-O2" || arg == "-O3" || arg == "-Os") {
+            optimizationFlag = arg;
+        } else if (arg == "--check-vectorize") {
+            checkVectorize = true;
+        } else if (arg == "--bounds-check") {
+            boundsCheck = true;
+        } else if (arg == "--run") {
+            runInProcess = true;
+        } else if (arg == "--asm") {
+            directAssembly = true;
+        } else if (arg == "--ir") {
+            useIR = true;
+        } else if (arg.compare(0, 9, "--passes=") == 0) {
+            useIR = true;
+            pipeline = arg.substr(9);
+        } else if (arg == "--dump-ir") {
+            useIR = true;
+            dumpIR = true;
+        } else if (arg == "--instrument") {
+            instrument = true;
+        } else if (arg == "--time-passes") {
+            useIR = true;
+            timePasses = true;
         } else if (outputFile.empty()) {
             outputFile = arg;
         } else {
@@ -1314,11 +2102,18 @@ int main(int argc, char** argv) {
         }
     }
 
-    if (outputFile.empty()) {
+    if (outputFile.empty() && !runInProcess && !dumpIR) {
         std::cerr << "Output file not specified" << std::endl;
         return 1;
     }
 
+    PassManager passes;
+    std::string pipelineError;
+    if (useIR && !passes.add(pipeline, pipelineError)) {
+        std::cerr << "--passes: " << pipelineError << std::endl;
+        return 1;
+    }
+
     if (intermediateCFile.empty()) {
         intermediateCFile = "/tmp/sl_temp_" + std::to_string(getpid()) + ".c";
     }
@@ -1347,10 +2142,10 @@ int main(int argc, char** argv) {
     }
     yyin = file;
 
-    yyparse();
+    int parsed = yyparse();
     fclose(yyin);
 
-    if (!programRoot) {
+    if (parsed != 0 || !programRoot) {
         std::cerr << "Parse failed" << std::endl;
         return 1;
     }
@@ -1364,6 +2159,86 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    // --run skips C and gcc: the checked tree goes straight to bytecode.
+    // Programs the VM does not cover are built through C into a temporary
+    // executable, which runs in its place.
+    bool runCompiled = false;
+    if (runInProcess) {
+        BytecodeCompiler bytecode;
+        if (bytecode.compile(programRoot.get())) {
+            VirtualMachine vm(bytecode.getProgram());
+            return vm.run();
+        }
+        std::cerr << "note: " << bytecode.getErrors().front() << "; running through C" << std::endl;
+        runCompiled = true;
+        outputType = OutputType::EXECUTABLE;
+        outputFile = "/tmp/sl_run_" + std::to_string(getpid());
+    }
+
+    // --asm writes assembly itself and links it with as and ld, for quick
+    // debug builds; programs it does not cover go on through C and gcc, and
+    // so do instrumented builds.
+    if (directAssembly && outputType == OutputType::EXECUTABLE && !checkVectorize && !instrument && !runCompiled) {
+        X86Generator assembly;
+        assembly.setSourceFile(inputFile);
+        if (assembly.generate(programRoot.get())) {
+            std::string asmFile = keepIntermediate ? intermediateCFile
+                                                   : "/tmp/sl_temp_" + std::to_string(getpid()) + ".s";
+            std::string objFile = asmFile.substr(0, asmFile.find_last_of('.')) + ".o";
+            std::ofstream asmOutput(asmFile);
+            if (!asmOutput) {
+                std::cerr << "Cannot create assembly file: " << asmFile << std::endl;
+                return 1;
+            }
+            asmOutput << assembly.getAssembly();
+            asmOutput.close();
+
+            std::string command = "as --64 " + asmFile + " -o " + objFile + " && ld " + objFile + " -o " + outputFile;
+            int result = system(command.c_str());
+            if (!keepIntermediate) {
+                remove(asmFile.c_str());
+            }
+            remove(objFile.c_str());
+            if (result != 0) {
+                std::cerr << "Assembling failed" << std::endl;
+                return 1;
+            }
+            std::cout << "Successfully compiled " << inputFile << " to executable " << outputFile << std::endl;
+            return 0;
+        }
+        std::cerr << "note: " << assembly.getErrors().front() << "; compiling through C" << std::endl;
+    }
+
+    EscapeAnalyzer escape;
+    escape.analyze(programRoot.get());
+
+    RangeAnalyzer ranges;
+    if (boundsCheck) {
+        ranges.analyze(programRoot.get());
+        reportBoundsChecks(inputFile, ranges);
+    }
+
+    // --ir lowers the functions it covers to SSA and optimizes them there;
+    // the generator writes those from the IR and the rest from the tree.
+    IRModule module;
+    if (useIR) {
+        IRBuilder builder;
+        builder.build(programRoot.get(), module);
+        passes.setDump(dumpIR ? &std::cout : nullptr);
+        passes.run(module);
+        if (dumpIR) {
+            for (const auto& skipped : module.skipped) {
+                std::cout << "; not lowered: " << skipped << std::endl;
+            }
+        }
+        if (timePasses) {
+            passes.printTiming(std::cerr);
+        }
+        if (dumpIR && outputFile.empty()) {
+            return 0;
+        }
+    }
+
     std::ofstream cFileOutput(intermediateCFile);
     if (!cFileOutput) {
         std::cerr << "Cannot create intermediate C file: " << intermediateCFile << std::endl;
@@ -1374,31 +2249,56 @@ int main(int argc, char** argv) {
     if (outputType == OutputType::SHARED_LIB || outputType == OutputType::STATIC_LIB) {
         generator.setLibraryMode(true);
     }
+    generator.setSharedLibrary(outputType == OutputType::SHARED_LIB);
+    generator.setBoundsChecking(boundsCheck);
+    generator.setInstrumentation(instrument);
+    if (useIR) {
+        generator.setIR(&module);
+    }
     generator.generate(programRoot.get());
     cFileOutput.close();
 
     std::string gccCommand;
     std::string finalOutput = outputFile;
 
+    if (checkVectorize && optimizationFlag.empty()) {
+        optimizationFlag = "-O3";
+    }
+    std::string gccFlags = generator.getCompilerFlags();
+    if (!optimizationFlag.empty()) {
+        gccFlags += " " + optimizationFlag;
+    }
+    std::string vectorizeReport = intermediateCFile + ".vec";
+    if (checkVectorize) {
+        gccFlags += " -fopt-info-vec-all=" + vectorizeReport;
+    }
+
     switch (outputType) {
         case OutputType::EXECUTABLE:
-            gccCommand = "gcc " + intermediateCFile + " -o " + finalOutput;
+            gccCommand = "gcc" + gccFlags + " " + intermediateCFile + " -o " + finalOutput;
             break;
         case OutputType::SHARED_LIB:
             if (finalOutput.find(".so") == std::string::npos) {
                 finalOutput += ".so";
             }
-            gccCommand = "gcc -shared -fPIC " + intermediateCFile + " -o " + finalOutput;
+            gccCommand = "gcc -shared -fPIC" + gccFlags + " " + intermediateCFile + " -o " + finalOutput;
             break;
         case OutputType::STATIC_LIB:
             std::string objFile = intermediateCFile.substr(0, intermediateCFile.find_last_of('.')) + ".o";
-            gccCommand = "gcc -c " + intermediateCFile + " -o " + objFile +
+            gccCommand = "gcc -c" + gccFlags + " " + intermediateCFile + " -o " + objFile +
                         " && ar rcs " + finalOutput + " " + objFile;
             break;
     }
 
     int gccResult = system(gccCommand.c_str());
 
+    if (checkVectorize && gccResult == 0) {
+        reportVectorization(vectorizeReport, intermediateCFile, inputFile, generator.getLoops());
+    }
+    if (checkVectorize) {
+        remove(vectorizeReport.c_str());
+    }
+
     if (!keepIntermediate) {
         remove(intermediateCFile.c_str());
         if (outputType == OutputType::STATIC_LIB) {
@@ -1412,6 +2312,12 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    if (runCompiled) {
+        int status = system(finalOutput.c_str());
+        remove(finalOutput.c_str());
+        return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    }
+
     std::string outputTypeStr;
     switch (outputType) {
         case OutputType::EXECUTABLE: outputTypeStr = "executable"; break;
@@ -0,0 +1,362 @@
+#include "repl.h"
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <fstream>
+#include <regex>
+#include <unistd.h>
+#include "../semantic/escape.h"
+#include "../codegen/codegen.h"
+
+namespace {
+
+struct Scan {
+    int depth = 0;  // brackets still open
+    char last = 0;  // last character outside comments, 0 if there is none
+};
+
+// Looks at the text of an entry the way the lexer would, skipping string
+// literals and comments, so that entries can span several lines.
+Scan scanEntry(const std::string& text) {
+    Scan scan;
+    bool inString = false;
+    bool lineComment = false;
+    bool blockComment = false;
+    for (size_t i = 0; i < text.size(); ++i) {
+        char c = text[i];
+        char next = i + 1 < text.size() ? text[i + 1] : 0;
+        if (lineComment) {
+            if (c == '\n') lineComment = false;
+            continue;
+        }
+        if (blockComment) {
+            if (c == '*' && next == '/') {
+                blockComment = false;
+                ++i;
+            }
+            continue;
+        }
+        if (inString) {
+            if (c == '\\') ++i;
+            else if (c == '"') inString = false;
+            scan.last = c;
+            continue;
+        }
+        if (c == '/' && next == '/') {
+            lineComment = true;
+            continue;
+        }
+        if (c == '/' && next == '*') {
+            blockComment = true;
+            ++i;
+            continue;
+        }
+        if (c == '"') inString = true;
+        if (c == '{' || c == '(' || c == '[') scan.depth++;
+        if (c == '}' || c == ')' || c == ']') scan.depth--;
+        if (!isspace((unsigned char)c)) scan.last = c;
+    }
+    return scan;
+}
+
+std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) return "";
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(begin, end - begin + 1);
+}
+
+// Functions, templates, classes, directives and variable declarations are
+// definitions and persist; anything else is a statement that runs once.
+bool isDefinition(const std::string& text) {
+    static const std::regex definition(
+        "^(function|template|class|struct)\\b|^[#@]|"
+        "^(const\\s+)?[A-Za-z_]\\w*(<[^>]*>)?(\\[:?\\])?\\s+[A-Za-z_]\\w*\\s*[=;\\[]");
+    static const std::regex statement("^(return|spawn)\\b");
+    return std::regex_search(text, definition) && !std::regex_search(text, statement);
+}
+
+std::unique_ptr<FunctionNode> makeEntry(const std::string& name, std::unique_ptr<BlockNode> body) {
+    auto entry = std::make_unique<FunctionNode>();
+    entry->line = 1;
+    entry->name = name;
+    entry->returnType = Type::VOID;
+    entry->body = std::move(body);
+    return entry;
+}
+
+// Values the REPL prints itself, with the formats of the write_ built-ins.
+bool isScalar(Type type) {
+    return type == Type::BOOL || type == Type::FLOAT || type == Type::DOUBLE || isIntegerType(type);
+}
+
+// Calls an entry returning a scalar through a pointer of its C type.
+std::string callForValue(void* entry, Type type) {
+    char text[64];
+    switch (type) {
+        case Type::BOOL: return reinterpret_cast<bool (*)()>(entry)() ? "true" : "false";
+        case Type::FLOAT: snprintf(text, sizeof(text), "%f", (double)reinterpret_cast<float (*)()>(entry)()); break;
+        case Type::DOUBLE: snprintf(text, sizeof(text), "%f", reinterpret_cast<double (*)()>(entry)()); break;
+        case Type::I8: snprintf(text, sizeof(text), "%d", reinterpret_cast<int8_t (*)()>(entry)()); break;
+        case Type::I16: snprintf(text, sizeof(text), "%d", reinterpret_cast<int16_t (*)()>(entry)()); break;
+        case Type::I64: snprintf(text, sizeof(text), "%" PRId64, reinterpret_cast<int64_t (*)()>(entry)()); break;
+        case Type::U8: snprintf(text, sizeof(text), "%u", reinterpret_cast<uint8_t (*)()>(entry)()); break;
+        case Type::U16: snprintf(text, sizeof(text), "%u", reinterpret_cast<uint16_t (*)()>(entry)()); break;
+        case Type::U32: snprintf(text, sizeof(text), "%u", reinterpret_cast<uint32_t (*)()>(entry)()); break;
+        case Type::U64: snprintf(text, sizeof(text), "%" PRIu64, reinterpret_cast<uint64_t (*)()>(entry)()); break;
+        default: snprintf(text, sizeof(text), "%d", reinterpret_cast<int32_t (*)()>(entry)()); break;
+    }
+    return text;
+}
+
+std::unique_ptr<ExpressionStmtNode> callStatement(const std::string& name, std::unique_ptr<ExpressionNode> arg,
+                                                  int line) {
+    auto call = std::make_unique<CallExprNode>();
+    call->line = line;
+    call->functionName = name;
+    call->type = Type::VOID;
+    if (arg) call->arguments.push_back(std::move(arg));
+    auto stmt = std::make_unique<ExpressionStmtNode>();
+    stmt->line = line;
+    stmt->expression = std::move(call);
+    return stmt;
+}
+
+template <typename T>
+void moveAll(std::vector<std::unique_ptr<T>>& from, std::vector<std::unique_ptr<T>>& to) {
+    for (auto& item : from) {
+        to.push_back(std::move(item));
+    }
+    from.clear();
+}
+
+} // namespace
+
+Repl::Repl(const std::string& gccFlags) : gccFlags(gccFlags), entries(0), timing(false) {
+    char path[] = "/tmp/sl_repl_XXXXXX";
+    if (mkdtemp(path)) {
+        directory = path;
+    }
+}
+
+Repl::~Repl() {
+    if (!directory.empty()) {
+        rmdir(directory.c_str());
+    }
+}
+
+int Repl::run(std::istream& in, bool interactive) {
+    if (directory.empty()) {
+        std::cerr << "Cannot create a directory for compiled entries" << std::endl;
+        return 1;
+    }
+
+    bool failed = false;
+    std::string pending;
+    std::string line;
+    if (interactive) std::cout << "sl> " << std::flush;
+    while (std::getline(in, line)) {
+        if (pending.empty() && trim(line) == ":quit") break;
+        if (pending.empty() && trim(line) == ":time") {
+            timing = !timing;
+            if (interactive) std::cout << "sl> " << std::flush;
+            continue;
+        }
+        pending += line + "\n";
+        Scan scan = scanEntry(pending);
+        if (scan.depth > 0) {
+            if (interactive) std::cout << "... " << std::flush;
+            continue;
+        }
+        if (scan.last != 0) {
+            auto start = std::chrono::steady_clock::now();
+            if (!evaluate(pending)) failed = true;
+            if (timing) {
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                std::cerr << "time: " << elapsed.count() << " ms" << std::endl;
+            }
+        }
+        pending.clear();
+        if (interactive) std::cout << "sl> " << std::flush;
+    }
+    if (interactive) std::cout << std::endl;
+    flushOutput();
+    return failed && !interactive ? 1 : 0;
+}
+
+bool Repl::evaluate(const std::string& text) {
+    std::string entryName = "sl_repl_" + std::to_string(++entries);
+    bool printResult = false;
+    std::unique_ptr<ProgramNode> delta = parseEntry(text, entryName, printResult);
+    if (!delta) return false;
+
+    // The host process already has a main; functions are called directly.
+    for (const auto& func : delta->functions) {
+        if (func->name == "main") {
+            std::cerr << "Line " << func->line << ": main cannot be defined in the REPL" << std::endl;
+            return false;
+        }
+    }
+
+    if (!semantic.analyzeDelta(delta.get())) {
+        for (const auto& error : semantic.getErrors()) {
+            std::cerr << error << std::endl;
+        }
+        semantic.rollback();
+        return false;
+    }
+
+    // An expression entered without ';' prints its value. Scalars are
+    // returned and printed here, which keeps the I/O runtime out of the
+    // entry and so out of gcc's way; strings are written by the entry.
+    Type resultType = Type::VOID;
+    if (printResult) {
+        FunctionNode* entry = delta->functions.back().get();
+        auto& statements = entry->body->statements;
+        auto* stmt = statements.size() == 1 ? dynamic_cast<ExpressionStmtNode*>(statements[0].get()) : nullptr;
+        Type type = stmt ? stmt->expression->type : Type::VOID;
+        if (isScalar(type)) {
+            auto ret = std::make_unique<ReturnNode>();
+            ret->line = stmt->line;
+            ret->value = std::move(stmt->expression);
+            statements[0] = std::move(ret);
+            entry->returnType = type;
+            resultType = type;
+        } else if (type == Type::STRING) {
+            int line = stmt->line;
+            statements[0] = callStatement("write_str", std::move(stmt->expression), line);
+            statements.push_back(callStatement("write_newline", nullptr, line));
+        }
+    }
+
+    return load(delta.get(), entryName, resultType);
+}
+
+std::unique_ptr<ProgramNode> Repl::parseEntry(const std::string& text, const std::string& entryName,
+                                              bool& printResult) {
+    if (isDefinition(trim(text))) {
+        std::unique_ptr<ProgramNode> delta = parseProgram(text);
+        if (!delta) return nullptr;
+
+        // Initializers run once, as statements of the entry, so that they
+        // may call earlier functions: C only takes constants at file scope.
+        auto body = std::make_unique<BlockNode>();
+        for (auto& global : delta->globals) {
+            if (global->isConst || global->isArray || !global->initializer) continue;
+            auto assign = std::make_unique<VarAssignNode>();
+            assign->line = global->line;
+            assign->name = global->name;
+            assign->assignOp = BinaryOp::ADD; // the parser's plain '='
+            assign->value = std::move(global->initializer);
+            body->statements.push_back(std::move(assign));
+        }
+        if (!body->statements.empty()) {
+            delta->functions.push_back(makeEntry(entryName, std::move(body)));
+        }
+        return delta;
+    }
+
+    // Statements become the body of a function run right after loading;
+    // the body starts on line 1 so that errors point into the entry. An
+    // expression is parenthesized: a statement starting with a field access
+    // would otherwise parse as an assignment.
+    Scan scan = scanEntry(text);
+    printResult = scan.last != ';' && scan.last != '}';
+    std::string body = printResult ? "(" + text + "\n);" : text;
+    return parseProgram("function " + entryName + "() -> void { " + body + "\n}");
+}
+
+// The delta joins the session, whose earlier definitions are only declared
+// in the generated C, so gcc compiles just what the entry adds.
+bool Repl::load(ProgramNode* delta, const std::string& entryName, Type resultType) {
+    size_t directives = session.directives.size();
+    size_t functions = session.functions.size();
+    size_t templates = session.templates.size();
+    size_t classes = session.classes.size();
+    size_t globals = session.globals.size();
+    moveAll(delta->directives, session.directives);
+    moveAll(delta->functions, session.functions);
+    moveAll(delta->templates, session.templates);
+    moveAll(delta->classes, session.classes);
+    moveAll(delta->globals, session.globals);
+
+    EscapeAnalyzer escape;
+    escape.analyze(&session);
+
+    std::string base = directory + "/" + entryName;
+    std::ofstream source(base + ".c");
+    CodeGenerator generator(source);
+    generator.setLibraryMode(true);
+    generator.setSharedLibrary(true);
+    generator.generate(&session);
+    source.close();
+
+    std::string command = "gcc -shared -fPIC -pipe" + generator.getCompilerFlags() + gccFlags + " " + base + ".c -o " +
+                          base + ".so";
+    int gccResult = system(command.c_str());
+    remove((base + ".c").c_str());
+
+    // The file can go once it is mapped; earlier libraries resolve the
+    // symbols of later ones, so they stay loaded for the whole session.
+    void* library = gccResult == 0 ? dlopen((base + ".so").c_str(), RTLD_NOW | RTLD_GLOBAL) : nullptr;
+    remove((base + ".so").c_str());
+    if (!library) {
+        if (gccResult != 0) {
+            std::cerr << "GCC compilation failed" << std::endl;
+        } else {
+            std::cerr << dlerror() << std::endl;
+        }
+        session.directives.resize(directives);
+        session.functions.resize(functions);
+        session.templates.resize(templates);
+        session.classes.resize(classes);
+        session.globals.resize(globals);
+        semantic.rollback();
+        return false;
+    }
+
+    for (auto& func : session.functions) {
+        func->external = true;
+    }
+    for (auto& templ : session.templates) {
+        for (auto& instance : templ->instances) {
+            instance->external = true;
+        }
+    }
+    for (auto& cls : session.classes) {
+        cls->external = true;
+    }
+    for (auto& global : session.globals) {
+        global->external = true;
+    }
+
+    if (void* flush = dlsym(library, "sl_flush_output")) {
+        flushers.push_back(reinterpret_cast<void (*)()>(flush));
+    }
+
+    // Only the statements of this entry run, once.
+    if (!session.functions.empty() && session.functions.back()->name == entryName) {
+        session.functions.pop_back();
+        void* entry = dlsym(library, entryName.c_str());
+        if (entry && resultType == Type::VOID) {
+            reinterpret_cast<void (*)()>(entry)();
+        } else if (entry) {
+            std::string value = callForValue(entry, resultType);
+            flushOutput();
+            printf("%s\n", value.c_str());
+        }
+    }
+    flushOutput();
+    return true;
+}
+
+// Each library buffers what it writes; all of them are flushed after every
+// entry so that its output shows before the next prompt.
+void Repl::flushOutput() {
+    for (auto flush : flushers) {
+        flush();
+    }
+    fflush(stdout);
+}
@@ -0,0 +1,49 @@
+#ifndef REPL_H
+#define REPL_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../ast/ast.h"
+#include "../semantic/semantic.h"
+
+// Parses SL source held in memory; defined next to the grammar. Returns
+// null after reporting a syntax error.
+std::unique_ptr<ProgramNode> parseProgram(const std::string& source);
+
+// `slc repl`: reads one definition or statement at a time. Each entry is
+// checked against everything entered before by one long-lived
+// SemanticAnalyzer, then compiled as a shared object that defines only what
+// the entry adds and declares the rest, and loaded with dlopen. Later
+// entries link against the loaded ones, so nothing is compiled twice and
+// every call runs native code.
+class Repl {
+private:
+    SemanticAnalyzer semantic;
+    ProgramNode session; // every loaded definition, all marked external
+    std::vector<void (*)()> flushers; // sl_flush_output of each library
+    std::string directory;
+    std::string gccFlags;
+    int entries;
+    bool timing; // :time reports how long each entry took
+
+    bool evaluate(const std::string& text);
+    std::unique_ptr<ProgramNode> parseEntry(const std::string& text, const std::string& entryName,
+                                            bool& printResult);
+    bool load(ProgramNode* delta, const std::string& entryName, Type resultType);
+    void flushOutput();
+
+public:
+    // gccFlags are added to every compile, e.g. " -O2".
+    explicit Repl(const std::string& gccFlags);
+    ~Repl();
+    Repl(const Repl&) = delete;
+    Repl& operator=(const Repl&) = delete;
+
+    // Reads entries until end of input or :quit; :time toggles timing.
+    // Prompts when in is a terminal. Returns the exit status for slc.
+    int run(std::istream& in, bool interactive);
+};
+
+#endif // REPL_H
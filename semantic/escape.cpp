@@ -0,0 +1,311 @@
+#include "escape.h"
+
+void EscapeAnalyzer::analyze(ProgramNode* program) {
+    if (!program) return;
+
+    for (auto& func : program->functions) {
+        summaries[func->name] = std::vector<bool>(func->parameters.size(), false);
+    }
+    for (auto& templ : program->templates) {
+        for (auto& instance : templ->instances) {
+            summaries[instance->name] = std::vector<bool>(instance->parameters.size(), false);
+        }
+    }
+    for (auto& cls : program->classes) {
+        size_t count = cls->constructor ? cls->constructor->parameters.size() : 0;
+        summaries[cls->name] = std::vector<bool>(count, false);
+        if (cls->isValue) {
+            valueClasses.insert(cls->name);
+        }
+    }
+
+    // Summaries only ever switch from "stays" to "escapes", so repeating the
+    // pass until nothing changes terminates. The decisions recorded on the
+    // declarations during the last pass are consistent with the final
+    // summaries.
+    do {
+        changed = false;
+        program->accept(this);
+    } while (changed);
+}
+
+void EscapeAnalyzer::enterScope() {
+    scopes.push_back(std::map<std::string, Binding*>());
+}
+
+void EscapeAnalyzer::exitScope() {
+    if (scopes.empty()) return;
+    for (auto& entry : scopes.back()) {
+        Binding* binding = entry.second;
+        if (binding->declaration) {
+            binding->declaration->stackAllocated = !binding->escapes;
+        }
+    }
+    scopes.pop_back();
+}
+
+EscapeAnalyzer::Binding* EscapeAnalyzer::lookup(const std::string& name) {
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+        auto found = it->find(name);
+        if (found != it->end()) {
+            return found->second;
+        }
+    }
+    return nullptr;
+}
+
+// Marks the objects an expression evaluates to as escaping. Only variables
+// and ternaries pass an existing object through; calls and constructors
+// yield objects that the callee is responsible for.
+void EscapeAnalyzer::markEscape(ExpressionNode* expr) {
+    if (auto* var = dynamic_cast<VarNode*>(expr)) {
+        Binding* binding = lookup(var->name);
+        if (binding) {
+            binding->escapes = true;
+        }
+    } else if (auto* ternary = dynamic_cast<TernaryExprNode*>(expr)) {
+        markEscape(ternary->trueExpr.get());
+        markEscape(ternary->falseExpr.get());
+    }
+}
+
+void EscapeAnalyzer::analyzeBody(const std::string& summaryKey,
+                                 const std::vector<std::pair<std::string, Type>>& params, BlockNode* body) {
+    enterScope();
+    parameters.clear();
+    for (size_t i = 0; i < params.size(); ++i) {
+        bindings.push_back(std::make_unique<Binding>());
+        Binding* binding = bindings.back().get();
+        binding->parameter = static_cast<int>(i);
+        scopes.back()[params[i].first] = binding;
+        parameters.push_back(binding);
+    }
+
+    if (body) {
+        body->accept(this);
+    }
+
+    auto summary = summaries.find(summaryKey);
+    if (summary != summaries.end()) {
+        for (size_t i = 0; i < parameters.size() && i < summary->second.size(); ++i) {
+            if (parameters[i]->escapes && !summary->second[i]) {
+                summary->second[i] = true;
+                changed = true;
+            }
+        }
+    }
+
+    exitScope();
+    parameters.clear();
+    bindings.clear();
+}
+
+void EscapeAnalyzer::visit(ProgramNode* node) {
+    for (auto& templ : node->templates) {
+        templ->accept(this);
+    }
+    for (auto& cls : node->classes) {
+        cls->accept(this);
+    }
+    for (auto& func : node->functions) {
+        func->accept(this);
+    }
+}
+
+void EscapeAnalyzer::visit(DirectiveNode* node) {
+}
+
+void EscapeAnalyzer::visit(FunctionNode* node) {
+    analyzeBody(node->name, node->parameters, node->body.get());
+}
+
+void EscapeAnalyzer::visit(TemplateNode* node) {
+    for (auto& instance : node->instances) {
+        instance->accept(this);
+    }
+}
+
+void EscapeAnalyzer::visit(ClassNode* node) {
+    if (node->constructor) {
+        node->constructor->accept(this);
+    }
+    for (auto& method : node->methods) {
+        method->accept(this);
+    }
+}
+
+void EscapeAnalyzer::visit(MethodNode* node) {
+    analyzeBody("", node->parameters, node->body.get());
+}
+
+void EscapeAnalyzer::visit(ConstructorNode* node) {
+    analyzeBody(node->className, node->parameters, node->body.get());
+}
+
+void EscapeAnalyzer::visit(BlockNode* node) {
+    enterScope();
+    for (auto& stmt : node->statements) {
+        stmt->accept(this);
+    }
+    exitScope();
+}
+
+void EscapeAnalyzer::visit(VarDeclNode* node) {
+    if (node->arraySize) {
+        node->arraySize->accept(this);
+    }
+    if (node->initializer) {
+        markEscape(node->initializer.get());
+        node->initializer->accept(this);
+    }
+
+    // Every declaration gets a binding so that it shadows outer names; only
+    // locals constructed in place are candidates for the stack.
+    bindings.push_back(std::make_unique<Binding>());
+    Binding* binding = bindings.back().get();
+    auto* call = dynamic_cast<CallExprNode*>(node->initializer.get());
+    if (node->type == Type::CLASS && !node->isArray && call && call->functionName == node->className &&
+        !valueClasses.count(node->className)) {
+        binding->declaration = node;
+    }
+    if (!scopes.empty()) {
+        scopes.back()[node->name] = binding;
+    }
+}
+
+void EscapeAnalyzer::visit(VarAssignNode* node) {
+    if (node->index) {
+        node->index->accept(this);
+    }
+    if (node->value) {
+        markEscape(node->value.get());
+        node->value->accept(this);
+    }
+}
+
+void EscapeAnalyzer::visit(ReturnNode* node) {
+    if (node->value) {
+        markEscape(node->value.get());
+        node->value->accept(this);
+    }
+}
+
+void EscapeAnalyzer::visit(IfNode* node) {
+    if (node->condition) node->condition->accept(this);
+    if (node->thenBlock) node->thenBlock->accept(this);
+    if (node->elseIf) node->elseIf->accept(this);
+    if (node->elseBlock) node->elseBlock->accept(this);
+}
+
+void EscapeAnalyzer::visit(WhileNode* node) {
+    if (node->condition) node->condition->accept(this);
+    if (node->body) node->body->accept(this);
+}
+
+void EscapeAnalyzer::visit(ForNode* node) {
+    enterScope();
+    if (node->init) node->init->accept(this);
+    if (node->condition) node->condition->accept(this);
+    if (node->increment) node->increment->accept(this);
+    if (node->body) node->body->accept(this);
+    exitScope();
+}
+
+void EscapeAnalyzer::visit(BinaryExprNode* node) {
+    if (node->left) node->left->accept(this);
+    if (node->right) node->right->accept(this);
+}
+
+void EscapeAnalyzer::visit(UnaryExprNode* node) {
+    if (node->operand) node->operand->accept(this);
+}
+
+void EscapeAnalyzer::visit(CallExprNode* node) {
+    auto summary = summaries.find(node->functionName);
+    for (size_t i = 0; i < node->arguments.size(); ++i) {
+        // Built-ins and anything without a summary may keep the object.
+        bool escapes = summary == summaries.end() || i >= summary->second.size() || summary->second[i];
+        if (escapes) {
+            markEscape(node->arguments[i].get());
+        }
+        node->arguments[i]->accept(this);
+    }
+}
+
+void EscapeAnalyzer::visit(LiteralNode* node) {
+}
+
+void EscapeAnalyzer::visit(VarNode* node) {
+}
+
+void EscapeAnalyzer::visit(ArrayAccessNode* node) {
+    if (node->index) node->index->accept(this);
+}
+
+void EscapeAnalyzer::visit(IncDecNode* node) {
+}
+
+void EscapeAnalyzer::visit(IncDecExprNode* node) {
+}
+
+void EscapeAnalyzer::visit(DoWhileNode* node) {
+    if (node->body) node->body->accept(this);
+    if (node->condition) node->condition->accept(this);
+}
+
+void EscapeAnalyzer::visit(BreakNode* node) {
+}
+
+void EscapeAnalyzer::visit(ContinueNode* node) {
+}
+
+void EscapeAnalyzer::visit(SwitchNode* node) {
+    if (node->expression) node->expression->accept(this);
+    for (auto& caseNode : node->cases) {
+        caseNode->accept(this);
+    }
+    if (node->defaultCase) node->defaultCase->accept(this);
+}
+
+void EscapeAnalyzer::visit(CaseNode* node) {
+    if (node->value) node->value->accept(this);
+    if (node->block) node->block->accept(this);
+}
+
+void EscapeAnalyzer::visit(TernaryExprNode* node) {
+    if (node->condition) node->condition->accept(this);
+    if (node->trueExpr) node->trueExpr->accept(this);
+    if (node->falseExpr) node->falseExpr->accept(this);
+}
+
+// A spawned call may still be running on another worker when the spawning
+// block ends, so its arguments always escape.
+void EscapeAnalyzer::visit(SpawnNode* node) {
+    auto* call = dynamic_cast<CallExprNode*>(node->call.get());
+    if (!call) return;
+    for (auto& arg : call->arguments) {
+        markEscape(arg.get());
+    }
+    call->accept(this);
+    if (node->declaresTarget && !scopes.empty()) {
+        bindings.push_back(std::make_unique<Binding>());
+        scopes.back()[node->target] = bindings.back().get();
+    }
+}
+
+void EscapeAnalyzer::visit(SyncNode* node) {
+}
+
+void EscapeAnalyzer::visit(ExpressionStmtNode* node) {
+    if (node->expression) node->expression->accept(this);
+}
+
+// Reading a field does not leak the object that holds it.
+void EscapeAnalyzer::visit(FieldAccessNode* node) {
+    if (node->object) node->object->accept(this);
+}
+
+void EscapeAnalyzer::visit(SliceExprNode* node) {
+    if (node->low) node->low->accept(this);
+    if (node->high) node->high->accept(this);
+}
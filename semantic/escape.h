@@ -0,0 +1,83 @@
+#ifndef ESCAPE_H
+#define ESCAPE_H
+
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include "../ast/ast.h"
+
+// Finds class instances that never leave the function that constructs them.
+// An object escapes when the variable holding it is returned, copied into
+// another variable or field, spawned, or passed to a parameter that escapes
+// in turn.
+// Parameter summaries are computed for the whole program to a fixed point;
+// locals whose object does not escape are marked for stack allocation.
+class EscapeAnalyzer : public ASTVisitor {
+private:
+    struct Binding {
+        VarDeclNode* declaration = nullptr;
+        int parameter = -1;
+        bool escapes = false;
+    };
+
+    // Parameter escape flags per function, keyed by function name; class
+    // constructors are keyed by the class name.
+    std::map<std::string, std::vector<bool>> summaries;
+    // Structs are copied by value and never heap allocated.
+    std::set<std::string> valueClasses;
+    std::vector<std::map<std::string, Binding*>> scopes;
+    std::vector<std::unique_ptr<Binding>> bindings;
+    std::vector<Binding*> parameters;
+    bool changed;
+
+    void enterScope();
+    void exitScope();
+    Binding* lookup(const std::string& name);
+    void markEscape(ExpressionNode* expr);
+    void analyzeBody(const std::string& summaryKey,
+                     const std::vector<std::pair<std::string, Type>>& params, BlockNode* body);
+
+public:
+    EscapeAnalyzer() : changed(false) {}
+    ~EscapeAnalyzer() = default;
+
+    void analyze(ProgramNode* program);
+
+    // Visitor methods
+    void visit(ProgramNode* node) override;
+    void visit(DirectiveNode* node) override;
+    void visit(FunctionNode* node) override;
+    void visit(TemplateNode* node) override;
+    void visit(ClassNode* node) override;
+    void visit(MethodNode* node) override;
+    void visit(ConstructorNode* node) override;
+    void visit(BlockNode* node) override;
+    void visit(VarDeclNode* node) override;
+    void visit(VarAssignNode* node) override;
+    void visit(ReturnNode* node) override;
+    void visit(IfNode* node) override;
+    void visit(WhileNode* node) override;
+    void visit(ForNode* node) override;
+    void visit(BinaryExprNode* node) override;
+    void visit(UnaryExprNode* node) override;
+    void visit(CallExprNode* node) override;
+    void visit(LiteralNode* node) override;
+    void visit(VarNode* node) override;
+    void visit(ArrayAccessNode* node) override;
+    void visit(IncDecNode* node) override;
+    void visit(IncDecExprNode* node) override;
+    void visit(DoWhileNode* node) override;
+    void visit(BreakNode* node) override;
+    void visit(ContinueNode* node) override;
+    void visit(SwitchNode* node) override;
+    void visit(CaseNode* node) override;
+    void visit(TernaryExprNode* node) override;
+    void visit(SpawnNode* node) override;
+    void visit(SyncNode* node) override;
+    void visit(ExpressionStmtNode* node) override;
+    void visit(FieldAccessNode* node) override;
+    void visit(SliceExprNode* node) override;
+};
+
+#endif // ESCAPE_H
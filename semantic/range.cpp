@@ -0,0 +1,585 @@
+#include "range.h"
+#include <algorithm>
+
+// Vector lanes are indexed like a fixed array of this length.
+static long vectorLanes(Type type) {
+    switch (type) {
+        case Type::VEC4F:
+        case Type::VEC4D:
+            return 4;
+        case Type::VEC8F:
+        case Type::VEC8I:
+            return 8;
+        default:
+            return -1;
+    }
+}
+
+void RangeAnalyzer::analyze(ProgramNode* program) {
+    if (!program) return;
+    program->accept(this);
+}
+
+void RangeAnalyzer::enterScope() {
+    scopes.push_back(std::map<std::string, Name>());
+}
+
+void RangeAnalyzer::exitScope() {
+    if (!scopes.empty()) {
+        scopes.pop_back();
+    }
+}
+
+void RangeAnalyzer::declare(const std::string& name, const Name& info) {
+    if (!scopes.empty()) {
+        scopes.back()[name] = info;
+    }
+}
+
+const RangeAnalyzer::Name* RangeAnalyzer::lookup(const std::string& name) const {
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+        auto found = it->find(name);
+        if (found != it->end()) {
+            return &found->second;
+        }
+    }
+    return nullptr;
+}
+
+const RangeAnalyzer::Induction* RangeAnalyzer::lookupInduction(const std::string& name) const {
+    for (auto it = inductions.rbegin(); it != inductions.rend(); ++it) {
+        if (it->name == name) {
+            return &*it;
+        }
+    }
+    return nullptr;
+}
+
+// Interval arithmetic over int expressions whose operands all have a
+// compile-time range.
+RangeAnalyzer::Interval RangeAnalyzer::rangeOf(ExpressionNode* expr) const {
+    Interval result;
+    if (auto* literal = dynamic_cast<LiteralNode*>(expr)) {
+        if (literal->literalType == Type::INT) {
+            result.known = true;
+            result.low = result.high = literal->intValue;
+        }
+    } else if (auto* var = dynamic_cast<VarNode*>(expr)) {
+        const Induction* loop = lookupInduction(var->name);
+        const Name* name = lookup(var->name);
+        if (loop && !loop->low.base && !loop->high.base && loop->low.offset < loop->high.offset) {
+            result.known = true;
+            result.low = loop->low.offset;
+            result.high = loop->high.offset - 1;
+        } else if (!loop && name && name->isConstant) {
+            result.known = true;
+            result.low = result.high = name->value;
+        }
+    } else if (auto* unary = dynamic_cast<UnaryExprNode*>(expr)) {
+        Interval operand = rangeOf(unary->operand.get());
+        if (unary->op == UnaryOp::NEG && operand.known) {
+            result.known = true;
+            result.low = -operand.high;
+            result.high = -operand.low;
+        }
+    } else if (auto* bin = dynamic_cast<BinaryExprNode*>(expr)) {
+        Interval a = rangeOf(bin->left.get());
+        Interval b = rangeOf(bin->right.get());
+        if (!a.known || !b.known) return result;
+        switch (bin->op) {
+            case BinaryOp::ADD:
+                result.known = true;
+                result.low = a.low + b.low;
+                result.high = a.high + b.high;
+                break;
+            case BinaryOp::SUB:
+                result.known = true;
+                result.low = a.low - b.high;
+                result.high = a.high - b.low;
+                break;
+            case BinaryOp::MUL: {
+                long products[] = {a.low * b.low, a.low * b.high, a.high * b.low, a.high * b.high};
+                result.known = true;
+                result.low = *std::min_element(products, products + 4);
+                result.high = *std::max_element(products, products + 4);
+                break;
+            }
+            case BinaryOp::DIV:
+                if (a.low >= 0 && b.low == b.high && b.low > 0) {
+                    result.known = true;
+                    result.low = a.low / b.low;
+                    result.high = a.high / b.low;
+                }
+                break;
+            case BinaryOp::MOD:
+                if (a.low >= 0 && b.low == b.high && b.low > 0) {
+                    result.known = true;
+                    result.low = 0;
+                    result.high = std::min(a.high, b.low - 1);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return result;
+}
+
+// Splits a loop bound into a base evaluated at run time and a constant
+// offset. Bases are limited to side-effect-free forms, a variable or
+// len(variable), so a hoisted check may evaluate them again.
+bool RangeAnalyzer::parseBound(ExpressionNode* expr, Bound& bound) const {
+    Interval constant = rangeOf(expr);
+    if (constant.known && constant.low == constant.high) {
+        bound.base = nullptr;
+        bound.offset = constant.low;
+        return true;
+    }
+    if (auto* var = dynamic_cast<VarNode*>(expr)) {
+        if (var->isField || var->type != Type::INT) return false;
+        bound.base = expr;
+        bound.offset = 0;
+        return true;
+    }
+    if (auto* call = dynamic_cast<CallExprNode*>(expr)) {
+        if (call->functionName != "len" || call->arguments.size() != 1) return false;
+        auto* array = dynamic_cast<VarNode*>(call->arguments[0].get());
+        if (!array || array->isField) return false;
+        bound.base = expr;
+        bound.offset = 0;
+        return true;
+    }
+    if (auto* bin = dynamic_cast<BinaryExprNode*>(expr)) {
+        Interval right = rangeOf(bin->right.get());
+        if (!right.known || right.low != right.high) return false;
+        if (bin->op != BinaryOp::ADD && bin->op != BinaryOp::SUB) return false;
+        if (!parseBound(bin->left.get(), bound)) return false;
+        bound.offset += bin->op == BinaryOp::ADD ? right.low : -right.low;
+        return true;
+    }
+    return false;
+}
+
+// A base is stable in a loop when the loop body cannot change its value:
+// it names a local of the current function that the body never writes.
+bool RangeAnalyzer::stable(ExpressionNode* base, const Induction& loop) const {
+    if (!base) return true;
+    std::string name;
+    if (auto* var = dynamic_cast<VarNode*>(base)) {
+        name = var->name;
+    } else if (auto* call = dynamic_cast<CallExprNode*>(base)) {
+        name = static_cast<VarNode*>(call->arguments[0].get())->name;
+    }
+    const Name* info = lookup(name);
+    return info && info->local && !loop.writes.count(name);
+}
+
+bool RangeAnalyzer::isLengthOf(ExpressionNode* base, const std::string& arrayName) const {
+    auto* call = dynamic_cast<CallExprNode*>(base);
+    if (!call || call->functionName != "len") return false;
+    return static_cast<VarNode*>(call->arguments[0].get())->name == arrayName;
+}
+
+// Matches i, i + c, c + i and i - c.
+bool RangeAnalyzer::linearIndex(ExpressionNode* index, std::string& name, long& offset) const {
+    if (auto* var = dynamic_cast<VarNode*>(index)) {
+        if (var->isField) return false;
+        name = var->name;
+        offset = 0;
+        return true;
+    }
+    auto* bin = dynamic_cast<BinaryExprNode*>(index);
+    if (!bin || (bin->op != BinaryOp::ADD && bin->op != BinaryOp::SUB)) return false;
+    Interval right = rangeOf(bin->right.get());
+    if (right.known && right.low == right.high && linearIndex(bin->left.get(), name, offset)) {
+        offset += bin->op == BinaryOp::ADD ? right.low : -right.low;
+        return true;
+    }
+    Interval left = rangeOf(bin->left.get());
+    if (bin->op == BinaryOp::ADD && left.known && left.low == left.high &&
+        linearIndex(bin->right.get(), name, offset)) {
+        offset += left.low;
+        return true;
+    }
+    return false;
+}
+
+// Recognizes for (int i = a; i < b; i++) and for (int i = a; i >= b; i--),
+// including <= and >, and records the half-open range of i.
+bool RangeAnalyzer::countedLoop(ForNode* node, Induction& induction) const {
+    VarDeclNode* init = node->init.get();
+    auto* step = dynamic_cast<IncDecExprNode*>(node->increment.get());
+    auto* test = dynamic_cast<BinaryExprNode*>(node->condition.get());
+    if (!init || init->type != Type::INT || init->isArray || !init->initializer || !step || !test) {
+        return false;
+    }
+    if (step->name != init->name || step->isField) return false;
+
+    BinaryOp op = test->op;
+    ExpressionNode* limit = test->right.get();
+    auto* var = dynamic_cast<VarNode*>(test->left.get());
+    if (!var || var->name != init->name) {
+        // b > i is i < b with the operands swapped.
+        var = dynamic_cast<VarNode*>(test->right.get());
+        if (!var || var->name != init->name) return false;
+        limit = test->left.get();
+        switch (op) {
+            case BinaryOp::LT: op = BinaryOp::GT; break;
+            case BinaryOp::GT: op = BinaryOp::LT; break;
+            case BinaryOp::LE: op = BinaryOp::GE; break;
+            case BinaryOp::GE: op = BinaryOp::LE; break;
+            default: return false;
+        }
+    }
+
+    Bound start;
+    Bound end;
+    if (!parseBound(init->initializer.get(), start) || !parseBound(limit, end)) return false;
+
+    if (step->isIncrement && (op == BinaryOp::LT || op == BinaryOp::LE)) {
+        induction.low = start;
+        induction.high = end;
+        if (op == BinaryOp::LE) induction.high.offset++;
+    } else if (!step->isIncrement && (op == BinaryOp::GT || op == BinaryOp::GE)) {
+        induction.low = end;
+        if (op == BinaryOp::GT) induction.low.offset++;
+        induction.high = start;
+        induction.high.offset++;
+    } else {
+        return false;
+    }
+    induction.name = init->name;
+    induction.loop = node;
+    return true;
+}
+
+// Returns true when the access keeps its own check.
+bool RangeAnalyzer::analyzeAccess(const std::string& arrayName, ArrayKind kind, const std::string& className,
+                                  ExpressionNode* index, int line) {
+    if (kind == ArrayKind::MAP) return false; // a key lookup, not an index
+    if (writes || !index) return true;
+    total++;
+
+    const Name* array = lookup(arrayName);
+    bool fixed = kind == ArrayKind::FIXED || kind == ArrayKind::BITS;
+    long size = array && fixed ? array->arraySize : -1;
+
+    std::string var;
+    long offset = 0;
+    const Induction* loop = linearIndex(index, var, offset) ? lookupInduction(var) : nullptr;
+    if (loop) {
+        long low = loop->low.offset + offset;
+        long high = loop->high.offset + offset;
+        bool lengthStable = fixed || (array && array->local && !loop->writes.count(arrayName));
+        bool lowSafe = !loop->low.base && low >= 0;
+        bool highSafe = loop->high.base
+            ? !fixed && lengthStable && isLengthOf(loop->high.base, arrayName) &&
+              stable(loop->high.base, *loop) && high <= 0
+            : size >= 0 && high <= size;
+        if (lowSafe && highSafe) {
+            proven++;
+            return false;
+        }
+
+        if (loop->hoistable && guardDepth == loop->guardDepth && lengthStable &&
+            stable(loop->low.base, *loop) && stable(loop->high.base, *loop)) {
+            auto& checks = loop->loop->boundsChecks;
+            auto existing = std::find_if(checks.begin(), checks.end(),
+                                         [&](const BoundsCheck& check) { return check.arrayName == arrayName; });
+            if (existing != checks.end()) {
+                existing->lowOffset = std::min(existing->lowOffset, low);
+                existing->highOffset = std::max(existing->highOffset, high);
+            } else {
+                BoundsCheck check;
+                check.arrayName = arrayName;
+                check.arrayKind = kind;
+                check.className = className;
+                check.low = loop->low.base;
+                check.lowOffset = low;
+                check.high = loop->high.base;
+                check.highOffset = high;
+                check.line = line;
+                checks.push_back(check);
+            }
+            hoisted++;
+            return false;
+        }
+    }
+
+    Interval range = rangeOf(index);
+    if (range.known && size >= 0 && range.low >= 0 && range.high < size) {
+        proven++;
+        return false;
+    }
+    kept.push_back(std::make_pair(line, arrayName));
+    return true;
+}
+
+void RangeAnalyzer::analyzeBody(const std::vector<std::pair<std::string, Type>>& params, BlockNode* body) {
+    enterScope();
+    for (const auto& param : params) {
+        Name info;
+        info.local = true;
+        info.arraySize = vectorLanes(param.second);
+        declare(param.first, info);
+    }
+    if (body) {
+        body->accept(this);
+    }
+    exitScope();
+}
+
+// Code that may be skipped on some iteration of the enclosing loop.
+void RangeAnalyzer::visitGuarded(ASTNode* node) {
+    if (!node) return;
+    guardDepth++;
+    node->accept(this);
+    guardDepth--;
+}
+
+void RangeAnalyzer::visit(ProgramNode* node) {
+    enterScope();
+    for (auto& global : node->globals) {
+        global->accept(this);
+    }
+    for (auto& templ : node->templates) {
+        templ->accept(this);
+    }
+    for (auto& cls : node->classes) {
+        cls->accept(this);
+    }
+    for (auto& func : node->functions) {
+        func->accept(this);
+    }
+    exitScope();
+}
+
+void RangeAnalyzer::visit(DirectiveNode* node) {
+}
+
+void RangeAnalyzer::visit(FunctionNode* node) {
+    analyzeBody(node->parameters, node->body.get());
+}
+
+void RangeAnalyzer::visit(TemplateNode* node) {
+    for (auto& instance : node->instances) {
+        instance->accept(this);
+    }
+}
+
+void RangeAnalyzer::visit(ClassNode* node) {
+    if (node->constructor) {
+        node->constructor->accept(this);
+    }
+    for (auto& method : node->methods) {
+        method->accept(this);
+    }
+}
+
+void RangeAnalyzer::visit(MethodNode* node) {
+    analyzeBody(node->parameters, node->body.get());
+}
+
+void RangeAnalyzer::visit(ConstructorNode* node) {
+    analyzeBody(node->parameters, node->body.get());
+}
+
+void RangeAnalyzer::visit(BlockNode* node) {
+    enterScope();
+    for (auto& stmt : node->statements) {
+        stmt->accept(this);
+    }
+    exitScope();
+}
+
+void RangeAnalyzer::visit(VarDeclNode* node) {
+    if (writes) {
+        writes->insert(node->name);
+    }
+    if (node->arraySize) node->arraySize->accept(this);
+    if (node->initializer) node->initializer->accept(this);
+
+    Name info;
+    info.local = scopes.size() > 1;
+    info.arraySize = node->isArray ? -1 : vectorLanes(node->type);
+    if (node->isArray && node->arraySize) {
+        Interval size = rangeOf(node->arraySize.get());
+        if (size.known && size.low == size.high) {
+            info.arraySize = size.low;
+        }
+    } else if (node->isConst && node->type == Type::INT && node->initializer) {
+        Interval value = rangeOf(node->initializer.get());
+        if (value.known && value.low == value.high) {
+            info.isConstant = true;
+            info.value = value.low;
+        }
+    }
+    declare(node->name, info);
+}
+
+void RangeAnalyzer::visit(VarAssignNode* node) {
+    if (writes && !node->index && node->field.empty()) {
+        writes->insert(node->name);
+    }
+    if (node->index) {
+        node->index->accept(this);
+        bool check = analyzeAccess(node->name, node->arrayKind, node->objectClass, node->index.get(), node->line);
+        if (!writes) node->boundsCheck = check;
+    }
+    if (node->value) node->value->accept(this);
+}
+
+void RangeAnalyzer::visit(ReturnNode* node) {
+    if (writes) exits = true;
+    if (node->value) node->value->accept(this);
+}
+
+void RangeAnalyzer::visit(IfNode* node) {
+    if (node->condition) node->condition->accept(this);
+    visitGuarded(node->thenBlock.get());
+    visitGuarded(node->elseIf.get());
+    visitGuarded(node->elseBlock.get());
+}
+
+void RangeAnalyzer::visit(WhileNode* node) {
+    visitGuarded(node->condition.get());
+    visitGuarded(node->body.get());
+}
+
+// The condition and increment also run with i one past the range, so only
+// the body sees the induction variable's range.
+void RangeAnalyzer::visit(ForNode* node) {
+    enterScope();
+    if (node->init) node->init->accept(this);
+    if (node->condition) node->condition->accept(this);
+
+    Induction induction;
+    bool counted = !writes && countedLoop(node, induction);
+    if (counted) {
+        writes = &induction.writes;
+        exits = false;
+        if (node->body) node->body->accept(this);
+        writes = nullptr;
+        induction.hoistable = !exits;
+        counted = !induction.writes.count(induction.name);
+    }
+
+    guardDepth++;
+    if (counted) {
+        induction.guardDepth = guardDepth;
+        inductions.push_back(induction);
+    }
+    if (node->body) node->body->accept(this);
+    if (counted) {
+        inductions.pop_back();
+    }
+    if (node->increment) node->increment->accept(this);
+    guardDepth--;
+    exitScope();
+}
+
+void RangeAnalyzer::visit(BinaryExprNode* node) {
+    if (node->left) node->left->accept(this);
+    if (node->op == BinaryOp::AND || node->op == BinaryOp::OR) {
+        visitGuarded(node->right.get());
+    } else if (node->right) {
+        node->right->accept(this);
+    }
+}
+
+void RangeAnalyzer::visit(UnaryExprNode* node) {
+    if (node->operand) node->operand->accept(this);
+}
+
+// Growable arrays are the only arguments passed by reference. len,
+// reserve and shrink leave their length alone; push changes it, so a
+// check hoisted against the length before the loop would be wrong, and
+// any other call may free or replace them.
+void RangeAnalyzer::visit(CallExprNode* node) {
+    static const std::set<std::string> keepsLength = {"len", "reserve", "shrink"};
+    for (auto& arg : node->arguments) {
+        auto* var = dynamic_cast<VarNode*>(arg.get());
+        if (writes && var && var->type == Type::ARRAY && !keepsLength.count(node->functionName)) {
+            writes->insert(var->name);
+        }
+        arg->accept(this);
+    }
+}
+
+void RangeAnalyzer::visit(LiteralNode* node) {
+}
+
+void RangeAnalyzer::visit(VarNode* node) {
+}
+
+void RangeAnalyzer::visit(ArrayAccessNode* node) {
+    if (node->index) node->index->accept(this);
+    bool check = analyzeAccess(node->arrayName, node->arrayKind, node->className, node->index.get(), node->line);
+    if (!writes) node->boundsCheck = check;
+}
+
+void RangeAnalyzer::visit(IncDecNode* node) {
+    if (writes) writes->insert(node->name);
+}
+
+void RangeAnalyzer::visit(IncDecExprNode* node) {
+    if (writes) writes->insert(node->name);
+}
+
+void RangeAnalyzer::visit(DoWhileNode* node) {
+    visitGuarded(node->body.get());
+    visitGuarded(node->condition.get());
+}
+
+void RangeAnalyzer::visit(BreakNode* node) {
+    if (writes) exits = true;
+}
+
+void RangeAnalyzer::visit(ContinueNode* node) {
+    if (writes) exits = true;
+}
+
+void RangeAnalyzer::visit(SwitchNode* node) {
+    if (node->expression) node->expression->accept(this);
+    for (auto& caseNode : node->cases) {
+        visitGuarded(caseNode.get());
+    }
+    visitGuarded(node->defaultCase.get());
+}
+
+void RangeAnalyzer::visit(CaseNode* node) {
+    if (node->value) node->value->accept(this);
+    if (node->block) node->block->accept(this);
+}
+
+void RangeAnalyzer::visit(TernaryExprNode* node) {
+    if (node->condition) node->condition->accept(this);
+    visitGuarded(node->trueExpr.get());
+    visitGuarded(node->falseExpr.get());
+}
+
+void RangeAnalyzer::visit(SpawnNode* node) {
+    if (writes) writes->insert(node->target);
+    if (node->call) node->call->accept(this);
+    if (node->declaresTarget) {
+        Name info;
+        info.local = true;
+        declare(node->target, info);
+    }
+}
+
+void RangeAnalyzer::visit(SyncNode* node) {
+}
+
+void RangeAnalyzer::visit(ExpressionStmtNode* node) {
+    if (node->expression) node->expression->accept(this);
+}
+
+void RangeAnalyzer::visit(FieldAccessNode* node) {
+    if (node->object) node->object->accept(this);
+}
+
+void RangeAnalyzer::visit(SliceExprNode* node) {
+    if (node->low) node->low->accept(this);
+    if (node->high) node->high->accept(this);
+}
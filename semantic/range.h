@@ -0,0 +1,128 @@
+#ifndef RANGE_H
+#define RANGE_H
+
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include "../ast/ast.h"
+
+// Decides which array indexes need a run-time bounds check. Ranges come
+// from constant array sizes, const ints and the induction variables of
+// counted for loops (for (int i = a; i < b; i++) and its descending form,
+// with i never written in the body).
+// An index proven to stay in range loses its check. An index that cannot
+// be proven but only depends on bounds that are fixed for the whole loop
+// is checked once in front of the loop instead, provided the loop runs
+// every iteration and the access happens on each of them.
+class RangeAnalyzer : public ASTVisitor {
+private:
+    // value = base + offset; a null base is a constant.
+    struct Bound {
+        ExpressionNode* base = nullptr;
+        long offset = 0;
+    };
+
+    struct Induction {
+        std::string name;
+        Bound low;  // inclusive
+        Bound high; // exclusive
+        ForNode* loop;
+        int guardDepth;      // accesses deeper than this may be skipped
+        bool hoistable;      // the body runs for every value of the range
+        std::set<std::string> writes; // names the body assigns or may shrink
+    };
+
+    struct Name {
+        long arraySize = -1; // fixed arrays whose size is a compile-time constant
+        bool local = false;  // declared in the function being analyzed
+        bool isConstant = false;
+        long value = 0;
+    };
+
+    struct Interval {
+        bool known = false;
+        long low = 0;
+        long high = 0; // inclusive
+    };
+
+    std::vector<std::map<std::string, Name>> scopes;
+    std::vector<Induction> inductions;
+    int guardDepth;
+
+    // Set while a loop body is scanned for writes instead of analyzed.
+    std::set<std::string>* writes;
+    bool exits;
+
+    int total;
+    int proven;
+    int hoisted;
+    std::vector<std::pair<int, std::string>> kept;
+
+    void enterScope();
+    void exitScope();
+    void declare(const std::string& name, const Name& info);
+    const Name* lookup(const std::string& name) const;
+    const Induction* lookupInduction(const std::string& name) const;
+
+    Interval rangeOf(ExpressionNode* expr) const;
+    bool parseBound(ExpressionNode* expr, Bound& bound) const;
+    bool stable(ExpressionNode* base, const Induction& loop) const;
+    bool isLengthOf(ExpressionNode* base, const std::string& arrayName) const;
+    bool linearIndex(ExpressionNode* index, std::string& name, long& offset) const;
+    bool countedLoop(ForNode* node, Induction& induction) const;
+    bool analyzeAccess(const std::string& arrayName, ArrayKind kind, const std::string& className,
+                       ExpressionNode* index, int line);
+    void analyzeBody(const std::vector<std::pair<std::string, Type>>& params, BlockNode* body);
+    void visitGuarded(ASTNode* node);
+
+public:
+    RangeAnalyzer()
+        : guardDepth(0), writes(nullptr), exits(false), total(0), proven(0), hoisted(0) {}
+    ~RangeAnalyzer() = default;
+
+    void analyze(ProgramNode* program);
+
+    int getTotal() const { return total; }
+    int getProven() const { return proven; }
+    int getHoisted() const { return hoisted; }
+    // Source line and array name of every access that keeps its check.
+    const std::vector<std::pair<int, std::string>>& getKept() const { return kept; }
+
+    // Visitor methods
+    void visit(ProgramNode* node) override;
+    void visit(DirectiveNode* node) override;
+    void visit(FunctionNode* node) override;
+    void visit(TemplateNode* node) override;
+    void visit(ClassNode* node) override;
+    void visit(MethodNode* node) override;
+    void visit(ConstructorNode* node) override;
+    void visit(BlockNode* node) override;
+    void visit(VarDeclNode* node) override;
+    void visit(VarAssignNode* node) override;
+    void visit(ReturnNode* node) override;
+    void visit(IfNode* node) override;
+    void visit(WhileNode* node) override;
+    void visit(ForNode* node) override;
+    void visit(BinaryExprNode* node) override;
+    void visit(UnaryExprNode* node) override;
+    void visit(CallExprNode* node) override;
+    void visit(LiteralNode* node) override;
+    void visit(VarNode* node) override;
+    void visit(ArrayAccessNode* node) override;
+    void visit(IncDecNode* node) override;
+    void visit(IncDecExprNode* node) override;
+    void visit(DoWhileNode* node) override;
+    void visit(BreakNode* node) override;
+    void visit(ContinueNode* node) override;
+    void visit(SwitchNode* node) override;
+    void visit(CaseNode* node) override;
+    void visit(TernaryExprNode* node) override;
+    void visit(SpawnNode* node) override;
+    void visit(SyncNode* node) override;
+    void visit(ExpressionStmtNode* node) override;
+    void visit(FieldAccessNode* node) override;
+    void visit(SliceExprNode* node) override;
+};
+
+#endif // RANGE_H
@@ -1,7 +1,37 @@
 #include "semantic.h"
+#include "template.h"
 #include <sstream>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
 extern int yylineno;
 
+static ArrayKind arrayKindOf(const Symbol& sym) {
+    if (sym.type == Type::ARRAY) return ArrayKind::DYNAMIC;
+    if (sym.type == Type::SLICE) return ArrayKind::SLICE;
+    if (sym.type == Type::MAP) return ArrayKind::MAP;
+    if (sym.isArray && sym.type == Type::BOOL) return ArrayKind::BITS;
+    return ArrayKind::FIXED;
+}
+
+// Type name of what indexing sym yields, for everything but fixed arrays.
+static std::string elementNameOf(const Symbol& sym) {
+    if (sym.type == Type::MAP) return mapValueName(sym.className);
+    if (arrayKindOf(sym) == ArrayKind::BITS) return "bool";
+    return sym.className;
+}
+
+// Usual arithmetic conversions between two integer types: the wider type
+// wins, and at equal width an unsigned type wins over a signed one.
+static Type promoteIntegers(Type left, Type right) {
+    if (integerBits(left) != integerBits(right)) {
+        return integerBits(left) > integerBits(right) ? left : right;
+    }
+    if (isUnsignedType(right)) return right;
+    if (isUnsignedType(left) || left == Type::INT) return left;
+    return right;
+}
+
 void SemanticAnalyzer::enterScope() {
     scopes.push_back(std::map<std::string, Symbol>());
 }
@@ -12,7 +42,8 @@ void SemanticAnalyzer::exitScope() {
     }
 }
 
-void SemanticAnalyzer::declareSymbol(const std::string& name, Type type) {
+void SemanticAnalyzer::declareSymbol(const std::string& name, Type type, bool isArray,
+                                     const std::string& className) {
     if (!scopes.empty()) {
         if (scopes.back().find(name) != scopes.back().end()) {
             std::stringstream ss;
@@ -23,11 +54,94 @@ void SemanticAnalyzer::declareSymbol(const std::string& name, Type type) {
             sym.name = name;
             sym.type = type;
             sym.isFunction = false;
+            sym.isArray = isArray;
+            sym.className = className;
             scopes.back()[name] = sym;
         }
     }
 }
 
+void SemanticAnalyzer::declareBuiltin(const std::string& name, Type returnType,
+                                      const std::vector<Type>& paramTypes,
+                                      const std::vector<bool>& arrayParams,
+                                      const std::string& returnClass,
+                                      const std::vector<std::string>& paramClasses) {
+    Symbol sym;
+    sym.name = name;
+    sym.type = returnType;
+    sym.isFunction = true;
+    sym.isBuiltin = true;
+    sym.returnType = returnType;
+    sym.returnClass = returnClass;
+    sym.paramTypes = paramTypes;
+    sym.paramClasses = paramClasses;
+    sym.arrayParams = arrayParams;
+    sym.arrayParams.resize(paramTypes.size(), false);
+    functions[name] = sym;
+}
+
+void SemanticAnalyzer::registerBuiltins() {
+    for (Type vec : {Type::VEC4F, Type::VEC8F, Type::VEC4D, Type::VEC8I}) {
+        std::string prefix = typeToString(vec);
+        Type element = vectorElementType(vec);
+        declareBuiltin(prefix + "_load", vec, {element, Type::INT}, {true, false});
+        declareBuiltin(prefix + "_store", Type::VOID, {element, Type::INT, vec}, {true, false, false});
+        declareBuiltin(prefix + "_splat", vec, {element}, {});
+        declareBuiltin(prefix + "_sum", element, {vec}, {});
+    }
+    declareBuiltin("str_len", Type::INT, {Type::STRING}, {});
+    declareBuiltin("str_reset", Type::VOID, {}, {});
+
+    // Growable array built-ins accept any element type; push checks its
+    // value against the element type of the array at each call.
+    declareBuiltin("push", Type::VOID, {Type::ARRAY, Type::VOID}, {});
+    declareBuiltin("reserve", Type::VOID, {Type::ARRAY, Type::INT}, {});
+    declareBuiltin("len", Type::INT, {Type::ARRAY}, {});
+    declareBuiltin("shrink", Type::VOID, {Type::ARRAY}, {});
+    declareBuiltin("array_free", Type::VOID, {Type::ARRAY}, {});
+
+    // Map built-ins check their key against the key type of the map.
+    declareBuiltin("has", Type::BOOL, {Type::MAP, Type::VOID}, {});
+    declareBuiltin("remove", Type::BOOL, {Type::MAP, Type::VOID}, {});
+    declareBuiltin("map_free", Type::VOID, {Type::MAP}, {});
+
+    // Packed bool arrays: whole-array operations a word at a time.
+    declareBuiltin("bits_count", Type::INT, {Type::BOOL}, {true});
+    declareBuiltin("bits_fill", Type::VOID, {Type::BOOL, Type::BOOL}, {true, false});
+
+    // Buffered standard I/O.
+    declareBuiltin("write_int", Type::VOID, {Type::I64}, {});
+    declareBuiltin("write_uint", Type::VOID, {Type::U64}, {});
+    declareBuiltin("write_double", Type::VOID, {Type::DOUBLE}, {});
+    declareBuiltin("write_bool", Type::VOID, {Type::BOOL}, {});
+    declareBuiltin("write_str", Type::VOID, {Type::STRING}, {});
+    declareBuiltin("write_newline", Type::VOID, {}, {});
+    declareBuiltin("flush", Type::VOID, {}, {});
+    declareBuiltin("read_line", Type::STRING, {}, {});
+    declareBuiltin("at_eof", Type::BOOL, {}, {});
+
+    // Memory-mapped files, seen as u8 slices over the mapping.
+    declareBuiltin("map_file", Type::SLICE, {Type::STRING}, {}, "u8");
+    declareBuiltin("map_window", Type::SLICE, {Type::STRING, Type::I64, Type::INT}, {}, "u8");
+    declareBuiltin("file_size", Type::I64, {Type::STRING}, {});
+    declareBuiltin("unmap", Type::VOID, {Type::SLICE}, {}, "", {"u8"});
+    declareBuiltin("str_view", Type::STRING, {Type::SLICE}, {}, "", {"u8"});
+
+    // Asynchronous whole-file reads, identified by request id.
+    declareBuiltin("read_async", Type::INT, {Type::STRING}, {});
+    declareBuiltin("await_read", Type::STRING, {Type::INT}, {});
+    declareBuiltin("await_any", Type::INT, {}, {});
+}
+
+void SemanticAnalyzer::declareParameters(const std::vector<std::pair<std::string, Type>>& parameters,
+                                         const std::vector<std::string>& parameterClasses, int line) {
+    for (size_t i = 0; i < parameters.size(); ++i) {
+        std::string className = i < parameterClasses.size() ? parameterClasses[i] : "";
+        checkClassName(className, line);
+        declareSymbol(parameters[i].first, parameters[i].second, false, className);
+    }
+}
+
 Symbol* SemanticAnalyzer::lookupSymbol(const std::string& name) {
     for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
         auto found = it->find(name);
@@ -38,6 +152,38 @@ Symbol* SemanticAnalyzer::lookupSymbol(const std::string& name) {
     return nullptr;
 }
 
+int SemanticAnalyzer::lookupSymbolScope(const std::string& name) {
+    for (int i = static_cast<int>(scopes.size()) - 1; i >= 0; --i) {
+        if (scopes[i].find(name) != scopes[i].end()) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void SemanticAnalyzer::checkParallelWrite(const std::string& name, int line) {
+    if (parallelScopeBase < 0) return;
+
+    if (name == parallelInductionVar) {
+        std::stringstream ss;
+        ss << "Line " << line << ": parallel for body must not modify loop variable '" << name << "'";
+        errors.push_back(ss.str());
+        return;
+    }
+
+    int scope = lookupSymbolScope(name);
+    if (scope < 0 || scope >= parallelScopeBase) return;
+
+    for (const auto& reduction : parallelReductions) {
+        if (reduction.second == name) return;
+    }
+
+    std::stringstream ss;
+    ss << "Line " << line << ": parallel for body writes to shared variable '" << name
+       << "' outside a reduction";
+    errors.push_back(ss.str());
+}
+
 Symbol* SemanticAnalyzer::lookupFunction(const std::string& name) {
     auto found = functions.find(name);
     if (found != functions.end()) {
@@ -46,6 +192,114 @@ Symbol* SemanticAnalyzer::lookupFunction(const std::string& name) {
     return nullptr;
 }
 
+void SemanticAnalyzer::declareFunction(FunctionNode* func) {
+    Symbol sym;
+    sym.name = func->name;
+    sym.type = func->returnType;
+    sym.isFunction = true;
+    sym.returnType = func->returnType;
+    sym.returnClass = func->returnClass;
+    sym.paramClasses = func->parameterClasses;
+    for (auto& param : func->parameters) {
+        sym.paramTypes.push_back(param.second);
+    }
+    if (reservedBuiltin(func->name)) {
+        // Calls are checked against the user's signature, so the clash is
+        // reported once rather than at every call.
+        functions[func->name] = sym;
+    } else if (functions.find(func->name) != functions.end() || templates.count(func->name)) {
+        std::stringstream ss;
+        ss << "Function '" << func->name << "' already declared";
+        errors.push_back(ss.str());
+    } else {
+        functions[func->name] = sym;
+    }
+}
+
+// Built-ins are lowered by name in every backend, so a user function cannot
+// take the name of one.
+bool SemanticAnalyzer::reservedBuiltin(const std::string& name) {
+    auto found = functions.find(name);
+    if (found == functions.end() || !found->second.isBuiltin) {
+        return false;
+    }
+    std::stringstream ss;
+    ss << "Function '" << name << "' is a reserved built-in name";
+    errors.push_back(ss.str());
+    return true;
+}
+
+// Deduces the template parameter from the arguments, instantiates the
+// template for it once and points the call at that instance. Parameters
+// declared T take the argument's type; T[] and T[:] take its element type.
+void SemanticAnalyzer::checkTemplateCall(CallExprNode* node, TemplateNode* templ) {
+    FunctionNode* generic = templ->function.get();
+    const std::string& param = templ->templateParam;
+    if (generic->parameters.size() != node->arguments.size()) {
+        std::stringstream ss;
+        ss << "Function '" << node->functionName << "' expects "
+           << generic->parameters.size() << " arguments but got "
+           << node->arguments.size();
+        errors.push_back(ss.str());
+        return;
+    }
+
+    std::string typeName;
+    for (size_t i = 0; i < node->arguments.size(); ++i) {
+        ExpressionNode* arg = node->arguments[i].get();
+        arg->accept(this);
+        Type argType = inferType(arg);
+        Type paramType = generic->parameters[i].second;
+        if (i >= generic->parameterClasses.size() || generic->parameterClasses[i] != param) continue;
+
+        std::string deduced;
+        if (paramType == Type::CLASS) {
+            if (argType == Type::CLASS) {
+                deduced = arg->className;
+            } else if (argType != Type::ARRAY && argType != Type::SLICE && argType != Type::MAP &&
+                       argType != Type::VOID) {
+                deduced = typeToString(argType);
+            }
+        } else if ((paramType == Type::ARRAY || paramType == Type::SLICE) && argType == paramType) {
+            deduced = arg->className;
+        }
+        if (deduced.empty()) continue;
+        if (!typeName.empty() && typeName != deduced) {
+            std::stringstream ss;
+            ss << "Line " << node->line << ": Template parameter '" << param << "' of '" << generic->name
+               << "' deduced as both " << typeName << " and " << deduced;
+            errors.push_back(ss.str());
+            return;
+        }
+        typeName = deduced;
+    }
+    if (typeName.empty()) {
+        std::stringstream ss;
+        ss << "Line " << node->line << ": Cannot deduce template parameter '" << param << "' of '"
+           << generic->name << "'";
+        errors.push_back(ss.str());
+        return;
+    }
+
+    std::string name = templateInstanceName(generic->name, typeName);
+    if (!functions.count(name)) {
+        templ->instances.push_back(instantiateTemplate(templ, typeName, name));
+        FunctionNode* instance = templ->instances.back().get();
+        declareFunction(instance);
+        pendingInstances.push_back(instance);
+    }
+    node->functionName = name;
+
+    Symbol* func = lookupFunction(name);
+    node->type = func->returnType;
+    node->className = func->returnClass;
+    for (size_t i = 0; i < node->arguments.size(); ++i) {
+        checkType(func->paramTypes[i], inferType(node->arguments[i].get()), "Function argument");
+        checkLiteral(func->paramTypes[i], node->arguments[i].get());
+        checkClass(func->paramClasses[i], node->arguments[i].get(), "Function argument");
+    }
+}
+
 Type SemanticAnalyzer::inferType(ExpressionNode* expr) {
     if (!expr) return Type::VOID;
     
@@ -57,7 +311,31 @@ Type SemanticAnalyzer::inferType(ExpressionNode* expr) {
             return sym->type;
         }
         return Type::VOID;
+    } else if (auto* arr = dynamic_cast<ArrayAccessNode*>(expr)) {
+        Symbol* sym = lookupSymbol(arr->arrayName);
+        if (sym && arrayKindOf(*sym) != ArrayKind::FIXED) {
+            return arrayElementType(elementNameOf(*sym));
+        }
+        if (sym) {
+            return vectorElementType(sym->type);
+        }
+        return Type::VOID;
+    } else if (auto* incDec = dynamic_cast<IncDecExprNode*>(expr)) {
+        Symbol* sym = lookupSymbol(incDec->name);
+        if (sym) {
+            return sym->type;
+        }
+        return Type::VOID;
+    } else if (auto* ternary = dynamic_cast<TernaryExprNode*>(expr)) {
+        return inferType(ternary->trueExpr.get());
+    } else if (auto* access = dynamic_cast<FieldAccessNode*>(expr)) {
+        return access->type;
+    } else if (auto* slice = dynamic_cast<SliceExprNode*>(expr)) {
+        return slice->type;
     } else if (auto* call = dynamic_cast<CallExprNode*>(expr)) {
+        if (classes.count(call->functionName)) {
+            return Type::CLASS;
+        }
         Symbol* func = lookupFunction(call->functionName);
         if (func) {
             return func->returnType;
@@ -75,11 +353,12 @@ Type SemanticAnalyzer::inferType(ExpressionNode* expr) {
         }
         
         if (left == right) return left;
-        if ((left == Type::INT || left == Type::FLOAT || left == Type::DOUBLE) &&
-            (right == Type::INT || right == Type::FLOAT || right == Type::DOUBLE)) {
+        if (isVectorType(left) && !isVectorType(right)) return left;
+        if (isVectorType(right) && !isVectorType(left)) return right;
+        if (isNumericType(left) && isNumericType(right)) {
             if (left == Type::DOUBLE || right == Type::DOUBLE) return Type::DOUBLE;
             if (left == Type::FLOAT || right == Type::FLOAT) return Type::FLOAT;
-            return Type::INT;
+            return promoteIntegers(left, right);
         }
         
         return Type::VOID;
@@ -97,8 +376,7 @@ bool SemanticAnalyzer::checkType(Type expected, Type actual, const std::string&
     if (expected == actual) return true;
     if (expected == Type::VOID || actual == Type::VOID) return false;
 
-    if ((expected == Type::INT || expected == Type::FLOAT || expected == Type::DOUBLE) &&
-        (actual == Type::INT || actual == Type::FLOAT || actual == Type::DOUBLE)) {
+    if (isNumericType(expected) && isNumericType(actual)) {
         return true;
     }
     
@@ -109,29 +387,210 @@ bool SemanticAnalyzer::checkType(Type expected, Type actual, const std::string&
     return false;
 }
 
+// An integer literal, negated or not, has to fit the type it initializes,
+// is assigned to or is passed as; C would silently truncate it.
+void SemanticAnalyzer::checkLiteral(Type expected, ExpressionNode* expr) {
+    bool negated = false;
+    auto* literal = dynamic_cast<LiteralNode*>(expr);
+    auto* unary = dynamic_cast<UnaryExprNode*>(expr);
+    if (unary && unary->op == UnaryOp::NEG) {
+        literal = dynamic_cast<LiteralNode*>(unary->operand.get());
+        negated = true;
+    }
+    if (!literal || (literal->literalType != Type::INT && literal->literalType != Type::I64)) return;
+    long value = negated ? -literal->intValue : literal->intValue;
+    long low = LONG_MIN;
+    long high = LONG_MAX;
+    switch (expected) {
+        case Type::INT: case Type::I32: low = INT32_MIN; high = INT32_MAX; break;
+        case Type::I8: low = INT8_MIN; high = INT8_MAX; break;
+        case Type::I16: low = INT16_MIN; high = INT16_MAX; break;
+        case Type::U8: low = 0; high = UINT8_MAX; break;
+        case Type::U16: low = 0; high = UINT16_MAX; break;
+        case Type::U32: low = 0; high = UINT32_MAX; break;
+        case Type::U64: low = 0; break;
+        case Type::I64: break;
+        default: return;
+    }
+    if (value < low || value > high) {
+        std::stringstream ss;
+        ss << "Line " << literal->line << ": Integer literal " << value << " out of range for "
+           << typeToString(expected);
+        errors.push_back(ss.str());
+    }
+}
+
+void SemanticAnalyzer::checkClassName(const std::string& className, int line) {
+    if (className.empty()) return;
+    if (className.find(',') != std::string::npos) {
+        Type key = arrayElementType(mapKeyName(className));
+        Type value = arrayElementType(mapValueName(className));
+        std::stringstream ss;
+        if (key != Type::INT && key != Type::DOUBLE && key != Type::STRING) {
+            ss << "Line " << line << ": Map keys must be int, double or string";
+            errors.push_back(ss.str());
+        } else if (value == Type::VOID || isVectorType(value)) {
+            ss << "Line " << line << ": Map values cannot be " << mapValueName(className);
+            errors.push_back(ss.str());
+        } else {
+            checkClassName(mapValueName(className), line);
+        }
+        return;
+    }
+    if (arrayElementType(className) != Type::CLASS) return; // element of a built-in array type
+    if (classes.find(className) == classes.end()) {
+        std::stringstream ss;
+        ss << "Line " << line << ": Unknown type '" << className << "'";
+        errors.push_back(ss.str());
+    }
+}
+
+void SemanticAnalyzer::checkClass(const std::string& expected, ExpressionNode* expr, const std::string& context) {
+    if (expected.empty() || !expr) return;
+    if (expr->type != Type::CLASS && expr->type != Type::ARRAY && expr->type != Type::SLICE &&
+        expr->type != Type::MAP) return;
+    if (expr->className != expected) {
+        std::stringstream ss;
+        ss << context << ": type mismatch, expected " << expected << " but got " << expr->className;
+        errors.push_back(ss.str());
+    }
+}
+
+// A value class embeds its fields, so a value-class field must name a
+// struct declared earlier; this also rules out recursive layouts.
+void SemanticAnalyzer::checkFields(ClassNode* cls, const std::set<std::string>& declared) {
+    std::set<std::string> names;
+    for (const auto& field : cls->fields) {
+        std::stringstream ss;
+        if (!names.insert(field.name).second) {
+            ss << "Line " << field.line << ": Field '" << field.name << "' already declared in class '"
+               << cls->name << "'";
+            errors.push_back(ss.str());
+            continue;
+        }
+        if (field.type == Type::VOID) {
+            ss << "Line " << field.line << ": Field '" << field.name << "' cannot be void";
+            errors.push_back(ss.str());
+            continue;
+        }
+        checkClassName(field.className, field.line);
+        auto fieldClass = classes.find(field.className);
+        if (fieldClass != classes.end() && fieldClass->second->isValue && !declared.count(field.className)) {
+            ss << "Line " << field.line << ": Struct '" << field.className
+               << "' must be declared before it is embedded in '" << cls->name << "'";
+            errors.push_back(ss.str());
+        }
+    }
+}
+
+const FieldDecl* SemanticAnalyzer::lookupField(const std::string& className, const std::string& field, int line) {
+    auto cls = classes.find(className);
+    if (cls == classes.end()) return nullptr;
+    for (const auto& decl : cls->second->fields) {
+        if (decl.name != field) continue;
+        if (decl.isPrivate && className != currentClass) {
+            std::stringstream ss;
+            ss << "Line " << line << ": Field '" << field << "' of class '" << className << "' is private";
+            errors.push_back(ss.str());
+        }
+        return &decl;
+    }
+    std::stringstream ss;
+    ss << "Line " << line << ": Class '" << className << "' has no field '" << field << "'";
+    errors.push_back(ss.str());
+    return nullptr;
+}
+
+void SemanticAnalyzer::checkLoopAnnotations(const std::vector<LoopAnnotation>& annotations, int line, bool isFor) {
+    bool hasSimd = false;
+    bool hasUnroll = false;
+
+    for (const auto& annotation : annotations) {
+        std::stringstream ss;
+        if (annotation.name == "simd") {
+            hasSimd = true;
+            if (!isFor) {
+                ss << "Line " << line << ": @simd can only be applied to a for loop";
+                errors.push_back(ss.str());
+            }
+        } else if (annotation.name == "unroll") {
+            hasUnroll = true;
+            if (annotation.argument <= 0) {
+                ss << "Line " << line << ": @unroll requires a positive unroll factor";
+                errors.push_back(ss.str());
+            }
+        } else if (annotation.name != "noalias") {
+            ss << "Line " << line << ": Unknown loop annotation '@" << annotation.name << "'";
+            errors.push_back(ss.str());
+        }
+    }
+
+    if (hasSimd && hasUnroll) {
+        std::stringstream ss;
+        ss << "Line " << line << ": @unroll cannot be combined with @simd";
+        errors.push_back(ss.str());
+    }
+}
+
 bool SemanticAnalyzer::analyze(ProgramNode* program) {
     if (!program) return false;
     program->accept(this);
     return errors.empty();
 }
 
+bool SemanticAnalyzer::analyzeDelta(ProgramNode* delta) {
+    snapshot.globals = scopes.front();
+    snapshot.functions = functions;
+    snapshot.classes = classes;
+    snapshot.templates = templates;
+    snapshot.instanceCounts.clear();
+    for (const auto& templ : templates) {
+        snapshot.instanceCounts[templ.second] = templ.second->instances.size();
+    }
+    errors.clear();
+    return analyze(delta);
+}
+
+void SemanticAnalyzer::rollback() {
+    scopes.resize(1);
+    scopes.front() = snapshot.globals;
+    functions = snapshot.functions;
+    classes = snapshot.classes;
+    templates = snapshot.templates;
+    for (const auto& count : snapshot.instanceCounts) {
+        count.first->instances.resize(count.second);
+    }
+    pendingInstances.clear();
+    currentClass.clear();
+    parallelScopeBase = -1;
+}
+
 void SemanticAnalyzer::visit(ProgramNode* node) {
-    for (auto& func : node->functions) {
-        Symbol sym;
-        sym.name = func->name;
-        sym.type = func->returnType;
-        sym.isFunction = true;
-        sym.returnType = func->returnType;
-        for (auto& param : func->parameters) {
-            sym.paramTypes.push_back(param.second);
-        }
-        if (functions.find(func->name) != functions.end()) {
+    for (auto& cls : node->classes) {
+        if (classes.find(cls->name) != classes.end()) {
             std::stringstream ss;
-            ss << "Function '" << func->name << "' already declared";
+            ss << "Line " << cls->line << ": Class '" << cls->name << "' already declared";
             errors.push_back(ss.str());
-        } else {
-            functions[func->name] = sym;
+            continue;
         }
+        classes[cls->name] = cls.get();
+        if (cls->isValue) continue;
+
+        // Generated pool helpers: release one instance, or every instance
+        // allocated by the current thread.
+        declareBuiltin(cls->name + "_free", Type::VOID, {Type::CLASS}, {});
+        functions[cls->name + "_free"].paramClasses = {cls->name};
+        declareBuiltin(cls->name + "_reset", Type::VOID, {}, {});
+    }
+
+    std::set<std::string> declared;
+    for (auto& cls : node->classes) {
+        checkFields(cls.get(), declared);
+        declared.insert(cls->name);
+    }
+
+    for (auto& func : node->functions) {
+        declareFunction(func.get());
     }
 
     for (auto& templ : node->templates) {
@@ -153,6 +612,13 @@ void SemanticAnalyzer::visit(ProgramNode* node) {
     for (auto& func : node->functions) {
         func->accept(this);
     }
+
+    // Checking an instance can instantiate further templates.
+    while (!pendingInstances.empty()) {
+        FunctionNode* instance = pendingInstances.back();
+        pendingInstances.pop_back();
+        instance->accept(this);
+    }
 }
 
 void SemanticAnalyzer::visit(DirectiveNode* node) {
@@ -161,9 +627,8 @@ void SemanticAnalyzer::visit(DirectiveNode* node) {
 void SemanticAnalyzer::visit(FunctionNode* node) {
     enterScope();
 
-    for (auto& param : node->parameters) {
-        declareSymbol(param.first, param.second);
-    }
+    checkClassName(node->returnClass, node->line);
+    declareParameters(node->parameters, node->parameterClasses, node->line);
 
     if (node->body) {
         node->body->accept(this);
@@ -172,16 +637,44 @@ void SemanticAnalyzer::visit(FunctionNode* node) {
     exitScope();
 }
 
+// A template is only checked through its instances.
 void SemanticAnalyzer::visit(TemplateNode* node) {
-    if (node->function) {
-        node->function->accept(this);
+    const std::string& name = node->function->name;
+    if (reservedBuiltin(name)) {
+        templates[name] = node;
+        return;
     }
+    if (functions.count(name) || templates.count(name)) {
+        std::stringstream ss;
+        ss << "Function '" << name << "' already declared";
+        errors.push_back(ss.str());
+        return;
+    }
+    templates[name] = node;
 }
 
 void SemanticAnalyzer::visit(ClassNode* node) {
     enterScope();
+    currentClass = node->name;
+
+    for (const auto& annotation : node->annotations) {
+        std::stringstream ss;
+        if (annotation != "soa") {
+            ss << "Line " << node->line << ": Unknown class annotation '@" << annotation << "'";
+            errors.push_back(ss.str());
+        } else if (!node->isValue) {
+            ss << "Line " << node->line << ": @soa can only be applied to a struct";
+            errors.push_back(ss.str());
+        }
+    }
 
     if (node->constructor) {
+        if (node->constructor->className != node->name) {
+            std::stringstream ss;
+            ss << "Line " << node->constructor->line << ": Constructor '" << node->constructor->className
+               << "' does not match class '" << node->name << "'";
+            errors.push_back(ss.str());
+        }
         node->constructor->accept(this);
     }
 
@@ -189,15 +682,15 @@ void SemanticAnalyzer::visit(ClassNode* node) {
         method->accept(this);
     }
 
+    currentClass.clear();
     exitScope();
 }
 
 void SemanticAnalyzer::visit(MethodNode* node) {
     enterScope();
 
-    for (auto& param : node->parameters) {
-        declareSymbol(param.first, param.second);
-    }
+    checkClassName(node->returnClass, node->line);
+    declareParameters(node->parameters, node->parameterClasses, node->line);
 
     if (node->body) {
         node->body->accept(this);
@@ -206,18 +699,28 @@ void SemanticAnalyzer::visit(MethodNode* node) {
     exitScope();
 }
 
+// Fields are in scope inside the constructor body, which initializes the
+// object in place; parameters shadow fields of the same name.
 void SemanticAnalyzer::visit(ConstructorNode* node) {
     enterScope();
-
-    for (auto& param : node->parameters) {
-        declareSymbol(param.first, param.second);
+    auto cls = classes.find(node->className);
+    if (cls != classes.end()) {
+        for (const auto& field : cls->second->fields) {
+            if (scopes.back().count(field.name)) continue;
+            declareSymbol(field.name, field.type, false, field.className);
+            scopes.back()[field.name].isField = true;
+        }
     }
 
+    enterScope();
+    declareParameters(node->parameters, node->parameterClasses, node->line);
+
     if (node->body) {
         node->body->accept(this);
     }
 
     exitScope();
+    exitScope();
 }
 
 void SemanticAnalyzer::visit(BlockNode* node) {
@@ -229,13 +732,30 @@ void SemanticAnalyzer::visit(BlockNode* node) {
 }
 
 void SemanticAnalyzer::visit(VarDeclNode* node) {
-    declareSymbol(node->name, node->type);
+    checkClassName(node->className, node->line);
+
+    auto cls = classes.find(node->className);
+    if (node->isArray && !node->arraySize && cls != classes.end() &&
+        std::count(cls->second->annotations.begin(), cls->second->annotations.end(), "soa")) {
+        std::stringstream ss;
+        ss << "Line " << node->line << ": Array of @soa struct '" << node->className << "' needs a size";
+        errors.push_back(ss.str());
+    }
+    if (node->isArray && node->type == Type::MAP) {
+        std::stringstream ss;
+        ss << "Line " << node->line << ": Arrays of maps are not supported";
+        errors.push_back(ss.str());
+    }
     
     if (node->initializer) {
         node->initializer->accept(this);
         Type initType = inferType(node->initializer.get());
         checkType(node->type, initType, "Variable initialization");
+        checkLiteral(node->type, node->initializer.get());
+        checkClass(node->className, node->initializer.get(), "Variable initialization");
     }
+
+    declareSymbol(node->name, node->type, node->isArray, node->className);
 }
 
 void SemanticAnalyzer::visit(VarAssignNode* node) {
@@ -246,11 +766,57 @@ void SemanticAnalyzer::visit(VarAssignNode* node) {
         errors.push_back(ss.str());
         return;
     }
+
+    if (!node->index) {
+        checkParallelWrite(node->name, node->line);
+    }
+    node->isField = sym->isField;
+    node->objectClass = sym->className;
+    node->arrayKind = arrayKindOf(*sym);
+
+    Type targetType = sym->type;
+    std::string targetClass = sym->className;
+    if (node->index) {
+        node->index->accept(this);
+        Type indexType = inferType(node->index.get());
+        if (node->arrayKind == ArrayKind::MAP) {
+            checkType(arrayElementType(mapKeyName(sym->className)), indexType, "Map key");
+        } else {
+            checkType(Type::INT, indexType, "Array index");
+        }
+        if (node->arrayKind == ArrayKind::BITS && node->assignOp != BinaryOp::ADD) {
+            std::stringstream ss;
+            ss << "Line " << node->line << ": Compound assignment to packed bool array '" << node->name << "'";
+            errors.push_back(ss.str());
+        }
+        if (node->arrayKind != ArrayKind::FIXED) {
+            targetClass = elementNameOf(*sym);
+            targetType = arrayElementType(targetClass);
+            if (targetType != Type::CLASS) targetClass.clear();
+        } else {
+            targetType = vectorElementType(sym->type);
+        }
+    }
+    if (!node->field.empty()) {
+        bool indexed = sym->isArray || node->arrayKind != ArrayKind::FIXED;
+        if (targetType != Type::CLASS || indexed != (node->index != nullptr)) {
+            std::stringstream ss;
+            ss << "Line " << node->line << ": Variable '" << node->name << "' is not a class instance";
+            errors.push_back(ss.str());
+            return;
+        }
+        const FieldDecl* field = lookupField(elementNameOf(*sym), node->field, node->line);
+        if (!field) return;
+        targetType = field->type;
+        targetClass = field->className;
+    }
     
     if (node->value) {
         node->value->accept(this);
         Type valueType = inferType(node->value.get());
-        checkType(sym->type, valueType, "Variable assignment");
+        checkType(targetType, valueType, "Variable assignment");
+        checkLiteral(targetType, node->value.get());
+        checkClass(targetClass, node->value.get(), "Variable assignment");
     }
 }
 
@@ -271,12 +837,18 @@ void SemanticAnalyzer::visit(IfNode* node) {
         node->thenBlock->accept(this);
     }
     
+    if (node->elseIf) {
+        node->elseIf->accept(this);
+    }
+    
     if (node->elseBlock) {
         node->elseBlock->accept(this);
     }
 }
 
 void SemanticAnalyzer::visit(WhileNode* node) {
+    checkLoopAnnotations(node->annotations, node->line, false);
+
     if (node->condition) {
         node->condition->accept(this);
         Type condType = inferType(node->condition.get());
@@ -289,6 +861,29 @@ void SemanticAnalyzer::visit(WhileNode* node) {
 }
 
 void SemanticAnalyzer::visit(ForNode* node) {
+    checkLoopAnnotations(node->annotations, node->line, true);
+
+    int savedScopeBase = parallelScopeBase;
+    std::string savedInductionVar = parallelInductionVar;
+    auto savedReductions = parallelReductions;
+
+    if (node->isParallel) {
+        for (const auto& reduction : node->reductions) {
+            Symbol* sym = lookupSymbol(reduction.second);
+            if (!sym) {
+                std::stringstream ss;
+                ss << "Line " << node->line << ": Undefined reduction variable '" << reduction.second << "'";
+                errors.push_back(ss.str());
+            } else if (reduction.first == BinaryOp::AND || reduction.first == BinaryOp::OR) {
+                checkType(Type::BOOL, sym->type, "Logical reduction");
+            } else if (!isNumericType(sym->type)) {
+                std::stringstream ss;
+                ss << "Line " << node->line << ": Arithmetic reduction requires a numeric variable";
+                errors.push_back(ss.str());
+            }
+        }
+    }
+
     enterScope();
     
     if (node->init) {
@@ -304,10 +899,20 @@ void SemanticAnalyzer::visit(ForNode* node) {
     if (node->increment) {
         node->increment->accept(this);
     }
+
+    if (node->isParallel) {
+        parallelScopeBase = static_cast<int>(scopes.size()) - 1;
+        parallelInductionVar = node->init ? node->init->name : "";
+        parallelReductions = node->reductions;
+    }
     
     if (node->body) {
         node->body->accept(this);
     }
+
+    parallelScopeBase = savedScopeBase;
+    parallelInductionVar = savedInductionVar;
+    parallelReductions = savedReductions;
     
     exitScope();
 }
@@ -322,6 +927,12 @@ void SemanticAnalyzer::visit(BinaryExprNode* node) {
     if (node->op == BinaryOp::EQ || node->op == BinaryOp::NE ||
         node->op == BinaryOp::LT || node->op == BinaryOp::GT ||
         node->op == BinaryOp::LE || node->op == BinaryOp::GE) {
+        if ((leftType == Type::STRING) != (rightType == Type::STRING)) {
+            std::stringstream ss;
+            ss << "Line " << node->line << ": Cannot compare string with "
+               << typeToString(leftType == Type::STRING ? rightType : leftType);
+            errors.push_back(ss.str());
+        }
     } else if (node->op == BinaryOp::AND || node->op == BinaryOp::OR) {
         checkType(Type::BOOL, leftType, "Left operand of logical operator");
         checkType(Type::BOOL, rightType, "Right operand of logical operator");
@@ -329,9 +940,56 @@ void SemanticAnalyzer::visit(BinaryExprNode* node) {
         if (leftType == Type::STRING || rightType == Type::STRING) {
             if (node->op != BinaryOp::ADD) {
                 errors.push_back("String type only supports addition operator");
+            } else {
+                checkType(Type::STRING, leftType, "String concatenation");
+                checkType(Type::STRING, rightType, "String concatenation");
             }
         }
     }
+
+    if (leftType == Type::CLASS || rightType == Type::CLASS) {
+        std::stringstream ss;
+        ss << "Line " << node->line << ": Operator '" << binaryOpToString(node->op)
+           << "' is not supported on class instances";
+        errors.push_back(ss.str());
+    }
+
+    if (leftType == Type::ARRAY || rightType == Type::ARRAY ||
+        leftType == Type::SLICE || rightType == Type::SLICE) {
+        std::stringstream ss;
+        ss << "Line " << node->line << ": Operator '" << binaryOpToString(node->op)
+           << "' is not supported on arrays";
+        errors.push_back(ss.str());
+    }
+
+    if (leftType == Type::MAP || rightType == Type::MAP) {
+        std::stringstream ss;
+        ss << "Line " << node->line << ": Operator '" << binaryOpToString(node->op)
+           << "' is not supported on maps";
+        errors.push_back(ss.str());
+    }
+
+    if (isVectorType(leftType) || isVectorType(rightType)) {
+        std::stringstream ss;
+        bool arithmetic = node->op == BinaryOp::ADD || node->op == BinaryOp::SUB ||
+                          node->op == BinaryOp::MUL || node->op == BinaryOp::DIV ||
+                          (node->op == BinaryOp::MOD && (leftType == Type::VEC8I || rightType == Type::VEC8I));
+        if (!arithmetic) {
+            ss << "Line " << node->line << ": Operator '" << binaryOpToString(node->op)
+               << "' is not supported on vector types";
+            errors.push_back(ss.str());
+        } else if (isVectorType(leftType) && isVectorType(rightType) && leftType != rightType) {
+            ss << "Line " << node->line << ": Cannot combine " << typeToString(leftType)
+               << " and " << typeToString(rightType);
+            errors.push_back(ss.str());
+        } else if (!isVectorType(leftType)) {
+            checkType(vectorElementType(rightType), leftType, "Vector operand");
+        } else if (!isVectorType(rightType)) {
+            checkType(vectorElementType(leftType), rightType, "Vector operand");
+        }
+    }
+
+    node->type = inferType(node);
 }
 
 void SemanticAnalyzer::visit(UnaryExprNode* node) {
@@ -343,9 +1001,42 @@ void SemanticAnalyzer::visit(UnaryExprNode* node) {
         Type opType = inferType(node->operand.get());
         checkType(Type::BOOL, opType, "Not operator");
     }
+
+    node->type = inferType(node);
 }
 
 void SemanticAnalyzer::visit(CallExprNode* node) {
+    auto cls = classes.find(node->functionName);
+    if (cls != classes.end()) {
+        node->type = Type::CLASS;
+        node->className = node->functionName;
+        ConstructorNode* ctor = cls->second->constructor.get();
+        size_t expected = ctor ? ctor->parameters.size() : 0;
+        if (expected != node->arguments.size()) {
+            std::stringstream ss;
+            ss << "Line " << node->line << ": Constructor of '" << node->functionName << "' expects "
+               << expected << " arguments but got " << node->arguments.size();
+            errors.push_back(ss.str());
+            return;
+        }
+        for (size_t i = 0; i < node->arguments.size(); ++i) {
+            node->arguments[i]->accept(this);
+            Type argType = inferType(node->arguments[i].get());
+            checkType(ctor->parameters[i].second, argType, "Constructor argument");
+            checkLiteral(ctor->parameters[i].second, node->arguments[i].get());
+            if (i < ctor->parameterClasses.size()) {
+                checkClass(ctor->parameterClasses[i], node->arguments[i].get(), "Constructor argument");
+            }
+        }
+        return;
+    }
+
+    auto templ = templates.find(node->functionName);
+    if (templ != templates.end()) {
+        checkTemplateCall(node, templ->second);
+        return;
+    }
+
     Symbol* func = lookupFunction(node->functionName);
     if (!func) {
         std::stringstream ss;
@@ -354,6 +1045,9 @@ void SemanticAnalyzer::visit(CallExprNode* node) {
         return;
     }
     
+    node->type = func->returnType;
+    node->className = func->returnClass;
+
     if (func->paramTypes.size() != node->arguments.size()) {
         std::stringstream ss;
         ss << "Function '" << node->functionName << "' expects "
@@ -363,13 +1057,49 @@ void SemanticAnalyzer::visit(CallExprNode* node) {
     } else {
         for (size_t i = 0; i < node->arguments.size(); ++i) {
             node->arguments[i]->accept(this);
+            if (i < func->arrayParams.size() && func->arrayParams[i]) {
+                auto* var = dynamic_cast<VarNode*>(node->arguments[i].get());
+                Symbol* sym = var ? lookupSymbol(var->name) : nullptr;
+                if (!sym || !sym->isArray || sym->type != func->paramTypes[i]) {
+                    std::stringstream ss;
+                    ss << "Line " << node->line << ": Argument " << (i + 1) << " of '" << node->functionName
+                       << "' must be a " << typeToString(func->paramTypes[i]) << " array";
+                    errors.push_back(ss.str());
+                }
+                continue;
+            }
             Type argType = inferType(node->arguments[i].get());
+            if (node->functionName == "len" && func->isBuiltin &&
+                (argType == Type::SLICE || argType == Type::MAP)) {
+                continue; // len also reads the length of a slice or the size of a map
+            }
+            if (func->paramTypes[i] == Type::VOID && func->isBuiltin && i > 0 &&
+                node->arguments[0]->type == Type::MAP) {
+                // has, remove: the key must match the key type of the map.
+                checkType(arrayElementType(mapKeyName(node->arguments[0]->className)), argType, "Map key");
+                continue;
+            }
+            if (func->paramTypes[i] == Type::VOID && func->isBuiltin && i > 0) {
+                // push: the value must match the element type of the array.
+                const std::string& element = node->arguments[0]->className;
+                checkType(arrayElementType(element), argType, "Array element");
+                checkLiteral(arrayElementType(element), node->arguments[i].get());
+                if (arrayElementType(element) == Type::CLASS) {
+                    checkClass(element, node->arguments[i].get(), "Array element");
+                }
+                continue;
+            }
             checkType(func->paramTypes[i], argType, "Function argument");
+            checkLiteral(func->paramTypes[i], node->arguments[i].get());
+            if (i < func->paramClasses.size()) {
+                checkClass(func->paramClasses[i], node->arguments[i].get(), "Function argument");
+            }
         }
     }
 }
 
 void SemanticAnalyzer::visit(LiteralNode* node) {
+    node->type = node->literalType;
 }
 
 void SemanticAnalyzer::visit(VarNode* node) {
@@ -378,6 +1108,10 @@ void SemanticAnalyzer::visit(VarNode* node) {
         std::stringstream ss;
         ss << "Line " << node->line << ": Undefined variable '" << node->name << "'";
         errors.push_back(ss.str());
+    } else {
+        node->type = sym->type;
+        node->className = sym->className;
+        node->isField = sym->isField;
     }
 }
 
@@ -387,12 +1121,28 @@ void SemanticAnalyzer::visit(ArrayAccessNode* node) {
         std::stringstream ss;
         ss << "Line " << node->line << ": Undefined array '" << node->arrayName << "'";
         errors.push_back(ss.str());
+    } else if (sym->isArray) {
+        node->className = sym->className;
+        node->arrayKind = arrayKindOf(*sym);
+    } else if (arrayKindOf(*sym) != ArrayKind::FIXED) {
+        node->arrayKind = arrayKindOf(*sym);
+        if (arrayElementType(elementNameOf(*sym)) == Type::CLASS) {
+            node->className = elementNameOf(*sym);
+        }
+        if (node->arrayKind == ArrayKind::MAP) {
+            node->keyName = mapKeyName(sym->className);
+        }
     }
     if (node->index) {
         node->index->accept(this);
         Type indexType = inferType(node->index.get());
-        checkType(Type::INT, indexType, "Array index");
+        if (node->arrayKind == ArrayKind::MAP) {
+            checkType(arrayElementType(node->keyName), indexType, "Map key");
+        } else {
+            checkType(Type::INT, indexType, "Array index");
+        }
     }
+    node->type = inferType(node);
 }
 
 void SemanticAnalyzer::visit(IncDecNode* node) {
@@ -402,7 +1152,9 @@ void SemanticAnalyzer::visit(IncDecNode* node) {
         ss << "Line " << node->line << ": Undefined variable '" << node->name << "'";
         errors.push_back(ss.str());
     } else {
-        if (sym->type != Type::INT && sym->type != Type::FLOAT && sym->type != Type::DOUBLE) {
+        checkParallelWrite(node->name, node->line);
+        node->isField = sym->isField;
+        if (!isNumericType(sym->type)) {
             std::stringstream ss;
             ss << "Line " << node->line << ": Increment/decrement only works on numeric types";
             errors.push_back(ss.str());
@@ -417,7 +1169,10 @@ void SemanticAnalyzer::visit(IncDecExprNode* node) {
         ss << "Line " << node->line << ": Undefined variable '" << node->name << "'";
         errors.push_back(ss.str());
     } else {
-        if (sym->type != Type::INT && sym->type != Type::FLOAT && sym->type != Type::DOUBLE) {
+        checkParallelWrite(node->name, node->line);
+        node->type = sym->type;
+        node->isField = sym->isField;
+        if (!isNumericType(sym->type)) {
             std::stringstream ss;
             ss << "Line " << node->line << ": Increment/decrement only works on numeric types";
             errors.push_back(ss.str());
@@ -442,12 +1197,53 @@ void SemanticAnalyzer::visit(BreakNode* node) {
 void SemanticAnalyzer::visit(ContinueNode* node) {
 }
 
+// Case values must be literals of the switch type so code generation can
+// pick a dispatch strategy from the full set of values.
 void SemanticAnalyzer::visit(SwitchNode* node) {
+    Type switchType = Type::INT;
     if (node->expression) {
         node->expression->accept(this);
+        switchType = inferType(node->expression.get());
+        if (!isIntegerType(switchType) && switchType != Type::BOOL && switchType != Type::STRING) {
+            std::stringstream ss;
+            ss << "Line " << node->line << ": Cannot switch on " << typeToString(switchType);
+            errors.push_back(ss.str());
+            switchType = Type::INT;
+        }
     }
+
+    std::set<long> ints;
+    std::set<std::string> strings;
     for (auto& caseNode : node->cases) {
         caseNode->accept(this);
+        auto* literal = dynamic_cast<LiteralNode*>(caseNode->value.get());
+        auto* negated = dynamic_cast<UnaryExprNode*>(caseNode->value.get());
+        if (negated && negated->op == UnaryOp::NEG) {
+            literal = dynamic_cast<LiteralNode*>(negated->operand.get());
+            if (literal && literal->literalType != Type::INT && literal->literalType != Type::I64) literal = nullptr;
+        }
+
+        std::stringstream ss;
+        bool duplicate = false;
+        if (switchType == Type::STRING && literal && literal->literalType == Type::STRING) {
+            caseNode->stringValue = literal->stringValue;
+            duplicate = !strings.insert(caseNode->stringValue).second;
+        } else if (switchType != Type::STRING && literal &&
+                   (literal->literalType == Type::INT || literal->literalType == Type::I64 ||
+                    literal->literalType == Type::BOOL)) {
+            caseNode->intValue = literal->literalType == Type::BOOL ? literal->boolValue : literal->intValue;
+            if (negated) caseNode->intValue = -caseNode->intValue;
+            checkLiteral(switchType, caseNode->value.get());
+            duplicate = !ints.insert(caseNode->intValue).second;
+        } else {
+            ss << "Line " << caseNode->line << ": Case value must be a literal of type " << typeToString(switchType);
+            errors.push_back(ss.str());
+            continue;
+        }
+        if (duplicate) {
+            ss << "Line " << caseNode->line << ": Duplicate case value";
+            errors.push_back(ss.str());
+        }
     }
     if (node->defaultCase) {
         node->defaultCase->accept(this);
@@ -467,7 +1263,7 @@ void SemanticAnalyzer::visit(TernaryExprNode* node) {
     if (node->condition) {
         node->condition->accept(this);
         Type condType = inferType(node->condition.get());
-        if (condType != Type::BOOL && condType != Type::INT) {
+        if (condType != Type::BOOL && !isIntegerType(condType)) {
             std::stringstream ss;
             ss << "Line " << node->line << ": Ternary condition must be boolean or numeric";
             errors.push_back(ss.str());
@@ -486,4 +1282,129 @@ void SemanticAnalyzer::visit(TernaryExprNode* node) {
         ss << "Line " << node->line << ": Ternary operator branches must have compatible types";
         errors.push_back(ss.str());
     }
+    node->type = trueType;
+    node->className = node->trueExpr ? node->trueExpr->className : "";
+}
+
+void SemanticAnalyzer::visit(SpawnNode* node) {
+    auto* call = dynamic_cast<CallExprNode*>(node->call.get());
+    if (!call) {
+        std::stringstream ss;
+        ss << "Line " << node->line << ": spawn expects a function call";
+        errors.push_back(ss.str());
+        return;
+    }
+
+    if (classes.count(call->functionName)) {
+        std::stringstream ss;
+        ss << "Line " << node->line << ": Cannot spawn constructor of '" << call->functionName << "'";
+        errors.push_back(ss.str());
+        return;
+    }
+
+    call->accept(this);
+    Symbol* func = lookupFunction(call->functionName);
+    if (func && func->isBuiltin) {
+        std::stringstream ss;
+        ss << "Line " << node->line << ": Cannot spawn built-in function '" << call->functionName << "'";
+        errors.push_back(ss.str());
+        return;
+    }
+    if (!func || node->target.empty()) return;
+
+    if (func->returnType == Type::VOID) {
+        std::stringstream ss;
+        ss << "Line " << node->line << ": Cannot assign result of void function '" << call->functionName << "'";
+        errors.push_back(ss.str());
+        return;
+    }
+
+    if (node->declaresTarget) {
+        checkClassName(node->targetClass, node->line);
+        declareSymbol(node->target, node->targetType, false, node->targetClass);
+        checkType(node->targetType, func->returnType, "Spawn result");
+        checkClass(node->targetClass, call, "Spawn result");
+        return;
+    }
+
+    Symbol* sym = lookupSymbol(node->target);
+    if (!sym) {
+        std::stringstream ss;
+        ss << "Line " << node->line << ": Undefined variable '" << node->target << "'";
+        errors.push_back(ss.str());
+        return;
+    }
+    checkParallelWrite(node->target, node->line);
+    checkType(sym->type, func->returnType, "Spawn result");
+    checkClass(sym->className, call, "Spawn result");
+}
+
+void SemanticAnalyzer::visit(SyncNode* node) {
+}
+
+void SemanticAnalyzer::visit(ExpressionStmtNode* node) {
+    if (node->expression) {
+        node->expression->accept(this);
+    }
+}
+
+void SemanticAnalyzer::visit(FieldAccessNode* node) {
+    if (!node->object) return;
+    node->object->accept(this);
+    if (node->object->type != Type::CLASS) {
+        std::stringstream ss;
+        ss << "Line " << node->line << ": Field '" << node->field << "' accessed on a non-class value";
+        errors.push_back(ss.str());
+        return;
+    }
+    const FieldDecl* field = lookupField(node->object->className, node->field, node->line);
+    if (field) {
+        node->type = field->type;
+        node->className = field->className;
+    }
+}
+
+void SemanticAnalyzer::visit(SliceExprNode* node) {
+    for (ExpressionNode* bound : {node->low.get(), node->high.get()}) {
+        if (bound) {
+            bound->accept(this);
+            checkType(Type::INT, inferType(bound), "Slice bound");
+        }
+    }
+
+    Symbol* sym = lookupSymbol(node->arrayName);
+    if (!sym) {
+        std::stringstream ss;
+        ss << "Line " << node->line << ": Undefined variable '" << node->arrayName << "'";
+        errors.push_back(ss.str());
+        return;
+    }
+
+    node->arrayKind = arrayKindOf(*sym);
+    if (sym->type == Type::STRING && !sym->isArray) {
+        node->type = Type::STRING;
+    } else if (node->arrayKind == ArrayKind::BITS) {
+        std::stringstream ss;
+        ss << "Line " << node->line << ": Cannot slice packed bool array '" << node->arrayName << "'";
+        errors.push_back(ss.str());
+        return;
+    } else if (node->arrayKind != ArrayKind::FIXED) {
+        node->type = Type::SLICE;
+        node->className = sym->className;
+    } else if (sym->isArray) {
+        auto cls = classes.find(sym->className);
+        if (cls != classes.end() &&
+            std::count(cls->second->annotations.begin(), cls->second->annotations.end(), "soa")) {
+            std::stringstream ss;
+            ss << "Line " << node->line << ": Cannot slice @soa array '" << node->arrayName << "'";
+            errors.push_back(ss.str());
+            return;
+        }
+        node->type = Type::SLICE;
+        node->className = sym->type == Type::CLASS ? sym->className : typeToString(sym->type);
+    } else {
+        std::stringstream ss;
+        ss << "Line " << node->line << ": Cannot slice '" << node->arrayName << "'";
+        errors.push_back(ss.str());
+    }
 }
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <map>
+#include <set>
 #include <vector>
 #include "../ast/ast.h"
 
@@ -10,29 +11,83 @@ struct Symbol {
     std::string name;
     Type type;
     bool isFunction;
+    bool isArray = false;
+    bool isBuiltin = false;
+    bool isField = false; // field of the class whose constructor is being checked
+    std::string className; // for class instances
     std::vector<Type> paramTypes; // for functions
+    std::vector<std::string> paramClasses;
+    std::vector<bool> arrayParams; // for built-ins taking arrays
     Type returnType; // for functions
+    std::string returnClass;
 };
 
 class SemanticAnalyzer : public ASTVisitor {
 private:
     std::vector<std::map<std::string, Symbol>> scopes;
     std::map<std::string, Symbol> functions;
+    std::map<std::string, ClassNode*> classes;
+    std::map<std::string, TemplateNode*> templates;
+    std::vector<FunctionNode*> pendingInstances; // declared but not checked yet
+    std::string currentClass;
     std::vector<std::string> errors;
+
+    // Inside a parallel for, scopes below parallelScopeBase are shared between threads.
+    int parallelScopeBase;
+    std::string parallelInductionVar;
+    std::vector<std::pair<BinaryOp, std::string>> parallelReductions;
+
+    // Declarations before the latest analyzeDelta, restored by rollback().
+    struct Snapshot {
+        std::map<std::string, Symbol> globals;
+        std::map<std::string, Symbol> functions;
+        std::map<std::string, ClassNode*> classes;
+        std::map<std::string, TemplateNode*> templates;
+        std::map<TemplateNode*, size_t> instanceCounts;
+    };
+    Snapshot snapshot;
     
     void enterScope();
     void exitScope();
-    void declareSymbol(const std::string& name, Type type);
+    void declareSymbol(const std::string& name, Type type, bool isArray = false,
+                       const std::string& className = "");
+    void declareParameters(const std::vector<std::pair<std::string, Type>>& parameters,
+                           const std::vector<std::string>& parameterClasses, int line);
+    void declareBuiltin(const std::string& name, Type returnType,
+                        const std::vector<Type>& paramTypes, const std::vector<bool>& arrayParams,
+                        const std::string& returnClass = "", const std::vector<std::string>& paramClasses = {});
+    void registerBuiltins();
     Symbol* lookupSymbol(const std::string& name);
+    int lookupSymbolScope(const std::string& name);
+    void checkParallelWrite(const std::string& name, int line);
     Symbol* lookupFunction(const std::string& name);
+    void declareFunction(FunctionNode* func);
+    bool reservedBuiltin(const std::string& name);
+    void checkTemplateCall(CallExprNode* node, TemplateNode* templ);
     Type inferType(ExpressionNode* expr);
     bool checkType(Type expected, Type actual, const std::string& context);
+    void checkLiteral(Type expected, ExpressionNode* expr);
+    void checkClassName(const std::string& className, int line);
+    void checkClass(const std::string& expected, ExpressionNode* expr, const std::string& context);
+    void checkFields(ClassNode* cls, const std::set<std::string>& declared);
+    const FieldDecl* lookupField(const std::string& className, const std::string& field, int line);
+    void checkLoopAnnotations(const std::vector<LoopAnnotation>& annotations, int line, bool isFor);
     
 public:
-    SemanticAnalyzer() { enterScope(); }
+    SemanticAnalyzer() : parallelScopeBase(-1) {
+        enterScope();
+        registerBuiltins();
+    }
     ~SemanticAnalyzer() = default;
     
     bool analyze(ProgramNode* program);
+    // Checks a program that extends the ones analyzed before, as entered in
+    // the REPL: earlier globals, functions, classes and templates stay
+    // declared. Errors only cover this delta.
+    bool analyzeDelta(ProgramNode* delta);
+    // Forgets what the latest analyzeDelta declared, including template
+    // instances it added to earlier templates.
+    void rollback();
     const std::vector<std::string>& getErrors() const { return errors; }
     
     // Visitor methods
@@ -64,6 +119,11 @@ public:
     void visit(SwitchNode* node) override;
     void visit(CaseNode* node) override;
     void visit(TernaryExprNode* node) override;
+    void visit(SpawnNode* node) override;
+    void visit(SyncNode* node) override;
+    void visit(ExpressionStmtNode* node) override;
+    void visit(FieldAccessNode* node) override;
+    void visit(SliceExprNode* node) override;
 };
 
 #endif // SEMANTIC_H
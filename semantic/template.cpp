@@ -0,0 +1,247 @@
+#include "template.h"
+
+namespace {
+
+// Copies function bodies node by node. Only what the parser sets is copied;
+// semantic analysis fills in the rest for each instance on its own.
+class TemplateCopier {
+public:
+    TemplateCopier(const std::string& param, const std::string& typeName)
+        : param(param), typeName(typeName) {}
+
+    // T becomes the type argument; T[], T[:] and maps over T get it as
+    // their element, key or value type name.
+    void substitute(Type& type, std::string& className) const {
+        if (type == Type::CLASS && className == param) {
+            type = arrayElementType(typeName);
+            className = type == Type::CLASS ? typeName : "";
+        } else if ((type == Type::ARRAY || type == Type::SLICE) && className == param) {
+            className = typeName;
+        } else if (type == Type::MAP) {
+            std::string key = mapKeyName(className);
+            std::string value = mapValueName(className);
+            className = (key == param ? typeName : key) + "," + (value == param ? typeName : value);
+        }
+    }
+
+    std::unique_ptr<BlockNode> copy(const BlockNode* block) const {
+        if (!block) return nullptr;
+        auto result = std::make_unique<BlockNode>();
+        result->line = block->line;
+        for (const auto& stmt : block->statements) {
+            result->statements.push_back(copy(stmt.get()));
+        }
+        return result;
+    }
+
+    std::unique_ptr<VarDeclNode> copy(const VarDeclNode* decl) const {
+        if (!decl) return nullptr;
+        auto result = std::make_unique<VarDeclNode>();
+        result->line = decl->line;
+        result->type = decl->type;
+        result->className = decl->className;
+        substitute(result->type, result->className);
+        result->name = decl->name;
+        result->isArray = decl->isArray;
+        result->isConst = decl->isConst;
+        result->arraySize = copy(decl->arraySize.get());
+        result->initializer = copy(decl->initializer.get());
+        return result;
+    }
+
+    std::unique_ptr<IfNode> copy(const IfNode* ifNode) const {
+        if (!ifNode) return nullptr;
+        auto result = std::make_unique<IfNode>();
+        result->line = ifNode->line;
+        result->condition = copy(ifNode->condition.get());
+        result->thenBlock = copy(ifNode->thenBlock.get());
+        result->elseBlock = copy(ifNode->elseBlock.get());
+        result->elseIf = copy(ifNode->elseIf.get());
+        return result;
+    }
+
+    std::unique_ptr<StatementNode> copy(const StatementNode* stmt) const {
+        std::unique_ptr<StatementNode> result;
+        if (auto* decl = dynamic_cast<const VarDeclNode*>(stmt)) {
+            result = copy(decl);
+        } else if (auto* assign = dynamic_cast<const VarAssignNode*>(stmt)) {
+            auto node = std::make_unique<VarAssignNode>();
+            node->name = assign->name;
+            node->field = assign->field;
+            node->index = copy(assign->index.get());
+            node->value = copy(assign->value.get());
+            node->assignOp = assign->assignOp;
+            result = std::move(node);
+        } else if (auto* incDec = dynamic_cast<const IncDecNode*>(stmt)) {
+            auto node = std::make_unique<IncDecNode>();
+            node->name = incDec->name;
+            node->isIncrement = incDec->isIncrement;
+            node->isPrefix = incDec->isPrefix;
+            result = std::move(node);
+        } else if (auto* ret = dynamic_cast<const ReturnNode*>(stmt)) {
+            auto node = std::make_unique<ReturnNode>();
+            node->value = copy(ret->value.get());
+            result = std::move(node);
+        } else if (auto* ifNode = dynamic_cast<const IfNode*>(stmt)) {
+            result = copy(ifNode);
+        } else if (auto* whileNode = dynamic_cast<const WhileNode*>(stmt)) {
+            auto node = std::make_unique<WhileNode>();
+            node->condition = copy(whileNode->condition.get());
+            node->body = copy(whileNode->body.get());
+            node->annotations = whileNode->annotations;
+            result = std::move(node);
+        } else if (auto* doWhile = dynamic_cast<const DoWhileNode*>(stmt)) {
+            auto node = std::make_unique<DoWhileNode>();
+            node->body = copy(doWhile->body.get());
+            node->condition = copy(doWhile->condition.get());
+            result = std::move(node);
+        } else if (auto* forNode = dynamic_cast<const ForNode*>(stmt)) {
+            auto node = std::make_unique<ForNode>();
+            node->init = copy(forNode->init.get());
+            node->condition = copy(forNode->condition.get());
+            node->increment = copy(forNode->increment.get());
+            node->body = copy(forNode->body.get());
+            node->annotations = forNode->annotations;
+            node->isParallel = forNode->isParallel;
+            node->reductions = forNode->reductions;
+            result = std::move(node);
+        } else if (auto* switchNode = dynamic_cast<const SwitchNode*>(stmt)) {
+            auto node = std::make_unique<SwitchNode>();
+            node->expression = copy(switchNode->expression.get());
+            for (const auto& caseNode : switchNode->cases) {
+                auto copied = std::make_unique<CaseNode>();
+                copied->line = caseNode->line;
+                copied->value = copy(caseNode->value.get());
+                copied->block = copy(caseNode->block.get());
+                node->cases.push_back(std::move(copied));
+            }
+            node->defaultCase = copy(switchNode->defaultCase.get());
+            result = std::move(node);
+        } else if (auto* spawn = dynamic_cast<const SpawnNode*>(stmt)) {
+            auto node = std::make_unique<SpawnNode>();
+            node->target = spawn->target;
+            node->targetType = spawn->targetType;
+            node->targetClass = spawn->targetClass;
+            substitute(node->targetType, node->targetClass);
+            node->declaresTarget = spawn->declaresTarget;
+            node->call = copy(spawn->call.get());
+            result = std::move(node);
+        } else if (auto* exprStmt = dynamic_cast<const ExpressionStmtNode*>(stmt)) {
+            auto node = std::make_unique<ExpressionStmtNode>();
+            node->expression = copy(exprStmt->expression.get());
+            result = std::move(node);
+        } else if (dynamic_cast<const BreakNode*>(stmt)) {
+            result = std::make_unique<BreakNode>();
+        } else if (dynamic_cast<const ContinueNode*>(stmt)) {
+            result = std::make_unique<ContinueNode>();
+        } else if (dynamic_cast<const SyncNode*>(stmt)) {
+            result = std::make_unique<SyncNode>();
+        } else {
+            return nullptr;
+        }
+        result->line = stmt->line;
+        return result;
+    }
+
+    std::unique_ptr<ExpressionNode> copy(const ExpressionNode* expr) const {
+        if (!expr) return nullptr;
+        std::unique_ptr<ExpressionNode> result;
+        if (auto* bin = dynamic_cast<const BinaryExprNode*>(expr)) {
+            auto node = std::make_unique<BinaryExprNode>();
+            node->op = bin->op;
+            node->left = copy(bin->left.get());
+            node->right = copy(bin->right.get());
+            result = std::move(node);
+        } else if (auto* unary = dynamic_cast<const UnaryExprNode*>(expr)) {
+            auto node = std::make_unique<UnaryExprNode>();
+            node->op = unary->op;
+            node->operand = copy(unary->operand.get());
+            result = std::move(node);
+        } else if (auto* call = dynamic_cast<const CallExprNode*>(expr)) {
+            auto node = std::make_unique<CallExprNode>();
+            // T(...) constructs an instance when T is a class.
+            node->functionName = call->functionName == param ? typeName : call->functionName;
+            for (const auto& arg : call->arguments) {
+                node->arguments.push_back(copy(arg.get()));
+            }
+            result = std::move(node);
+        } else if (auto* literal = dynamic_cast<const LiteralNode*>(expr)) {
+            auto node = std::make_unique<LiteralNode>();
+            node->literalType = literal->literalType;
+            switch (literal->literalType) {
+                case Type::DOUBLE: node->doubleValue = literal->doubleValue; break;
+                case Type::FLOAT: node->floatValue = literal->floatValue; break;
+                case Type::BOOL: node->boolValue = literal->boolValue; break;
+                default: node->intValue = literal->intValue; break;
+            }
+            node->stringValue = literal->stringValue;
+            result = std::move(node);
+        } else if (auto* var = dynamic_cast<const VarNode*>(expr)) {
+            auto node = std::make_unique<VarNode>();
+            node->name = var->name;
+            result = std::move(node);
+        } else if (auto* incDec = dynamic_cast<const IncDecExprNode*>(expr)) {
+            auto node = std::make_unique<IncDecExprNode>();
+            node->name = incDec->name;
+            node->isIncrement = incDec->isIncrement;
+            node->isPrefix = incDec->isPrefix;
+            result = std::move(node);
+        } else if (auto* ternary = dynamic_cast<const TernaryExprNode*>(expr)) {
+            auto node = std::make_unique<TernaryExprNode>();
+            node->condition = copy(ternary->condition.get());
+            node->trueExpr = copy(ternary->trueExpr.get());
+            node->falseExpr = copy(ternary->falseExpr.get());
+            result = std::move(node);
+        } else if (auto* access = dynamic_cast<const ArrayAccessNode*>(expr)) {
+            auto node = std::make_unique<ArrayAccessNode>();
+            node->arrayName = access->arrayName;
+            node->index = copy(access->index.get());
+            result = std::move(node);
+        } else if (auto* field = dynamic_cast<const FieldAccessNode*>(expr)) {
+            auto node = std::make_unique<FieldAccessNode>();
+            node->object = copy(field->object.get());
+            node->field = field->field;
+            result = std::move(node);
+        } else if (auto* slice = dynamic_cast<const SliceExprNode*>(expr)) {
+            auto node = std::make_unique<SliceExprNode>();
+            node->arrayName = slice->arrayName;
+            node->low = copy(slice->low.get());
+            node->high = copy(slice->high.get());
+            result = std::move(node);
+        } else {
+            return nullptr;
+        }
+        result->line = expr->line;
+        return result;
+    }
+
+private:
+    const std::string& param;
+    const std::string& typeName;
+};
+
+} // namespace
+
+std::string templateInstanceName(const std::string& function, const std::string& typeName) {
+    return function + "__" + typeName;
+}
+
+std::unique_ptr<FunctionNode> instantiateTemplate(const TemplateNode* templ, const std::string& typeName,
+                                                  const std::string& name) {
+    const FunctionNode* generic = templ->function.get();
+    TemplateCopier copier(templ->templateParam, typeName);
+
+    auto instance = std::make_unique<FunctionNode>();
+    instance->line = generic->line;
+    instance->name = name;
+    instance->returnType = generic->returnType;
+    instance->returnClass = generic->returnClass;
+    copier.substitute(instance->returnType, instance->returnClass);
+    instance->parameters = generic->parameters;
+    instance->parameterClasses = generic->parameterClasses;
+    for (size_t i = 0; i < instance->parameters.size() && i < instance->parameterClasses.size(); ++i) {
+        copier.substitute(instance->parameters[i].second, instance->parameterClasses[i]);
+    }
+    instance->body = copier.copy(generic->body.get());
+    return instance;
+}
@@ -0,0 +1,19 @@
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+
+#include <memory>
+#include <string>
+#include "../ast/ast.h"
+
+// Name of the instance of a template function for one type argument, e.g.
+// maxOf__double. Instances are cached per name, so every call with the same
+// type argument shares one C function.
+std::string templateInstanceName(const std::string& function, const std::string& typeName);
+
+// Copies the function of `templ` with every use of the template parameter
+// replaced by `typeName`: a built-in type name such as "int" or a class.
+// The copy is a plain function named `name`, ready for semantic analysis.
+std::unique_ptr<FunctionNode> instantiateTemplate(const TemplateNode* templ, const std::string& typeName,
+                                                  const std::string& name);
+
+#endif // TEMPLATE_H
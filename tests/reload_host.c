@@ -0,0 +1,82 @@
+// Host for the hot-reload test: swaps tests/reload_v2.sl in while another
+// thread keeps calling into the library, then offers tests/reload_bad.sl,
+// which must be refused. Exit code 68 (20 + 30 + 7 + 11).
+// Usage: reload_host <lib.so> <v2.so> <bad.so>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "sl_reload.h"
+
+enum { SCORE, BONUS };
+
+static const sl_binding BINDINGS[] = {
+    { "score", "int(int)" },
+    { "bonus", "int()" },
+};
+
+static sl_library* library;
+static atomic_int running = 1;
+static atomic_long wrong = 0;
+
+// Each call must see one build: score(10) is 20 or 30, never a mix.
+static void* caller(void* arg) {
+    (void)arg;
+    while (atomic_load(&running)) {
+        sl_version* v = sl_enter(library);
+        int score = SL_FUNCTION(v, SCORE, int (*)(int))(10);
+        int bonus = SL_FUNCTION(v, BONUS, int (*)(void))();
+        if (score != (v->generation == 1 ? 20 : 30) || bonus != 7) atomic_fetch_add(&wrong, 1);
+        sl_leave(v);
+    }
+    return NULL;
+}
+
+static int call_score(void) {
+    sl_version* v = sl_enter(library);
+    int result = SL_FUNCTION(v, SCORE, int (*)(int))(10);
+    sl_leave(v);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s <lib.so> <v2.so> <bad.so>\n", argv[0]);
+        return 1;
+    }
+    library = sl_library_open(argv[1], BINDINGS, 2);
+    if (!library) {
+        fprintf(stderr, "%s\n", sl_reload_error());
+        return 1;
+    }
+    int result = call_score();
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, caller, NULL);
+    usleep(20000);
+    rename(argv[2], argv[1]);
+    while (sl_library_poll(library) == 0) {
+        usleep(1000);
+    }
+    usleep(20000);
+    result += call_score();
+
+    rename(argv[3], argv[1]);
+    int refused = 0;
+    for (int i = 0; i < 100 && !refused; i++) {
+        refused = sl_library_poll(library) < 0;
+        usleep(1000);
+    }
+    if (refused) result += 7;
+    if (call_score() == 30) result += 11;
+
+    atomic_store(&running, 0);
+    pthread_join(thread, NULL);
+    sl_library_close(library);
+    if (atomic_load(&wrong) != 0) {
+        fprintf(stderr, "%ld calls saw a mixed build\n", atomic_load(&wrong));
+        return 2;
+    }
+    return result;
+}
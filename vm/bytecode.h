@@ -0,0 +1,134 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../codegen/switch.h"
+
+// Register bytecode for `slc --run`. Every function has a fixed number of
+// 64-bit registers: parameters first, then its constants, which are copied
+// in on every call so that instructions only ever name registers, then
+// locals and temporaries. Values carry no type tag; the compiler picks the
+// instruction for the static types, so an int add is one ADD_I.
+//
+// Integers are kept sign-extended (int, i8..i64) or zero-extended (u8..u64)
+// to 64 bits, floats as doubles holding a float value, strings and arrays
+// as pointers. Arithmetic follows C: operands narrower than int compute as
+// int, and stores narrow the result back to the declared type.
+
+union Value {
+    int64_t i;
+    uint64_t u;
+    double d;
+    void* p;
+};
+
+struct VMString {
+    uint32_t len;
+    const char* data;
+};
+
+// Fixed and growable arrays and slices share one layout; only growable
+// arrays own their elements, slices point into those of another array.
+struct VMArray {
+    Value* data;
+    int len;
+    int cap;
+};
+
+// X(name): a, b and c always name registers; k holds jump targets,
+// function, global, switch and built-in indexes and counts.
+#define SL_VM_OPCODES(X) \
+    X(MOV)     /* a = b */ \
+    X(GETG)    /* a = globals[k] */ \
+    X(SETG)    /* globals[k] = a */ \
+    X(ADD_I) X(SUB_I) X(MUL_I) X(DIV_I) X(MOD_I) /* int, wraps at 32 bits */ \
+    X(ADD_U) X(SUB_U) X(MUL_U) X(DIV_U) X(MOD_U) /* u32 */ \
+    X(ADD_L) X(SUB_L) X(MUL_L) X(DIV_L) X(MOD_L) /* i64; add, sub and mul also u64 */ \
+    X(DIV_Q) X(MOD_Q)                            /* u64 */ \
+    X(ADD_F) X(SUB_F) X(MUL_F) X(DIV_F)          /* float, rounded after each op */ \
+    X(ADD_D) X(SUB_D) X(MUL_D) X(DIV_D) \
+    X(NEG_I) X(NEG_U) X(NEG_L) X(NEG_D) X(NOT) \
+    X(EQ_L) X(NE_L) X(LT_L) X(LE_L) X(LT_Q) X(LE_Q) /* a = b op c as 0 or 1 */ \
+    X(EQ_D) X(NE_D) X(LT_D) X(LE_D) \
+    X(EQ_S) X(NE_S) X(LT_S) X(LE_S) \
+    X(SEXT8) X(ZEXT8) X(SEXT16) X(ZEXT16) X(SEXT32) X(ZEXT32) \
+    X(I2D) X(Q2D) X(I2F) X(Q2F) X(D2F) X(D2L) X(D2Q) \
+    X(JMP)     /* pc = k */ \
+    X(JMPF)    /* if (!a) pc = k */ \
+    X(JMPT)    /* if (a) pc = k */ \
+    X(JEQ) X(JNE) X(JLT) X(JLE) X(JLT_Q) X(JLE_Q) /* if (a op b) pc = k, integers */ \
+    X(SWITCH)  /* jump through switches[k] on the int in a */ \
+    X(SWITCH_S) /* the same on a string */ \
+    X(CALL)    /* a = functions[k](b, b + 1, ...) */ \
+    X(BUILTIN) /* a = builtins[k](b, b + 1, ...) */ \
+    X(RET)     /* return a */ \
+    X(RET0)    /* return 0 */ \
+    X(NEWARR)  /* a = fixed array of b zeroed elements, freed on return */ \
+    X(NEWDYN)  /* a = empty growable array */ \
+    X(GETE)    /* a = b[c] */ \
+    X(SETE)    /* a[b] = c */ \
+    X(LEN)     /* a = len(b) */ \
+    X(SLICE)   /* a = b[c : c + 1] */ \
+    X(SLICE_S) /* the same on a string */ \
+    X(STRLEN)  /* a = str_len(b) */ \
+    X(CONCAT)  /* a = b + b + 1 + ... (k strings) */
+
+enum class Opcode : uint16_t {
+#define SL_VM_ENUM(name) name,
+    SL_VM_OPCODES(SL_VM_ENUM)
+#undef SL_VM_ENUM
+};
+
+#define SL_VM_BUILTINS(X) \
+    X(push) X(reserve) X(shrink) X(array_free) X(bits_count) X(bits_fill) \
+    X(write_int) X(write_uint) X(write_double) X(write_bool) X(write_str) \
+    X(write_newline) X(flush) X(read_line) X(at_eof) X(str_reset)
+
+enum class Builtin : int32_t {
+#define SL_VM_ENUM(name) name,
+    SL_VM_BUILTINS(SL_VM_ENUM)
+#undef SL_VM_ENUM
+};
+
+struct Instruction {
+    Opcode op;
+    uint16_t a;
+    uint16_t b;
+    uint16_t c;
+    int32_t k;
+};
+
+// Case values of one switch, found through the same perfect hash as the
+// compiled switch dispatch; targets[i] is the case of slot i.
+struct SwitchTable {
+    PerfectHash hash;
+    std::vector<int64_t> keys;
+    std::vector<std::string> stringKeys;
+    std::vector<int32_t> targets;
+    int32_t defaultTarget = 0;
+};
+
+struct VMFunction {
+    std::string name;
+    int paramCount = 0;
+    int constBase = 0;   // first constant register
+    int frameSize = 0;   // registers including constants
+    std::vector<Value> constants;
+    std::vector<Instruction> code;
+    std::vector<int> lines; // source line of each instruction
+};
+
+struct BytecodeProgram {
+    std::vector<VMFunction> functions;
+    int entry = 0;       // runs the global initializers, then returns main()
+    int globalCount = 0;
+    std::vector<SwitchTable> switches;
+    std::deque<std::string> stringData; // bytes of string constants
+    std::deque<VMString> strings;
+};
+
+#endif // BYTECODE_H
@@ -0,0 +1,1154 @@
+#include "compiler.h"
+#include <algorithm>
+#include <sstream>
+
+namespace {
+
+// Registers are 16-bit. While a function is compiled its constants are
+// numbered down from the top; finishFunction moves them behind the
+// parameters once the number of registers is known.
+const int REGISTER_LIMIT = 0xFFFF;
+
+bool isIntegral(Type type) {
+    return isIntegerType(type) || type == Type::BOOL;
+}
+
+bool isFloating(Type type) {
+    return type == Type::FLOAT || type == Type::DOUBLE;
+}
+
+bool isComparison(BinaryOp op) {
+    return op == BinaryOp::EQ || op == BinaryOp::NE || op == BinaryOp::LT || op == BinaryOp::GT ||
+           op == BinaryOp::LE || op == BinaryOp::GE;
+}
+
+BinaryOp negated(BinaryOp op) {
+    switch (op) {
+        case BinaryOp::EQ: return BinaryOp::NE;
+        case BinaryOp::NE: return BinaryOp::EQ;
+        case BinaryOp::LT: return BinaryOp::GE;
+        case BinaryOp::GE: return BinaryOp::LT;
+        case BinaryOp::GT: return BinaryOp::LE;
+        default: return BinaryOp::GT;
+    }
+}
+
+// Whether a value of `from` can be used as a `to` without any instruction:
+// every integer already sits sign- or zero-extended in 64 bits, so only
+// narrowing and the int/float boundary cost anything.
+bool needsConversion(Type from, Type to) {
+    if (from == to || !isNumericType(to)) return false;
+    if (from == Type::FLOAT && to == Type::DOUBLE) return false;
+    if (!isIntegral(from)) return true;
+    if (!isIntegerType(to)) return true;
+    if (from == Type::BOOL || integerBits(to) == 64) return false;
+    if (isUnsignedType(from) == isUnsignedType(to)) return integerBits(from) > integerBits(to);
+    return !isUnsignedType(from) || integerBits(from) >= integerBits(to);
+}
+
+Opcode narrowing(Type to) {
+    switch (to) {
+        case Type::I8: return Opcode::SEXT8;
+        case Type::U8: return Opcode::ZEXT8;
+        case Type::I16: return Opcode::SEXT16;
+        case Type::U16: return Opcode::ZEXT16;
+        case Type::U32: return Opcode::ZEXT32;
+        default: return Opcode::SEXT32;
+    }
+}
+
+int64_t narrow(int64_t value, Type to) {
+    switch (to) {
+        case Type::I8: return (int8_t)value;
+        case Type::U8: return (uint8_t)value;
+        case Type::I16: return (int16_t)value;
+        case Type::U16: return (uint16_t)value;
+        case Type::U32: return (uint32_t)value;
+        case Type::I64: case Type::U64: return value;
+        default: return (int32_t)value;
+    }
+}
+
+// The conversion the VM would do at run time, done on a constant.
+Value convertValue(Value value, Type from, Type to) {
+    Value result;
+    if (isIntegerType(to)) {
+        int64_t whole = value.i;
+        if (isFloating(from)) {
+            whole = to == Type::U64 ? (int64_t)(uint64_t)value.d : (int64_t)value.d;
+        }
+        result.i = narrow(whole, to);
+    } else if (to == Type::FLOAT) {
+        if (isFloating(from)) result.d = (float)value.d;
+        else result.d = from == Type::U64 ? (float)value.u : (float)value.i;
+    } else {
+        if (isFloating(from)) result.d = value.d;
+        else result.d = from == Type::U64 ? (double)value.u : (double)value.i;
+    }
+    return result;
+}
+
+void collectConcatParts(ExpressionNode* expr, std::vector<ExpressionNode*>& parts) {
+    auto* bin = dynamic_cast<BinaryExprNode*>(expr);
+    if (bin && bin->op == BinaryOp::ADD && bin->type == Type::STRING) {
+        collectConcatParts(bin->left.get(), parts);
+        collectConcatParts(bin->right.get(), parts);
+    } else {
+        parts.push_back(expr);
+    }
+}
+
+struct BuiltinInfo {
+    Builtin id;
+    Type returnType;
+    std::vector<Type> params; // ARRAY takes any array as is
+};
+
+const std::map<std::string, BuiltinInfo>& builtinTable() {
+    static const std::map<std::string, BuiltinInfo> table = {
+        {"push", {Builtin::push, Type::VOID, {Type::ARRAY, Type::VOID}}},
+        {"reserve", {Builtin::reserve, Type::VOID, {Type::ARRAY, Type::INT}}},
+        {"shrink", {Builtin::shrink, Type::VOID, {Type::ARRAY}}},
+        {"array_free", {Builtin::array_free, Type::VOID, {Type::ARRAY}}},
+        {"bits_count", {Builtin::bits_count, Type::INT, {Type::ARRAY}}},
+        {"bits_fill", {Builtin::bits_fill, Type::VOID, {Type::ARRAY, Type::BOOL}}},
+        {"write_int", {Builtin::write_int, Type::VOID, {Type::I64}}},
+        {"write_uint", {Builtin::write_uint, Type::VOID, {Type::U64}}},
+        {"write_double", {Builtin::write_double, Type::VOID, {Type::DOUBLE}}},
+        {"write_bool", {Builtin::write_bool, Type::VOID, {Type::BOOL}}},
+        {"write_str", {Builtin::write_str, Type::VOID, {Type::STRING}}},
+        {"write_newline", {Builtin::write_newline, Type::VOID, {}}},
+        {"flush", {Builtin::flush, Type::VOID, {}}},
+        {"read_line", {Builtin::read_line, Type::STRING, {}}},
+        {"at_eof", {Builtin::at_eof, Type::BOOL, {}}},
+        {"str_reset", {Builtin::str_reset, Type::VOID, {}}},
+    };
+    return table;
+}
+
+// What the built-ins the bytecode leaves out belong to.
+std::string unsupportedBuiltin(const std::string& name) {
+    if (name == "has" || name == "remove" || name == "map_free") return "maps";
+    if (name == "read_async" || name == "await_read" || name == "await_any") return "asynchronous reads";
+    if (name == "map_file" || name == "map_window" || name == "file_size" || name == "unmap" ||
+        name == "str_view") {
+        return "memory-mapped files";
+    }
+    return "vector types";
+}
+
+} // namespace
+
+BytecodeCompiler::BytecodeCompiler()
+    : function(nullptr), returnType(Type::VOID), nextReg(0), localsEnd(0), maxReg(0), line(0),
+      lastLabel(-1), fileScope(false), resultReg(0), resultType(Type::VOID) {}
+
+bool BytecodeCompiler::compile(ProgramNode* root) {
+    root->accept(this);
+    return errors.empty();
+}
+
+void BytecodeCompiler::unsupported(const std::string& what, int line) {
+    std::stringstream ss;
+    ss << "Line " << line << ": " << what << " are not supported by --run";
+    errors.push_back(ss.str());
+}
+
+BytecodeCompiler::Kind BytecodeCompiler::kindOf(Type type) {
+    switch (type) {
+        case Type::U32: return Kind::U32;
+        case Type::I64: return Kind::I64;
+        case Type::U64: return Kind::U64;
+        case Type::FLOAT: return Kind::F32;
+        case Type::DOUBLE: return Kind::F64;
+        case Type::STRING: return Kind::STR;
+        case Type::ARRAY: case Type::SLICE: return Kind::REF;
+        case Type::VOID: return Kind::NONE;
+        default: return Kind::I32; // int, bool and everything narrower
+    }
+}
+
+Type BytecodeCompiler::typeOfKind(Kind kind) {
+    switch (kind) {
+        case Kind::U32: return Type::U32;
+        case Kind::I64: return Type::I64;
+        case Kind::U64: return Type::U64;
+        case Kind::F32: return Type::FLOAT;
+        case Kind::F64: return Type::DOUBLE;
+        case Kind::STR: return Type::STRING;
+        case Kind::REF: return Type::ARRAY;
+        case Kind::NONE: return Type::VOID;
+        default: return Type::INT;
+    }
+}
+
+// Usual arithmetic conversions: double, then float, then the widest
+// integer kind, with unsigned winning at equal width.
+BytecodeCompiler::Kind BytecodeCompiler::arithmeticKind(Kind left, Kind right) {
+    if (left == Kind::F64 || right == Kind::F64) return Kind::F64;
+    if (left == Kind::F32 || right == Kind::F32) return Kind::F32;
+    return std::max(left, right);
+}
+
+bool BytecodeCompiler::supported(Type type, const std::string& className, int line) {
+    if (type == Type::ARRAY || type == Type::SLICE) {
+        type = arrayElementType(className);
+    }
+    if (type == Type::CLASS) {
+        unsupported("classes and structs", line);
+    } else if (type == Type::MAP) {
+        unsupported("maps", line);
+    } else if (isVectorType(type)) {
+        unsupported("vector types", line);
+    } else {
+        return true;
+    }
+    return false;
+}
+
+int BytecodeCompiler::emit(Opcode op, int a, int b, int c, int32_t k) {
+    function->code.push_back({op, (uint16_t)a, (uint16_t)b, (uint16_t)c, k});
+    function->lines.push_back(line);
+    return (int)function->code.size() - 1;
+}
+
+int BytecodeCompiler::here() const {
+    return (int)function->code.size();
+}
+
+void BytecodeCompiler::patch(const std::vector<int>& jumps, int target) {
+    for (int jump : jumps) {
+        function->code[jump].k = target;
+    }
+    if (!jumps.empty()) {
+        lastLabel = std::max(lastLabel, target);
+    }
+}
+
+int BytecodeCompiler::allocTemps(int count) {
+    int first = nextReg;
+    nextReg += count;
+    maxReg = std::max(maxReg, nextReg);
+    return first;
+}
+
+int BytecodeCompiler::allocTemp() {
+    return allocTemps(1);
+}
+
+bool BytecodeCompiler::isConstant(int reg) const {
+    return reg > REGISTER_LIMIT - (int)function->constants.size();
+}
+
+int BytecodeCompiler::constant(Value value) {
+    auto it = constantIndex.find(value.i);
+    if (it != constantIndex.end()) {
+        return REGISTER_LIMIT - it->second;
+    }
+    int index = (int)function->constants.size();
+    function->constants.push_back(value);
+    constantIndex[value.i] = index;
+    return REGISTER_LIMIT - index;
+}
+
+int BytecodeCompiler::intConstant(int64_t value) {
+    Value v;
+    v.i = value;
+    return constant(v);
+}
+
+int BytecodeCompiler::stringConstant(const std::string& text) {
+    auto it = stringConstants.find(text);
+    if (it == stringConstants.end()) {
+        program.stringData.push_back(text);
+        const std::string& bytes = program.stringData.back();
+        program.strings.push_back({(uint32_t)bytes.size(), bytes.data()});
+        it = stringConstants.emplace(text, &program.strings.back()).first;
+    }
+    Value v;
+    v.p = (void*)it->second;
+    return constant(v);
+}
+
+// Moves a value into `target`. A temporary that the last instruction just
+// computed is renamed instead, unless a jump lands after that instruction
+// and another path would skip it.
+int BytecodeCompiler::place(int reg, int target) {
+    if (target < 0 || reg == target) return reg;
+    if (!function->code.empty() && lastLabel != here() && reg >= localsEnd && !isConstant(reg)) {
+        Instruction& last = function->code.back();
+        bool writesA = last.op != Opcode::SETG && last.op != Opcode::SETE && last.op != Opcode::JMP &&
+                       last.op != Opcode::JMPF && last.op != Opcode::JMPT && last.op != Opcode::RET &&
+                       last.op != Opcode::SWITCH && last.op != Opcode::SWITCH_S;
+        if (writesA && last.a == reg) {
+            last.a = (uint16_t)target;
+            return target;
+        }
+    }
+    emit(Opcode::MOV, target, reg);
+    return target;
+}
+
+void BytecodeCompiler::result(int reg, Type type) {
+    resultReg = reg;
+    resultType = type;
+}
+
+void BytecodeCompiler::enterScope() {
+    scopes.emplace_back();
+    scopeLocals.push_back(localsEnd);
+}
+
+void BytecodeCompiler::exitScope() {
+    localsEnd = scopeLocals.back();
+    nextReg = localsEnd;
+    scopeLocals.pop_back();
+    scopes.pop_back();
+}
+
+BytecodeCompiler::Variable* BytecodeCompiler::lookup(const std::string& name) {
+    for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+        auto it = scope->find(name);
+        if (it != scope->end()) return &it->second;
+    }
+    return nullptr;
+}
+
+// Storage for a new variable: a global slot at file scope, otherwise the
+// next local register. It is entered into the scope by the caller once its
+// initializer has been compiled.
+BytecodeCompiler::Variable BytecodeCompiler::newVariable(Type type, const std::string& className, bool isArray) {
+    Variable var;
+    var.type = type;
+    var.isArray = isArray;
+    if (isArray) {
+        var.element = type;
+    } else if (type == Type::ARRAY || type == Type::SLICE) {
+        var.element = arrayElementType(className);
+    }
+    if (fileScope) {
+        var.global = program.globalCount++;
+    } else {
+        var.reg = localsEnd++;
+        nextReg = std::max(nextReg, localsEnd);
+        maxReg = std::max(maxReg, nextReg);
+    }
+    return var;
+}
+
+int BytecodeCompiler::load(const Variable& var) {
+    if (var.global < 0) return var.reg;
+    int reg = allocTemp();
+    emit(Opcode::GETG, reg, 0, 0, var.global);
+    return reg;
+}
+
+void BytecodeCompiler::store(const Variable& var, int reg) {
+    if (var.global >= 0) {
+        emit(Opcode::SETG, reg, 0, 0, var.global);
+    }
+}
+
+int BytecodeCompiler::expression(ExpressionNode* expr, int target) {
+    expr->accept(this);
+    return place(resultReg, target);
+}
+
+int BytecodeCompiler::expressionAs(ExpressionNode* expr, Type to, int target) {
+    int reg = expression(expr, -1);
+    return convert(reg, resultType, to, target);
+}
+
+int BytecodeCompiler::convert(int reg, Type from, Type to, int target) {
+    if (!needsConversion(from, to)) {
+        return place(reg, target);
+    }
+    if (isConstant(reg)) {
+        Value value = function->constants[REGISTER_LIMIT - reg];
+        return place(constant(convertValue(value, from, to)), target);
+    }
+    int out = target >= 0 ? target : allocTemp();
+    if (isIntegerType(to)) {
+        int source = reg;
+        if (isFloating(from)) {
+            emit(to == Type::U64 ? Opcode::D2Q : Opcode::D2L, out, reg);
+            if (integerBits(to) == 64) return out;
+            source = out;
+        }
+        emit(narrowing(to), out, source);
+    } else if (to == Type::FLOAT) {
+        emit(from == Type::DOUBLE ? Opcode::D2F : from == Type::U64 ? Opcode::Q2F : Opcode::I2F, out, reg);
+    } else {
+        emit(from == Type::U64 ? Opcode::Q2D : Opcode::I2D, out, reg);
+    }
+    return out;
+}
+
+int BytecodeCompiler::arithmetic(BinaryOp op, int left, int right, Kind kind, int target) {
+    static const Opcode table[6][5] = {
+        {Opcode::ADD_I, Opcode::SUB_I, Opcode::MUL_I, Opcode::DIV_I, Opcode::MOD_I},
+        {Opcode::ADD_U, Opcode::SUB_U, Opcode::MUL_U, Opcode::DIV_U, Opcode::MOD_U},
+        {Opcode::ADD_L, Opcode::SUB_L, Opcode::MUL_L, Opcode::DIV_L, Opcode::MOD_L},
+        {Opcode::ADD_L, Opcode::SUB_L, Opcode::MUL_L, Opcode::DIV_Q, Opcode::MOD_Q},
+        {Opcode::ADD_F, Opcode::SUB_F, Opcode::MUL_F, Opcode::DIV_F, Opcode::DIV_F},
+        {Opcode::ADD_D, Opcode::SUB_D, Opcode::MUL_D, Opcode::DIV_D, Opcode::DIV_D},
+    };
+    int column;
+    switch (op) {
+        case BinaryOp::ADD: case BinaryOp::PLUS_ASSIGN: column = 0; break;
+        case BinaryOp::SUB: case BinaryOp::MINUS_ASSIGN: column = 1; break;
+        case BinaryOp::MUL: case BinaryOp::STAR_ASSIGN: column = 2; break;
+        case BinaryOp::DIV: case BinaryOp::SLASH_ASSIGN: column = 3; break;
+        default: column = 4; break;
+    }
+    if (column == 4 && (kind == Kind::F32 || kind == Kind::F64)) {
+        unsupported("floating-point remainders", line);
+    }
+    int out = target >= 0 ? target : allocTemp();
+    emit(table[(int)kind][column], out, left, right);
+    return out;
+}
+
+// current op= value, computed in the common type of both and narrowed back
+// to the type of current, as C does.
+int BytecodeCompiler::combine(BinaryOp op, int current, Type currentType, ExpressionNode* value, int target) {
+    if (currentType == Type::STRING) {
+        int parts = allocTemps(2);
+        emit(Opcode::MOV, parts, current);
+        expression(value, parts + 1);
+        int out = target >= 0 ? target : allocTemp();
+        emit(Opcode::CONCAT, out, parts, 0, 2);
+        return out;
+    }
+    int right = expression(value, -1);
+    Type valueType = resultType;
+    Kind kind = arithmeticKind(kindOf(currentType), kindOf(valueType));
+    Type common = typeOfKind(kind);
+    int left = convert(current, currentType, common, -1);
+    right = convert(right, valueType, common, -1);
+    bool narrows = needsConversion(common, currentType);
+    int out = arithmetic(op, left, right, kind, narrows ? -1 : target);
+    return narrows ? convert(out, common, currentType, target) : out;
+}
+
+// Evaluates both operands of a comparison, converted to the type they are
+// compared in.
+BytecodeCompiler::Kind BytecodeCompiler::operands(BinaryExprNode* node, int& left, int& right) {
+    left = expression(node->left.get(), -1);
+    Type leftType = resultType;
+    right = expression(node->right.get(), -1);
+    Type rightType = resultType;
+    if (leftType == Type::STRING) return Kind::STR;
+    Kind kind = arithmeticKind(kindOf(leftType), kindOf(rightType));
+    left = convert(left, leftType, typeOfKind(kind), -1);
+    right = convert(right, rightType, typeOfKind(kind), -1);
+    return kind;
+}
+
+// Jumps when `condition` is `jumpIf` and falls through otherwise. Integer
+// comparisons jump directly; && and || only evaluate what they need.
+void BytecodeCompiler::branch(ExpressionNode* condition, bool jumpIf, std::vector<int>& jumps) {
+    auto* literal = dynamic_cast<LiteralNode*>(condition);
+    if (literal && literal->literalType == Type::BOOL) {
+        if (literal->boolValue == jumpIf) {
+            jumps.push_back(emit(Opcode::JMP));
+        }
+        return;
+    }
+    auto* unary = dynamic_cast<UnaryExprNode*>(condition);
+    if (unary && unary->op == UnaryOp::NOT) {
+        branch(unary->operand.get(), !jumpIf, jumps);
+        return;
+    }
+    auto* bin = dynamic_cast<BinaryExprNode*>(condition);
+    if (bin && (bin->op == BinaryOp::AND || bin->op == BinaryOp::OR)) {
+        bool shortCircuit = bin->op == BinaryOp::OR; // the value that decides early
+        if (jumpIf == shortCircuit) {
+            branch(bin->left.get(), jumpIf, jumps);
+            branch(bin->right.get(), jumpIf, jumps);
+        } else {
+            std::vector<int> decided;
+            branch(bin->left.get(), shortCircuit, decided);
+            branch(bin->right.get(), jumpIf, jumps);
+            patch(decided, here());
+        }
+        return;
+    }
+    if (bin && isComparison(bin->op) && bin->left->type != Type::STRING) {
+        int left;
+        int right;
+        Kind kind = operands(bin, left, right);
+        if (kind != Kind::F32 && kind != Kind::F64) {
+            BinaryOp op = jumpIf ? bin->op : negated(bin->op);
+            if (op == BinaryOp::GT || op == BinaryOp::GE) {
+                std::swap(left, right);
+                op = op == BinaryOp::GT ? BinaryOp::LT : BinaryOp::LE;
+            }
+            Opcode jump;
+            switch (op) {
+                case BinaryOp::EQ: jump = Opcode::JEQ; break;
+                case BinaryOp::NE: jump = Opcode::JNE; break;
+                case BinaryOp::LT: jump = kind == Kind::U64 ? Opcode::JLT_Q : Opcode::JLT; break;
+                default: jump = kind == Kind::U64 ? Opcode::JLE_Q : Opcode::JLE; break;
+            }
+            jumps.push_back(emit(jump, left, right));
+            return;
+        }
+        // Negating a float comparison is wrong for NaN, so test the value.
+        int value = compare(bin->op, left, right, kind, -1);
+        jumps.push_back(emit(jumpIf ? Opcode::JMPT : Opcode::JMPF, value));
+        return;
+    }
+    int value = expression(condition, -1);
+    jumps.push_back(emit(jumpIf ? Opcode::JMPT : Opcode::JMPF, value));
+}
+
+int BytecodeCompiler::compare(BinaryOp op, int left, int right, Kind kind, int target) {
+    if (op == BinaryOp::GT || op == BinaryOp::GE) {
+        std::swap(left, right);
+        op = op == BinaryOp::GT ? BinaryOp::LT : BinaryOp::LE;
+    }
+    int row = kind == Kind::STR ? 3 : kind == Kind::F32 || kind == Kind::F64 ? 2 : kind == Kind::U64 ? 1 : 0;
+    static const Opcode table[4][4] = {
+        {Opcode::EQ_L, Opcode::NE_L, Opcode::LT_L, Opcode::LE_L},
+        {Opcode::EQ_L, Opcode::NE_L, Opcode::LT_Q, Opcode::LE_Q},
+        {Opcode::EQ_D, Opcode::NE_D, Opcode::LT_D, Opcode::LE_D},
+        {Opcode::EQ_S, Opcode::NE_S, Opcode::LT_S, Opcode::LE_S},
+    };
+    int column = op == BinaryOp::EQ ? 0 : op == BinaryOp::NE ? 1 : op == BinaryOp::LT ? 2 : 3;
+    int out = target >= 0 ? target : allocTemp();
+    emit(table[row][column], out, left, right);
+    return out;
+}
+
+int BytecodeCompiler::increment(const Variable& var, bool up) {
+    Kind kind = kindOf(var.type);
+    Type common = typeOfKind(kind);
+    Value one;
+    if (kind == Kind::F32 || kind == Kind::F64) {
+        one.d = 1.0;
+    } else {
+        one.i = 1;
+    }
+    int target = var.global >= 0 ? -1 : var.reg;
+    bool narrows = needsConversion(common, var.type);
+    int current = convert(load(var), var.type, common, -1);
+    int out = arithmetic(up ? BinaryOp::ADD : BinaryOp::SUB, current, constant(one), kind, narrows ? -1 : target);
+    if (narrows) {
+        out = convert(out, common, var.type, target);
+    }
+    store(var, out);
+    return out;
+}
+
+void BytecodeCompiler::statement(StatementNode* stmt) {
+    if (stmt->line) {
+        line = stmt->line;
+    }
+    stmt->accept(this);
+    nextReg = localsEnd;
+}
+
+void BytecodeCompiler::compileFunction(FunctionNode* node) {
+    function = &program.functions[functionIndex[node->name]];
+    function->name = node->name;
+    function->paramCount = (int)node->parameters.size();
+    returnType = node->returnType;
+    constantIndex.clear();
+    nextReg = localsEnd = maxReg = 0;
+    lastLabel = -1;
+    line = node->line;
+    supported(node->returnType, node->returnClass, node->line);
+
+    enterScope();
+    for (size_t i = 0; i < node->parameters.size(); ++i) {
+        const auto& param = node->parameters[i];
+        std::string className = i < node->parameterClasses.size() ? node->parameterClasses[i] : "";
+        supported(param.second, className, node->line);
+        scopes.back()[param.first] = newVariable(param.second, className, false);
+    }
+    if (node->body) {
+        node->body->accept(this);
+    }
+    emit(Opcode::RET0);
+    exitScope();
+    finishFunction();
+}
+
+// Puts the constants right after the parameters, where CALL copies them.
+void BytecodeCompiler::finishFunction() {
+    int constants = (int)function->constants.size();
+    int params = function->paramCount;
+    if (maxReg + constants >= REGISTER_LIMIT - constants) {
+        std::stringstream ss;
+        ss << "Line " << line << ": Function '" << function->name << "' needs more registers than --run has";
+        errors.push_back(ss.str());
+        return;
+    }
+    auto remap = [&](uint16_t& reg) {
+        if (reg > REGISTER_LIMIT - constants) {
+            reg = (uint16_t)(params + REGISTER_LIMIT - reg);
+        } else if (reg >= params) {
+            reg = (uint16_t)(reg + constants);
+        }
+    };
+    for (auto& instruction : function->code) {
+        remap(instruction.a);
+        remap(instruction.b);
+        remap(instruction.c);
+    }
+    function->constBase = params;
+    function->frameSize = std::max(maxReg, params) + constants;
+}
+
+void BytecodeCompiler::visit(ProgramNode* node) {
+    if (!node->classes.empty()) {
+        unsupported("classes and structs", node->classes.front()->line);
+        return;
+    }
+
+    // The entry function comes first; every function gets its index before
+    // any code is compiled, so calls may go in any direction.
+    std::vector<FunctionNode*> bodies;
+    for (auto& func : node->functions) {
+        bodies.push_back(func.get());
+    }
+    for (auto& templ : node->templates) {
+        for (auto& instance : templ->instances) {
+            bodies.push_back(instance.get());
+        }
+    }
+    program.functions.resize(bodies.size() + 1);
+    program.entry = 0;
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        functionIndex[bodies[i]->name] = (int)i + 1;
+        functionNodes[bodies[i]->name] = bodies[i];
+    }
+    auto main = functionIndex.find("main");
+    if (main == functionIndex.end()) {
+        errors.push_back("Line 1: --run needs a main function");
+        return;
+    }
+
+    // <init> sets up the globals, then returns what main returns.
+    function = &program.functions[0];
+    function->name = "<init>";
+    scopes.emplace_back();
+    fileScope = true;
+    for (auto& global : node->globals) {
+        statement(global.get());
+    }
+    fileScope = false;
+    int result = allocTemp();
+    emit(Opcode::CALL, result, nextReg, 0, main->second);
+    emit(Opcode::RET, result);
+    finishFunction();
+
+    for (FunctionNode* body : bodies) {
+        compileFunction(body);
+    }
+}
+
+void BytecodeCompiler::visit(DirectiveNode* node) {
+}
+
+void BytecodeCompiler::visit(FunctionNode* node) {
+}
+
+void BytecodeCompiler::visit(TemplateNode* node) {
+}
+
+void BytecodeCompiler::visit(ClassNode* node) {
+    unsupported("classes and structs", node->line);
+}
+
+void BytecodeCompiler::visit(MethodNode* node) {
+    unsupported("classes and structs", node->line);
+}
+
+void BytecodeCompiler::visit(ConstructorNode* node) {
+    unsupported("classes and structs", node->line);
+}
+
+void BytecodeCompiler::visit(BlockNode* node) {
+    enterScope();
+    for (auto& stmt : node->statements) {
+        statement(stmt.get());
+    }
+    exitScope();
+}
+
+void BytecodeCompiler::visit(VarDeclNode* node) {
+    if (!supported(node->type, node->className, node->line)) return;
+    Variable var = newVariable(node->type, node->className, node->isArray);
+    int target = var.global >= 0 ? -1 : var.reg;
+    int value;
+    if (node->isArray) {
+        if (!node->arraySize || node->initializer) {
+            unsupported("array initializers", node->line);
+            return;
+        }
+        int size = expressionAs(node->arraySize.get(), Type::INT, -1);
+        value = target >= 0 ? target : allocTemp();
+        emit(Opcode::NEWARR, value, size);
+    } else if (node->initializer) {
+        value = expressionAs(node->initializer.get(), node->type, target);
+    } else if (node->type == Type::ARRAY || node->type == Type::SLICE) {
+        value = target >= 0 ? target : allocTemp();
+        emit(Opcode::NEWDYN, value);
+    } else if (target >= 0) {
+        value = place(intConstant(0), target); // globals start zeroed
+    } else {
+        scopes.back()[node->name] = var;
+        return;
+    }
+    store(var, value);
+    scopes.back()[node->name] = var;
+}
+
+void BytecodeCompiler::visit(VarAssignNode* node) {
+    if (!node->field.empty() || node->isField) {
+        unsupported("classes and structs", node->line);
+        return;
+    }
+    if (node->index && node->arrayKind == ArrayKind::MAP) {
+        unsupported("maps", node->line);
+        return;
+    }
+    Variable* var = lookup(node->name);
+    if (!var) return;
+    bool compound = node->assignOp != BinaryOp::ADD; // plain = is parsed as ADD
+
+    if (node->index) {
+        int array = load(*var);
+        int index = expression(node->index.get(), -1);
+        int value;
+        if (compound) {
+            int current = allocTemp();
+            emit(Opcode::GETE, current, array, index);
+            value = combine(node->assignOp, current, var->element, node->value.get(), -1);
+        } else {
+            value = expressionAs(node->value.get(), var->element, -1);
+        }
+        emit(Opcode::SETE, array, index, value);
+        return;
+    }
+
+    int target = var->global >= 0 ? -1 : var->reg;
+    int value;
+    if (compound) {
+        value = combine(node->assignOp, load(*var), var->type, node->value.get(), target);
+    } else {
+        value = expressionAs(node->value.get(), var->type, target);
+    }
+    store(*var, value);
+}
+
+void BytecodeCompiler::visit(ReturnNode* node) {
+    if (node->value && returnType != Type::VOID) {
+        emit(Opcode::RET, expressionAs(node->value.get(), returnType, -1));
+    } else {
+        emit(Opcode::RET0);
+    }
+}
+
+void BytecodeCompiler::visit(IfNode* node) {
+    std::vector<int> elseJumps;
+    branch(node->condition.get(), false, elseJumps);
+    nextReg = localsEnd;
+    if (node->thenBlock) {
+        node->thenBlock->accept(this);
+    }
+    if (node->elseIf || node->elseBlock) {
+        std::vector<int> endJumps = {emit(Opcode::JMP)};
+        patch(elseJumps, here());
+        if (node->elseIf) {
+            statement(node->elseIf.get());
+        } else {
+            node->elseBlock->accept(this);
+        }
+        patch(endJumps, here());
+    } else {
+        patch(elseJumps, here());
+    }
+}
+
+// Loops test their condition at the bottom, so each iteration takes one
+// conditional jump; the first test is reached by a jump over the body.
+void BytecodeCompiler::loop(ExpressionNode* condition, BlockNode* body, ExpressionNode* step, bool testFirst) {
+    std::vector<int> entry;
+    if (testFirst) {
+        entry.push_back(emit(Opcode::JMP));
+    }
+    int bodyStart = here();
+    lastLabel = std::max(lastLabel, bodyStart);
+    jumpTargets.push_back({true, {}, {}});
+    if (body) {
+        body->accept(this);
+    }
+    JumpTarget target = jumpTargets.back();
+    jumpTargets.pop_back();
+
+    patch(target.continues, here());
+    if (step) {
+        expression(step, -1);
+        nextReg = localsEnd;
+    }
+    patch(entry, here());
+    std::vector<int> back;
+    if (condition) {
+        branch(condition, true, back);
+        nextReg = localsEnd;
+    } else {
+        back.push_back(emit(Opcode::JMP));
+    }
+    patch(back, bodyStart);
+    patch(target.breaks, here());
+}
+
+void BytecodeCompiler::visit(WhileNode* node) {
+    loop(node->condition.get(), node->body.get(), nullptr, true);
+}
+
+// parallel for runs its iterations in order, which gives the result its
+// reductions compute.
+void BytecodeCompiler::visit(ForNode* node) {
+    enterScope();
+    if (node->init) {
+        statement(node->init.get());
+    }
+    loop(node->condition.get(), node->body.get(), node->increment.get(), true);
+    exitScope();
+}
+
+void BytecodeCompiler::visit(DoWhileNode* node) {
+    loop(node->condition.get(), node->body.get(), nullptr, false);
+}
+
+void BytecodeCompiler::visit(BinaryExprNode* node) {
+    if (node->type == Type::STRING && node->op == BinaryOp::ADD) {
+        std::vector<ExpressionNode*> parts;
+        collectConcatParts(node, parts);
+        int first = allocTemps((int)parts.size());
+        for (size_t i = 0; i < parts.size(); ++i) {
+            expression(parts[i], first + (int)i);
+        }
+        int out = allocTemp();
+        emit(Opcode::CONCAT, out, first, 0, (int32_t)parts.size());
+        result(out, Type::STRING);
+        return;
+    }
+
+    if (node->op == BinaryOp::AND || node->op == BinaryOp::OR) {
+        std::vector<int> falseJumps;
+        branch(node, false, falseJumps);
+        int out = allocTemp();
+        emit(Opcode::MOV, out, intConstant(1));
+        std::vector<int> endJumps = {emit(Opcode::JMP)};
+        patch(falseJumps, here());
+        emit(Opcode::MOV, out, intConstant(0));
+        patch(endJumps, here());
+        result(out, Type::BOOL);
+        return;
+    }
+
+    int left;
+    int right;
+    Kind kind = operands(node, left, right);
+    if (isComparison(node->op)) {
+        result(compare(node->op, left, right, kind, -1), Type::BOOL);
+    } else {
+        result(arithmetic(node->op, left, right, kind, -1), typeOfKind(kind));
+    }
+}
+
+void BytecodeCompiler::visit(UnaryExprNode* node) {
+    int operand = expression(node->operand.get(), -1);
+    if (node->op == UnaryOp::NOT) {
+        int out = allocTemp();
+        emit(Opcode::NOT, out, operand);
+        result(out, Type::BOOL);
+        return;
+    }
+
+    Kind kind = kindOf(resultType);
+    Type type = typeOfKind(kind);
+    operand = convert(operand, resultType, type, -1);
+    if (isConstant(operand)) {
+        Value value = function->constants[REGISTER_LIMIT - operand];
+        if (kind == Kind::F32 || kind == Kind::F64) {
+            value.d = -value.d;
+        } else {
+            value.i = narrow((int64_t)(0 - value.u), type);
+        }
+        result(constant(value), type);
+        return;
+    }
+    Opcode op = kind == Kind::I32 ? Opcode::NEG_I : kind == Kind::U32 ? Opcode::NEG_U
+              : kind == Kind::F32 || kind == Kind::F64 ? Opcode::NEG_D : Opcode::NEG_L;
+    int out = allocTemp();
+    emit(op, out, operand);
+    result(out, type);
+}
+
+void BytecodeCompiler::visit(CallExprNode* node) {
+    const std::string& name = node->functionName;
+    auto callee = functionNodes.find(name);
+    if (callee != functionNodes.end()) {
+        FunctionNode* func = callee->second;
+        int first = allocTemps((int)node->arguments.size());
+        for (size_t i = 0; i < node->arguments.size(); ++i) {
+            expressionAs(node->arguments[i].get(), func->parameters[i].second, first + (int)i);
+        }
+        int out = allocTemp();
+        emit(Opcode::CALL, out, first, 0, functionIndex[name]);
+        result(out, func->returnType);
+        return;
+    }
+
+    if (name == "len" || name == "str_len") {
+        int value = expression(node->arguments[0].get(), -1);
+        int out = allocTemp();
+        emit(name == "len" ? Opcode::LEN : Opcode::STRLEN, out, value);
+        result(out, Type::INT);
+        return;
+    }
+
+    auto builtin = builtinTable().find(name);
+    if (builtin == builtinTable().end() || (!node->arguments.empty() && node->arguments[0]->type == Type::MAP)) {
+        unsupported(node->type == Type::CLASS ? "classes and structs"
+                    : node->arguments.empty() || node->arguments[0]->type != Type::MAP ? unsupportedBuiltin(name)
+                    : "maps", node->line);
+        result(intConstant(0), node->type);
+        return;
+    }
+    const BuiltinInfo& info = builtin->second;
+    int first = allocTemps((int)node->arguments.size());
+    for (size_t i = 0; i < node->arguments.size(); ++i) {
+        Type param = info.params[i];
+        if (param == Type::VOID) {
+            param = arrayElementType(node->arguments[0]->className); // push
+        }
+        if (param == Type::ARRAY) {
+            expression(node->arguments[i].get(), first + (int)i);
+        } else {
+            expressionAs(node->arguments[i].get(), param, first + (int)i);
+        }
+    }
+    int out = allocTemp();
+    emit(Opcode::BUILTIN, out, first, 0, (int32_t)info.id);
+    result(out, info.returnType);
+}
+
+void BytecodeCompiler::visit(LiteralNode* node) {
+    Value value;
+    switch (node->literalType) {
+        case Type::DOUBLE: value.d = node->doubleValue; break;
+        case Type::FLOAT: value.d = node->floatValue; break;
+        case Type::BOOL: value.i = node->boolValue ? 1 : 0; break;
+        case Type::STRING:
+            result(stringConstant(node->stringValue), Type::STRING);
+            return;
+        default: value.i = node->intValue; break;
+    }
+    result(constant(value), node->literalType);
+}
+
+void BytecodeCompiler::visit(VarNode* node) {
+    Variable* var = node->isField ? nullptr : lookup(node->name);
+    if (!var) {
+        unsupported("classes and structs", node->line);
+        result(intConstant(0), Type::INT);
+        return;
+    }
+    result(load(*var), var->isArray ? Type::ARRAY : var->type);
+}
+
+void BytecodeCompiler::visit(ArrayAccessNode* node) {
+    if (node->arrayKind == ArrayKind::MAP) {
+        unsupported("maps", node->line);
+        result(intConstant(0), node->type);
+        return;
+    }
+    if (node->line) {
+        line = node->line;
+    }
+    Variable* var = lookup(node->arrayName);
+    int array = load(*var);
+    int index = expression(node->index.get(), -1);
+    int out = allocTemp();
+    emit(Opcode::GETE, out, array, index);
+    result(out, var->element);
+}
+
+void BytecodeCompiler::visit(IncDecNode* node) {
+    Variable* var = node->isField ? nullptr : lookup(node->name);
+    if (!var) {
+        unsupported("classes and structs", node->line);
+        return;
+    }
+    increment(*var, node->isIncrement);
+}
+
+void BytecodeCompiler::visit(IncDecExprNode* node) {
+    Variable* var = node->isField ? nullptr : lookup(node->name);
+    if (!var) {
+        unsupported("classes and structs", node->line);
+        result(intConstant(0), Type::INT);
+        return;
+    }
+    if (node->isPrefix) {
+        result(increment(*var, node->isIncrement), var->type);
+        return;
+    }
+    int old = load(*var);
+    if (var->global < 0) {
+        old = allocTemp();
+        emit(Opcode::MOV, old, var->reg);
+    }
+    increment(*var, node->isIncrement);
+    result(old, var->type);
+}
+
+void BytecodeCompiler::visit(BreakNode* node) {
+    jumpTargets.back().breaks.push_back(emit(Opcode::JMP));
+}
+
+void BytecodeCompiler::visit(ContinueNode* node) {
+    for (auto target = jumpTargets.rbegin(); target != jumpTargets.rend(); ++target) {
+        if (target->isLoop) {
+            target->continues.push_back(emit(Opcode::JMP));
+            return;
+        }
+    }
+}
+
+// One SWITCH through the same perfect hash as the compiled dispatch; case
+// bodies follow each other so that they fall through.
+void BytecodeCompiler::visit(SwitchNode* node) {
+    int key = expression(node->expression.get(), -1);
+    bool isString = resultType == Type::STRING;
+    size_t count = node->cases.size();
+    int table = (int)program.switches.size();
+    program.switches.emplace_back();
+
+    std::vector<int> dispatch;
+    if (count == 0) {
+        dispatch.push_back(emit(Opcode::JMP));
+    } else {
+        program.switches[table].hash = buildPerfectHash(count, [&](size_t i, uint64_t seed) {
+            return isString ? switchHashString(node->cases[i]->stringValue, seed)
+                            : switchHashInt(node->cases[i]->intValue, seed);
+        });
+        emit(isString ? Opcode::SWITCH_S : Opcode::SWITCH, key, 0, 0, table);
+    }
+    nextReg = localsEnd;
+
+    jumpTargets.push_back({false, {}, {}});
+    std::vector<int> starts;
+    for (auto& caseNode : node->cases) {
+        starts.push_back(here());
+        lastLabel = std::max(lastLabel, here());
+        caseNode->accept(this);
+    }
+    int defaultTarget = here();
+    lastLabel = std::max(lastLabel, here());
+    if (node->defaultCase) {
+        node->defaultCase->accept(this);
+    }
+    JumpTarget target = jumpTargets.back();
+    jumpTargets.pop_back();
+    patch(target.breaks, here());
+    patch(dispatch, defaultTarget);
+    lastLabel = std::max(lastLabel, here());
+
+    SwitchTable& entry = program.switches[table];
+    entry.defaultTarget = defaultTarget;
+    for (int slot : entry.hash.slots) {
+        entry.targets.push_back(slot < 0 ? defaultTarget : starts[slot]);
+        if (isString) {
+            entry.stringKeys.push_back(slot < 0 ? "" : node->cases[slot]->stringValue);
+        } else {
+            entry.keys.push_back(slot < 0 ? 0 : node->cases[slot]->intValue);
+        }
+    }
+}
+
+void BytecodeCompiler::visit(CaseNode* node) {
+    if (node->block) {
+        node->block->accept(this);
+    }
+}
+
+void BytecodeCompiler::visit(TernaryExprNode* node) {
+    Type type = node->trueExpr->type;
+    if (isNumericType(type) && isNumericType(node->falseExpr->type)) {
+        type = typeOfKind(arithmeticKind(kindOf(type), kindOf(node->falseExpr->type)));
+    }
+    std::vector<int> elseJumps;
+    branch(node->condition.get(), false, elseJumps);
+    int out = allocTemp();
+    expressionAs(node->trueExpr.get(), type, out);
+    std::vector<int> endJumps = {emit(Opcode::JMP)};
+    patch(elseJumps, here());
+    expressionAs(node->falseExpr.get(), type, out);
+    patch(endJumps, here());
+    result(out, type);
+}
+
+// The task runs right away on this thread; sync has nothing to wait for.
+void BytecodeCompiler::visit(SpawnNode* node) {
+    if (node->target.empty()) {
+        expression(node->call.get(), -1);
+        return;
+    }
+    Variable var;
+    if (node->declaresTarget) {
+        if (!supported(node->targetType, node->targetClass, node->line)) return;
+        var = newVariable(node->targetType, node->targetClass, false);
+    } else {
+        Variable* existing = lookup(node->target);
+        if (!existing) return;
+        var = *existing;
+    }
+    store(var, expressionAs(node->call.get(), var.type, var.global >= 0 ? -1 : var.reg));
+    if (node->declaresTarget) {
+        scopes.back()[node->target] = var;
+    }
+}
+
+void BytecodeCompiler::visit(SyncNode* node) {
+}
+
+void BytecodeCompiler::visit(ExpressionStmtNode* node) {
+    if (node->expression) {
+        expression(node->expression.get(), -1);
+    }
+}
+
+void BytecodeCompiler::visit(FieldAccessNode* node) {
+    unsupported("classes and structs", node->line);
+    result(intConstant(0), node->type);
+}
+
+// A missing low bound is 0 and a missing high bound the length; the VM
+// checks lo <= hi <= length.
+void BytecodeCompiler::visit(SliceExprNode* node) {
+    Variable* var = lookup(node->arrayName);
+    bool isString = node->type == Type::STRING;
+    int source = load(*var);
+    int bounds = allocTemps(2);
+    if (node->low) {
+        expressionAs(node->low.get(), Type::INT, bounds);
+    } else {
+        emit(Opcode::MOV, bounds, intConstant(0));
+    }
+    if (node->high) {
+        expressionAs(node->high.get(), Type::INT, bounds + 1);
+    } else {
+        emit(isString ? Opcode::STRLEN : Opcode::LEN, bounds + 1, source);
+    }
+    int out = allocTemp();
+    emit(isString ? Opcode::SLICE_S : Opcode::SLICE, out, source, bounds);
+    result(out, node->type);
+}
@@ -0,0 +1,147 @@
+#ifndef VM_COMPILER_H
+#define VM_COMPILER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include "../ast/ast.h"
+#include "bytecode.h"
+
+// Compiles a semantically checked program to register bytecode for
+// `slc --run`. Covers scalars, strings, fixed and growable arrays, slices,
+// switch and the I/O built-ins; parallel for and spawn run sequentially,
+// which gives the same results. Programs using classes, maps, vector types
+// or memory-mapped and asynchronous files are reported and must be
+// compiled to C instead.
+class BytecodeCompiler : public ASTVisitor {
+private:
+    // How a value is held in a register; the arithmetic of a binary
+    // expression runs in the wider kind of its operands, as in C.
+    enum class Kind { I32, U32, I64, U64, F32, F64, STR, REF, NONE };
+
+    struct Variable {
+        int reg = 0;
+        int global = -1;          // slot in the globals, -1 for locals
+        Type type = Type::VOID;   // declared type; element type of fixed arrays
+        Type element = Type::VOID; // element type of any array
+        bool isArray = false;     // fixed array
+    };
+
+    // Innermost loop or switch: the jumps of its break and continue
+    // statements, patched once the targets are known.
+    struct JumpTarget {
+        bool isLoop;
+        std::vector<int> breaks;
+        std::vector<int> continues;
+    };
+
+    BytecodeProgram program;
+    std::vector<std::string> errors;
+    std::map<std::string, int> functionIndex;
+    std::map<std::string, FunctionNode*> functionNodes;
+    std::map<std::string, const VMString*> stringConstants;
+    std::vector<std::map<std::string, Variable>> scopes; // globals first
+    std::vector<int> scopeLocals;
+    std::vector<JumpTarget> jumpTargets;
+
+    // State of the function being compiled.
+    VMFunction* function;
+    Type returnType;
+    std::map<int64_t, int> constantIndex;
+    int nextReg;   // first free register
+    int localsEnd; // registers below hold live locals
+    int maxReg;
+    int line;
+    int lastLabel; // latest instruction a jump lands on
+    bool fileScope;
+
+    // Register and type of the value of the last expression compiled.
+    int resultReg;
+    Type resultType;
+
+    void unsupported(const std::string& what, int line);
+    static Kind kindOf(Type type);
+    static Type typeOfKind(Kind kind);
+    static Kind arithmeticKind(Kind left, Kind right);
+    bool supported(Type type, const std::string& className, int line);
+
+    int emit(Opcode op, int a = 0, int b = 0, int c = 0, int32_t k = 0);
+    int here() const;
+    void patch(const std::vector<int>& jumps, int target);
+    int allocTemp();
+    int allocTemps(int count);
+    bool isConstant(int reg) const;
+    int constant(Value value);
+    int intConstant(int64_t value);
+    int stringConstant(const std::string& text);
+    int place(int reg, int target);
+    void result(int reg, Type type);
+
+    void enterScope();
+    void exitScope();
+    Variable* lookup(const std::string& name);
+    Variable newVariable(Type type, const std::string& className, bool isArray);
+    int load(const Variable& var);
+    void store(const Variable& var, int reg);
+
+    // Compile an expression and return the register holding its value, which
+    // is `target` unless that is -1.
+    int expression(ExpressionNode* expr, int target);
+    int expressionAs(ExpressionNode* expr, Type to, int target);
+    int convert(int reg, Type from, Type to, int target);
+    int arithmetic(BinaryOp op, int left, int right, Kind kind, int target);
+    int combine(BinaryOp op, int current, Type currentType, ExpressionNode* value, int target);
+    Kind operands(BinaryExprNode* node, int& left, int& right);
+    int compare(BinaryOp op, int left, int right, Kind kind, int target);
+    void branch(ExpressionNode* condition, bool jumpIf, std::vector<int>& jumps);
+    int increment(const Variable& var, bool up);
+    void loop(ExpressionNode* condition, BlockNode* body, ExpressionNode* step, bool testFirst);
+    void statement(StatementNode* stmt);
+    void compileFunction(FunctionNode* node);
+    void finishFunction();
+
+public:
+    BytecodeCompiler();
+
+    // Returns false and fills getErrors() when the program uses something
+    // the bytecode does not cover.
+    bool compile(ProgramNode* root);
+    const BytecodeProgram& getProgram() const { return program; }
+    const std::vector<std::string>& getErrors() const { return errors; }
+
+    void visit(ProgramNode* node) override;
+    void visit(DirectiveNode* node) override;
+    void visit(FunctionNode* node) override;
+    void visit(TemplateNode* node) override;
+    void visit(ClassNode* node) override;
+    void visit(MethodNode* node) override;
+    void visit(ConstructorNode* node) override;
+    void visit(BlockNode* node) override;
+    void visit(VarDeclNode* node) override;
+    void visit(VarAssignNode* node) override;
+    void visit(ReturnNode* node) override;
+    void visit(IfNode* node) override;
+    void visit(WhileNode* node) override;
+    void visit(ForNode* node) override;
+    void visit(BinaryExprNode* node) override;
+    void visit(UnaryExprNode* node) override;
+    void visit(CallExprNode* node) override;
+    void visit(LiteralNode* node) override;
+    void visit(VarNode* node) override;
+    void visit(ArrayAccessNode* node) override;
+    void visit(IncDecNode* node) override;
+    void visit(IncDecExprNode* node) override;
+    void visit(DoWhileNode* node) override;
+    void visit(BreakNode* node) override;
+    void visit(ContinueNode* node) override;
+    void visit(SwitchNode* node) override;
+    void visit(CaseNode* node) override;
+    void visit(TernaryExprNode* node) override;
+    void visit(SpawnNode* node) override;
+    void visit(SyncNode* node) override;
+    void visit(ExpressionStmtNode* node) override;
+    void visit(FieldAccessNode* node) override;
+    void visit(SliceExprNode* node) override;
+};
+
+#endif // VM_COMPILER_H
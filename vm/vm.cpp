@@ -0,0 +1,490 @@
+#include "vm.h"
+#include <cinttypes>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+
+namespace {
+
+// Both stacks are reserved up front and only touched pages are backed.
+const size_t REGISTER_STACK = (size_t)1 << 24; // values
+const size_t DATA_STACK = (size_t)1 << 30;     // bytes
+const size_t ARENA_BLOCK = (size_t)1 << 20;
+
+void* reserve(size_t bytes) {
+    void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    return memory;
+}
+
+// A null string is the empty string, which is what unset globals hold.
+inline const char* chars(const void* s) {
+    return s ? static_cast<const VMString*>(s)->data : "";
+}
+
+inline uint32_t length(const void* s) {
+    return s ? static_cast<const VMString*>(s)->len : 0;
+}
+
+bool equalStrings(const void* a, const void* b) {
+    uint32_t n = length(a);
+    return n == length(b) && memcmp(chars(a), chars(b), n) == 0;
+}
+
+int compareStrings(const void* a, const void* b) {
+    uint32_t la = length(a);
+    uint32_t lb = length(b);
+    int c = memcmp(chars(a), chars(b), la < lb ? la : lb);
+    if (c != 0) return c;
+    return (la > lb) - (la < lb);
+}
+
+void resizeArray(VMArray* array, int64_t capacity) {
+    Value* data = (Value*)realloc(array->data, (size_t)capacity * sizeof(Value));
+    if (!data && capacity > 0) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    array->data = data;
+    array->cap = (int)capacity;
+}
+
+} // namespace
+
+VirtualMachine::VirtualMachine(const BytecodeProgram& program)
+    : program(program), globals(program.globalCount), arenaNext(nullptr), arenaEnd(nullptr),
+      inputEnded(false), lineBuffer(nullptr), lineCapacity(0) {
+    registers = static_cast<Value*>(reserve(REGISTER_STACK * sizeof(Value)));
+    registersEnd = registers + REGISTER_STACK;
+    data = static_cast<char*>(reserve(DATA_STACK));
+    dataEnd = data + DATA_STACK;
+    frames.reserve(256);
+}
+
+VirtualMachine::~VirtualMachine() {
+    munmap(registers, REGISTER_STACK * sizeof(Value));
+    munmap(data, DATA_STACK);
+    for (char* block : arenaBlocks) {
+        free(block);
+    }
+    free(lineBuffer);
+}
+
+void* VirtualMachine::allocate(size_t bytes) {
+    bytes = (bytes + 15) & ~(size_t)15;
+    if ((size_t)(arenaEnd - arenaNext) < bytes) {
+        size_t size = bytes > ARENA_BLOCK ? bytes : ARENA_BLOCK;
+        char* block = static_cast<char*>(malloc(size));
+        if (!block) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        arenaBlocks.push_back(block);
+        arenaNext = block;
+        arenaEnd = block + size;
+    }
+    void* result = arenaNext;
+    arenaNext += bytes;
+    return result;
+}
+
+const VMString* VirtualMachine::makeString(const char* bytes, size_t size) {
+    char* memory = static_cast<char*>(allocate(sizeof(VMString) + size));
+    VMString* s = reinterpret_cast<VMString*>(memory);
+    memcpy(memory + sizeof(VMString), bytes, size);
+    s->len = (uint32_t)size;
+    s->data = memory + sizeof(VMString);
+    return s;
+}
+
+void VirtualMachine::fail(const VMFunction* function, const Instruction* at, const char* format, ...) {
+    fflush(stdout);
+    fprintf(stderr, "line %d: ", function->lines[at - function->code.data()]);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+    abort();
+}
+
+// Output goes through stdio with a large buffer, like the compiled
+// runtime; printf("%f") is what its write_double reproduces.
+Value VirtualMachine::builtin(Builtin id, Value* args) {
+    Value result;
+    result.i = 0;
+    VMArray* array = static_cast<VMArray*>(args[0].p);
+    switch (id) {
+        case Builtin::push:
+            if (array->len == array->cap) {
+                resizeArray(array, array->cap ? (int64_t)array->cap * 2 : 8);
+            }
+            array->data[array->len++] = args[1];
+            break;
+        case Builtin::reserve:
+            if (args[1].i > array->cap) resizeArray(array, args[1].i);
+            break;
+        case Builtin::shrink:
+            if (array->cap > array->len) resizeArray(array, array->len);
+            break;
+        case Builtin::array_free:
+            free(array->data);
+            free(array);
+            break;
+        case Builtin::bits_count:
+            for (int i = 0; i < array->len; i++) {
+                result.i += array->data[i].i != 0;
+            }
+            break;
+        case Builtin::bits_fill:
+            for (int i = 0; i < array->len; i++) {
+                array->data[i].i = args[1].i != 0;
+            }
+            break;
+        case Builtin::write_int:
+            printf("%" PRId64, args[0].i);
+            break;
+        case Builtin::write_uint:
+            printf("%" PRIu64, args[0].u);
+            break;
+        case Builtin::write_double:
+            printf("%f", args[0].d);
+            break;
+        case Builtin::write_bool:
+            fputs(args[0].i ? "true" : "false", stdout);
+            break;
+        case Builtin::write_str:
+            fwrite(chars(args[0].p), 1, length(args[0].p), stdout);
+            break;
+        case Builtin::write_newline:
+            putchar('\n');
+            break;
+        case Builtin::flush:
+            fflush(stdout);
+            break;
+        case Builtin::read_line: {
+            fflush(stdout); // a prompt written before reading must be visible
+            ssize_t n = getline(&lineBuffer, &lineCapacity, stdin);
+            if (n < 0) {
+                inputEnded = true;
+                break;
+            }
+            if (n > 0 && lineBuffer[n - 1] == '\n') n--;
+            result.p = (void*)makeString(lineBuffer, (size_t)n);
+            break;
+        }
+        case Builtin::at_eof:
+            result.i = inputEnded;
+            break;
+        case Builtin::str_reset:
+            break; // slices share the arena with strings, so it is kept
+    }
+    return result;
+}
+
+int VirtualMachine::run() {
+    static char outputBuffer[1 << 16];
+    setvbuf(stdout, outputBuffer, _IOFBF, sizeof(outputBuffer));
+
+    const std::vector<VMFunction>& functions = program.functions;
+    const VMFunction* fn = &functions[program.entry];
+    Value* base = registers;
+    Value* global = globals.data();
+    char* dataTop = data;
+    memcpy(base + fn->constBase, fn->constants.data(), fn->constants.size() * sizeof(Value));
+    const Instruction* ip = fn->code.data();
+
+#define A base[ip->a]
+#define B base[ip->b]
+#define C base[ip->c]
+#define INT32(x) ((int64_t)(int32_t)(uint32_t)(x))
+
+// Threaded dispatch: every handler ends in its own indirect jump, which
+// predicts far better than the single jump of a switch.
+#ifdef __GNUC__
+#define SL_VM_LABEL(name) &&op_##name,
+    static void* const dispatch[] = {SL_VM_OPCODES(SL_VM_LABEL)};
+#undef SL_VM_LABEL
+#define OP(name) op_##name:
+#define DISPATCH() goto *dispatch[(int)ip->op]
+#else
+#define OP(name) case Opcode::name:
+#define DISPATCH() goto next
+#endif
+#define NEXT() do { ++ip; DISPATCH(); } while (0)
+#define JUMP(target) do { ip = fn->code.data() + (target); DISPATCH(); } while (0)
+#define RETURN(value) do { \
+        Value returned = (value); \
+        if (frames.empty()) return (int)returned.i; \
+        const Frame& frame = frames.back(); \
+        *frame.result = returned; \
+        fn = frame.function; \
+        ip = frame.returnTo; \
+        base = frame.base; \
+        dataTop = frame.dataTop; \
+        frames.pop_back(); \
+        DISPATCH(); \
+    } while (0)
+
+#ifdef __GNUC__
+    DISPATCH();
+#else
+next:
+    switch (ip->op) {
+#endif
+    OP(MOV) { A = B; NEXT(); }
+    OP(GETG) { A = global[ip->k]; NEXT(); }
+    OP(SETG) { global[ip->k] = A; NEXT(); }
+
+    OP(ADD_I) { A.i = INT32(B.u + C.u); NEXT(); }
+    OP(SUB_I) { A.i = INT32(B.u - C.u); NEXT(); }
+    OP(MUL_I) { A.i = INT32(B.u * C.u); NEXT(); }
+    OP(DIV_I) {
+        int32_t d = (int32_t)C.i;
+        if (d == 0) fail(fn, ip, "division by zero");
+        A.i = d == -1 ? INT32(0 - B.u) : (int32_t)B.i / d;
+        NEXT();
+    }
+    OP(MOD_I) {
+        int32_t d = (int32_t)C.i;
+        if (d == 0) fail(fn, ip, "division by zero");
+        A.i = d == -1 ? 0 : (int32_t)B.i % d;
+        NEXT();
+    }
+    OP(ADD_U) { A.u = (uint32_t)(B.u + C.u); NEXT(); }
+    OP(SUB_U) { A.u = (uint32_t)(B.u - C.u); NEXT(); }
+    OP(MUL_U) { A.u = (uint32_t)(B.u * C.u); NEXT(); }
+    OP(DIV_U) {
+        if ((uint32_t)C.u == 0) fail(fn, ip, "division by zero");
+        A.u = (uint32_t)B.u / (uint32_t)C.u;
+        NEXT();
+    }
+    OP(MOD_U) {
+        if ((uint32_t)C.u == 0) fail(fn, ip, "division by zero");
+        A.u = (uint32_t)B.u % (uint32_t)C.u;
+        NEXT();
+    }
+    OP(ADD_L) { A.u = B.u + C.u; NEXT(); }
+    OP(SUB_L) { A.u = B.u - C.u; NEXT(); }
+    OP(MUL_L) { A.u = B.u * C.u; NEXT(); }
+    OP(DIV_L) {
+        if (C.i == 0) fail(fn, ip, "division by zero");
+        A.i = C.i == -1 ? (int64_t)(0 - B.u) : B.i / C.i;
+        NEXT();
+    }
+    OP(MOD_L) {
+        if (C.i == 0) fail(fn, ip, "division by zero");
+        A.i = C.i == -1 ? 0 : B.i % C.i;
+        NEXT();
+    }
+    OP(DIV_Q) {
+        if (C.u == 0) fail(fn, ip, "division by zero");
+        A.u = B.u / C.u;
+        NEXT();
+    }
+    OP(MOD_Q) {
+        if (C.u == 0) fail(fn, ip, "division by zero");
+        A.u = B.u % C.u;
+        NEXT();
+    }
+    OP(ADD_F) { A.d = (float)(B.d + C.d); NEXT(); }
+    OP(SUB_F) { A.d = (float)(B.d - C.d); NEXT(); }
+    OP(MUL_F) { A.d = (float)(B.d * C.d); NEXT(); }
+    OP(DIV_F) { A.d = (float)(B.d / C.d); NEXT(); }
+    OP(ADD_D) { A.d = B.d + C.d; NEXT(); }
+    OP(SUB_D) { A.d = B.d - C.d; NEXT(); }
+    OP(MUL_D) { A.d = B.d * C.d; NEXT(); }
+    OP(DIV_D) { A.d = B.d / C.d; NEXT(); }
+    OP(NEG_I) { A.i = INT32(0 - B.u); NEXT(); }
+    OP(NEG_U) { A.u = (uint32_t)(0 - B.u); NEXT(); }
+    OP(NEG_L) { A.u = 0 - B.u; NEXT(); }
+    OP(NEG_D) { A.d = -B.d; NEXT(); }
+    OP(NOT) { A.i = !B.i; NEXT(); }
+
+    OP(EQ_L) { A.i = B.i == C.i; NEXT(); }
+    OP(NE_L) { A.i = B.i != C.i; NEXT(); }
+    OP(LT_L) { A.i = B.i < C.i; NEXT(); }
+    OP(LE_L) { A.i = B.i <= C.i; NEXT(); }
+    OP(LT_Q) { A.i = B.u < C.u; NEXT(); }
+    OP(LE_Q) { A.i = B.u <= C.u; NEXT(); }
+    OP(EQ_D) { A.i = B.d == C.d; NEXT(); }
+    OP(NE_D) { A.i = B.d != C.d; NEXT(); }
+    OP(LT_D) { A.i = B.d < C.d; NEXT(); }
+    OP(LE_D) { A.i = B.d <= C.d; NEXT(); }
+    OP(EQ_S) { A.i = equalStrings(B.p, C.p); NEXT(); }
+    OP(NE_S) { A.i = !equalStrings(B.p, C.p); NEXT(); }
+    OP(LT_S) { A.i = compareStrings(B.p, C.p) < 0; NEXT(); }
+    OP(LE_S) { A.i = compareStrings(B.p, C.p) <= 0; NEXT(); }
+
+    OP(SEXT8) { A.i = (int8_t)B.i; NEXT(); }
+    OP(ZEXT8) { A.i = (uint8_t)B.i; NEXT(); }
+    OP(SEXT16) { A.i = (int16_t)B.i; NEXT(); }
+    OP(ZEXT16) { A.i = (uint16_t)B.i; NEXT(); }
+    OP(SEXT32) { A.i = (int32_t)B.i; NEXT(); }
+    OP(ZEXT32) { A.i = (uint32_t)B.i; NEXT(); }
+    OP(I2D) { A.d = (double)B.i; NEXT(); }
+    OP(Q2D) { A.d = (double)B.u; NEXT(); }
+    OP(I2F) { A.d = (float)B.i; NEXT(); }
+    OP(Q2F) { A.d = (float)B.u; NEXT(); }
+    OP(D2F) { A.d = (float)B.d; NEXT(); }
+    OP(D2L) { A.i = (int64_t)B.d; NEXT(); }
+    OP(D2Q) { A.u = (uint64_t)B.d; NEXT(); }
+
+    OP(JMP) { JUMP(ip->k); }
+    OP(JMPF) { if (!A.i) JUMP(ip->k); NEXT(); }
+    OP(JMPT) { if (A.i) JUMP(ip->k); NEXT(); }
+    OP(JEQ) { if (A.i == B.i) JUMP(ip->k); NEXT(); }
+    OP(JNE) { if (A.i != B.i) JUMP(ip->k); NEXT(); }
+    OP(JLT) { if (A.i < B.i) JUMP(ip->k); NEXT(); }
+    OP(JLE) { if (A.i <= B.i) JUMP(ip->k); NEXT(); }
+    OP(JLT_Q) { if (A.u < B.u) JUMP(ip->k); NEXT(); }
+    OP(JLE_Q) { if (A.u <= B.u) JUMP(ip->k); NEXT(); }
+    OP(SWITCH) {
+        const SwitchTable& table = program.switches[ip->k];
+        const PerfectHash& hash = table.hash;
+        uint64_t h = switchHashInt(A.i, hash.seed);
+        unsigned slot = switchSlot(h, hash.bucketSeeds[h & (hash.bucketSeeds.size() - 1)],
+                                   (unsigned)hash.slots.size() - 1);
+        JUMP(table.keys[slot] == A.i ? table.targets[slot] : table.defaultTarget);
+    }
+    OP(SWITCH_S) {
+        const SwitchTable& table = program.switches[ip->k];
+        const PerfectHash& hash = table.hash;
+        const char* bytes = chars(A.p);
+        uint32_t size = length(A.p);
+        uint64_t h = switchHashString(bytes, size, hash.seed);
+        unsigned slot = switchSlot(h, hash.bucketSeeds[h & (hash.bucketSeeds.size() - 1)],
+                                   (unsigned)hash.slots.size() - 1);
+        const std::string& key = table.stringKeys[slot];
+        bool match = key.size() == size && memcmp(key.data(), bytes, size) == 0;
+        JUMP(match ? table.targets[slot] : table.defaultTarget);
+    }
+
+    OP(CALL) {
+        const VMFunction* callee = &functions[ip->k];
+        Value* calleeBase = base + ip->b;
+        if (calleeBase + callee->frameSize > registersEnd) fail(fn, ip, "call stack overflow");
+        frames.push_back({fn, ip + 1, base, &A, dataTop});
+        memcpy(calleeBase + callee->constBase, callee->constants.data(), callee->constants.size() * sizeof(Value));
+        fn = callee;
+        base = calleeBase;
+        ip = callee->code.data();
+        DISPATCH();
+    }
+    OP(BUILTIN) {
+        Value value = builtin((Builtin)ip->k, base + ip->b);
+        A = value;
+        NEXT();
+    }
+    OP(RET) { RETURN(A); }
+    OP(RET0) {
+        Value zero;
+        zero.i = 0;
+        RETURN(zero);
+    }
+
+    OP(NEWARR) {
+        int64_t count = B.i;
+        if (count < 0 || count > INT32_MAX) fail(fn, ip, "invalid array size %" PRId64, count);
+        size_t bytes = sizeof(VMArray) + (size_t)count * sizeof(Value);
+        if ((size_t)(dataEnd - dataTop) < bytes) fail(fn, ip, "out of stack space for arrays");
+        VMArray* array = reinterpret_cast<VMArray*>(dataTop);
+        dataTop += bytes;
+        array->data = reinterpret_cast<Value*>(array + 1);
+        array->len = (int)count;
+        array->cap = 0;
+        memset(array->data, 0, (size_t)count * sizeof(Value));
+        A.p = array;
+        NEXT();
+    }
+    OP(NEWDYN) {
+        void* array = calloc(1, sizeof(VMArray));
+        if (!array) fail(fn, ip, "out of memory");
+        A.p = array;
+        NEXT();
+    }
+    OP(GETE) {
+        const VMArray* array = static_cast<const VMArray*>(B.p);
+        int64_t index = C.i;
+        if ((uint64_t)index >= (uint64_t)array->len) {
+            fail(fn, ip, "index %d out of bounds for length %d", (int)index, array->len);
+        }
+        A = array->data[index];
+        NEXT();
+    }
+    OP(SETE) {
+        VMArray* array = static_cast<VMArray*>(A.p);
+        int64_t index = B.i;
+        if ((uint64_t)index >= (uint64_t)array->len) {
+            fail(fn, ip, "index %d out of bounds for length %d", (int)index, array->len);
+        }
+        array->data[index] = C;
+        NEXT();
+    }
+    OP(LEN) { A.i = static_cast<const VMArray*>(B.p)->len; NEXT(); }
+    OP(SLICE) {
+        const VMArray* array = static_cast<const VMArray*>(B.p);
+        int64_t low = C.i;
+        int64_t high = base[ip->c + 1].i;
+        if (low < 0 || high < low || high > array->len) {
+            fail(fn, ip, "slice [%d:%d] out of bounds for length %d", (int)low, (int)high, array->len);
+        }
+        VMArray* slice = static_cast<VMArray*>(allocate(sizeof(VMArray)));
+        slice->data = array->data + low;
+        slice->len = (int)(high - low);
+        slice->cap = slice->len;
+        A.p = slice;
+        NEXT();
+    }
+    OP(SLICE_S) {
+        uint32_t size = length(B.p);
+        int64_t low = C.i;
+        int64_t high = base[ip->c + 1].i;
+        if (low < 0 || high < low || high > size) {
+            fail(fn, ip, "slice [%d:%d] out of bounds for length %d", (int)low, (int)high, (int)size);
+        }
+        VMString* view = static_cast<VMString*>(allocate(sizeof(VMString)));
+        view->len = (uint32_t)(high - low);
+        view->data = chars(B.p) + low;
+        A.p = view;
+        NEXT();
+    }
+    OP(STRLEN) { A.i = length(B.p); NEXT(); }
+    OP(CONCAT) {
+        const Value* parts = base + ip->b;
+        size_t total = 0;
+        for (int i = 0; i < ip->k; i++) {
+            total += length(parts[i].p);
+        }
+        char* memory = static_cast<char*>(allocate(sizeof(VMString) + total));
+        VMString* s = reinterpret_cast<VMString*>(memory);
+        char* out = memory + sizeof(VMString);
+        s->len = (uint32_t)total;
+        s->data = out;
+        for (int i = 0; i < ip->k; i++) {
+            memcpy(out, chars(parts[i].p), length(parts[i].p));
+            out += length(parts[i].p);
+        }
+        A.p = s;
+        NEXT();
+    }
+#ifndef __GNUC__
+    }
+#endif
+
+#undef A
+#undef B
+#undef C
+#undef INT32
+#undef OP
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef RETURN
+    return 0;
+}
@@ -0,0 +1,53 @@
+#ifndef VM_H
+#define VM_H
+
+#include <cstddef>
+#include <vector>
+#include "bytecode.h"
+
+// Runs a BytecodeProgram in this process. Registers of all active calls
+// live on one stack: a call's frame starts at the caller's argument
+// registers, so arguments are never copied. Fixed arrays are carved from
+// a second stack and released when their function returns; strings and
+// slices made at run time come from an arena that lives as long as the
+// machine. Every index is bounds checked.
+class VirtualMachine {
+public:
+    explicit VirtualMachine(const BytecodeProgram& program);
+    ~VirtualMachine();
+    VirtualMachine(const VirtualMachine&) = delete;
+    VirtualMachine& operator=(const VirtualMachine&) = delete;
+
+    // Runs the entry function; returns what main returned.
+    int run();
+
+private:
+    struct Frame {
+        const VMFunction* function;
+        const Instruction* returnTo;
+        Value* base;
+        Value* result;
+        char* dataTop;
+    };
+
+    const BytecodeProgram& program;
+    std::vector<Value> globals;
+    std::vector<Frame> frames;
+    Value* registers;
+    Value* registersEnd;
+    char* data;
+    char* dataEnd;
+    std::vector<char*> arenaBlocks;
+    char* arenaNext;
+    char* arenaEnd;
+    bool inputEnded;
+    char* lineBuffer;
+    size_t lineCapacity;
+
+    void* allocate(size_t bytes);
+    const VMString* makeString(const char* bytes, size_t size);
+    Value builtin(Builtin id, Value* args);
+    [[noreturn]] void fail(const VMFunction* function, const Instruction* at, const char* format, ...);
+};
+
+#endif // VM_H